@@ -15,6 +15,7 @@ echo -en "cex 1 me\n" | nc -w1 -u $CAN_INTERFACE 2000
 ./read_servo_motion_queue $CAN_INTERFACE:$CAN_PORT $MOTOR_ID 2>&1 | tee read_servo_motion_queue.log
 ./read_servo_trajectory_time $CAN_INTERFACE:$CAN_PORT $MOTOR_ID 2>&1 | tee read_servo_trajectory_time.log
 ./check_motion_points 2>&1 | tee check_motion_points.log
+./check_trajectory_models 2>&1 | tee check_trajectory_models.log
 ./hb_timings $CAN_INTERFACE:$CAN_PORT $MOTOR_ID  2>&1 | tee hb_timings.log
 ./read_emcy_log $CAN_INTERFACE:$CAN_PORT $MOTOR_ID 2>&1 | tee read_emcy_log.log
 ./calibrate_cogging $CAN_INTERFACE:$CAN_PORT $MOTOR_ID 2>&1 | tee calibrate_cogging.log
@@ -85,6 +85,64 @@ typedef enum
     TPDO3 = 7,
 } rr_pdo_n_t;
 
+/**
+ * @brief RPDO to be sent within a group (see ::rr_send_pdo_group)
+ */
+typedef struct
+{
+    uint8_t id;         ///< Servo identifier
+    rr_pdo_n_t pdo_n;   ///< RPDO number
+    uint8_t len;        ///< Data length (up to 8 bytes)
+    uint8_t data[8];    ///< Data
+} rr_pdo_frame_t;
+
+/**
+ * @brief Bus representation of a PDO signal (see ::rr_pdo_signal_t)
+ */
+typedef enum
+{
+    RR_PDO_SIG_INT8 = 0,   ///< Signed 8-bit integer
+    RR_PDO_SIG_UINT8,      ///< Unsigned 8-bit integer
+    RR_PDO_SIG_INT16,      ///< Signed 16-bit integer
+    RR_PDO_SIG_UINT16,     ///< Unsigned 16-bit integer
+    RR_PDO_SIG_INT32,      ///< Signed 32-bit integer
+    RR_PDO_SIG_UINT32,     ///< Unsigned 32-bit integer
+    RR_PDO_SIG_FLOAT,      ///< 32-bit floating point
+} rr_pdo_sig_type_t;
+
+/**
+ * @brief PDO signal descriptor: an object to be mapped to a PDO and its place in the user state block
+ */
+typedef struct
+{
+    uint16_t idx;            ///< Object index
+    uint8_t sidx;            ///< Object sub-index
+    rr_pdo_sig_type_t type;  ///< Bus representation of the object elements
+    uint8_t count;           ///< Number of elements in the object (0 is treated as 1), e.g. 2 for a position-velocity pair
+    float scale;             ///< Scale factor: value = raw * scale (0 is treated as 1)
+    int offset;              ///< Offset of the first 'float' field in the user state block (use 'offsetof')
+} rr_pdo_signal_t;
+
+/**
+ * @brief Maximum number of signals in a PDO layout
+ */
+#define RR_PDO_MAX_SIGNALS 16
+
+/**
+ * @brief Compiled PDO layout (see ::rr_pdo_compile)
+ */
+typedef struct
+{
+    bool tx;                                ///< true - TPDOs (from servo), false - RPDOs (to servo)
+    int n_pdo;                              ///< Number of PDOs used by the layout
+    rr_pdo_n_t pdo[4];                      ///< PDO numbers used by the layout
+    uint8_t len[4];                         ///< Byte length of each PDO
+    int n_sig;                              ///< Number of signals
+    rr_pdo_signal_t sig[RR_PDO_MAX_SIGNALS]; ///< Signals
+    uint8_t sig_pdo[RR_PDO_MAX_SIGNALS];    ///< Index (in 'pdo') of the PDO carrying each signal
+    uint8_t sig_pos[RR_PDO_MAX_SIGNALS];    ///< Byte position of each signal within its PDO
+} rr_pdo_layout_t;
+
 /**
  * @brief Device parameter and source indices
  * 
@@ -198,6 +256,312 @@ typedef struct
     int32_t err_info;
 } emcy_log_entry_t;
 
+/**
+ * @brief Network census entry (see ::rr_net_list_nodes)
+ */
+typedef struct
+{
+	uint8_t id;             ///< Device CAN identifier
+	rr_nmt_state_t state;   ///< Last NMT state reported by the device heartbeat
+} rr_net_node_t;
+
+/**
+ * @brief Maximum length of the device identity strings (including the terminating zero)
+ */
+#define RR_NET_IDENT_STR_SIZE	64
+
+/**
+ * @brief Device identity read by ::rr_net_identify_nodes
+ */
+typedef struct
+{
+	uint8_t id;                                 ///< Device CAN identifier
+	rr_ret_status_t status;                     ///< RET_OK when all identity objects were read
+	char device_name[RR_NET_IDENT_STR_SIZE];    ///< Device name (0x1008)
+	char hw_version[RR_NET_IDENT_STR_SIZE];     ///< Hardware version (0x1009)
+	char sw_version[RR_NET_IDENT_STR_SIZE];     ///< Software version (0x100A)
+	uint32_t vendor_id;                         ///< Vendor ID (0x1018 sub-index 1)
+	uint32_t product_code;                      ///< Product code (0x1018 sub-index 2)
+	uint32_t revision;                          ///< Revision number (0x1018 sub-index 3)
+	uint32_t serial;                            ///< Serial number (0x1018 sub-index 4)
+} rr_net_node_identity_t;
+
+/**
+ * @brief Servo state mirror (see ::rr_servo_snapshot)
+ * <p>The 'float' fields (from 'position' to 'user') can be fed by any TPDO signals (see ::rr_servo_mirror_setup).</p>
+ */
+typedef struct
+{
+	float position;             ///< Output shaft position (degrees)
+	float velocity;             ///< Output shaft velocity (degrees per second)
+	float current;              ///< Phase current (A)
+	float queue_fill;           ///< Motion queue fill (number of points)
+	float user[4];              ///< Custom TPDO signals
+	rr_nmt_state_t nmt_state;   ///< NMT state
+	emcy_log_entry_t emcy;      ///< Last EMCY event
+	uint32_t emcy_count;        ///< Number of EMCY events received
+	uint32_t pdo_count;         ///< Number of TPDOs decoded into the mirror
+	int64_t pdo_timestamp_us;   ///< RX time of the last decoded TPDO (monotonic clock, microseconds), 0 if none
+} rr_servo_state_t;
+
+/**
+ * @brief Number of bins in a cycle timing histogram
+ */
+#define RR_CYCLE_HIST_BINS 32
+
+/**
+ * @brief Cycle timing histogram (see ::rr_cycle_monitor_read)
+ * <p>Bin 'k' counts the samples from 'lo_us + k * bin_us' to 'lo_us + (k + 1) * bin_us'. 
+ * The first and the last bins also count the samples below and above the histogram range.</p>
+ */
+typedef struct
+{
+	int32_t lo_us;                      ///< Lower bound of the first bin (microseconds)
+	int32_t bin_us;                     ///< Bin width (microseconds)
+	uint32_t bins[RR_CYCLE_HIST_BINS];  ///< Number of samples per bin
+	uint32_t n;                         ///< Total number of samples
+	int32_t min_us;                     ///< Minimum sample (microseconds)
+	int32_t max_us;                     ///< Maximum sample, i.e. the worst case (microseconds)
+	int64_t sum_us;                     ///< Sum of the samples, the mean is 'sum_us / n' (microseconds)
+} rr_cycle_hist_t;
+
+/**
+ * @brief SYNC timing statistics of an interface (see ::rr_cycle_monitor_read)
+ */
+typedef struct
+{
+	uint32_t cycle_us;          ///< Nominal cycle time (microseconds)
+	uint32_t late_us;           ///< Lateness tolerance (microseconds)
+	uint32_t cycles;            ///< Number of SYNC periods measured
+	uint32_t late_cycles;       ///< Number of SYNC periods longer than 'cycle_us + late_us'
+	uint32_t missing_tpdo;      ///< Number of cycles without TPDOs, summed over the monitored servos
+	int64_t window_us;          ///< Duration of the statistics window (microseconds)
+	rr_cycle_hist_t jitter;     ///< SYNC period deviation from the nominal cycle time
+} rr_cycle_stats_t;
+
+/**
+ * @brief TPDO timing statistics of a servo (see ::rr_cycle_monitor_read)
+ */
+typedef struct
+{
+	uint8_t id;                 ///< Device CAN identifier
+	uint32_t tpdo_count;        ///< Number of TPDOs received
+	uint32_t missing;           ///< Number of cycles without any TPDO from the servo
+	rr_cycle_hist_t latency;    ///< Latency from SYNC to TPDO arrival
+} rr_cycle_node_stats_t;
+
+/**
+ * @brief Motion trajectory point (see ::rr_add_motion_points)
+ */
+typedef struct
+{
+	float position_deg;             ///< Position (degrees)
+	float velocity_deg_per_sec;     ///< Velocity (degrees per second)
+	float accel_deg_per_sec2;       ///< Acceleration (degrees per second^2), PVAT points only
+	uint32_t time_ms;               ///< Time to move from the previous point (ms)
+} rr_motion_point_t;
+
+/**
+ * @brief Trajectory file signature ("RRTJ", see ::rr_trj_file_header_t)
+ */
+#define RR_TRJ_FILE_MAGIC 0x4A545252u
+/**
+ * @brief Trajectory file format version
+ */
+#define RR_TRJ_FILE_VERSION 1
+/**
+ * @brief Trajectory file flag: PVAT points (PVT points otherwise)
+ */
+#define RR_TRJ_FILE_PVAT 0x0001
+
+/**
+ * @brief Trajectory file header (see ::rr_trj_file_write). All fields are little-endian.
+ * <p>The header is followed by the axis table (::rr_trj_file_axis_t per axis) and, at 'data_offset', 
+ * by the contiguous array of point records (::rr_motion_point_t) of all the axes.</p>
+ */
+typedef struct __attribute__((packed))
+{
+	uint32_t magic;                 ///< ::RR_TRJ_FILE_MAGIC
+	uint16_t version;               ///< ::RR_TRJ_FILE_VERSION
+	uint16_t flags;                 ///< Flags (::RR_TRJ_FILE_PVAT)
+	uint32_t n_axes;                ///< Number of axes
+	uint32_t record_size;           ///< Size of a point record (bytes)
+	uint64_t data_offset;           ///< Offset of the record array from the start of the file (bytes, multiple of 16)
+	uint16_t crc;                   ///< CRC-16-CCITT of the axis table and the records of all the axes
+	uint16_t reserved[3];
+} rr_trj_file_header_t;
+
+/**
+ * @brief Trajectory file axis descriptor (see ::rr_trj_file_header_t)
+ */
+typedef struct __attribute__((packed))
+{
+	uint8_t id;                     ///< Axis (servo) identifier
+	uint8_t reserved[3];
+	uint32_t count;                 ///< Number of points of the axis
+	uint64_t offset;                ///< Index of the first point of the axis in the record array
+	rr_motion_point_t start;        ///< Initial state of the axis (the 'time_ms' field is not used), zero when unknown
+} rr_trj_file_axis_t;
+
+/**
+ * @brief Trajectory file instance (see ::rr_trj_file_open)
+ */
+typedef struct rr_trj_file_t rr_trj_file_t;
+
+/**
+ * @brief Trajectory segment polynomial (see ::rr_trj_compile)
+ */
+typedef struct
+{
+	double c[6];            ///< Position polynomial coefficients c[0] + c[1] * t + ... + c[5] * t^5 (degrees, t - seconds from the segment start)
+	double t0;              ///< Segment start time (s)
+	double duration;        ///< Segment duration (s)
+} rr_trj_segment_t;
+
+/**
+ * @brief Trajectory limits (see ::rr_check_trajectory)
+ */
+typedef struct
+{
+	float velocity_deg_per_sec;     ///< Velocity limit (degrees per second), 0 - not checked
+	float accel_deg_per_sec2;       ///< Acceleration limit (degrees per second^2), 0 - not checked
+	float jerk_deg_per_sec3;        ///< Jerk limit (degrees per second^3), 0 - not checked
+} rr_trj_limits_t;
+
+/**
+ * @brief Trajectory validation report (see ::rr_check_trajectory)
+ */
+typedef struct
+{
+	int *segments;                  ///< Set by the caller: array to receive the indices of the violating segments (the 'k'-th segment leads to the 'k'-th point) or NULL
+	int max_segments;               ///< Set by the caller: capacity of the 'segments' array
+	int violations;                 ///< Total number of violating segments
+	float velocity_max_deg_per_sec; ///< Peak absolute velocity of the trajectory
+	int velocity_max_segment;       ///< Segment with the peak velocity (-1 - none)
+	float accel_max_deg_per_sec2;   ///< Peak absolute acceleration of the trajectory
+	int accel_max_segment;          ///< Segment with the peak acceleration (-1 - none)
+	float jerk_max_deg_per_sec3;    ///< Peak absolute jerk of the trajectory
+	int jerk_max_segment;           ///< Segment with the peak jerk (-1 - none)
+} rr_trj_report_t;
+
+/**
+ * @brief Maximum number of points of a planned S-curve motion (see ::rr_plan_scurve)
+ */
+#define RR_SCURVE_MAX_POINTS 7
+
+/**
+ * @brief Maximum number of points of a blended segment (see ::rr_blend_get_points)
+ */
+#define RR_BLEND_MAX_POINTS 3
+
+/**
+ * @brief Motion blending planner (see ::rr_init_blend)
+ */
+typedef struct rr_blend_t rr_blend_t;
+
+/**
+ * @brief Setpoint streaming modes (see ::rr_init_stream)
+ */
+typedef enum
+{
+	RR_STREAM_PV = 0,       ///< Position-velocity setpoints buffered by the servo (RPDO2, RPDO3 and TPDO2 queue fill feedback)
+	RR_STREAM_VELOCITY,     ///< Motor shaft velocity setpoints (RPDO0)
+	RR_STREAM_CURRENT,      ///< Current setpoints (RPDO0)
+} rr_stream_mode_t;
+
+/**
+ * @brief Setpoint sample of a servo (see ::rr_stream_push)
+ */
+typedef struct
+{
+	float position;         ///< Position (degrees), PV mode
+	float velocity;         ///< Velocity (degrees per second), PV mode
+	float velocity_rpm;     ///< Motor shaft velocity (RPM, before the gearbox), velocity mode
+	float current;          ///< Current (A), current mode
+} rr_setpoint_t;
+
+/**
+ * @brief Setpoint streaming statistics (see ::rr_stream_get_stats)
+ */
+typedef struct
+{
+	uint32_t cycles;        ///< Number of cycles processed
+	uint32_t samples;       ///< Number of setpoint samples sent
+	uint32_t underruns;     ///< Number of cycles with the producer queue empty
+	uint32_t holds;         ///< Number of hold setpoints sent on underrun
+	uint32_t throttled;     ///< Number of cycles the transmission was held back by the servo queue fill (PV mode)
+	int queue_fill_max;     ///< Maximum reported servo queue fill (PV mode)
+} rr_stream_stats_t;
+
+/**
+ * @brief Setpoint stream instance (see ::rr_init_stream)
+ */
+typedef struct rr_stream_t rr_stream_t;
+
+/**
+ * @brief Trajectory source callback (see ::rr_init_traj_stream)
+ * @param ctx User context
+ * @param axis Index of the servo in the stream servo array
+ * @param points Array to receive the next points of the axis trajectory
+ * @param max Capacity of the 'points' array
+ * @return Number of points written (0 - end of the axis trajectory, negative - error)
+ */
+typedef int (*rr_traj_source_cb_t)(void *ctx, int axis, rr_motion_point_t *points, int max);
+
+/**
+ * @brief Trajectory streaming state (see ::rr_traj_stream_get_stats)
+ */
+typedef enum
+{
+	RR_TRAJ_STREAM_IDLE = 0,        ///< Not started
+	RR_TRAJ_STREAM_RUNNING,         ///< Motion is in progress, the motion queues are being refilled
+	RR_TRAJ_STREAM_DONE,            ///< All the points are executed
+	RR_TRAJ_STREAM_ERROR,           ///< Streaming is aborted (see the 'error' field of ::rr_traj_stream_stats_t)
+} rr_traj_stream_state_t;
+
+/**
+ * @brief Trajectory streaming statistics (see ::rr_traj_stream_get_stats)
+ */
+typedef struct
+{
+	rr_traj_stream_state_t state;   ///< Streaming state
+	rr_ret_status_t error;          ///< Failure status when the state is RR_TRAJ_STREAM_ERROR
+	int error_axis;                 ///< Index of the servo that failed (-1 - none)
+	uint64_t points;                ///< Total number of points uploaded
+	uint32_t refills;               ///< Number of refill uploads
+	uint32_t polls;                 ///< Number of motion queue polls
+	uint32_t min_queue;             ///< Minimum motion queue size observed while the trajectory was not exhausted
+	uint32_t capacity;              ///< Minimum motion queue capacity of the servos
+} rr_traj_stream_stats_t;
+
+/**
+ * @brief Trajectory stream instance (see ::rr_init_traj_stream)
+ */
+typedef struct rr_traj_stream_t rr_traj_stream_t;
+
+/**
+ * @brief Pre-encoded trajectory template (see ::rr_init_traj_template)
+ */
+typedef struct rr_traj_template_t rr_traj_template_t;
+
+/**
+ * @brief Telemetry service statistics (see ::rr_telemetry_get_stats)
+ */
+typedef struct
+{
+	uint32_t ticks;             ///< Number of scheduler ticks
+	uint64_t transactions;      ///< Number of SDO transactions issued
+	uint64_t frames;            ///< Estimated number of CAN frames used
+	uint64_t deferred;          ///< Number of due reads deferred to the next ticks due to the bus budget
+	uint32_t failures;          ///< Number of failed transactions
+	float load;                 ///< Budget share used in the last tick (may exceed 1 when the budget carried over is used)
+} rr_telemetry_stats_t;
+
+/**
+ * @brief Telemetry service instance (see ::rr_init_telemetry)
+ */
+typedef struct rr_telemetry_t rr_telemetry_t;
+
 /**
  * @brief Device instance structure
  * 
@@ -219,6 +583,9 @@ typedef struct
     void *emcy_cb; ///< EMCY callback pointer
     void *com_frame_cb; ///< CAN frame callback pointer
     void *pdo_cb; ///< PDO (from device)callback pointer
+    void *nodes;  ///< Per device internals (PDO bindings)
+    void *cycle_mon; ///< Cycle timing monitor internals
+    void *dispatch; ///< COB-ID dispatch table internals
     struct
     {
 	    emcy_log_entry_t *d;
@@ -257,6 +624,35 @@ typedef void (*rr_com_frame_cb_t)(rr_can_interface_t *iface, int cob_id, int dlc
  */
 typedef void (*rr_pdo_cb_t)(rr_can_interface_t *iface, int id, rr_pdo_n_t pdo_n, int len, uint8_t *data);
 
+/**
+ * @brief Extended (29-bit) CAN identifier flag of a COB-ID (see ::rr_send_com_frame and ::rr_setup_cob_callback)
+ */
+#define RR_CAN_EID_FLAG 0x40000000u
+
+/**
+ * @brief Type of the COB-ID callback (see ::rr_setup_cob_callback)<br>
+ * @param iface Descriptor of the interface (see ::rr_init_interface) where the frame was received
+ * @param cob_id ID of CAN frame (extended IDs are marked with ::RR_CAN_EID_FLAG)
+ * @param len Data Length Code (length of data field)
+ * @param data pointer to data
+ * @param ts_us RX time of the frame (monotonic clock, microseconds, see ::rr_get_rx_timestamp)
+ * @param ctx User context passed to ::rr_setup_cob_callback
+ * 
+ */
+typedef void (*rr_cob_cb_t)(rr_can_interface_t *iface, uint32_t cob_id, int len, uint8_t *data, int64_t ts_us, void *ctx);
+
+/**
+ * @brief Type of the servo PDO callback (see ::rr_setup_servo_pdo_callback)<br>
+ * @param servo Descriptor of the servo (see ::rr_init_servo) the PDO was received from
+ * @param pdo_n PDO number (TPDO0 to TPDO3)
+ * @param len Data Length Code (length of data field)
+ * @param data pointer to data
+ * @param ts_us RX time of the PDO (monotonic clock, microseconds, see ::rr_get_rx_timestamp)
+ * @param ctx User context passed to ::rr_setup_servo_pdo_callback
+ * 
+ */
+typedef void (*rr_servo_pdo_cb_t)(rr_servo_t *servo, rr_pdo_n_t pdo_n, int len, uint8_t *data, int64_t ts_us, void *ctx);
+
 /**
  * @brief Type of the intiated emergency (EMCY) callback<br>
  * @param iface Descriptor of the interface (see ::rr_init_interface) where the EMCY event occured
@@ -279,15 +675,24 @@ typedef void (*rr_emcy_cb_t)(rr_can_interface_t *iface, int servo_id, uint16_t c
 void rr_sleep_ms(int ms);
 rr_ret_status_t rr_write_raw_sdo(const rr_servo_t *servo, uint16_t idx, uint8_t sidx, uint8_t *data, int sz, int retry, int tout);
 rr_ret_status_t rr_read_raw_sdo(const rr_servo_t *servo, uint16_t idx, uint8_t sidx, uint8_t *data, int *sz, int retry, int tout);
+rr_ret_status_t rr_read_raw_sdo_coalesced(const rr_servo_t *servo, uint16_t idx, uint8_t sidx, uint8_t *data, int *sz, int retry, int tout, int max_age_ms);
 
 void rr_set_debug_log_stream(FILE *f);
 void rr_set_comm_log_stream(const rr_can_interface_t *iface, FILE *f);
 void rr_setup_nmt_callback(rr_can_interface_t *iface, rr_nmt_cb_t cb);
 void rr_setup_com_frame_callback(rr_can_interface_t *iface, rr_com_frame_cb_t cb);
 void rr_setup_pdo_callback(rr_can_interface_t *iface, rr_pdo_cb_t cb);
+int64_t rr_get_rx_timestamp(const rr_can_interface_t *iface);
+rr_ret_status_t rr_setup_cob_callback(rr_can_interface_t *iface, uint32_t cob_id, rr_cob_cb_t cb, void *ctx);
+rr_ret_status_t rr_setup_servo_pdo_callback(rr_servo_t *servo, rr_pdo_n_t pdo_n, rr_servo_pdo_cb_t cb, void *ctx);
 rr_ret_status_t rr_send_com_frame(const rr_can_interface_t *iface, uint32_t cob_id, int dlc, uint8_t *data);
 rr_ret_status_t rr_send_pdo(const rr_can_interface_t *iface, int id, rr_pdo_n_t pdo_n, int len, uint8_t *data);
 rr_ret_status_t rr_send_pdo_sync(const rr_can_interface_t *iface);
+rr_ret_status_t rr_send_pdo_group(const rr_can_interface_t *iface, const rr_pdo_frame_t *pdo, int n, bool sync);
+rr_ret_status_t rr_cycle_monitor_start(rr_can_interface_t *iface, uint32_t cycle_us, uint32_t late_us, const uint8_t *ids, int n);
+rr_ret_status_t rr_cycle_monitor_stop(rr_can_interface_t *iface);
+rr_ret_status_t rr_cycle_monitor_read(rr_can_interface_t *iface, rr_cycle_stats_t *stats, rr_cycle_node_stats_t *nodes, int *count, bool clear);
+rr_ret_status_t rr_cycle_monitor_set_summary(rr_can_interface_t *iface, int period_ms);
 
 rr_ret_status_t rr_pdo_disable(rr_servo_t *s, rr_pdo_n_t n);
 rr_ret_status_t rr_pdo_enable(rr_servo_t *s, rr_pdo_n_t n);
@@ -302,6 +707,24 @@ rr_ret_status_t rr_pdo_set_trans_type_sync(rr_servo_t *s, rr_pdo_n_t n, uint8_t
 rr_ret_status_t rr_pdo_set_trans_type_async(rr_servo_t *s, rr_pdo_n_t n);
 rr_ret_status_t rr_pdo_set_cycle_time(rr_servo_t *s, uint32_t cycle_time_us);
 
+rr_ret_status_t rr_pdo_compile(rr_pdo_layout_t *layout, bool tx, const rr_pdo_n_t *pdo_pool, int n_pool, const rr_pdo_signal_t *sig, int n_sig);
+rr_ret_status_t rr_pdo_program(rr_servo_t **servos, int n_servos, const rr_pdo_layout_t *layout, uint8_t trans_type);
+rr_ret_status_t rr_pdo_decode(const rr_pdo_layout_t *layout, rr_pdo_n_t pdo_n, const uint8_t *data, int len, void *state);
+rr_ret_status_t rr_pdo_encode(const rr_pdo_layout_t *layout, int k, const void *state, uint8_t *data, int *len);
+rr_ret_status_t rr_pdo_bind_state(rr_servo_t *servo, const rr_pdo_layout_t *layout, void *state);
+rr_ret_status_t rr_pdo_send_state(const rr_servo_t *servo, const rr_pdo_layout_t *layout, const void *state);
+rr_ret_status_t rr_servo_mirror_setup(rr_servo_t *servo, const rr_pdo_layout_t *layout);
+rr_ret_status_t rr_servo_snapshot(const rr_servo_t *servo, rr_servo_state_t *state);
+
+rr_stream_t *rr_init_stream(rr_servo_t **servos, int n, rr_stream_mode_t mode, int depth);
+rr_ret_status_t rr_deinit_stream(rr_stream_t **stream);
+rr_ret_status_t rr_stream_push(rr_stream_t *stream, const rr_setpoint_t *sp);
+rr_ret_status_t rr_stream_get_free_space(const rr_stream_t *stream, uint32_t *num);
+rr_ret_status_t rr_stream_start(rr_stream_t *stream, uint32_t cycle_us, int preload);
+rr_ret_status_t rr_stream_cycle(rr_stream_t *stream);
+rr_ret_status_t rr_stream_stop(rr_stream_t *stream);
+rr_ret_status_t rr_stream_get_stats(const rr_stream_t *stream, rr_stream_stats_t *stats);
+
 void rr_setup_emcy_callback(rr_can_interface_t *iface, rr_emcy_cb_t cb);
 const char *rr_describe_nmt(rr_nmt_state_t state);
 const char *rr_describe_emcy_code(uint16_t code);
@@ -313,6 +736,7 @@ void rr_emcy_log_clear(rr_can_interface_t *iface);
 rr_can_interface_t *rr_init_interface(const char *interface_name);
 rr_ret_status_t rr_deinit_interface(rr_can_interface_t **iface);
 rr_servo_t *rr_init_servo(rr_can_interface_t *iface, const uint8_t id);
+rr_ret_status_t rr_init_servos(rr_can_interface_t *iface, const uint8_t *ids, int n, rr_servo_t **servos);
 rr_ret_status_t rr_deinit_servo(rr_servo_t **servo);
 
 rr_ret_status_t rr_servo_reboot(const rr_servo_t *servo);
@@ -320,6 +744,7 @@ rr_ret_status_t rr_servo_reset_communication(const rr_servo_t *servo);
 rr_ret_status_t rr_servo_set_state_operational(const rr_servo_t *servo);
 rr_ret_status_t rr_servo_set_state_pre_operational(const rr_servo_t *servo);
 rr_ret_status_t rr_servo_set_state_stopped(const rr_servo_t *servo);
+rr_ret_status_t rr_servo_set_state_and_wait(const rr_servo_t *servo, rr_nmt_state_t state, int timeout_ms);
 
 rr_ret_status_t rr_servo_get_state(const rr_servo_t *servo, rr_nmt_state_t *state);
 rr_ret_status_t rr_servo_get_hb_stat(const rr_servo_t *servo, int64_t *min_hb_ival, int64_t *max_hb_ival);
@@ -330,7 +755,10 @@ rr_ret_status_t rr_net_reset_communication(const rr_can_interface_t *iface);
 rr_ret_status_t rr_net_set_state_operational(const rr_can_interface_t *iface);
 rr_ret_status_t rr_net_set_state_pre_operational(const rr_can_interface_t *iface);
 rr_ret_status_t rr_net_set_state_stopped(const rr_can_interface_t *iface);
+rr_ret_status_t rr_net_set_state_and_wait(const rr_can_interface_t *iface, rr_nmt_state_t state, const uint8_t *ids, int n, int timeout_ms);
 rr_ret_status_t rr_net_get_state(const rr_can_interface_t *iface, int id, rr_nmt_state_t *state);
+rr_ret_status_t rr_net_list_nodes(const rr_can_interface_t *iface, rr_net_node_t *nodes, int *count);
+rr_ret_status_t rr_net_identify_nodes(const rr_can_interface_t *iface, const rr_net_node_t *nodes, rr_net_node_identity_t *ident, int count);
 
 rr_ret_status_t rr_release(const rr_servo_t *servo);
 rr_ret_status_t rr_freeze(const rr_servo_t *servo);
@@ -345,6 +773,8 @@ rr_ret_status_t rr_get_velocity_rate(const rr_servo_t *servo, float *const veloc
 rr_ret_status_t rr_set_position(const rr_servo_t *servo, const float position_deg);
 rr_ret_status_t rr_set_velocity_with_limits(const rr_servo_t *servo, const float velocity_deg_per_sec, const float current_a);
 rr_ret_status_t rr_set_position_with_limits(rr_servo_t *servo, const float position_deg, const float velocity_deg_per_sec, const float accel_deg_per_sec_sq, uint32_t *time_ms);
+rr_ret_status_t rr_group_move_to(rr_servo_t *const *servos, int n, const float *targets_deg, 
+    const float *vmax_deg_per_sec, const float *amax_deg_per_sec_sq, uint32_t *time_ms);
 rr_ret_status_t rr_set_duty(const rr_servo_t *servo, float duty_percent);
 
 rr_ret_status_t rr_add_motion_point(const rr_servo_t *servo, const float position_deg, const float velocity_deg, const uint32_t time_ms);
@@ -354,16 +784,64 @@ rr_ret_status_t rr_add_motion_point_pvat(
     const float velocity_deg_per_sec, 
     const float accel_deg_per_sec2, 
     const uint32_t time_ms);
+rr_ret_status_t rr_add_motion_points(const rr_servo_t *servo, const rr_motion_point_t *points, int n, bool pvat, int *rejected);
+rr_ret_status_t rr_add_motion_points_group(rr_servo_t *const *servos, int n_servos, 
+    const rr_motion_point_t *const *points, const int *n, bool pvat, int *rejected);
+rr_traj_template_t *rr_init_traj_template(rr_servo_t *const *servos, int n_servos, const rr_motion_point_t *const *points, const int *n, 
+    bool pvat, const rr_motion_point_t *start, const rr_trj_limits_t *limits);
+rr_ret_status_t rr_deinit_traj_template(rr_traj_template_t **tmpl);
+rr_ret_status_t rr_traj_template_play(rr_traj_template_t *tmpl, const float *offset_deg, bool start);
     
 rr_ret_status_t rr_start_motion(rr_can_interface_t *iface, uint32_t timestamp_ms);
 
+rr_ret_status_t rr_trj_compile(const rr_motion_point_t *start, const rr_motion_point_t *points, int n, bool pvat, rr_trj_segment_t *segments);
+int rr_trj_sample_count(const rr_trj_segment_t *segments, int n, double step_s);
+int rr_trj_sample(const rr_trj_segment_t *segments, int n, double step_s, float *pos, float *vel, float *acc, int max);
+rr_ret_status_t rr_trj_eval(const rr_trj_segment_t *segments, int n, double t_s, float *pos, float *vel, float *acc);
+rr_ret_status_t rr_check_trajectory(const rr_motion_point_t *start, const rr_motion_point_t *points, int n, bool pvat, 
+    const rr_trj_limits_t *limits, rr_trj_report_t *report);
+rr_ret_status_t rr_calc_segment_time(const rr_motion_point_t *start, const rr_motion_point_t *end, const rr_trj_limits_t *limits, uint32_t *time_ms);
+rr_ret_status_t rr_calc_trajectory_time(const rr_motion_point_t *start, rr_motion_point_t *points, int n, const rr_trj_limits_t *limits, int *failed);
+rr_ret_status_t rr_trj_file_write(const char *path, const rr_trj_file_axis_t *axes, const rr_motion_point_t *const *points, int n_axes, bool pvat);
+rr_trj_file_t *rr_trj_file_open(const char *path, bool verify);
+rr_ret_status_t rr_trj_file_close(rr_trj_file_t **file);
+rr_ret_status_t rr_trj_file_get_info(const rr_trj_file_t *file, int *n_axes, bool *pvat);
+rr_ret_status_t rr_trj_file_get_axis(const rr_trj_file_t *file, int axis, rr_trj_file_axis_t *info, const rr_motion_point_t **points, int *n);
+int rr_trj_file_source(void *file, int axis, rr_motion_point_t *points, int max);
+rr_ret_status_t rr_trj_file_rewind(rr_trj_file_t *file);
+rr_ret_status_t rr_trj_file_from_csv(const char *csv_path, const char *path, bool pvat);
+rr_ret_status_t rr_trj_fit(const float *pos, const float *vel, const float *acc, int n, uint32_t step_ms, float tol_deg,
+    rr_motion_point_t *start, rr_motion_point_t *points, int *n_points);
+rr_blend_t *rr_init_blend(float start_deg, const rr_trj_limits_t *limits, int depth);
+rr_ret_status_t rr_deinit_blend(rr_blend_t **blend);
+rr_ret_status_t rr_blend_add_waypoint(rr_blend_t *blend, float position_deg, float tol_deg);
+int rr_blend_get_points(rr_blend_t *blend, rr_motion_point_t *points, int max, bool flush);
+rr_ret_status_t rr_plan_scurve(const rr_motion_point_t *start, float position_deg, const rr_trj_limits_t *limits, 
+    rr_motion_point_t *points, int *n, uint32_t *time_ms);
+
+rr_traj_stream_t *rr_init_traj_stream(rr_servo_t *const *servos, int n, bool pvat, rr_traj_source_cb_t source, void *ctx);
+rr_ret_status_t rr_deinit_traj_stream(rr_traj_stream_t **stream);
+rr_ret_status_t rr_traj_stream_start(rr_traj_stream_t *stream, uint32_t low_watermark, uint32_t poll_ms, uint32_t timestamp_ms);
+rr_ret_status_t rr_traj_stream_wait(rr_traj_stream_t *stream, int timeout_ms);
+rr_ret_status_t rr_traj_stream_get_stats(rr_traj_stream_t *stream, rr_traj_stream_stats_t *stats);
+
 rr_ret_status_t rr_read_error_status(const rr_servo_t *servo, uint32_t *const error_count, uint8_t *const error_array);
 
 rr_ret_status_t rr_param_cache_update(rr_servo_t *servo);
 rr_ret_status_t rr_param_cache_update_with_timestamp(rr_servo_t *servo);
 rr_ret_status_t rr_param_cache_setup_entry(rr_servo_t *servo, const rr_servo_param_t param, bool enabled);
+rr_ret_status_t rr_param_cache_stream_enable(rr_servo_t *servo, uint8_t trans_type, const rr_pdo_n_t *pdo_pool, int n_pool);
+rr_ret_status_t rr_param_cache_stream_disable(rr_servo_t *servo);
+
+rr_telemetry_t *rr_init_telemetry(rr_can_interface_t *iface, uint32_t tick_ms, uint32_t bitrate, float bus_share);
+rr_ret_status_t rr_deinit_telemetry(rr_telemetry_t **telemetry);
+rr_ret_status_t rr_telemetry_subscribe(rr_telemetry_t *telemetry, rr_servo_t *servo, rr_servo_param_t param, float rate_hz, int priority);
+rr_ret_status_t rr_telemetry_unsubscribe(rr_telemetry_t *telemetry, rr_servo_t *servo, rr_servo_param_t param);
+rr_ret_status_t rr_telemetry_get_rate(rr_telemetry_t *telemetry, const rr_servo_t *servo, rr_servo_param_t param, float *rate_hz);
+rr_ret_status_t rr_telemetry_get_stats(rr_telemetry_t *telemetry, rr_telemetry_stats_t *stats);
 
 rr_ret_status_t rr_read_parameter(rr_servo_t *servo, const rr_servo_param_t param, float *value);
+rr_ret_status_t rr_read_parameter_coalesced(rr_servo_t *servo, const rr_servo_param_t param, float *value, int max_age_ms);
 rr_ret_status_t rr_read_parameter_with_timestamp(rr_servo_t *servo, const rr_servo_param_t param, float *value, uint32_t *timestamp);
 rr_ret_status_t rr_read_cached_parameter(rr_servo_t *servo, const rr_servo_param_t param, float *value);
 rr_ret_status_t rr_read_cached_parameter_with_timestamp(rr_servo_t *servo, const rr_servo_param_t param, float *value, uint32_t *timestamp);
@@ -40,6 +40,7 @@
  * -# \ref tutor_c_read_emcy_log
  * -# \ref tutor_c_check_motion_points
  * -# \ref tutor_c_time_optimal_movement
+ * -# \ref tutor_c_check_trajectory_models
  * 
  * 
  * \defgroup Init Initialization and deinitialization
@@ -70,6 +71,7 @@
  * \defgroup tutor_c_read_emcy_log Reading emergency (EMY) log
  * \defgroup tutor_c_check_motion_points Checking PVT points
  * \defgroup tutor_c_time_optimal_movement Setting position with limits
+ * \defgroup tutor_c_check_trajectory_models Verifying the trajectory model and planners
  */
 /* Includes ------------------------------------------------------------------*/
 #include "api.h"
@@ -81,11 +83,150 @@
 
 //! @cond Doxygen_Suppress
 /* Private typedef -----------------------------------------------------------*/
+typedef struct
+{
+	const rr_pdo_layout_t *tpdo_layout;
+	void *tpdo_state;
+	const rr_pdo_layout_t *mirror_layout;
+	uint32_t mirror_seq;
+	rr_servo_state_t mirror;
+	int64_t mirror_pdo_us[4]; //RX time of the last TPDO0-TPDO3 decoded into the mirror, 0 if none
+	const rr_pdo_layout_t *tpdo_map[4]; //layout programmed to TPDO0-TPDO3: NULL - factory, &mirror_none_layout - unknown
+	rr_servo_t *pcache_servo;
+	rr_pdo_layout_t pcache_layout;
+	const rr_pdo_layout_t *pcache_mirror; //mirror layout detached while TPDO0 is taken by streaming
+	bool pcache_tpdo0_saved; //TPDO0 settings below are saved before streaming remaps it
+	uint8_t pcache_tpdo0_cnt;
+	uint8_t pcache_tpdo0_tt;
+	uint32_t pcache_tpdo0_cob;
+	uint32_t pcache_tpdo0_map[8];
+	const rr_pdo_layout_t *pcache_tpdo0_owner;
+	float max_velocity; //cached rr_get_max_velocity value
+	int64_t max_velocity_us; //time max_velocity was read, 0 - unknown
+} __attribute__((aligned(64))) rr_node_t; //cache line aligned
+
+typedef struct
+{
+	pthread_mutex_t mutex;
+	bool enabled;
+	int64_t sync_us;
+	int64_t prev_sync_us;
+	int64_t window_start_us;
+	int64_t summary_ival_us;
+	rr_cycle_stats_t stats;
+	int n_ids;
+	uint8_t ids[MAX_CO_DEV];
+	bool monitored[MAX_CO_DEV];
+	bool seen[MAX_CO_DEV];
+	rr_cycle_node_stats_t node[MAX_CO_DEV];
+} rr_cycle_mon_t;
+
+struct rr_traj_stream_t
+{
+	rr_can_interface_t *iface;
+	int n;
+	rr_servo_t **servos;
+	bool pvat;
+	rr_traj_source_cb_t source;
+	void *ctx;
+	uint32_t low_watermark;
+	uint32_t poll_ms;
+	uint32_t *cap;
+	bool *exhausted;
+	int *count;
+	rr_motion_point_t **buf;
+	pthread_t thread;
+	bool thread_running;
+	bool stop;
+	pthread_mutex_t mutex;
+	rr_traj_stream_stats_t stats;
+};
+
+struct rr_traj_template_t
+{
+	usbcan_instance_t *inst;
+	int n;
+	rr_servo_t **servos;
+	int *servo_of;
+	int total;
+	int size;
+	float *position;
+	uint8_t *buf;
+	usbcan_sdo_req_t *req;
+};
+
+typedef struct
+{
+	rr_servo_t *servo;
+	rr_servo_param_t param;
+	int priority;
+	int64_t period_us;
+	int64_t due_us;
+	int64_t last_us;
+	int64_t since_us; //subscription time
+	float interval_us; //moving average of the read interval
+	bool own_entry;
+} telemetry_sub_t;
+
+struct rr_telemetry_t
+{
+	usbcan_instance_t *inst;
+	uint32_t tick_ms;
+	double frames_per_tick;
+	double tokens;
+	int n;
+	int cap;
+	telemetry_sub_t *sub;
+	pthread_t thread;
+	bool thread_running;
+	bool stop;
+	pthread_mutex_t mutex;
+	rr_telemetry_stats_t stats;
+};
+
+struct rr_stream_t
+{
+	rr_can_interface_t *iface;
+	rr_stream_mode_t mode;
+	int n;
+	rr_servo_t **servos;
+	uint32_t depth;
+	uint32_t head;
+	uint32_t tail;
+	rr_setpoint_t *q;
+	rr_setpoint_t *last;
+	int *fill;
+	rr_pdo_frame_t *pdo;
+	int preload;
+	bool started;
+	rr_stream_stats_t stats;
+};
+
+typedef struct
+{
+	uint32_t seq;
+	uint32_t key;
+	void *cb;
+	void *ctx;
+	rr_servo_t *servo;
+} rr_cob_entry_t;
+
 /* Private define ------------------------------------------------------------*/
 #define RR_API_WAIT_DEVICE_TIMEOUT_MS 2000
 #define RR_API_REBOOT_TIMEOUT_MS 10000
 #define RR_API_RESET_COMM_TIMEOUT_MS 5000
 #define RR_API_CHANGE_STATE_TIMEOUT_MS 2000
+#define RR_API_COALESCE_AGE_MS 0
+#define RR_API_COB_STD_SIZE 2048
+#define RR_API_COB_EXT_BITS 8
+#define RR_API_COB_EXT_SIZE (1 << RR_API_COB_EXT_BITS)
+#define RR_API_TPDO_COB_ID(id, pdo_n) (0x180 + 0x100 * ((pdo_n) - TPDO0) + (id))
+#define RR_API_STREAM_FILL_SLACK 2
+#define RR_API_STREAM_CW_START (1 << 4)
+#define RR_API_MIRROR_POSITION_AGE_US 20000
+#define RR_API_MAX_VELOCITY_AGE_US 1000000 //the limit follows the supply voltage
+#define RR_API_TELEMETRY_FRAME_BITS 135 //8 byte standard frame with worst case bit stuffing and interframe space
+#define RR_API_TELEMETRY_ARRAY_FRAMES(m) (2 + 2 * ((4 * (m) + 6) / 7)) //segmented upload of 'm' parameters
 
 /* Private macro -------------------------------------------------------------*/
 #define BIT_SET_UINT_ARRAY(array, bit) ((array)[(bit) / 8] |= (1 << ((bit) % 8)))
@@ -105,10 +246,371 @@
 //! @w
 
 /* Private variables ---------------------------------------------------------*/
+/*Factory TPDO0 mapping: position (float), velocity (0.02 deg/s), current (0.0016 A)*/
+static const rr_pdo_layout_t mirror_default_layout = 
+{
+	.tx = true,
+	.n_pdo = 1,
+	.pdo = {TPDO0},
+	.len = {8},
+	.n_sig = 3,
+	.sig = 
+	{
+		{.type = RR_PDO_SIG_FLOAT, .count = 1, .scale = 1.0, .offset = offsetof(rr_servo_state_t, position)},
+		{.type = RR_PDO_SIG_INT16, .count = 1, .scale = 0.02, .offset = offsetof(rr_servo_state_t, velocity)},
+		{.type = RR_PDO_SIG_INT16, .count = 1, .scale = 0.0016, .offset = offsetof(rr_servo_state_t, current)},
+	},
+	.sig_pdo = {0, 0, 0},
+	.sig_pos = {0, 4, 6},
+};
+
+/*Empty layout: the mirror is detached from the TPDOs (nothing is decoded)*/
+static const rr_pdo_layout_t mirror_none_layout = {.tx = true};
+
 /* Extern variables ----------------------------------------------------------*/
 /* Extern function prototypes ------------------------------------------------*/
 /* Private function prototypes -----------------------------------------------*/
+static rr_ret_status_t add_motion_points_batch(const rr_servo_t *const *servos, int n_servos, 
+		const rr_motion_point_t *const *points, const int *n, bool pvat, bool check_space, int *rejected);
 /* Private functions ---------------------------------------------------------*/
+static void *aligned_calloc(size_t sz, size_t align)
+{
+	uint8_t *m = (uint8_t *)calloc(1, sz + align + sizeof(void *));
+	if(!m)
+	{
+		return NULL;
+	}
+	uint8_t *p = (uint8_t *)(((uintptr_t)m + sizeof(void *) + align - 1) & ~(uintptr_t)(align - 1));
+	((void **)p)[-1] = m;
+	return p;
+}
+
+static void aligned_free(void *p)
+{
+	if(p)
+	{
+		free(((void **)p)[-1]);
+	}
+}
+
+/*
+ * Servo state mirror is written by the interface thread only (single writer),
+ * readers retry while an update is in progress (odd sequence number) or has happened during their copy.
+ */
+static void mirror_write_begin(rr_node_t *n)
+{
+	__atomic_store_n(&n->mirror_seq, n->mirror_seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void mirror_write_end(rr_node_t *n)
+{
+	__atomic_store_n(&n->mirror_seq, n->mirror_seq + 1, __ATOMIC_RELEASE);
+}
+
+static rr_node_t *get_node(usbcan_instance_t *inst, int id)
+{
+	rr_can_interface_t *i = (rr_can_interface_t *)inst->udata;
+
+	if(!i || !i->nodes || !INRANGE(id, 0, MAX_CO_DEV - 1))
+	{
+		return NULL;
+	}
+	return &((rr_node_t *)i->nodes)[id];
+}
+
+static bool param_cache_is_streamed(const rr_servo_t *servo)
+{
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	rr_node_t *n = get_node(dev->inst, dev->id);
+
+	return n && (__atomic_load_n(&n->pcache_servo, __ATOMIC_ACQUIRE) == servo);
+}
+
+static void cycle_hist_init(rr_cycle_hist_t *h, int32_t lo_us, int32_t range_us)
+{
+	memset(h, 0, sizeof(*h));
+	h->lo_us = lo_us;
+	h->bin_us = MAX(1, range_us / RR_CYCLE_HIST_BINS);
+}
+
+static void cycle_hist_clear(rr_cycle_hist_t *h)
+{
+	cycle_hist_init(h, h->lo_us, h->bin_us * RR_CYCLE_HIST_BINS);
+}
+
+static void cycle_hist_add(rr_cycle_hist_t *h, int64_t v)
+{
+	int32_t s = (int32_t)CLIP(v, INT32_MIN, INT32_MAX);
+	int64_t k = ((int64_t)s - h->lo_us) / h->bin_us;
+
+	h->bins[CLIP(k, 0, RR_CYCLE_HIST_BINS - 1)]++;
+	if(!h->n || (s < h->min_us))
+	{
+		h->min_us = s;
+	}
+	if(!h->n || (s > h->max_us))
+	{
+		h->max_us = s;
+	}
+	h->n++;
+	h->sum_us += s;
+}
+
+static double cycle_hist_mean(const rr_cycle_hist_t *h)
+{
+	return h->n ? (double)h->sum_us / h->n : 0.0;
+}
+
+/*
+ * Called with the monitor mutex held.
+ */
+static void cycle_mon_clear(rr_cycle_mon_t *m, int64_t now)
+{
+	m->stats.cycles = 0;
+	m->stats.late_cycles = 0;
+	m->stats.missing_tpdo = 0;
+	m->stats.window_us = 0;
+	m->window_start_us = now;
+	cycle_hist_clear(&m->stats.jitter);
+
+	for(int k = 0; k < m->n_ids; k++)
+	{
+		rr_cycle_node_stats_t *n = &m->node[m->ids[k]];
+		n->tpdo_count = 0;
+		n->missing = 0;
+		cycle_hist_clear(&n->latency);
+	}
+}
+
+static void cycle_mon_print(const rr_cycle_stats_t *st, const rr_cycle_node_stats_t *n, int count)
+{
+	LOG_INFO(debug_log, "Cycle %" PRIu32 " us, window %" PRId64 " ms: %" PRIu32 " cycles, %" PRIu32 " late, %" PRIu32 " missing TPDOs, SYNC jitter min/mean/max %" PRId32 "/%.1f/%" PRId32 " us",
+			st->cycle_us, st->window_us / 1000, st->cycles, st->late_cycles, st->missing_tpdo,
+			st->jitter.min_us, cycle_hist_mean(&st->jitter), st->jitter.max_us);
+
+	for(int k = 0; k < count; k++)
+	{
+		LOG_INFO(debug_log, "  ID: %d %" PRIu32 " TPDOs, %" PRIu32 " missing, SYNC to TPDO latency min/mean/max %" PRId32 "/%.1f/%" PRId32 " us",
+				n[k].id, n[k].tpdo_count, n[k].missing,
+				n[k].latency.min_us, cycle_hist_mean(&n[k].latency), n[k].latency.max_us);
+	}
+}
+
+/*
+ * SYNC has just been transmitted ('now' is taken right before the transmission): close the previous cycle.
+ */
+static void cycle_mon_sync(const rr_can_interface_t *iface, int64_t now)
+{
+	rr_cycle_mon_t *m = (rr_cycle_mon_t *)iface->cycle_mon;
+
+	if(!m || !__atomic_load_n(&m->enabled, __ATOMIC_ACQUIRE))
+	{
+		return;
+	}
+
+	bool summary = false;
+	rr_cycle_stats_t st;
+	rr_cycle_node_stats_t n[MAX_CO_DEV];
+	int count = 0;
+
+	pthread_mutex_lock(&m->mutex);
+	if(m->sync_us)
+	{
+		int64_t period = now - m->sync_us;
+
+		m->stats.cycles++;
+		if(period > (int64_t)m->stats.cycle_us + m->stats.late_us)
+		{
+			m->stats.late_cycles++;
+		}
+		cycle_hist_add(&m->stats.jitter, period - m->stats.cycle_us);
+
+		for(int k = 0; k < m->n_ids; k++)
+		{
+			if(!m->seen[m->ids[k]])
+			{
+				m->node[m->ids[k]].missing++;
+				m->stats.missing_tpdo++;
+			}
+		}
+	}
+	memset(m->seen, 0, sizeof(m->seen));
+	m->prev_sync_us = m->sync_us;
+	m->sync_us = now;
+
+	if(m->summary_ival_us && ((now - m->window_start_us) >= m->summary_ival_us))
+	{
+		st = m->stats;
+		st.window_us = now - m->window_start_us;
+		for(count = 0; count < m->n_ids; count++)
+		{
+			n[count] = m->node[m->ids[count]];
+		}
+		cycle_mon_clear(m, now);
+		summary = true;
+	}
+	pthread_mutex_unlock(&m->mutex);
+
+	if(summary)
+	{
+		cycle_mon_print(&st, n, count);
+	}
+}
+
+static void cycle_mon_tpdo(const rr_can_interface_t *iface, int id, int64_t ts_us)
+{
+	rr_cycle_mon_t *m = (rr_cycle_mon_t *)iface->cycle_mon;
+
+	if(!m || !__atomic_load_n(&m->enabled, __ATOMIC_ACQUIRE) || !INRANGE(id, 0, MAX_CO_DEV - 1))
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&m->mutex);
+	if(m->monitored[id] && m->sync_us)
+	{
+		m->node[id].tpdo_count++;
+		if((ts_us >= m->sync_us) || !m->prev_sync_us)
+		{
+			m->seen[id] = true;
+			cycle_hist_add(&m->node[id].latency, ts_us - m->sync_us);
+		}
+		else
+		{
+			//received before the last SYNC, handled late
+			cycle_hist_add(&m->node[id].latency, ts_us - m->prev_sync_us);
+		}
+	}
+	pthread_mutex_unlock(&m->mutex);
+}
+
+/*
+ * COB-ID dispatch table: flat table for 11-bit identifiers, open addressing hash for extended ones.
+ * Entries are updated under the table mutex and read lock-free by the interface thread (seqlock).
+ * The 'busy' counter is odd while the interface thread runs the frame callbacks, so that a servo unpublished 
+ * from the table (and from the parameter cache streaming) is only freed after the callbacks that might still use it (see dispatch_grace).
+ */
+typedef struct
+{
+	pthread_mutex_t mutex;
+	uint32_t busy;
+	rr_cob_entry_t std[RR_API_COB_STD_SIZE];
+	rr_cob_entry_t ext[RR_API_COB_EXT_SIZE];
+} rr_dispatch_t;
+
+static void dispatch_enter(rr_dispatch_t *d)
+{
+	__atomic_store_n(&d->busy, d->busy + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static void dispatch_leave(rr_dispatch_t *d)
+{
+	__atomic_store_n(&d->busy, d->busy + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Waits until the callbacks running at the moment (if any) are finished. Called after a servo has been unpublished.
+ */
+static void dispatch_grace(usbcan_instance_t *inst, rr_dispatch_t *d)
+{
+	if(pthread_equal(pthread_self(), inst->usbcan_thread))
+	{
+		return; //called from a callback
+	}
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	uint32_t busy = __atomic_load_n(&d->busy, __ATOMIC_ACQUIRE);
+
+	while((busy & 1) && (__atomic_load_n(&d->busy, __ATOMIC_ACQUIRE) == busy))
+	{
+		msleep(1);
+	}
+}
+
+static rr_cob_entry_t *cob_lookup(rr_dispatch_t *d, uint32_t cob_id, bool insert)
+{
+	if(!(cob_id & RR_CAN_EID_FLAG))
+	{
+		return &d->std[cob_id & (RR_API_COB_STD_SIZE - 1)];
+	}
+
+	uint32_t h = (cob_id * 2654435761u) >> (32 - RR_API_COB_EXT_BITS);
+
+	for(int k = 0; k < RR_API_COB_EXT_SIZE; k++)
+	{
+		rr_cob_entry_t *e = &d->ext[(h + k) & (RR_API_COB_EXT_SIZE - 1)];
+		uint32_t key = __atomic_load_n(&e->key, __ATOMIC_ACQUIRE);
+
+		if(key == cob_id)
+		{
+			return e;
+		}
+		if(!key)
+		{
+			return insert ? e : NULL;
+		}
+	}
+	return NULL;
+}
+
+static bool cob_entry_load(const rr_cob_entry_t *e, rr_cob_entry_t *c)
+{
+	uint32_t seq;
+
+	do
+	{
+		seq = __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE);
+		c->cb = __atomic_load_n(&e->cb, __ATOMIC_RELAXED);
+		c->ctx = __atomic_load_n(&e->ctx, __ATOMIC_RELAXED);
+		c->servo = __atomic_load_n(&e->servo, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	}
+	while((seq & 1) || (seq != __atomic_load_n(&e->seq, __ATOMIC_RELAXED)));
+
+	return c->cb != NULL;
+}
+
+/*
+ * Called with the table mutex held.
+ */
+static void cob_entry_store(rr_cob_entry_t *e, uint32_t cob_id, void *cb, void *ctx, rr_servo_t *servo)
+{
+	__atomic_store_n(&e->seq, e->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&e->cb, cb, __ATOMIC_RELAXED);
+	__atomic_store_n(&e->ctx, ctx, __ATOMIC_RELAXED);
+	__atomic_store_n(&e->servo, servo, __ATOMIC_RELAXED);
+	__atomic_store_n(&e->seq, e->seq + 1, __ATOMIC_RELEASE);
+
+	if(cob_id & RR_CAN_EID_FLAG)
+	{
+		//hash keys are never removed, unregistered entry stays as a tombstone
+		__atomic_store_n(&e->key, cob_id, __ATOMIC_RELEASE);
+	}
+}
+
+static void cob_dispatch(rr_can_interface_t *i, uint32_t cob_id, int len, uint8_t *data, int64_t ts_us)
+{
+	rr_cob_entry_t *e = cob_lookup((rr_dispatch_t *)i->dispatch, cob_id, false);
+	rr_cob_entry_t c;
+
+	if(!e || !cob_entry_load(e, &c))
+	{
+		return;
+	}
+
+	if(c.servo)
+	{
+		((rr_servo_pdo_cb_t)c.cb)(c.servo, (rr_pdo_n_t)(TPDO0 + ((cob_id - 0x180) >> 8)), len, data, ts_us, c.ctx);
+	}
+	else
+	{
+		((rr_cob_cb_t)c.cb)(i, cob_id, len, data, ts_us, c.ctx);
+	}
+}
+
 static rr_ret_status_t ret_sdo(int code)
 {
 	switch(code)
@@ -122,31 +624,115 @@ static rr_ret_status_t ret_sdo(int code)
 	}
 }
 
+static int nmt_cmd(rr_nmt_state_t state)
+{
+	switch(state)
+	{
+		case RR_NMT_OPERATIONAL:
+			return CO_NMT_CMD_GOTO_OP;
+		case RR_NMT_PRE_OPERATIONAL:
+			return CO_NMT_CMD_GOTO_PREOP;
+		case RR_NMT_STOPPED:
+			return CO_NMT_CMD_GOTO_STOPPED;
+		default:
+			return -1;
+	}
+}
+
 void rr_nmt_state_master_cb(usbcan_instance_t *inst, int id, usbcan_nmt_state_t state)
 {
 	rr_can_interface_t *i = (rr_can_interface_t *)inst->udata;
 
 	LOG_INFO(debug_log, "ID: %d %s", id, rr_describe_nmt((rr_nmt_state_t)state));
 
+	rr_node_t *n = get_node(inst, id);
+	if(n)
+	{
+		mirror_write_begin(n);
+		n->mirror.nmt_state = (rr_nmt_state_t)state;
+		mirror_write_end(n);
+		if(state == (usbcan_nmt_state_t)RR_NMT_INITIALIZING)
+		{
+			//boot-up restores the default velocity limit and the stored PDO mapping
+			__atomic_store_n(&n->max_velocity_us, 0, __ATOMIC_RELEASE);
+			for(int k = 0; k < 4; k++)
+			{
+				__atomic_store_n(&n->tpdo_map[k], NULL, __ATOMIC_RELEASE);
+			}
+		}
+	}
+
 	if(i->nmt_cb)
 	{
 		((rr_nmt_cb_t)(i->nmt_cb))(i, id, (rr_nmt_state_t)state);
 	}
 }
 
-void rr_com_frame_cb(usbcan_instance_t *inst, can_msg_t *m)
+void rr_com_frame_cb(usbcan_instance_t *inst, can_msg_t *m, int64_t ts_us)
 {
 	rr_can_interface_t *i = (rr_can_interface_t *)inst->udata;
 
+	dispatch_enter((rr_dispatch_t *)i->dispatch);
+	cob_dispatch(i, m->id, m->dlc, m->data, ts_us);
+	dispatch_leave((rr_dispatch_t *)i->dispatch);
+
 	if(i->com_frame_cb)
 	{
 		((rr_com_frame_cb_t)(i->com_frame_cb))(i, m->id, m->dlc, m->data);
 	}
 }
 
-void rr_pdo_cb(usbcan_instance_t *inst, int id, int pdo_n, int len, uint8_t *data)
+void rr_pdo_cb(usbcan_instance_t *inst, int id, int pdo_n, int len, uint8_t *data, int64_t ts_us)
 {
 	rr_can_interface_t *i = (rr_can_interface_t *)inst->udata;
+	rr_node_t *n = get_node(inst, id);
+
+	dispatch_enter((rr_dispatch_t *)i->dispatch);
+
+	if(n)
+	{
+		const rr_pdo_layout_t *l = n->mirror_layout;
+
+		mirror_write_begin(n);
+		if(rr_pdo_decode(l, (rr_pdo_n_t)pdo_n, data, len, &n->mirror) == RET_OK)
+		{
+			n->mirror.pdo_count++;
+			n->mirror.pdo_timestamp_us = ts_us;
+			__atomic_store_n(&n->mirror_pdo_us[pdo_n - TPDO0], ts_us, __ATOMIC_RELAXED);
+		}
+		mirror_write_end(n);
+
+		if(n->tpdo_layout)
+		{
+			rr_pdo_decode(n->tpdo_layout, (rr_pdo_n_t)pdo_n, data, len, n->tpdo_state);
+		}
+
+		rr_servo_t *ps = __atomic_load_n(&n->pcache_servo, __ATOMIC_ACQUIRE);
+		if(ps && (rr_pdo_decode(&n->pcache_layout, (rr_pdo_n_t)pdo_n, data, len, ps) == RET_OK))
+		{
+			uint32_t ts;
+			if(!usbcan_get_sync_time(inst, ts_us, &ts))
+			{
+				ts = RR_TIMESTAMP_INVALID;
+			}
+			for(int k = 0; k < n->pcache_layout.n_sig; k++)
+			{
+				if(n->pcache_layout.pdo[n->pcache_layout.sig_pdo[k]] == pdo_n)
+				{
+					ps->pcache[n->pcache_layout.sig[k].sidx].timestamp = ts;
+				}
+			}
+		}
+	}
+
+	cycle_mon_tpdo(i, id, ts_us);
+
+	if(INRANGE(pdo_n, TPDO0, TPDO3))
+	{
+		cob_dispatch(i, RR_API_TPDO_COB_ID(id, pdo_n), len, data, ts_us);
+	}
+
+	dispatch_leave((rr_dispatch_t *)i->dispatch);
 
 	if(i->pdo_cb)
 	{
@@ -157,7 +743,7 @@ void rr_pdo_cb(usbcan_instance_t *inst, int id, int pdo_n, int len, uint8_t *dat
 void rr_emcy_log_push(rr_can_interface_t *iface, uint8_t id, uint16_t err_code, uint8_t err_reg,
 		uint8_t err_bits, int32_t err_info);
 
-void rr_emcy_master_cb(usbcan_instance_t *inst, int id, uint16_t code, uint8_t reg, uint8_t bits, uint32_t info)
+void rr_emcy_master_cb(usbcan_instance_t *inst, int id, uint16_t code, uint8_t reg, uint8_t bits, uint32_t info, int64_t ts_us)
 {
 	rr_can_interface_t *i = (rr_can_interface_t *)inst->udata;
 
@@ -166,6 +752,15 @@ void rr_emcy_master_cb(usbcan_instance_t *inst, int id, uint16_t code, uint8_t r
 
 	rr_emcy_log_push(i, id, code, reg, bits, info);
 
+	rr_node_t *n = get_node(inst, id);
+	if(n)
+	{
+		mirror_write_begin(n);
+		n->mirror.emcy = (emcy_log_entry_t){.id = id, .err_code = code, .err_reg = reg, .err_bits = bits, .err_info = info};
+		n->mirror.emcy_count++;
+		mirror_write_end(n);
+	}
+
 	if(i->emcy_cb)
 	{
 		((rr_emcy_cb_t)(i->emcy_cb))(i, id, code, reg, bits, info);
@@ -254,8 +849,15 @@ rr_ret_status_t rr_send_com_frame(const rr_can_interface_t *iface, uint32_t cob_
 	m.dlc = dlc;
 	memcpy(m.data, data, MIN(dlc, sizeof(m.data)));
 
+	int64_t ts = (cob_id == 0x80) ? monotonic_us() : 0;
+
 	usbcan_send_com_frame((usbcan_instance_t *)iface->iface, &m);
 
+	if(cob_id == 0x80)
+	{
+		cycle_mon_sync(iface, ts);
+	}
+
 	return RET_OK;
 }
 
@@ -281,6 +883,35 @@ rr_ret_status_t rr_read_raw_sdo(const rr_servo_t *servo, uint16_t idx, uint8_t s
 	return ret_sdo(sts);
 }
 
+/**
+ * @brief The function sends an SDO read request to the specified servo, sharing the transaction with other callers.
+ * When an identical read (same servo, index and subindex) issued by another thread is already in flight, the function
+ * does not send a new request but waits for that transaction and returns its result. 
+ * The result of a read that has just completed is reused in the same way.
+ * <p>The 'max_age_ms' parameter is the freshness bound of the caller: the shared transaction should have been issued 
+ * no more than 'max_age_ms' milliseconds ago. Otherwise, a new request is sent.</p>
+ * <p><b>Note:</b> Use the function for objects without side effects on reading only (e.g., realtime parameters).</p>
+ * @param servo Servo descriptor returned by the ::rr_init_servo function 
+ * @param idx Index of the SDO object to which the request refers
+ * @param sidx Subindex
+ * @param data Data to read to
+ * @param sz Size of the `data` in bytes, is writed with the number of readed bytes
+ * @param retry Number of retries (if a communication error occured during the request)
+ * @param tout Request timeout in milliseconds
+ * @param max_age_ms Maximum age (in milliseconds) of the shared result. When set to a negative value, the request is never shared.
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Aux
+ */
+rr_ret_status_t rr_read_raw_sdo_coalesced(const rr_servo_t *servo, uint16_t idx, uint8_t sidx, uint8_t *data, int *sz, int retry, int tout, int max_age_ms)
+{
+	IS_VALID_SERVO(servo);
+	CHECK_NMT_STATE(servo);
+
+	uint32_t sts = read_raw_sdo_coalesced((usbcan_device_t *)servo->dev, idx, sidx, data, sz, retry, tout, max_age_ms);
+
+	return ret_sdo(sts);
+}
+
 /**
  * @brief The function sets a stream for saving CAN communication dump from the specified interface.
  * Subsequently, the user can look through the logs saved to the stream to identify causes of CAN communication failures.
@@ -395,18 +1026,322 @@ rr_ret_status_t rr_send_pdo_sync(const rr_can_interface_t *iface)
 }
 
 /**
- * @brief This function sets a user callback for incoming PDOs
+ * @brief This function sends a group of RPDOs (e.g., setpoints of all the servos of a control loop), optionally followed by SYNC frame.
+ * All the frames are transmitted at once, in the order of the 'pdo' array, which is cheaper than 
+ * calling ::rr_send_pdo for each servo and ::rr_send_pdo_sync.
  * @param iface Descriptor of the interface (as returned by the ::rr_init_interface function)
- * @param cb (::rr_com_frame_cb_t) callback function
- * @return void
+ * @param pdo Array of RPDOs
+ * @param n Number of RPDOs in the array
+ * @param sync true - append SYNC frame
+ * @return Status code (::rr_ret_status_t)
  * @ingroup Cyclic
  */
-void rr_setup_pdo_callback(rr_can_interface_t *iface, rr_pdo_cb_t cb)
+rr_ret_status_t rr_send_pdo_group(const rr_can_interface_t *iface, const rr_pdo_frame_t *pdo, int n, bool sync)
 {
-	if(iface)
+	IS_VALID_INTERFACE(iface);
+
+	if((n < 0) || (n && !pdo) || (!n && !sync))
 	{
-		iface->pdo_cb = (void *)cb;
+		return RET_WRONG_ARG;
 	}
+
+	can_msg_t m[n + 1];
+
+	for(int i = 0; i < n; i++)
+	{
+		if(!INRANGE(pdo[i].pdo_n, RPDO0, RPDO3) || (pdo[i].len > 8))
+		{
+			return RET_WRONG_ARG;
+		}
+		m[i].id = 0x200 + pdo[i].id + 0x100 * pdo[i].pdo_n;
+		m[i].dlc = pdo[i].len;
+		memcpy(m[i].data, pdo[i].data, pdo[i].len);
+	}
+	if(sync)
+	{
+		m[n].id = 0x80;
+		m[n].dlc = 0;
+		n++;
+	}
+
+	int64_t ts = monotonic_us();
+
+	if(usbcan_send_com_frames((usbcan_instance_t *)iface->iface, m, n) < 0)
+	{
+		return RET_ERROR;
+	}
+	if(sync)
+	{
+		cycle_mon_sync(iface, ts);
+	}
+
+	return RET_OK;
+}
+
+/**
+ * @brief This function sets a user callback for incoming PDOs
+ * @param iface Descriptor of the interface (as returned by the ::rr_init_interface function)
+ * @param cb (::rr_com_frame_cb_t) callback function
+ * @return void
+ * @ingroup Cyclic
+ */
+void rr_setup_pdo_callback(rr_can_interface_t *iface, rr_pdo_cb_t cb)
+{
+	if(iface)
+	{
+		iface->pdo_cb = (void *)cb;
+	}
+}
+
+/**
+ * @brief This function returns the RX time of the CAN frame being handled by a user callback 
+ * (see ::rr_setup_pdo_callback, ::rr_setup_com_frame_callback, ::rr_setup_emcy_callback and ::rr_setup_nmt_callback).
+ * <p>For UDP interfaces, the time is taken from the kernel socket timestamp when the OS supports it (SO_TIMESTAMPNS),
+ * for serial interfaces, it is the time of the read completion. 
+ * Thus, the difference between the current time and the RX time is the delay of the frame within the host.</p>
+ * <p><b>Note:</b> The function should be called from the callbacks only.</p>
+ * @param iface Descriptor of the interface (as returned by the ::rr_init_interface function)
+ * @return RX time (monotonic clock, microseconds, the same clock as in ::rr_servo_state_t)
+ * @ingroup Cyclic
+ */
+int64_t rr_get_rx_timestamp(const rr_can_interface_t *iface)
+{
+	if(!iface)
+	{
+		return 0;
+	}
+	return usbcan_get_rx_timestamp((usbcan_instance_t *)iface->iface);
+}
+
+/**
+ * @brief This function sets a user callback for incoming CAN frames with the specified COB-ID.
+ * <p>Unlike the interface-wide callbacks (see ::rr_setup_com_frame_callback and ::rr_setup_pdo_callback), 
+ * the callback is called for its COB-ID only, with the user context, so the application needs no demultiplexing of its own.
+ * The dispatch takes constant time: 11-bit identifiers are looked up in a flat table, extended ones in a hash table.
+ * TPDOs received from the servos are dispatched by their COB-IDs as well (e.g., 0x180 + servo ID for TPDO0).</p>
+ * <p>The interface-wide callbacks are called in addition to the COB-ID callback. 
+ * Setting a callback for a COB-ID replaces the previous one.</p>
+ * @param iface Descriptor of the interface (as returned by the ::rr_init_interface function)
+ * @param cob_id CAN frame ID (mark extended IDs with ::RR_CAN_EID_FLAG)
+ * @param cb (::rr_cob_cb_t) callback function. When the parameter is set to "NULL," the callback is removed.
+ * On return, the previous callback is no longer running (unless the function is called from a callback), so its context can be released.
+ * @param ctx User context passed to the callback
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Cyclic
+ */
+rr_ret_status_t rr_setup_cob_callback(rr_can_interface_t *iface, uint32_t cob_id, rr_cob_cb_t cb, void *ctx)
+{
+	IS_VALID_INTERFACE(iface);
+
+	rr_dispatch_t *d = (rr_dispatch_t *)iface->dispatch;
+
+	if((cob_id & RR_CAN_EID_FLAG) ? (cob_id & ~(RR_CAN_EID_FLAG | 0x1fffffffu)) : (cob_id >= RR_API_COB_STD_SIZE))
+	{
+		return RET_WRONG_ARG;
+	}
+
+	pthread_mutex_lock(&d->mutex);
+	rr_cob_entry_t *e = cob_lookup(d, cob_id, cb != NULL);
+	if(e)
+	{
+		cob_entry_store(e, cob_id, (void *)cb, ctx, NULL);
+	}
+	pthread_mutex_unlock(&d->mutex);
+	dispatch_grace((usbcan_instance_t *)iface->iface, d);
+
+	return (e || !cb) ? RET_OK : RET_ERROR;
+}
+
+/**
+ * @brief This function sets a user callback for the specified TPDO of the servo.
+ * It is the same as ::rr_setup_cob_callback for the TPDO COB-ID, but the callback receives the servo descriptor and the PDO number.
+ * @param servo Servo descriptor returned by the ::rr_init_servo function
+ * @param pdo_n PDO number (valid are TPDO0 to TPDO3)
+ * @param cb (::rr_servo_pdo_cb_t) callback function. When the parameter is set to "NULL," the callback is removed.
+ * On return, the previous callback is no longer running (unless the function is called from a callback), so its context can be released.
+ * @param ctx User context passed to the callback
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Cyclic
+ */
+rr_ret_status_t rr_setup_servo_pdo_callback(rr_servo_t *servo, rr_pdo_n_t pdo_n, rr_servo_pdo_cb_t cb, void *ctx)
+{
+	IS_VALID_SERVO(servo);
+
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	rr_can_interface_t *i = (rr_can_interface_t *)dev->inst->udata;
+	rr_dispatch_t *d = (rr_dispatch_t *)i->dispatch;
+
+	if(!INRANGE(pdo_n, TPDO0, TPDO3))
+	{
+		return RET_WRONG_ARG;
+	}
+
+	uint32_t cob_id = RR_API_TPDO_COB_ID(dev->id, pdo_n);
+
+	pthread_mutex_lock(&d->mutex);
+	cob_entry_store(cob_lookup(d, cob_id, true), cob_id, (void *)cb, ctx, cb ? servo : NULL);
+	pthread_mutex_unlock(&d->mutex);
+	dispatch_grace(dev->inst, d);
+
+	return RET_OK;
+}
+
+/**
+ * @brief This function starts the cycle timing monitor of the interface.
+ * <p>The monitor timestamps every SYNC frame sent by ::rr_send_pdo_sync, ::rr_send_pdo_group or ::rr_send_com_frame
+ * and every TPDO received from the monitored servos (monotonic clock). It keeps the following statistics:
+ * <ul><li>SYNC period deviation from the nominal cycle time (jitter histogram) and the number of late cycles</li>
+ * <li>Latency from SYNC to TPDO arrival per servo (latency histogram, the worst case is the maximum)</li>
+ * <li>Number of cycles without any TPDO per servo (the servos are expected to transmit TPDOs on every SYNC)</li></ul></p>
+ * <p>The statistics are read with ::rr_cycle_monitor_read, periodic summary is enabled with ::rr_cycle_monitor_set_summary.
+ * Starting the monitor clears the statistics.</p>
+ * @param iface Descriptor of the interface (as returned by the ::rr_init_interface function)
+ * @param cycle_us Nominal cycle time in microseconds (normally the same as set by ::rr_pdo_set_cycle_time)
+ * @param late_us Tolerance in microseconds: a SYNC period longer than 'cycle_us + late_us' is counted as a late cycle (0 - 10% of the cycle time)
+ * @param ids Array of servo identifiers to monitor TPDOs from (can be NULL when 'n' is 0)
+ * @param n Number of servos in the 'ids' array
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Cyclic
+ */
+rr_ret_status_t rr_cycle_monitor_start(rr_can_interface_t *iface, uint32_t cycle_us, uint32_t late_us, const uint8_t *ids, int n)
+{
+	IS_VALID_INTERFACE(iface);
+
+	rr_cycle_mon_t *m = (rr_cycle_mon_t *)iface->cycle_mon;
+
+	if(!cycle_us || (cycle_us > INT32_MAX) || (n < 0) || (n > MAX_CO_DEV) || (n && !ids))
+	{
+		return RET_WRONG_ARG;
+	}
+	for(int k = 0; k < n; k++)
+	{
+		if(ids[k] >= MAX_CO_DEV)
+		{
+			return RET_WRONG_ARG;
+		}
+	}
+
+	pthread_mutex_lock(&m->mutex);
+	m->stats.cycle_us = cycle_us;
+	m->stats.late_us = late_us ? late_us : cycle_us / 10;
+	cycle_hist_init(&m->stats.jitter, -(int32_t)(cycle_us / 2), cycle_us);
+
+	memset(m->monitored, 0, sizeof(m->monitored));
+	m->n_ids = 0;
+	for(int k = 0; k < n; k++)
+	{
+		if(!m->monitored[ids[k]])
+		{
+			m->monitored[ids[k]] = true;
+			m->ids[m->n_ids++] = ids[k];
+			m->node[ids[k]].id = ids[k];
+			cycle_hist_init(&m->node[ids[k]].latency, 0, cycle_us);
+		}
+	}
+
+	m->sync_us = 0;
+	m->prev_sync_us = 0;
+	cycle_mon_clear(m, monotonic_us());
+	__atomic_store_n(&m->enabled, true, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&m->mutex);
+
+	return RET_OK;
+}
+
+/**
+ * @brief This function stops the cycle timing monitor of the interface (see ::rr_cycle_monitor_start).
+ * The collected statistics remain available to ::rr_cycle_monitor_read.
+ * @param iface Descriptor of the interface (as returned by the ::rr_init_interface function)
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Cyclic
+ */
+rr_ret_status_t rr_cycle_monitor_stop(rr_can_interface_t *iface)
+{
+	IS_VALID_INTERFACE(iface);
+
+	rr_cycle_mon_t *m = (rr_cycle_mon_t *)iface->cycle_mon;
+
+	pthread_mutex_lock(&m->mutex);
+	__atomic_store_n(&m->enabled, false, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&m->mutex);
+
+	return RET_OK;
+}
+
+/**
+ * @brief This function reads the statistics of the cycle timing monitor (see ::rr_cycle_monitor_start).
+ * <p>The statistics cover the window since the monitor start or the previous clearing. 
+ * Reading with 'clear' set to true starts a new window, thus giving rolling statistics when called periodically.</p>
+ * @param iface Descriptor of the interface (as returned by the ::rr_init_interface function)
+ * @param stats Pointer to the SYNC statistics (can be NULL)
+ * @param nodes Pointer to the array where the per servo statistics are returned (can be NULL when '*count' is 0)
+ * @param count Pointer to the variable holding the capacity of the 'nodes' array on input 
+ * and the number of monitored servos on output (can be NULL), the statistics of the servos beyond the capacity are not returned
+ * @param clear true - clear the statistics after reading
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Cyclic
+ */
+rr_ret_status_t rr_cycle_monitor_read(rr_can_interface_t *iface, rr_cycle_stats_t *stats, rr_cycle_node_stats_t *nodes, int *count, bool clear)
+{
+	IS_VALID_INTERFACE(iface);
+
+	rr_cycle_mon_t *m = (rr_cycle_mon_t *)iface->cycle_mon;
+
+	if(count && ((*count < 0) || (*count && !nodes)))
+	{
+		return RET_WRONG_ARG;
+	}
+
+	int64_t now = monotonic_us();
+
+	pthread_mutex_lock(&m->mutex);
+	if(stats)
+	{
+		*stats = m->stats;
+		stats->window_us = now - m->window_start_us;
+	}
+	if(count)
+	{
+		for(int k = 0; k < MIN(m->n_ids, *count); k++)
+		{
+			nodes[k] = m->node[m->ids[k]];
+		}
+		*count = m->n_ids;
+	}
+	if(clear)
+	{
+		cycle_mon_clear(m, now);
+	}
+	pthread_mutex_unlock(&m->mutex);
+
+	return RET_OK;
+}
+
+/**
+ * @brief This function enables periodic summary of the cycle timing monitor (see ::rr_cycle_monitor_start).
+ * <p>Once per period, the SYNC and per servo statistics are written to the debug log stream (see ::rr_set_debug_log_stream)
+ * and cleared. The summary is issued by the thread sending SYNC frames right after the SYNC transmission.</p>
+ * @param iface Descriptor of the interface (as returned by the ::rr_init_interface function)
+ * @param period_ms Summary period in milliseconds (0 - disable the summary)
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Cyclic
+ */
+rr_ret_status_t rr_cycle_monitor_set_summary(rr_can_interface_t *iface, int period_ms)
+{
+	IS_VALID_INTERFACE(iface);
+
+	rr_cycle_mon_t *m = (rr_cycle_mon_t *)iface->cycle_mon;
+
+	if(period_ms < 0)
+	{
+		return RET_WRONG_ARG;
+	}
+
+	pthread_mutex_lock(&m->mutex);
+	m->summary_ival_us = period_ms * 1000ll;
+	pthread_mutex_unlock(&m->mutex);
+
+	return RET_OK;
 }
 
 static uint16_t map_obj(rr_pdo_n_t n)
@@ -429,6 +1364,20 @@ static uint16_t tr_type_obj(rr_pdo_n_t n)
 	return o[n];
 }
 
+/*
+ * Records the layout programmed to a TPDO of the servo (the state mirror trusts the TPDOs mapped as it decodes them)
+ */
+static void tpdo_map_note(const rr_servo_t *s, rr_pdo_n_t n, const rr_pdo_layout_t *layout)
+{
+	usbcan_device_t *dev = (usbcan_device_t *)s->dev;
+	rr_node_t *node = get_node(dev->inst, dev->id);
+
+	if(node && INRANGE(n, TPDO0, TPDO3))
+	{
+		__atomic_store_n(&node->tpdo_map[n - TPDO0], layout, __ATOMIC_RELEASE);
+	}
+}
+
 /**
  * @brief This function disables specified PDO (it can't be transmitted or received while disabled).
  * @param s Servo descriptor returned by the ::rr_init_servo function 
@@ -529,6 +1478,7 @@ rr_ret_status_t rr_pdo_set_trans_type_async(rr_servo_t *s, rr_pdo_n_t n)
  */
 rr_ret_status_t rr_pdo_set_map_count(rr_servo_t *s, rr_pdo_n_t n, uint8_t cnt)
 {
+	tpdo_map_note(s, n, &mirror_none_layout);
 	if(rr_write_raw_sdo(s, map_obj(n), 0, &cnt, 1, 1, 100) != RET_OK)
 	{
 		return RET_ERROR;
@@ -589,6 +1539,7 @@ rr_ret_status_t rr_pdo_clear_map(rr_servo_t *s, rr_pdo_n_t n)
  */
 rr_ret_status_t rr_pdo_write_map(rr_servo_t *s, rr_pdo_n_t n, uint8_t map_entry, uint32_t map_value)
 {
+	tpdo_map_note(s, n, &mirror_none_layout);
 	if(rr_write_raw_sdo(s, map_obj(n), map_entry, (uint8_t *)&map_value, 4, 1, 100) != RET_OK) 
 	{
 		return RET_ERROR;
@@ -733,305 +1684,1218 @@ rr_ret_status_t rr_pdo_set_cycle_time(rr_servo_t *s, uint32_t cycle_time_us)
 	return RET_OK;
 }
 
-/*
- * Emergency log manipulation functions
- */
-
-
-/**
- * @brief The function returns the total count of entries in the EMCY logging buffer. Each entry in the buffer contains an EMCY event
- * that have occurred up to the moment on the servo specified in the descriptor.
- * <b>Note:</b>When the API library is disabled, no new entries are made in the buffer, irrespective of whether or not any events occur on the servo.
- * <br>The function is used in combination with the ::rr_emcy_log_pop and ::rr_emcy_log_clear functions. The typical sequence is as follows:
- * <ol><li>to clear the EMCY logging buffer with the ::rr_emcy_log_clear</li>
- * <li>to get the total count of entries in the EMCY logging buffer, using the ::rr_emcy_log_get_size function </li>
- * <li>to read the EMCY events from the buffer with the ::rr_emcy_log_pop function </li></ol>
-
- * @param iface Descriptor of the interface returned by the ::rr_init_interface function
- * @return int number of unread entries
- * @ingroup Err
- */
-int rr_emcy_log_get_size(rr_can_interface_t *iface)
+static int pdo_sig_size(const rr_pdo_signal_t *sig)
 {
-	return 	((iface->emcy_log.head - iface->emcy_log.tail + iface->emcy_log.sz) % iface->emcy_log.sz);
+	static const int sz[] = 
+	{
+		[RR_PDO_SIG_INT8] = 1, [RR_PDO_SIG_UINT8] = 1, 
+		[RR_PDO_SIG_INT16] = 2, [RR_PDO_SIG_UINT16] = 2, 
+		[RR_PDO_SIG_INT32] = 4, [RR_PDO_SIG_UINT32] = 4, 
+		[RR_PDO_SIG_FLOAT] = 4
+	};
+	if(!INRANGE(sig->type, RR_PDO_SIG_INT8, RR_PDO_SIG_FLOAT))
+	{
+		return 0;
+	}
+	return sz[sig->type] * (sig->count ? sig->count : 1);
 }
 
-void rr_emcy_log_push(rr_can_interface_t *iface, uint8_t id, uint16_t err_code, uint8_t err_reg,
-		uint8_t err_bits, int32_t err_info)
+static float pdo_get_raw(const uint8_t *d, rr_pdo_sig_type_t type)
 {
-	int unused = iface->emcy_log.sz - rr_emcy_log_get_size(iface);
+	union {int8_t i8; uint8_t u8; int16_t i16; uint16_t u16; int32_t i32; uint32_t u32; float f;} v;
 
-	iface->emcy_log.head = (iface->emcy_log.head + 1) % iface->emcy_log.sz;
-	iface->emcy_log.d[iface->emcy_log.head].id = id;
-	iface->emcy_log.d[iface->emcy_log.head].err_code = err_code;
-	iface->emcy_log.d[iface->emcy_log.head].err_reg = err_reg;
-	iface->emcy_log.d[iface->emcy_log.head].err_bits = err_bits;
-	iface->emcy_log.d[iface->emcy_log.head].err_info = err_info;
-	if(unused <= 1)
+	switch(type)
 	{
-		iface->emcy_log.tail = (iface->emcy_log.tail + 1) % iface->emcy_log.sz;
+		case RR_PDO_SIG_INT8:   memcpy(&v.i8, d, 1);  return v.i8;
+		case RR_PDO_SIG_UINT8:  memcpy(&v.u8, d, 1);  return v.u8;
+		case RR_PDO_SIG_INT16:  memcpy(&v.i16, d, 2); return v.i16;
+		case RR_PDO_SIG_UINT16: memcpy(&v.u16, d, 2); return v.u16;
+		case RR_PDO_SIG_INT32:  memcpy(&v.i32, d, 4); return v.i32;
+		case RR_PDO_SIG_UINT32: memcpy(&v.u32, d, 4); return v.u32;
+		default:                memcpy(&v.f, d, 4);   return v.f;
 	}
 }
 
-
-/**
- * @brief The function enables reading entries from the EMCY logging buffer. Reading the entries is according to the "first in-first out" principle.
- * Once an EMCY entry is read, the function removes it permenantly from the EMCY logging buffer.<br>
- * <b>Note:</b>Typically, the rr_emcy_log_pop function is used in combination with the ::rr_emcy_log_get_size and ::rr_emcy_log_clear functions.
- * For the sequence of using the functions, see ::rr_emcy_log_get_size.
- * @param iface Descriptor of the interface returned by the ::rr_init_interface function
- * @return emcy_log_entry_t pointer to the EMCY entry or NULL if the buffer contains no entries
- * @ingroup Err
- */
-emcy_log_entry_t *rr_emcy_log_pop(rr_can_interface_t *iface)
+static void pdo_put_raw(uint8_t *d, rr_pdo_sig_type_t type, float value)
 {
-	if(iface->emcy_log.tail != iface->emcy_log.head)
+	union {int8_t i8; uint8_t u8; int16_t i16; uint16_t u16; int32_t i32; uint32_t u32; float f;} v;
+
+	switch(type)
 	{
-		iface->emcy_log.tail = (iface->emcy_log.tail + 1) % iface->emcy_log.sz;
-		return &iface->emcy_log.d[iface->emcy_log.tail];
+		case RR_PDO_SIG_INT8:   v.i8 = lrintf(value);  memcpy(d, &v.i8, 1);  break;
+		case RR_PDO_SIG_UINT8:  v.u8 = lrintf(value);  memcpy(d, &v.u8, 1);  break;
+		case RR_PDO_SIG_INT16:  v.i16 = lrintf(value); memcpy(d, &v.i16, 2); break;
+		case RR_PDO_SIG_UINT16: v.u16 = lrintf(value); memcpy(d, &v.u16, 2); break;
+		case RR_PDO_SIG_INT32:  v.i32 = lrintf(value); memcpy(d, &v.i32, 4); break;
+		case RR_PDO_SIG_UINT32: v.u32 = llrintf(value); memcpy(d, &v.u32, 4); break;
+		default:                v.f = value;           memcpy(d, &v.f, 4);   break;
 	}
-	return NULL;
 }
 
 /**
- * @brief The function clears the EMCY logging buffer, removing the total of entries from it.
- * It is advisable to use the clearing function in the beginning of a new work session and before applying the ::rr_emcy_log_get_size and
- * ::rr_emcy_log_pop functions. For the typical sequence of using the functions, see ::rr_emcy_log_get_size.
- * @param iface Descriptor of the interface returned by the ::rr_init_interface function
- * @return void
- * @ingroup Err
+ * @brief This function compiles a list of signals into a PDO layout. The signals are packed into 
+ * the minimum number of 8-byte PDOs (first-fit decreasing, which is optimal for 1, 2, 4 and 8-byte signals).
+ * The layout is then used to program the servos (::rr_pdo_program) and to decode/encode PDO data 
+ * from/to a user state block (::rr_pdo_decode, ::rr_pdo_bind_state, ::rr_pdo_encode, ::rr_pdo_send_state).
+ * @param layout Pointer to the layout to fill in
+ * @param tx true - signals are transmitted by servos (TPDOs), false - signals are received by servos (RPDOs)
+ * @param pdo_pool PDO numbers the layout may use, in order of preference (NULL - all PDOs of the direction)
+ * @param n_pool Number of PDOs in the 'pdo_pool' array
+ * @param sig Array of signals
+ * @param n_sig Number of signals (up to RR_PDO_MAX_SIGNALS)
+ * @return RET_OK on success, RET_SIZE_MISMATCH if the signals don't fit into the PDO pool, RET_WRONG_ARG otherwise
+ * @ingroup Cyclic
  */
-void rr_emcy_log_clear(rr_can_interface_t *iface)
+rr_ret_status_t rr_pdo_compile(rr_pdo_layout_t *layout, bool tx, const rr_pdo_n_t *pdo_pool, int n_pool, const rr_pdo_signal_t *sig, int n_sig)
 {
-	iface->emcy_log.head = 0;
-	iface->emcy_log.tail = 0;
-}
+	static const rr_pdo_n_t tpdo[] = {TPDO0, TPDO1, TPDO2, TPDO3};
+	static const rr_pdo_n_t rpdo[] = {RPDO0, RPDO1, RPDO2, RPDO3};
+	int order[RR_PDO_MAX_SIGNALS];
+	int fill[4] = {0};
 
-/**
- * @brief The function returns a string describing the NMT state code specified in the 'state' parameter. 
- * You can also use the function with ::rr_setup_nmt_callback, setting the callback to display a detailed message
- * describing an NMT event.
- * @param state NMT state code to descibe
- * @return Pointer to the description string
- * @ingroup State
- */
-const char *rr_describe_nmt(rr_nmt_state_t state)
-{
-	switch(state)
+	if(!layout || !sig || !INRANGE(n_sig, 1, RR_PDO_MAX_SIGNALS))
 	{
-		case RR_NMT_INITIALIZING:
-			return "Device is initializing";
-		case RR_NMT_BOOT:
-			return "Bootloader mode";
-		case RR_NMT_PRE_OPERATIONAL:
-			return "Device is in pre-operational mode";
-		case RR_NMT_OPERATIONAL:
-			return "Device is in operational mode";
-		case RR_NMT_STOPPED:
-			return "Device is in stopped mode";
-		case RR_NMT_HB_TIMEOUT:
-			return "Device disappeared";
-		default:
-			return "N/A";
+		return RET_WRONG_ARG;
+	}
+	if(!pdo_pool)
+	{
+		pdo_pool = tx ? tpdo : rpdo;
+		n_pool = 4;
+	}
+	if(!INRANGE(n_pool, 1, 4))
+	{
+		return RET_WRONG_ARG;
+	}
+	for(int i = 0; i < n_pool; i++)
+	{
+		if(!(tx ? INRANGE(pdo_pool[i], TPDO0, TPDO3) : INRANGE(pdo_pool[i], RPDO0, RPDO3)))
+		{
+			return RET_WRONG_ARG;
+		}
+	}
+
+	/*Sort signals by size (descending, stable)*/
+	for(int i = 0; i < n_sig; i++)
+	{
+		int j = i;
+		int sz = pdo_sig_size(&sig[i]);
+
+		if(!INRANGE(sz, 1, 8))
+		{
+			return RET_WRONG_ARG;
+		}
+		for(; (j > 0) && (pdo_sig_size(&sig[order[j - 1]]) < sz); j--)
+		{
+			order[j] = order[j - 1];
+		}
+		order[j] = i;
+	}
+
+	memset(layout, 0, sizeof(*layout));
+	layout->tx = tx;
+	layout->n_sig = n_sig;
+
+	for(int i = 0; i < n_sig; i++)
+	{
+		int k = order[i];
+		int sz = pdo_sig_size(&sig[k]);
+		int p = 0;
+
+		while((p < layout->n_pdo) && (fill[p] + sz > 8))
+		{
+			p++;
+		}
+		if(p == layout->n_pdo)
+		{
+			if(p == n_pool)
+			{
+				return RET_SIZE_MISMATCH;
+			}
+			layout->pdo[p] = pdo_pool[p];
+			layout->n_pdo++;
+		}
+
+		layout->sig[k] = sig[k];
+		layout->sig[k].count = sig[k].count ? sig[k].count : 1;
+		layout->sig[k].scale = sig[k].scale != 0 ? sig[k].scale : 1;
+		layout->sig_pdo[k] = p;
+		layout->sig_pos[k] = fill[p];
+		fill[p] += sz;
+		layout->len[p] = fill[p];
 	}
+
+	return RET_OK;
 }
 
 /**
- * @brief The function returns a string describing in detail a specific EMCY event based on the code in the 'bit' parameter (e.g., "CAN bus warning limit reached").
- * The function can be used in combination with ::rr_describe_emcy_code. The latter provides a more generic description of an EMCY event.
- * @param bit Error bit field of the corresponding EMCY message (according to the CanOpen standard)
- * @return Pointer to the description string
- * @ingroup Err
+ * @brief This function programs a compiled PDO layout (see ::rr_pdo_compile) into the servos. 
+ * All the PDO configuration requests (disabling, mapping, transmission type, enabling) of all the servos 
+ * are issued as one pipelined batch, the servos being configured concurrently.
+ * <p><b>Note:</b> The PDOs are enabled with their default COB-IDs. 
+ * The servos should be in the pre-operational state.</p>
+ * @param servos Array of servo descriptors returned by the ::rr_init_servo function (all on the same interface)
+ * @param n_servos Number of servos
+ * @param layout Compiled layout
+ * @param trans_type Transmission type: 1-240 - synchronous (number of SYNC frames between transmissions), 254/255 - asynchronous
+ * @return RET_OK on success, RET_ERROR otherwise
+ * @ingroup Cyclic
  */
-const char *rr_describe_emcy_bit(uint8_t bit)
+rr_ret_status_t rr_pdo_program(rr_servo_t **servos, int n_servos, const rr_pdo_layout_t *layout, uint8_t trans_type)
 {
-	switch(bit)
+	if(!servos || (n_servos <= 0) || !layout || !INRANGE(layout->n_pdo, 1, 4))
 	{
-		case CO_EM_NO_ERROR:
-			return "Error Reset or No Error";
-		case CO_EM_CAN_BUS_WARNING:
-			return "CAN bus warning limit reached";
-		case CO_EM_RXMSG_WRONG_LENGTH:
-			return "Wrong data length of the received CAN message";
-		case CO_EM_RXMSG_OVERFLOW:
-			return "Previous received CAN message wasn't processed yet";
-		case CO_EM_RPDO_WRONG_LENGTH:
-			return "Wrong data length of received PDO";
-		case CO_EM_RPDO_OVERFLOW:
-			return "Previous received PDO wasn't processed yet";
-		case CO_EM_CAN_RX_BUS_PASSIVE:
-			return "CAN Rx passive";
-		case CO_EM_CAN_TX_BUS_PASSIVE:
-			return "CAN Tx passive";
+		return RET_WRONG_ARG;
+	}
 
-		case CO_EM_NMT_WRONG_COMMAND:
-			return "Wrong NMT command received";
-			//case 09-11 unused
+	usbcan_instance_t *inst = NULL;
 
-		case CO_EM_CAN_TX_BUS_OFF:
-			return "CAN transmit bus is off";
-		case CO_EM_CAN_RXB_OVERFLOW:
-			return "CAN module receive buffer has overflowed";
-		case CO_EM_CAN_TX_OVERFLOW:
-			return "CAN transmit buffer has overflowed";
-		case CO_EM_TPDO_OUTSIDE_WINDOW:
-			return "TPDO is outside SYNC window";
+	for(int i = 0; i < n_servos; i++)
+	{
+		IS_VALID_SERVO(servos[i]);
+		usbcan_device_t *dev = (usbcan_device_t *)servos[i]->dev;
+		if(inst && (inst != dev->inst))
+		{
+			return RET_WRONG_ARG;
+		}
+		inst = dev->inst;
+	}
 
-			//case 16-17 unused
+	int n_req = n_servos * (5 * layout->n_pdo + layout->n_sig);
+	usbcan_sdo_req_t req[n_req];
+	uint8_t buf[n_req][4];
+	int r = 0;
 
-		case CO_EM_SYNC_TIME_OUT:
-			return "SYNC message timeout";
-		case CO_EM_SYNC_LENGTH:
-			return "Unexpected SYNC data length";
-		case CO_EM_PDO_WRONG_MAPPING:
-			return "Error with PDO mapping";
-		case CO_EM_HB_CONSUMER_REMOTE_RESET:
-			return "Heartbeat consumer detected remote node reset";
+	for(int i = 0; i < n_servos; i++)
+	{
+		int id = ((usbcan_device_t *)servos[i]->dev)->id;
 
-			//case 1D-1F unused
+		for(int p = 0; p < layout->n_pdo; p++)
+		{
+			rr_pdo_n_t n = layout->pdo[p];
+			uint32_t cob_id = (layout->tx ? 0x180 + 0x100 * (n - TPDO0) : 0x200 + 0x100 * n) + id;
+			uint32_t cob_id_dis = cob_id | 0x80000000ul;
+			uint8_t cnt = 0;
+
+#define PDO_REQ(_idx, _sidx, _val, _len) \
+			do { \
+				memcpy(buf[r], _val, _len); \
+				req[r] = (usbcan_sdo_req_t){.id = id, .write = true, .idx = _idx, .sidx = _sidx, \
+					.data = buf[r], .len = _len, .retry = 1, .tout = 100}; \
+				r++; \
+			} while(0)
+
+			PDO_REQ(tr_type_obj(n), 1, &cob_id_dis, 4);
+			PDO_REQ(map_obj(n), 0, &cnt, 1);
+			for(int pos = 0; pos < layout->len[p]; pos++)
+			{
+				for(int k = 0; k < layout->n_sig; k++)
+				{
+					const rr_pdo_signal_t *sig = &layout->sig[k];
+					if((layout->sig_pdo[k] != p) || (layout->sig_pos[k] != pos))
+					{
+						continue;
+					}
+					uint32_t map = (uint32_t)sig->idx << 16 | (uint32_t)sig->sidx << 8 | (uint32_t)(pdo_sig_size(sig) << 3);
+					cnt++;
+					PDO_REQ(map_obj(n), cnt, &map, 4);
+				}
+			}
+			PDO_REQ(map_obj(n), 0, &cnt, 1);
+			PDO_REQ(tr_type_obj(n), 2, &trans_type, 1);
+			PDO_REQ(tr_type_obj(n), 1, &cob_id, 4);
+#undef PDO_REQ
+		}
+	}
 
-		case CO_EM_EMERGENCY_BUFFER_FULL:
-			return "Emergency buffer is full, Emergency message wasn't sent";
-		case CO_EM_MOTION_ERROR:
-			return "Motion Error";
-		case CO_EM_MICROCONTROLLER_RESET:
-			return "Microcontroller has just started";
-		case CO_EM_UNAUTHORIZED_ACCESS:
-			return "Access is only available to service engineer";
-		case CO_EM_TEMPERATURE_ERROR:
-			return "Temperature Motor is too high";
-		case CO_EM_TEMPERATURE_INTRNL_ERROR:
-			return "Temperature PCB is too high";
-		case CO_EM_HARDWARE_ERROR:
-			return "Hardware error (driver error)";
-		case CO_EM_MOTION_INVALID:
-			return "Invalid motion command received";
+	bool ok = batch_raw_sdo(inst, req, r, true) == r;
 
-		case CO_EM_WRONG_ERROR_REPORT:
-			return "Wrong parameters to CO_EM_reportError() function";
-		case CO_EM_ISR_TIMER_OVERFLOW:
-			return "Timer task has overflowed";
-		case CO_EM_MEMORY_ALLOCATION_ERROR:
-			return "Unable to allocate memory for objects";
-		case CO_EM_GENERIC_ERROR:
-			return "Generic error, test usage";
-		case CO_EM_GENERIC_SOFTWARE_ERROR:
-			return "Software error";
-		case CO_EM_INCONSISTENT_OBJECT_DICT:
-			return "Object dictionary does not match the software";
-		case CO_EM_CALCULATION_OF_PARAMETERS:
-			return "Error in calculation of device parameters";
-		case CO_EM_NON_VOLATILE_MEMORY:
-			return "Error with access to non volatile device memory";
+	for(int i = 0; layout->tx && (i < n_servos); i++)
+	{
+		for(int p = 0; p < layout->n_pdo; p++)
+		{
+			tpdo_map_note(servos[i], layout->pdo[p], ok ? layout : &mirror_none_layout);
+		}
+	}
 
-		case CO_EM_FLT_CONFIG_CONSTRAINT:
-			return "Constraint was applied to the settings";
-		case CO_EM_FLT_CONFIG_CRC:
-			return "CRC check of the setings failed";
-		case CO_EM_FLT_NTC:
-			return "NTC Error";
-		case CO_EM_FLT_CS0:
-			return "Current sensor 0 error";
-		case CO_EM_FLT_CS1:
-			return "Current sensor 1 error";
-		case CO_EM_FLT_CS2:
-			return "Current sensor 2 error";
-		case CO_EM_FLT_DRIVER:
-			return "Driver error";
-		case CO_EM_FLT_VS0:
-			return "Voltage sensor error";
+	return ok ? RET_OK : RET_ERROR;
+}
 
-		case CO_EM_FLT_ENC_M_OFF:
-			return "Motor Encoder disconnected";
-		case CO_EM_FLT_ENC_G_OFF:
-			return "Gear Encoder disconnected";
-		case CO_EM_FLT_ENC_M_STUP_CRC:
-			return "Motor Encoder CRC_ERR/EPR_ERR in STATUS1 & STUP in STATUS0";
-		case CO_EM_FLT_ENC_G_STUP_CRC:
-			return "Gear Encoder CRC_ERR/EPR_ERR in STATUS1 & STUP in STATUS0";
-		case CO_EM_FLT_ENC_M_LEVEL:
-			return "Motor Encoder FRQ_ABZ/FRQ_CNV in STATUS1 & AN_MAX/AN_MIN/AM_MAX/AM_MIN in STATUS0";
-		case CO_EM_FLT_ENC_G_LEVEL:
-			return "Gear Encoder FRQ_ABZ/FRQ_CNV in STATUS1 & AN_MAX/AN_MIN/AM_MAX/AM_MIN in STATUS0";
-		case CO_EM_FLT_ENC_M_SIG:
-			return "Motor Encoder NON_CTR bit in STATUS1";
-		case CO_EM_FLT_ENC_G_SIG:
-			return "Gear Encoder NON_CTR bit in STATUS1";
+/**
+ * @brief This function decodes PDO data into a user state block according to a compiled layout (see ::rr_pdo_compile).
+ * Each signal is scaled and stored as 'float' (or array of 'float') at its offset in the block.
+ * @param layout Compiled layout
+ * @param pdo_n (::rr_pdo_n_t) PDO number
+ * @param data PDO data
+ * @param len PDO data length
+ * @param state Pointer to the user state block
+ * @return RET_OK on success, RET_WRONG_ARG if the PDO doesn't belong to the layout, RET_SIZE_MISMATCH if the data is too short
+ * @ingroup Cyclic
+ */
+rr_ret_status_t rr_pdo_decode(const rr_pdo_layout_t *layout, rr_pdo_n_t pdo_n, const uint8_t *data, int len, void *state)
+{
+	int p = 0;
 
-		case CO_EM_HW_VOLT_LO:
-			return "Under Voltage";
-		case CO_EM_HW_VOLT_HI:
-			return "Over Voltage";
-		case CO_EM_HW_CUR_LIMIT:
-			return "Over Current";
-		case CO_EM_POWER_ERROR:
-			return "Over Power";
-		case CO_EM_FORCE_ERROR:
-			return "Over Force";
-		case CO_EM_HEARTBEAT_CONSUMER:
-			return "Heartbeat consumer timeout";
+	if(!layout || !data || !state)
+	{
+		return RET_WRONG_ARG;
+	}
+	while((p < layout->n_pdo) && (layout->pdo[p] != pdo_n))
+	{
+		p++;
+	}
+	if(p == layout->n_pdo)
+	{
+		return RET_WRONG_ARG;
+	}
+	if(len < layout->len[p])
+	{
+		return RET_SIZE_MISMATCH;
+	}
 
-		case CO_EM_HW_CUR_LIMIT_A:
-			return "Current Limit Phase A";
-		case CO_EM_HW_CUR_LIMIT_B:
-			return "Current Limit Phase B";
-		case CO_EM_HW_CUR_LIMIT_C:
-			return "Current Limit Phase C";
+	for(int k = 0; k < layout->n_sig; k++)
+	{
+		const rr_pdo_signal_t *sig = &layout->sig[k];
+		const uint8_t *d = data + layout->sig_pos[k];
+		float *v = (float *)((uint8_t *)state + sig->offset);
+		int sz = pdo_sig_size(sig) / sig->count;
 
-		default:
-			return "N/A";
+		if(layout->sig_pdo[k] != p)
+		{
+			continue;
+		}
+		for(int e = 0; e < sig->count; e++, d += sz)
+		{
+			v[e] = pdo_get_raw(d, sig->type) * sig->scale;
+		}
 	}
+
+	return RET_OK;
 }
 
 /**
- * @brief The function returns a string descibing a specific EMCY event based on the error code in the 'code' parameter. 
- * The description in the string is a generic type of the occured emergency event (e.g., "Temperature").
- * For a more detailed description, use the function together with the ::rr_describe_emcy_bit one.
- * @param code Error code from the corresponding EMCY message (according to the CanOpen standard)
- * @return Pointer to the description string
- * @ingroup Err
+ * @brief This function encodes a user state block into PDO data according to a compiled layout (see ::rr_pdo_compile).
+ * Each signal is read as 'float' (or array of 'float') at its offset in the block, divided by its scale and rounded to the bus representation.
+ * @param layout Compiled layout
+ * @param k Index of the PDO within the layout (0 to layout->n_pdo - 1)
+ * @param state Pointer to the user state block
+ * @param data Pointer to the buffer (8 bytes) to receive PDO data
+ * @param len Pointer to the variable to receive PDO data length
+ * @return RET_OK on success, RET_WRONG_ARG otherwise
+ * @ingroup Cyclic
  */
-const char *rr_describe_emcy_code(uint16_t code)
+rr_ret_status_t rr_pdo_encode(const rr_pdo_layout_t *layout, int k, const void *state, uint8_t *data, int *len)
 {
-	switch(code)
+	if(!layout || !state || !data || !len || !INRANGE(k, 0, layout->n_pdo - 1))
 	{
-		case CO_EMC_NO_ERROR:
-			return "Error Reset or No Error";
-		case CO_EMC_GENERIC:
-			return "Generic Error";
-		case CO_EMC_CURRENT:
-			return "Current";
-		case CO_EMC_CURRENT_INPUT:
-			return "Current, device input side";
-		case CO_EMC_CURRENT_INSIDE:
-			return "Current inside the device";
-		case CO_EMC_CURRENT_OUTPUT:
-			return "Current, device output side";
-		case CO_EMC_VOLTAGE:
-			return "Voltage";
-		case CO_EMC_VOLTAGE_MAINS:
-			return "Mains Voltage";
-		case CO_EMC_VOLTAGE_INSIDE:
-			return "Voltage inside the device";
-		case CO_EMC_VOLTAGE_OUTPUT:
-			return "Output Voltage";
-		case CO_EMC_TEMPERATURE:
-			return "Temperature";
-		case CO_EMC_TEMP_AMBIENT:
-			return "Ambient Temperature";
-		case CO_EMC_TEMP_DEVICE:
-			return "Device Temperature";
-		case CO_EMC_HARDWARE:
-			return "Device Hardware";
-		case CO_EMC_SOFTWARE_DEVICE:
-			return "Device Software";
-		case CO_EMC_SOFTWARE_INTERNAL:
-			return "Internal Software";
-		case CO_EMC_SOFTWARE_USER:
-			return "User Software";
-		case CO_EMC_DATA_SET:
-			return "Data Set";
-		case CO_EMC_ADDITIONAL_MODUL:
+		return RET_WRONG_ARG;
+	}
+
+	for(int i = 0; i < layout->n_sig; i++)
+	{
+		const rr_pdo_signal_t *sig = &layout->sig[i];
+		uint8_t *d = data + layout->sig_pos[i];
+		const float *v = (const float *)((const uint8_t *)state + sig->offset);
+		int sz = pdo_sig_size(sig) / sig->count;
+
+		if(layout->sig_pdo[i] != k)
+		{
+			continue;
+		}
+		for(int e = 0; e < sig->count; e++, d += sz)
+		{
+			pdo_put_raw(d, sig->type, v[e] / sig->scale);
+		}
+	}
+	*len = layout->len[k];
+
+	return RET_OK;
+}
+
+/**
+ * @brief This function binds a user state block to the servo. Every TPDO of the layout received from the servo 
+ * is decoded into the block (see ::rr_pdo_decode) before the user PDO callback (see ::rr_setup_pdo_callback) is called.
+ * <p><b>Note:</b> Decoding is performed by the interface thread. One layout can be bound to a servo at a time.</p>
+ * @param servo Servo descriptor returned by the ::rr_init_servo function 
+ * @param layout Compiled TPDO layout or NULL to unbind
+ * @param state Pointer to the user state block
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Cyclic
+ */
+rr_ret_status_t rr_pdo_bind_state(rr_servo_t *servo, const rr_pdo_layout_t *layout, void *state)
+{
+	IS_VALID_SERVO(servo);
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	rr_node_t *n = get_node(dev->inst, dev->id);
+
+	if(!n || (layout && (!layout->tx || !state)))
+	{
+		return RET_WRONG_ARG;
+	}
+
+	n->tpdo_layout = NULL;
+	__sync_synchronize();
+	n->tpdo_state = state;
+	__sync_synchronize();
+	n->tpdo_layout = layout;
+
+	return RET_OK;
+}
+
+/**
+ * @brief This function encodes a user state block (see ::rr_pdo_encode) and sends all RPDOs of the layout to the servo.
+ * @param servo Servo descriptor returned by the ::rr_init_servo function 
+ * @param layout Compiled RPDO layout
+ * @param state Pointer to the user state block
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Cyclic
+ */
+rr_ret_status_t rr_pdo_send_state(const rr_servo_t *servo, const rr_pdo_layout_t *layout, const void *state)
+{
+	IS_VALID_SERVO(servo);
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	rr_can_interface_t *iface = (rr_can_interface_t *)dev->inst->udata;
+
+	if(!layout || layout->tx)
+	{
+		return RET_WRONG_ARG;
+	}
+
+	rr_pdo_frame_t pdo[4];
+
+	for(int k = 0; k < layout->n_pdo; k++)
+	{
+		int len;
+
+		rr_pdo_encode(layout, k, state, pdo[k].data, &len);
+		pdo[k].id = dev->id;
+		pdo[k].pdo_n = layout->pdo[k];
+		pdo[k].len = len;
+	}
+
+	return rr_send_pdo_group(iface, pdo, layout->n_pdo, false);
+}
+
+/**
+ * @brief This function sets up the TPDO layout feeding the state mirror of the servo (see ::rr_servo_snapshot).
+ * The signal offsets of the layout are relative to ::rr_servo_state_t and should point to its 'float' fields 
+ * (e.g., offsetof(rr_servo_state_t, queue_fill)). By default, the factory TPDO0 mapping 
+ * (position, velocity and current) is decoded.
+ * @param servo Servo descriptor returned by the ::rr_init_servo function 
+ * @param layout Compiled TPDO layout (see ::rr_pdo_compile) or NULL to restore the default one
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Cyclic
+ */
+rr_ret_status_t rr_servo_mirror_setup(rr_servo_t *servo, const rr_pdo_layout_t *layout)
+{
+	IS_VALID_SERVO(servo);
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	rr_node_t *n = get_node(dev->inst, dev->id);
+
+	if(!n)
+	{
+		return RET_ERROR;
+	}
+	if(!layout)
+	{
+		layout = &mirror_default_layout;
+	}
+	if(!layout->tx)
+	{
+		return RET_WRONG_ARG;
+	}
+	for(int k = 0; k < layout->n_sig; k++)
+	{
+		const rr_pdo_signal_t *sig = &layout->sig[k];
+		if((sig->offset < 0) || (sig->offset % sizeof(float)) || 
+				(sig->offset + sig->count * sizeof(float) > offsetof(rr_servo_state_t, nmt_state)))
+		{
+			return RET_WRONG_ARG;
+		}
+	}
+
+	__atomic_store_n(&n->mirror_layout, layout, __ATOMIC_RELEASE);
+
+	return RET_OK;
+}
+
+/**
+ * @brief This function returns a consistent copy of the servo state mirror: the latest TPDO signals, NMT state and EMCY event
+ * received from the servo. The mirror is updated by the interface thread as the frames arrive, so the function involves
+ * no CAN communication and never blocks (it only retries the copy if the mirror has been updated in the meantime).
+ * It can be called from any number of threads, e.g., from a control loop.
+ * @param servo Servo descriptor returned by the ::rr_init_servo function 
+ * @param state Pointer to the structure to receive the state
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Cyclic
+ */
+rr_ret_status_t rr_servo_snapshot(const rr_servo_t *servo, rr_servo_state_t *state)
+{
+	IS_VALID_SERVO(servo);
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	rr_node_t *n = get_node(dev->inst, dev->id);
+	uint32_t seq;
+
+	if(!n || !state)
+	{
+		return RET_WRONG_ARG;
+	}
+
+	do
+	{
+		while((seq = __atomic_load_n(&n->mirror_seq, __ATOMIC_ACQUIRE)) & 1)
+		{
+		}
+		memcpy(state, &n->mirror, sizeof(*state));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	}
+	while(__atomic_load_n(&n->mirror_seq, __ATOMIC_RELAXED) != seq);
+
+	return RET_OK;
+}
+
+/*
+ * Setpoint streaming
+ */
+
+static void stream_fill_cb(rr_servo_t *servo, rr_pdo_n_t pdo_n, int len, uint8_t *data, int64_t ts_us, void *ctx)
+{
+	if(len >= 1)
+	{
+		__atomic_store_n((int *)ctx, data[0], __ATOMIC_RELAXED);
+	}
+}
+
+static void stream_encode(rr_stream_t *s, const rr_setpoint_t *sp, bool hold)
+{
+	for(int k = 0; k < s->n; k++)
+	{
+		rr_pdo_frame_t *f = &s->pdo[k];
+
+		f->len = 8;
+		if(s->mode == RR_STREAM_PV)
+		{
+			f->pdo_n = RPDO2;
+			pdo_put_raw(f->data, RR_PDO_SIG_FLOAT, sp[k].position);
+			pdo_put_raw(f->data + 4, RR_PDO_SIG_FLOAT, hold ? 0.0 : sp[k].velocity);
+		}
+		else
+		{
+			bool vel = s->mode == RR_STREAM_VELOCITY;
+
+			f->pdo_n = RPDO0;
+			f->data[0] = vel ? 1 : 0; //control mode
+			f->data[1] = 0;
+			pdo_put_raw(f->data + 2, RR_PDO_SIG_INT16, (vel || hold) ? 0.0 : sp[k].current / 0.0016);
+			pdo_put_raw(f->data + 4, RR_PDO_SIG_FLOAT, (!vel || hold) ? 0.0 : sp[k].velocity_rpm);
+		}
+	}
+}
+
+/*
+ * Takes the next sample from the producer queue into the PDO frames.
+ */
+static bool stream_pop(rr_stream_t *s)
+{
+	uint32_t t = s->tail;
+
+	if(t == __atomic_load_n(&s->head, __ATOMIC_ACQUIRE))
+	{
+		return false;
+	}
+
+	const rr_setpoint_t *sp = &s->q[(t & (s->depth - 1)) * s->n];
+	stream_encode(s, sp, false);
+	memcpy(s->last, sp, s->n * sizeof(rr_setpoint_t));
+	__atomic_store_n(&s->tail, t + 1, __ATOMIC_RELEASE);
+	s->stats.samples++;
+
+	return true;
+}
+
+/**
+ * @brief The function creates a cyclic setpoint stream for a group of servos.
+ * <p>Setpoint samples (one per servo) are pushed by a producer (e.g., a trajectory generator thread) with ::rr_stream_push 
+ * into a lock-free queue and are sent to the servos by ::rr_stream_cycle, called once per cycle from the control loop.
+ * Each cycle, the RPDOs of all the servos and SYNC frame are transmitted at once (see ::rr_send_pdo_group).</p>
+ * <p>The following modes are available:<ul>
+ * <li>RR_STREAM_PV - position-velocity setpoints are buffered by the servo. The function maps RPDO2 to the setpoint (0x5000 sub-index 7),
+ * RPDO3 to the control word (0x6040) and TPDO2 to the servo queue fill (0x5001 sub-index 0x0c). The queue fill reported by the servos 
+ * meters the transmission (see ::rr_stream_start).</li>
+ * <li>RR_STREAM_VELOCITY and RR_STREAM_CURRENT - velocity or current setpoints are sent by RPDO0 (factory mapping).
+ * RPDO0 takes the motor shaft velocity in RPM, so velocity mode reads rr_setpoint_t::velocity_rpm rather than
+ * rr_setpoint_t::velocity (degrees per second at the output flange).</li></ul></p>
+ * <p><b>Note:</b> The stream takes the TPDO2 callbacks of the servos in the PV mode (see ::rr_setup_servo_pdo_callback).</p>
+ * @param servos Array of servo descriptors (on the same interface)
+ * @param n Number of servos in the 'servos' array
+ * @param mode Streaming mode
+ * @param depth Capacity of the producer queue (number of samples, rounded up to a power of 2)
+ * @return Stream descriptor or NULL when an error occurs
+ * @ingroup Cyclic
+ */
+rr_stream_t *rr_init_stream(rr_servo_t **servos, int n, rr_stream_mode_t mode, int depth)
+{
+	if(!servos || (n <= 0) || (depth <= 0) || !INRANGE(mode, RR_STREAM_PV, RR_STREAM_CURRENT))
+	{
+		return NULL;
+	}
+
+	usbcan_instance_t *inst = NULL;
+
+	for(int k = 0; k < n; k++)
+	{
+		if(!servos[k] || (inst && (inst != ((usbcan_device_t *)servos[k]->dev)->inst)))
+		{
+			return NULL;
+		}
+		inst = ((usbcan_device_t *)servos[k]->dev)->inst;
+	}
+
+	if(mode == RR_STREAM_PV)
+	{
+		static const rr_pdo_n_t rx_pool[] = {RPDO2, RPDO3};
+		static const rr_pdo_n_t tx_pool[] = {TPDO2};
+		static const rr_pdo_signal_t rx_sig[] = 
+		{
+			{.idx = 0x5000, .sidx = 0x07, .type = RR_PDO_SIG_FLOAT, .count = 2},
+			{.idx = 0x6040, .sidx = 0x00, .type = RR_PDO_SIG_UINT16},
+		};
+		static const rr_pdo_signal_t tx_sig[] = 
+		{
+			{.idx = 0x5001, .sidx = 0x0c, .type = RR_PDO_SIG_UINT8},
+		};
+		rr_pdo_layout_t rx, tx;
+
+		if((rr_pdo_compile(&rx, false, rx_pool, 2, rx_sig, 2) != RET_OK) || 
+				(rr_pdo_compile(&tx, true, tx_pool, 1, tx_sig, 1) != RET_OK) ||
+				(rr_pdo_program(servos, n, &rx, 1) != RET_OK) ||
+				(rr_pdo_program(servos, n, &tx, 1) != RET_OK))
+		{
+			LOG_ERROR(debug_log, "%s: PDO mapping failed", __func__);
+			return NULL;
+		}
+	}
+
+	rr_stream_t *s = (rr_stream_t *)calloc(1, sizeof(rr_stream_t));
+	if(!s)
+	{
+		return NULL;
+	}
+
+	for(s->depth = 1; s->depth < (uint32_t)depth; s->depth <<= 1)
+	{
+	}
+	s->iface = (rr_can_interface_t *)inst->udata;
+	s->mode = mode;
+	s->n = n;
+	s->servos = (rr_servo_t **)malloc(n * sizeof(rr_servo_t *));
+	s->q = (rr_setpoint_t *)malloc(s->depth * n * sizeof(rr_setpoint_t));
+	s->last = (rr_setpoint_t *)calloc(n, sizeof(rr_setpoint_t));
+	s->fill = (int *)malloc(n * sizeof(int));
+	s->pdo = (rr_pdo_frame_t *)calloc(n, sizeof(rr_pdo_frame_t));
+	if(!s->servos || !s->q || !s->last || !s->fill || !s->pdo)
+	{
+		rr_deinit_stream(&s);
+		return NULL;
+	}
+
+	for(int k = 0; k < n; k++)
+	{
+		s->servos[k] = servos[k];
+		s->fill[k] = -1;
+		s->pdo[k].id = ((usbcan_device_t *)servos[k]->dev)->id;
+		if(mode == RR_STREAM_PV)
+		{
+			rr_setup_servo_pdo_callback(servos[k], TPDO2, stream_fill_cb, &s->fill[k]);
+		}
+	}
+
+	return s;
+}
+
+/**
+ * @brief The function destroys a setpoint stream (see ::rr_init_stream). The stream is stopped first if it is running.
+ * @param stream Pointer to the stream descriptor, set to NULL on return
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Cyclic
+ */
+rr_ret_status_t rr_deinit_stream(rr_stream_t **stream)
+{
+	if(!stream || !*stream)
+	{
+		return RET_BAD_INSTANCE;
+	}
+
+	rr_stream_t *s = *stream;
+
+	if(s->started)
+	{
+		rr_stream_stop(s);
+	}
+	if((s->mode == RR_STREAM_PV) && s->servos)
+	{
+		for(int k = 0; k < s->n; k++)
+		{
+			rr_setup_servo_pdo_callback(s->servos[k], TPDO2, NULL, NULL);
+		}
+	}
+
+	free(s->servos);
+	free(s->q);
+	free(s->last);
+	free(s->fill);
+	free(s->pdo);
+	free(s);
+	*stream = NULL;
+
+	return RET_OK;
+}
+
+/**
+ * @brief The function pushes a setpoint sample of the servo group into the producer queue of the stream.
+ * <p>The queue is lock-free for a single producer thread and a single thread running ::rr_stream_cycle.</p>
+ * @param stream Stream descriptor returned by the ::rr_init_stream function
+ * @param sp Array of setpoints, one per servo in the order of the ::rr_init_stream 'servos' array
+ * @return Status code (::rr_ret_status_t)<br>RET_BUSY - the queue is full, retry later
+ * @ingroup Cyclic
+ */
+rr_ret_status_t rr_stream_push(rr_stream_t *stream, const rr_setpoint_t *sp)
+{
+	if(!stream)
+	{
+		return RET_BAD_INSTANCE;
+	}
+	if(!sp)
+	{
+		return RET_WRONG_ARG;
+	}
+
+	uint32_t h = stream->head;
+
+	if((h - __atomic_load_n(&stream->tail, __ATOMIC_ACQUIRE)) >= stream->depth)
+	{
+		return RET_BUSY;
+	}
+	memcpy(&stream->q[(h & (stream->depth - 1)) * stream->n], sp, stream->n * sizeof(rr_setpoint_t));
+	__atomic_store_n(&stream->head, h + 1, __ATOMIC_RELEASE);
+
+	return RET_OK;
+}
+
+/**
+ * @brief The function returns the free space in the producer queue of the stream (see ::rr_stream_push).
+ * @param stream Stream descriptor returned by the ::rr_init_stream function
+ * @param num Pointer to the variable to receive the number of samples the queue can accept
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Cyclic
+ */
+rr_ret_status_t rr_stream_get_free_space(const rr_stream_t *stream, uint32_t *num)
+{
+	if(!stream)
+	{
+		return RET_BAD_INSTANCE;
+	}
+	if(!num)
+	{
+		return RET_WRONG_ARG;
+	}
+
+	*num = stream->depth - (__atomic_load_n(&stream->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&stream->tail, __ATOMIC_ACQUIRE));
+
+	return RET_OK;
+}
+
+/**
+ * @brief The function starts the stream (see ::rr_init_stream). The servos should be in the operational state.
+ * <p>The function sets the cycle time of the servos (see ::rr_pdo_set_cycle_time). In the PV mode, it preloads the servo queues with 
+ * the first 'preload' samples from the producer queue and starts the motion. 
+ * Then, ::rr_stream_cycle should be called once per cycle, otherwise the servos will go to the pre-operational state on the SYNC timeout.</p>
+ * <p>In the PV mode, 'preload' is also the target servo queue fill: a sample is sent only while the queue fill reported by each servo 
+ * doesn't exceed it (with a small slack for the feedback delay). When the producer queue runs empty, the servo queues absorb the underrun.
+ * Once a servo queue is about to drain (or while no servo has reported its queue fill), the last position is held with zero velocity 
+ * until new samples arrive.
+ * In the velocity and current modes, zero setpoints are sent on underrun.</p>
+ * @param stream Stream descriptor returned by the ::rr_init_stream function
+ * @param cycle_us Cycle time in microseconds (0 - don't change the servo cycle time)
+ * @param preload Number of samples to preload (PV mode, at least 1)
+ * @return Status code (::rr_ret_status_t)<br>RET_ZERO_SIZE - the producer queue holds less than 'preload' samples
+ * @ingroup Cyclic
+ */
+rr_ret_status_t rr_stream_start(rr_stream_t *stream, uint32_t cycle_us, int preload)
+{
+	if(!stream)
+	{
+		return RET_BAD_INSTANCE;
+	}
+
+	rr_stream_t *s = stream;
+
+	if(s->mode == RR_STREAM_PV)
+	{
+		if(preload < 1)
+		{
+			return RET_WRONG_ARG;
+		}
+		if((__atomic_load_n(&s->head, __ATOMIC_ACQUIRE) - s->tail) < (uint32_t)preload)
+		{
+			return RET_ZERO_SIZE;
+		}
+	}
+
+	for(int k = 0; cycle_us && (k < s->n); k++)
+	{
+		if(rr_pdo_set_cycle_time(s->servos[k], cycle_us) != RET_OK)
+		{
+			return RET_ERROR;
+		}
+	}
+
+	memset(&s->stats, 0, sizeof(s->stats));
+	s->preload = preload;
+
+	if(s->mode == RR_STREAM_PV)
+	{
+		for(int k = 0; k < preload; k++)
+		{
+			stream_pop(s);
+			if(rr_send_pdo_group(s->iface, s->pdo, s->n, true) != RET_OK)
+			{
+				return RET_ERROR;
+			}
+		}
+
+		uint16_t cw = RR_API_STREAM_CW_START;
+		rr_pdo_frame_t start[s->n];
+
+		for(int k = 0; k < s->n; k++)
+		{
+			start[k] = (rr_pdo_frame_t){.id = s->pdo[k].id, .pdo_n = RPDO3, .len = sizeof(cw)};
+			memcpy(start[k].data, &cw, sizeof(cw));
+		}
+		if(rr_send_pdo_group(s->iface, start, s->n, false) != RET_OK)
+		{
+			return RET_ERROR;
+		}
+	}
+
+	s->started = true;
+
+	return RET_OK;
+}
+
+/**
+ * @brief The function runs one cycle of the stream: takes the next sample from the producer queue 
+ * and sends it to the servos along with SYNC frame (see ::rr_stream_start for flow control and underrun handling).
+ * <p>The function should be called once per cycle (e.g., with 'interval_sleep' from the 'rt.h' tutorial header) from a single thread.
+ * It does not block and involves a single transmission.</p>
+ * @param stream Stream descriptor returned by the ::rr_init_stream function
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Cyclic
+ */
+rr_ret_status_t rr_stream_cycle(rr_stream_t *stream)
+{
+	if(!stream)
+	{
+		return RET_BAD_INSTANCE;
+	}
+
+	rr_stream_t *s = stream;
+	int fill_min = INT32_MAX, fill_max = -1;
+	int np = s->n;
+
+	if(!s->started)
+	{
+		return RET_ERROR;
+	}
+
+	s->stats.cycles++;
+
+	if(s->mode == RR_STREAM_PV)
+	{
+		for(int k = 0; k < s->n; k++)
+		{
+			int f = __atomic_load_n(&s->fill[k], __ATOMIC_RELAXED);
+			if(f >= 0)
+			{
+				fill_min = MIN(fill_min, f);
+				fill_max = MAX(fill_max, f);
+			}
+		}
+		s->stats.queue_fill_max = MAX(s->stats.queue_fill_max, fill_max);
+	}
+
+	if((s->mode == RR_STREAM_PV) && (fill_max > s->preload + RR_API_STREAM_FILL_SLACK))
+	{
+		s->stats.throttled++;
+		np = 0;
+	}
+	else if(!stream_pop(s))
+	{
+		s->stats.underruns++;
+		//the hold is sent as well while no servo has reported its queue fill yet
+		if((s->mode != RR_STREAM_PV) || (fill_min == INT32_MAX) || (fill_min <= 1))
+		{
+			stream_encode(s, s->last, true);
+			s->stats.holds++;
+		}
+		else
+		{
+			np = 0;
+		}
+	}
+
+	return rr_send_pdo_group(s->iface, s->pdo, np, true);
+}
+
+/**
+ * @brief The function stops the stream (see ::rr_stream_start) and resets the cycle time of the servos to zero (SYNC timeout disabled).
+ * The samples left in the producer queue are kept.
+ * @param stream Stream descriptor returned by the ::rr_init_stream function
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Cyclic
+ */
+rr_ret_status_t rr_stream_stop(rr_stream_t *stream)
+{
+	if(!stream)
+	{
+		return RET_BAD_INSTANCE;
+	}
+
+	rr_ret_status_t sts = RET_OK;
+
+	stream->started = false;
+	for(int k = 0; k < stream->n; k++)
+	{
+		if(rr_pdo_set_cycle_time(stream->servos[k], 0) != RET_OK)
+		{
+			sts = RET_ERROR;
+		}
+	}
+
+	return sts;
+}
+
+/**
+ * @brief The function reads the statistics of the stream. The statistics are reset by ::rr_stream_start.
+ * @param stream Stream descriptor returned by the ::rr_init_stream function
+ * @param stats Pointer to the structure to receive the statistics
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Cyclic
+ */
+rr_ret_status_t rr_stream_get_stats(const rr_stream_t *stream, rr_stream_stats_t *stats)
+{
+	if(!stream)
+	{
+		return RET_BAD_INSTANCE;
+	}
+	if(!stats)
+	{
+		return RET_WRONG_ARG;
+	}
+
+	*stats = stream->stats;
+
+	return RET_OK;
+}
+
+/*
+ * Emergency log manipulation functions
+ */
+
+
+/**
+ * @brief The function returns the total count of entries in the EMCY logging buffer. Each entry in the buffer contains an EMCY event
+ * that have occurred up to the moment on the servo specified in the descriptor.
+ * <b>Note:</b>When the API library is disabled, no new entries are made in the buffer, irrespective of whether or not any events occur on the servo.
+ * <br>The function is used in combination with the ::rr_emcy_log_pop and ::rr_emcy_log_clear functions. The typical sequence is as follows:
+ * <ol><li>to clear the EMCY logging buffer with the ::rr_emcy_log_clear</li>
+ * <li>to get the total count of entries in the EMCY logging buffer, using the ::rr_emcy_log_get_size function </li>
+ * <li>to read the EMCY events from the buffer with the ::rr_emcy_log_pop function </li></ol>
+
+ * @param iface Descriptor of the interface returned by the ::rr_init_interface function
+ * @return int number of unread entries
+ * @ingroup Err
+ */
+int rr_emcy_log_get_size(rr_can_interface_t *iface)
+{
+	return 	((iface->emcy_log.head - iface->emcy_log.tail + iface->emcy_log.sz) % iface->emcy_log.sz);
+}
+
+void rr_emcy_log_push(rr_can_interface_t *iface, uint8_t id, uint16_t err_code, uint8_t err_reg,
+		uint8_t err_bits, int32_t err_info)
+{
+	int unused = iface->emcy_log.sz - rr_emcy_log_get_size(iface);
+
+	iface->emcy_log.head = (iface->emcy_log.head + 1) % iface->emcy_log.sz;
+	iface->emcy_log.d[iface->emcy_log.head].id = id;
+	iface->emcy_log.d[iface->emcy_log.head].err_code = err_code;
+	iface->emcy_log.d[iface->emcy_log.head].err_reg = err_reg;
+	iface->emcy_log.d[iface->emcy_log.head].err_bits = err_bits;
+	iface->emcy_log.d[iface->emcy_log.head].err_info = err_info;
+	if(unused <= 1)
+	{
+		iface->emcy_log.tail = (iface->emcy_log.tail + 1) % iface->emcy_log.sz;
+	}
+}
+
+
+/**
+ * @brief The function enables reading entries from the EMCY logging buffer. Reading the entries is according to the "first in-first out" principle.
+ * Once an EMCY entry is read, the function removes it permenantly from the EMCY logging buffer.<br>
+ * <b>Note:</b>Typically, the rr_emcy_log_pop function is used in combination with the ::rr_emcy_log_get_size and ::rr_emcy_log_clear functions.
+ * For the sequence of using the functions, see ::rr_emcy_log_get_size.
+ * @param iface Descriptor of the interface returned by the ::rr_init_interface function
+ * @return emcy_log_entry_t pointer to the EMCY entry or NULL if the buffer contains no entries
+ * @ingroup Err
+ */
+emcy_log_entry_t *rr_emcy_log_pop(rr_can_interface_t *iface)
+{
+	if(iface->emcy_log.tail != iface->emcy_log.head)
+	{
+		iface->emcy_log.tail = (iface->emcy_log.tail + 1) % iface->emcy_log.sz;
+		return &iface->emcy_log.d[iface->emcy_log.tail];
+	}
+	return NULL;
+}
+
+/**
+ * @brief The function clears the EMCY logging buffer, removing the total of entries from it.
+ * It is advisable to use the clearing function in the beginning of a new work session and before applying the ::rr_emcy_log_get_size and
+ * ::rr_emcy_log_pop functions. For the typical sequence of using the functions, see ::rr_emcy_log_get_size.
+ * @param iface Descriptor of the interface returned by the ::rr_init_interface function
+ * @return void
+ * @ingroup Err
+ */
+void rr_emcy_log_clear(rr_can_interface_t *iface)
+{
+	iface->emcy_log.head = 0;
+	iface->emcy_log.tail = 0;
+}
+
+/**
+ * @brief The function returns a string describing the NMT state code specified in the 'state' parameter. 
+ * You can also use the function with ::rr_setup_nmt_callback, setting the callback to display a detailed message
+ * describing an NMT event.
+ * @param state NMT state code to descibe
+ * @return Pointer to the description string
+ * @ingroup State
+ */
+const char *rr_describe_nmt(rr_nmt_state_t state)
+{
+	switch(state)
+	{
+		case RR_NMT_INITIALIZING:
+			return "Device is initializing";
+		case RR_NMT_BOOT:
+			return "Bootloader mode";
+		case RR_NMT_PRE_OPERATIONAL:
+			return "Device is in pre-operational mode";
+		case RR_NMT_OPERATIONAL:
+			return "Device is in operational mode";
+		case RR_NMT_STOPPED:
+			return "Device is in stopped mode";
+		case RR_NMT_HB_TIMEOUT:
+			return "Device disappeared";
+		default:
+			return "N/A";
+	}
+}
+
+/**
+ * @brief The function returns a string describing in detail a specific EMCY event based on the code in the 'bit' parameter (e.g., "CAN bus warning limit reached").
+ * The function can be used in combination with ::rr_describe_emcy_code. The latter provides a more generic description of an EMCY event.
+ * @param bit Error bit field of the corresponding EMCY message (according to the CanOpen standard)
+ * @return Pointer to the description string
+ * @ingroup Err
+ */
+const char *rr_describe_emcy_bit(uint8_t bit)
+{
+	switch(bit)
+	{
+		case CO_EM_NO_ERROR:
+			return "Error Reset or No Error";
+		case CO_EM_CAN_BUS_WARNING:
+			return "CAN bus warning limit reached";
+		case CO_EM_RXMSG_WRONG_LENGTH:
+			return "Wrong data length of the received CAN message";
+		case CO_EM_RXMSG_OVERFLOW:
+			return "Previous received CAN message wasn't processed yet";
+		case CO_EM_RPDO_WRONG_LENGTH:
+			return "Wrong data length of received PDO";
+		case CO_EM_RPDO_OVERFLOW:
+			return "Previous received PDO wasn't processed yet";
+		case CO_EM_CAN_RX_BUS_PASSIVE:
+			return "CAN Rx passive";
+		case CO_EM_CAN_TX_BUS_PASSIVE:
+			return "CAN Tx passive";
+
+		case CO_EM_NMT_WRONG_COMMAND:
+			return "Wrong NMT command received";
+			//case 09-11 unused
+
+		case CO_EM_CAN_TX_BUS_OFF:
+			return "CAN transmit bus is off";
+		case CO_EM_CAN_RXB_OVERFLOW:
+			return "CAN module receive buffer has overflowed";
+		case CO_EM_CAN_TX_OVERFLOW:
+			return "CAN transmit buffer has overflowed";
+		case CO_EM_TPDO_OUTSIDE_WINDOW:
+			return "TPDO is outside SYNC window";
+
+			//case 16-17 unused
+
+		case CO_EM_SYNC_TIME_OUT:
+			return "SYNC message timeout";
+		case CO_EM_SYNC_LENGTH:
+			return "Unexpected SYNC data length";
+		case CO_EM_PDO_WRONG_MAPPING:
+			return "Error with PDO mapping";
+		case CO_EM_HB_CONSUMER_REMOTE_RESET:
+			return "Heartbeat consumer detected remote node reset";
+
+			//case 1D-1F unused
+
+		case CO_EM_EMERGENCY_BUFFER_FULL:
+			return "Emergency buffer is full, Emergency message wasn't sent";
+		case CO_EM_MOTION_ERROR:
+			return "Motion Error";
+		case CO_EM_MICROCONTROLLER_RESET:
+			return "Microcontroller has just started";
+		case CO_EM_UNAUTHORIZED_ACCESS:
+			return "Access is only available to service engineer";
+		case CO_EM_TEMPERATURE_ERROR:
+			return "Temperature Motor is too high";
+		case CO_EM_TEMPERATURE_INTRNL_ERROR:
+			return "Temperature PCB is too high";
+		case CO_EM_HARDWARE_ERROR:
+			return "Hardware error (driver error)";
+		case CO_EM_MOTION_INVALID:
+			return "Invalid motion command received";
+
+		case CO_EM_WRONG_ERROR_REPORT:
+			return "Wrong parameters to CO_EM_reportError() function";
+		case CO_EM_ISR_TIMER_OVERFLOW:
+			return "Timer task has overflowed";
+		case CO_EM_MEMORY_ALLOCATION_ERROR:
+			return "Unable to allocate memory for objects";
+		case CO_EM_GENERIC_ERROR:
+			return "Generic error, test usage";
+		case CO_EM_GENERIC_SOFTWARE_ERROR:
+			return "Software error";
+		case CO_EM_INCONSISTENT_OBJECT_DICT:
+			return "Object dictionary does not match the software";
+		case CO_EM_CALCULATION_OF_PARAMETERS:
+			return "Error in calculation of device parameters";
+		case CO_EM_NON_VOLATILE_MEMORY:
+			return "Error with access to non volatile device memory";
+
+		case CO_EM_FLT_CONFIG_CONSTRAINT:
+			return "Constraint was applied to the settings";
+		case CO_EM_FLT_CONFIG_CRC:
+			return "CRC check of the setings failed";
+		case CO_EM_FLT_NTC:
+			return "NTC Error";
+		case CO_EM_FLT_CS0:
+			return "Current sensor 0 error";
+		case CO_EM_FLT_CS1:
+			return "Current sensor 1 error";
+		case CO_EM_FLT_CS2:
+			return "Current sensor 2 error";
+		case CO_EM_FLT_DRIVER:
+			return "Driver error";
+		case CO_EM_FLT_VS0:
+			return "Voltage sensor error";
+
+		case CO_EM_FLT_ENC_M_OFF:
+			return "Motor Encoder disconnected";
+		case CO_EM_FLT_ENC_G_OFF:
+			return "Gear Encoder disconnected";
+		case CO_EM_FLT_ENC_M_STUP_CRC:
+			return "Motor Encoder CRC_ERR/EPR_ERR in STATUS1 & STUP in STATUS0";
+		case CO_EM_FLT_ENC_G_STUP_CRC:
+			return "Gear Encoder CRC_ERR/EPR_ERR in STATUS1 & STUP in STATUS0";
+		case CO_EM_FLT_ENC_M_LEVEL:
+			return "Motor Encoder FRQ_ABZ/FRQ_CNV in STATUS1 & AN_MAX/AN_MIN/AM_MAX/AM_MIN in STATUS0";
+		case CO_EM_FLT_ENC_G_LEVEL:
+			return "Gear Encoder FRQ_ABZ/FRQ_CNV in STATUS1 & AN_MAX/AN_MIN/AM_MAX/AM_MIN in STATUS0";
+		case CO_EM_FLT_ENC_M_SIG:
+			return "Motor Encoder NON_CTR bit in STATUS1";
+		case CO_EM_FLT_ENC_G_SIG:
+			return "Gear Encoder NON_CTR bit in STATUS1";
+
+		case CO_EM_HW_VOLT_LO:
+			return "Under Voltage";
+		case CO_EM_HW_VOLT_HI:
+			return "Over Voltage";
+		case CO_EM_HW_CUR_LIMIT:
+			return "Over Current";
+		case CO_EM_POWER_ERROR:
+			return "Over Power";
+		case CO_EM_FORCE_ERROR:
+			return "Over Force";
+		case CO_EM_HEARTBEAT_CONSUMER:
+			return "Heartbeat consumer timeout";
+
+		case CO_EM_HW_CUR_LIMIT_A:
+			return "Current Limit Phase A";
+		case CO_EM_HW_CUR_LIMIT_B:
+			return "Current Limit Phase B";
+		case CO_EM_HW_CUR_LIMIT_C:
+			return "Current Limit Phase C";
+
+		default:
+			return "N/A";
+	}
+}
+
+/**
+ * @brief The function returns a string descibing a specific EMCY event based on the error code in the 'code' parameter. 
+ * The description in the string is a generic type of the occured emergency event (e.g., "Temperature").
+ * For a more detailed description, use the function together with the ::rr_describe_emcy_bit one.
+ * @param code Error code from the corresponding EMCY message (according to the CanOpen standard)
+ * @return Pointer to the description string
+ * @ingroup Err
+ */
+const char *rr_describe_emcy_code(uint16_t code)
+{
+	switch(code)
+	{
+		case CO_EMC_NO_ERROR:
+			return "Error Reset or No Error";
+		case CO_EMC_GENERIC:
+			return "Generic Error";
+		case CO_EMC_CURRENT:
+			return "Current";
+		case CO_EMC_CURRENT_INPUT:
+			return "Current, device input side";
+		case CO_EMC_CURRENT_INSIDE:
+			return "Current inside the device";
+		case CO_EMC_CURRENT_OUTPUT:
+			return "Current, device output side";
+		case CO_EMC_VOLTAGE:
+			return "Voltage";
+		case CO_EMC_VOLTAGE_MAINS:
+			return "Mains Voltage";
+		case CO_EMC_VOLTAGE_INSIDE:
+			return "Voltage inside the device";
+		case CO_EMC_VOLTAGE_OUTPUT:
+			return "Output Voltage";
+		case CO_EMC_TEMPERATURE:
+			return "Temperature";
+		case CO_EMC_TEMP_AMBIENT:
+			return "Ambient Temperature";
+		case CO_EMC_TEMP_DEVICE:
+			return "Device Temperature";
+		case CO_EMC_HARDWARE:
+			return "Device Hardware";
+		case CO_EMC_SOFTWARE_DEVICE:
+			return "Device Software";
+		case CO_EMC_SOFTWARE_INTERNAL:
+			return "Internal Software";
+		case CO_EMC_SOFTWARE_USER:
+			return "User Software";
+		case CO_EMC_DATA_SET:
+			return "Data Set";
+		case CO_EMC_ADDITIONAL_MODUL:
 			return "Additional Modules";
 		case CO_EMC_MONITORING:
 			return "Monitoring";
@@ -1066,1128 +2930,3232 @@ const char *rr_describe_emcy_code(uint16_t code)
 		case CO_EMC_DEVICE_SPECIFIC:
 			return "Device specific";
 
-		case CO_EMC401_OUT_CUR_HI:
-			return "DS401: Current at outputs too high (overload)";
-		case CO_EMC401_OUT_SHORTED:
-			return "DS401: Short circuit at outputs";
-		case CO_EMC401_OUT_LOAD_DUMP:
-			return "DS401: Load dump at outputs";
-		case CO_EMC401_IN_VOLT_HI:
-			return "DS401: Input voltage too high";
-		case CO_EMC401_IN_VOLT_LOW:
-			return "DS401: Input voltage too low";
-		case CO_EMC401_INTERN_VOLT_HI:
-			return "DS401: Internal voltage too high";
-		case CO_EMC401_INTERN_VOLT_LO:
-			return "DS401: Internal voltage too low";
-		case CO_EMC401_OUT_VOLT_HIGH:
-			return "DS401: Output voltage too high";
-		case CO_EMC401_OUT_VOLT_LOW:
-			return "DS401: Output voltage too low";
-		case CO_EMC401_POWER_TEMP_OVER:
-			return "High temperature of the PCB";
-		case CO_EMC401_MOTOR_TEMP_OVER:
-			return "High temperature of the motor";
-		case CO_EMC401_SYS_ERROR:
-			return "System error";
-		case CO_EMC401_POINT_ERROR:
-			return "System error: invalid motion point";
-		case CO_EMC401_CURR_MEAS_OFFSET:
-			return "Control: Current measurement offset";
-		case CO_EMC401_EE_FAULT:
-			return "EEPROM fault";
-		case CO_EMC401_EE_CRC_ERROR:
-			return "EEPROM checksum error";
-		case CO_EMC401_CONF_ERROR:
-			return "Configuration error";
-		case CO_EMC401_ENC_CNT_ERROR:
-			return "Encoder counting error";
-		case CO_EMC401_VEL_FLW_ERROR:
-			return "Velocity controller following error";
-		case CO_EMC401_POS_LIMIT:
-			return "Position controller limits";
-		case CO_EMC401_POS_FLW_ERROR:
-			return "Position controller following error";
-		case CO_EMC401_POS_FLW_STATIC_ERROR:
-			return "Position controller static following error";
-		case CO_EMC401_ACCESS_ERROR:
-			return "Unauthorized access";
-		case CO_EMC401_PWRCTRL_ERROR:
-			return "Power Stage Controller Error";
-		case CO_EMC401_BUSY:
-			return "Busy";
-		case CO_EMC401_PROCEDURE_ERROR:
-			return "Procedure error";
-		case CO_EMC401_FORCE_OVER:
-			return "Over force";
-		case CO_EMC401_POWER_OVER:
-			return "Over power";
-		default:
-			return "N/A";
+		case CO_EMC401_OUT_CUR_HI:
+			return "DS401: Current at outputs too high (overload)";
+		case CO_EMC401_OUT_SHORTED:
+			return "DS401: Short circuit at outputs";
+		case CO_EMC401_OUT_LOAD_DUMP:
+			return "DS401: Load dump at outputs";
+		case CO_EMC401_IN_VOLT_HI:
+			return "DS401: Input voltage too high";
+		case CO_EMC401_IN_VOLT_LOW:
+			return "DS401: Input voltage too low";
+		case CO_EMC401_INTERN_VOLT_HI:
+			return "DS401: Internal voltage too high";
+		case CO_EMC401_INTERN_VOLT_LO:
+			return "DS401: Internal voltage too low";
+		case CO_EMC401_OUT_VOLT_HIGH:
+			return "DS401: Output voltage too high";
+		case CO_EMC401_OUT_VOLT_LOW:
+			return "DS401: Output voltage too low";
+		case CO_EMC401_POWER_TEMP_OVER:
+			return "High temperature of the PCB";
+		case CO_EMC401_MOTOR_TEMP_OVER:
+			return "High temperature of the motor";
+		case CO_EMC401_SYS_ERROR:
+			return "System error";
+		case CO_EMC401_POINT_ERROR:
+			return "System error: invalid motion point";
+		case CO_EMC401_CURR_MEAS_OFFSET:
+			return "Control: Current measurement offset";
+		case CO_EMC401_EE_FAULT:
+			return "EEPROM fault";
+		case CO_EMC401_EE_CRC_ERROR:
+			return "EEPROM checksum error";
+		case CO_EMC401_CONF_ERROR:
+			return "Configuration error";
+		case CO_EMC401_ENC_CNT_ERROR:
+			return "Encoder counting error";
+		case CO_EMC401_VEL_FLW_ERROR:
+			return "Velocity controller following error";
+		case CO_EMC401_POS_LIMIT:
+			return "Position controller limits";
+		case CO_EMC401_POS_FLW_ERROR:
+			return "Position controller following error";
+		case CO_EMC401_POS_FLW_STATIC_ERROR:
+			return "Position controller static following error";
+		case CO_EMC401_ACCESS_ERROR:
+			return "Unauthorized access";
+		case CO_EMC401_PWRCTRL_ERROR:
+			return "Power Stage Controller Error";
+		case CO_EMC401_BUSY:
+			return "Busy";
+		case CO_EMC401_PROCEDURE_ERROR:
+			return "Procedure error";
+		case CO_EMC401_FORCE_OVER:
+			return "Over force";
+		case CO_EMC401_POWER_OVER:
+			return "Over power";
+		default:
+			return "N/A";
+	}
+}
+
+/**
+ * @brief The function is the first to call to be able to work with the user API. It opens the COM port where the corresponding CAN-USB dongle
+ * is connected, enabling communication between the user program and the servo motors on the respective CAN bus.
+ <p><b>Example:</b></p>
+ * <p>rr_can_interface_t *iface =  rr_init_interface	("/dev/ttyACM0");</p>
+ * <p><code>if(!iface)<br>
+ *{<br>
+ *	... handle errors ...<br>
+ *}</code></p>
+ * @param interface_name Full path to the COM port to open. The path can vary, depending on the operating system.
+ <p><b>Examples:</b></p>
+ <p>OS Linux: "/dev/ttyACM0"</p>
+ <p>mac OS: "/dev/cu.modem301"</p>
+ * @return Interface descriptor (::rr_can_interface_t)<br> or NULL when an error occurs
+ * @ingroup Init
+ */
+rr_can_interface_t *rr_init_interface(const char *interface_name)
+{
+	rr_can_interface_t *i = (rr_can_interface_t *)calloc(1, sizeof(rr_can_interface_t));
+
+	if(!i)
+	{
+		return NULL;
+	}
+
+	rr_set_debug_log_stream(stderr);
+
+	rr_node_t *nodes = (rr_node_t *)aligned_calloc(MAX_CO_DEV * sizeof(rr_node_t), __alignof__(rr_node_t));
+	if(!nodes)
+	{
+		free(i);
+		return NULL;
+	}
+	for(int k = 0; k < MAX_CO_DEV; k++)
+	{
+		nodes[k].mirror_layout = &mirror_default_layout;
+		nodes[k].mirror.nmt_state = RR_NMT_HB_TIMEOUT;
+	}
+	i->nodes = nodes;
+
+	rr_cycle_mon_t *cmon = (rr_cycle_mon_t *)calloc(1, sizeof(rr_cycle_mon_t));
+	if(!cmon)
+	{
+		aligned_free(i->nodes);
+		free(i);
+		return NULL;
+	}
+	pthread_mutex_init(&cmon->mutex, NULL);
+	i->cycle_mon = cmon;
+
+	rr_dispatch_t *disp = (rr_dispatch_t *)calloc(1, sizeof(rr_dispatch_t));
+	if(!disp)
+	{
+		pthread_mutex_destroy(&cmon->mutex);
+		free(i->cycle_mon);
+		aligned_free(i->nodes);
+		free(i);
+		return NULL;
+	}
+	pthread_mutex_init(&disp->mutex, NULL);
+	i->dispatch = disp;
+
+	usbcan_instance_t *usbcan = usbcan_instance_init(interface_name);
+	if(!usbcan)
+	{
+		pthread_mutex_destroy(&disp->mutex);
+		free(i->dispatch);
+		pthread_mutex_destroy(&cmon->mutex);
+		free(i->cycle_mon);
+		aligned_free(i->nodes);
+		free(i);
+		return NULL;
+	}
+	usbcan->udata = i;
+	i->iface = usbcan;
+
+	usbcan_setup_nmt_state_cb(usbcan, rr_nmt_state_master_cb);
+	usbcan_setup_com_frame_cb(usbcan, rr_com_frame_cb);
+	usbcan_setup_pdo_cb(usbcan, rr_pdo_cb);
+	usbcan_setup_emcy_cb(usbcan, rr_emcy_master_cb);
+
+	i->emcy_log.d = (emcy_log_entry_t *)malloc(sizeof(emcy_log_entry_t) * EMCY_LOG_DEPTH);
+	i->emcy_log.sz = EMCY_LOG_DEPTH;
+	i->emcy_log.head = 0;
+	i->emcy_log.tail = 0;
+
+	if(!i->iface)
+	{
+		free(i->emcy_log.d);
+		free(i->dispatch);
+		free(i->cycle_mon);
+		aligned_free(i->nodes);
+		free(i);
+		return NULL;
+	}
+
+	return i;
+}
+
+/**
+ * @brief The function closes the COM port where the corresponding CAN-USB dongle is connected,
+ * clearing all data associated with the interface descriptor.
+ * It is advisable to call the function every time before quitting the user program.
+ * @param iface Interface descriptor (see ::rr_init_interface).
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Init
+ */
+rr_ret_status_t rr_deinit_interface(rr_can_interface_t **iface)
+{
+	IS_VALID_INTERFACE(*iface);
+
+	if(usbcan_instance_deinit((usbcan_instance_t **)&((*iface)->iface)))
+	{
+		pthread_mutex_destroy(&((rr_dispatch_t *)(*iface)->dispatch)->mutex);
+		free((*iface)->dispatch);
+		pthread_mutex_destroy(&((rr_cycle_mon_t *)(*iface)->cycle_mon)->mutex);
+		free((*iface)->cycle_mon);
+		aligned_free((*iface)->nodes);
+		free(*iface);
+		*iface = NULL;
+		return RET_OK;
+	}
+	return RET_ERROR;
+}
+
+/**
+ * @brief The function determines whether the servo motor with the specified ID is connected to the specified interface. It waits for 2 seconds to receive a Heartbeat message from the servo.
+ * When the message arrives within the interval, the servo is identified as successfully connected.<br>
+ * <p>The function returns the servo descriptor that you will need for subsequent API calls to the servo.</p> 
+ * <p><b>Note:</b> When the Heartbeat messages of the servo are already being received, the function returns immediately.</p>
+ * @param iface Descriptor of the interface (returned by the ::rr_init_interface function) where the servo is connected
+ * @param id Unique identifier of the servo in the specified interface. The available value range is from 0 to 127.
+ * @return Servo descriptor (::rr_servo_t) <br> or NULL when no Heartbeat message is received within the specified interval
+ * @ingroup Init
+ */
+rr_servo_t *rr_init_servo(rr_can_interface_t *iface, const uint8_t id)
+{
+	rr_servo_t *s = NULL;
+
+	rr_init_servos(iface, &id, 1, &s);
+
+	return s;
+}
+
+/**
+ * @brief The function initializes several servos at once. Unlike calling ::rr_init_servo for each servo,
+ * it waits for the Heartbeat messages of all the servos simultaneously, with a single 2-second deadline for the whole group.
+ * Servos whose Heartbeat messages are already being received are initialized immediately.
+ * <p></p>
+ * @param iface Descriptor of the interface (returned by the ::rr_init_interface function) where the servos are connected
+ * @param ids Array of servo identifiers
+ * @param n Number of servos in the 'ids' array
+ * @param servos Pointer to the array where the servo descriptors are returned (one per identifier). 
+ * The entry is set to NULL when no Heartbeat message is received from the servo within the interval.
+ * @return Status code (::rr_ret_status_t): RET_OK when all the servos are initialized, RET_TIMEOUT when some of them are missing
+ * @ingroup Init
+ */
+rr_ret_status_t rr_init_servos(rr_can_interface_t *iface, const uint8_t *ids, int n, rr_servo_t **servos)
+{
+	IS_VALID_INTERFACE(iface);
+	usbcan_instance_t *inst = (usbcan_instance_t *)iface->iface;
+
+	if((n <= 0) || !ids || !servos)
+	{
+		return RET_WRONG_ARG;
+	}
+
+	int id[n];
+	bool alive[n];
+
+	for(int i = 0; i < n; i++)
+	{
+		id[i] = ids[i];
+		servos[i] = NULL;
+	}
+
+	wait_devices(inst, id, n, RR_API_WAIT_DEVICE_TIMEOUT_MS, alive);
+
+	rr_ret_status_t ret = RET_OK;
+
+	for(int i = 0; i < n; i++)
+	{
+		if(!alive[i])
+		{
+			ret = RET_TIMEOUT;
+			continue;
+		}
+
+		rr_servo_t *s = (rr_servo_t *)calloc(1, sizeof(rr_servo_t));
+		if(!s)
+		{
+			ret = RET_ERROR;
+			continue;
+		}
+		s->dev = usbcan_device_init(inst, id[i]);
+		if(!s->dev)
+		{
+			free(s);
+			ret = RET_ERROR;
+			continue;
+		}
+		servos[i] = s;
+	}
+
+	return ret;
+}
+
+/**
+ * @brief The function deinitializes the servo, clearing all data associated with the servo descriptor.
+ * @param servo Servo descriptor returned by the ::rr_init_servo function
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Init
+ */
+rr_ret_status_t rr_deinit_servo(rr_servo_t **servo)
+{
+	IS_VALID_SERVO(*servo);
+
+	usbcan_device_t *dev = (usbcan_device_t *)(*servo)->dev;
+	rr_node_t *n = dev->inst ? get_node(dev->inst, dev->id) : NULL;
+	if(n && (n->pcache_servo == *servo))
+	{
+		__atomic_store_n(&n->pcache_servo, NULL, __ATOMIC_RELEASE);
+	}
+
+	if(dev->inst && dev->inst->udata)
+	{
+		rr_dispatch_t *d = (rr_dispatch_t *)((rr_can_interface_t *)dev->inst->udata)->dispatch;
+
+		pthread_mutex_lock(&d->mutex);
+		for(int k = TPDO0; k <= TPDO3; k++)
+		{
+			rr_cob_entry_t *e = cob_lookup(d, RR_API_TPDO_COB_ID(dev->id, k), false);
+			if(e->servo == *servo)
+			{
+				cob_entry_store(e, RR_API_TPDO_COB_ID(dev->id, k), NULL, NULL, NULL);
+			}
+		}
+		pthread_mutex_unlock(&d->mutex);
+
+		//the interface thread may still be running a callback with the servo
+		dispatch_grace(dev->inst, d);
+	}
+
+	if(usbcan_device_deinit((usbcan_device_t **)&((*servo)->dev)))
+	{
+		free(*servo);
+		*servo = NULL;
+		return RET_OK;
+	}
+	return RET_ERROR;
+}
+
+/**
+ * @brief The function reboots the servo specified in the 'servo' parameter of the function, resetting it to the power-on state.
+ * @param servo Servo descriptor returned by the ::rr_init_servo function 
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup State
+ */
+rr_ret_status_t rr_servo_reboot(const rr_servo_t *servo)
+{
+	IS_VALID_SERVO(servo);
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	clear_device_boot_up_flag(dev->inst, dev->id);
+	if(!write_nmt(dev->inst, dev->id, CO_NMT_CMD_RESET_NODE))
+	{
+		return RET_ERROR;
+	}
+	if(!wait_device_boot_up(dev->inst, dev->id, RR_API_REBOOT_TIMEOUT_MS))
+	{
+		return RET_ERROR;
+	}
+	return RET_OK;
+}
+
+/**
+ * @brief The function resets communication with the servo specified in the 'servo' parameter without resetting the entire interface.
+ * @param servo Servo descriptor returned by the ::rr_init_servo function
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup State
+ */
+rr_ret_status_t rr_servo_reset_communication(const rr_servo_t *servo)
+{
+	IS_VALID_SERVO(servo);
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	clear_device_boot_up_flag(dev->inst, dev->id);
+	if(!write_nmt(dev->inst, dev->id, CO_NMT_CMD_RESET_COMM))
+	{
+		return RET_ERROR;
+	}
+	if(!wait_device_boot_up(dev->inst, dev->id, RR_API_RESET_COMM_TIMEOUT_MS))
+	{
+		return RET_ERROR;
+	}
+	return RET_OK;
+}
+
+/**
+ * @brief The function sets the servo specified in the 'servo' parameter to the operational state. In the state, the servo is both available for communication and can execute commands.
+ * <p>For instance, you may need to call the function to switch the servo from the pre-operational state to the operational one after an error (e.g., due to overcurrent).</p>
+ * @param servo Servo descriptor returned by the ::rr_init_servo function
+ *  If the parameter is set to 0, all servos connected to the interface will be set to the operational state.
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup State
+ */
+rr_ret_status_t rr_servo_set_state_operational(const rr_servo_t *servo)
+{
+	IS_VALID_SERVO(servo);
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	if(!write_nmt(dev->inst, dev->id, CO_NMT_CMD_GOTO_OP))
+	{
+		return RET_ERROR;
+	}
+	if(!wait_device_state(dev->inst, dev->id, CO_NMT_OPERATIONAL, RR_API_CHANGE_STATE_TIMEOUT_MS))
+	{
+		return RET_ERROR;
+	}
+	return RET_OK;
+}
+
+/**
+ * @brief The function sets the servo specified in the 'servo' parameter to the pre-operational state. In the state, the servo is available for communication, but cannot execute any commands.  
+ * <p>For instance, you may need to call the function, if you want to force the servo to stop executing commands, e.g., in an emergency.</p>
+ * @param servo Servo descriptor returned by the ::rr_init_servo function
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup State
+ */
+rr_ret_status_t rr_servo_set_state_pre_operational(const rr_servo_t *servo)
+{
+	IS_VALID_SERVO(servo);
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	if(!write_nmt(dev->inst, dev->id, CO_NMT_CMD_GOTO_PREOP))
+	{
+		return RET_ERROR;
+	}
+	if(!wait_device_state(dev->inst, dev->id, CO_NMT_PRE_OPERATIONAL, RR_API_CHANGE_STATE_TIMEOUT_MS))
+	{
+		return RET_ERROR;
+	}
+	return RET_OK;
+}
+
+/**
+ * @brief The function sets the servo specified in the 'servo' parameter to the stopped state. In the state, only Heartbeats are available. You can neither communicate with the servo nor make it execute any commands.  
+ * <p>For instance, you may need to call the fuction to reduce the workload of a CAN bus by disabling individual servos connected to it without deninitializing them.</p>
+ * @param servo Servo descriptor returned by the ::rr_init_servo function  
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup State
+ */
+rr_ret_status_t rr_servo_set_state_stopped(const rr_servo_t *servo)
+{
+	IS_VALID_SERVO(servo);
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+
+	if(!write_nmt(dev->inst, dev->id, CO_NMT_CMD_GOTO_STOPPED))
+	{
+		return RET_ERROR;
+	}
+
+	if(!wait_device_state(dev->inst, dev->id, CO_NMT_STOPPED, RR_API_CHANGE_STATE_TIMEOUT_MS))
+	{
+		return RET_ERROR;
+	}
+	return RET_OK;
+}
+
+/**
+ * @brief The function sets the servo to the specified NMT state (operational, pre-operational or stopped)
+ * and waits until the servo reports the state in its Heartbeat message.
+ * The function returns as soon as the Heartbeat message is received (no polling is involved), 
+ * so it can be called by several threads simultaneously.
+ * <p></p>
+ * @param servo Servo descriptor returned by the ::rr_init_servo function
+ * @param state Target state: RR_NMT_OPERATIONAL, RR_NMT_PRE_OPERATIONAL or RR_NMT_STOPPED
+ * @param timeout_ms Maximum waiting time in milliseconds
+ * @return Status code (::rr_ret_status_t): RET_OK when the servo has entered the state, RET_TIMEOUT otherwise
+ * @ingroup State
+ */
+rr_ret_status_t rr_servo_set_state_and_wait(const rr_servo_t *servo, rr_nmt_state_t state, int timeout_ms)
+{
+	IS_VALID_SERVO(servo);
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	int cmd = nmt_cmd(state);
+	uint32_t seq;
+
+	if(cmd < 0)
+	{
+		return RET_WRONG_ARG;
+	}
+
+	get_devices_hb_seq(dev->inst, &dev->id, 1, &seq);
+
+	if(!write_nmt(dev->inst, dev->id, (usbcan_nmt_cmd_t)cmd))
+	{
+		return RET_ERROR;
+	}
+	if(!wait_devices_state(dev->inst, &dev->id, 1, (usbcan_nmt_state_t)state, &seq, timeout_ms, NULL))
+	{
+		return RET_TIMEOUT;
+	}
+	return RET_OK;
+}
+
+/**
+ * @brief The function retrieves the actual NMT state of a specified servo. The state is described as a status code (::rr_nmt_state_t).  
+ * <p></p>
+ * @param servo Servo descriptor returned by the ::rr_init_servo function 
+ * @param state Pointer to the variable where the state of the servo is returned 
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup State
+ */
+rr_ret_status_t rr_servo_get_state(const rr_servo_t *servo, rr_nmt_state_t *state)
+{
+	IS_VALID_SERVO(servo);
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+
+	*state = (rr_nmt_state_t)usbcan_get_device_state(dev->inst, dev->id);
+
+	return RET_OK;
+}
+
+/**
+ * @brief The function retrieves statistics on minimal and maximal intervals between Heartbeat messages of a servo. The statistics is saved to the variables
+ * specified in the param min_hb_ival and param max_hb_ival parameters, from where they are available for the user to perform further operations (e.g., comparison).<br>
+ * The Heartbeat statistics is helpful in diagnozing and troubleshooting servo failures. For instance, when the Heartbeat interval of a servo is too long,
+ * it may mean that the control device sees the servo as being offline.<br>
+ * <b>Note:</b> Before using the function, it is advisable to clear Heartbeat statistics with ::rr_servo_clear_hb_stat. 
+ * @param servo Servo descriptor returned by the ::rr_init_servo function 
+ * @param min_hb_ival Pointer to the variable where the minimal arrival interval is to be saved; when set to NULL, the variable is disabled. 
+ * @param max_hb_ival Pointer to the variable where the maximal arrival interval is to be saved; when set to NULL, the variable is disabled.
+ * @return Status code (::rr_ret_status_t), min_hb_ival & max_hb_ival - min/max arrival intervals or -1 if no information available
+ * @ingroup State
+ */
+rr_ret_status_t rr_servo_get_hb_stat(const rr_servo_t *servo, int64_t *min_hb_ival, int64_t *max_hb_ival)
+{
+	IS_VALID_SERVO(servo);
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+
+	if(min_hb_ival)
+	{
+		*min_hb_ival = usbcan_get_min_hb_interval(dev->inst, dev->id);
+	}
+
+	if(max_hb_ival)
+	{
+		*max_hb_ival = usbcan_get_max_hb_interval(dev->inst, dev->id);
+	}
+
+	return RET_OK;
+}
+
+/**
+ * @brief The function clears statistics on minimal and maximal intervals between Heartbeat messages of a servo.
+ * It is advisable to use the function before attempting to get the Heartbeat statistics with the ::rr_servo_get_hb_stat function.
+ * @param servo Servo descriptor returned by the ::rr_init_servo function 
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup State
+ */
+rr_ret_status_t rr_servo_clear_hb_stat(const rr_servo_t *servo)
+{
+	IS_VALID_SERVO(servo);
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+
+	usbcan_clear_hb_stat(dev->inst, dev->id);
+
+	return RET_OK;
+}
+
+/**
+ * @brief The function reboots all servos connected to the interface specified in the 'interface' parameter,
+ * resetting them back to the power-on state.
+ * @param iface Interface descriptor returned by the ::rr_init_interface function
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup State
+ */
+rr_ret_status_t rr_net_reboot(const rr_can_interface_t *iface)
+{
+	IS_VALID_INTERFACE(iface);
+	usbcan_instance_t *inst = (usbcan_instance_t *)iface->iface;
+	return write_nmt(inst, 0, CO_NMT_CMD_RESET_NODE) ? RET_OK : RET_ERROR;
+}
+
+/**
+ * @brief The function resets communication via the interface specified in the 'interface' parameter.
+ * For instance, you may need to use the function when changing settings that require a reset after modification.
+ * @param iface Interface descriptor returned by the ::rr_init_interface function 
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup State
+ */
+rr_ret_status_t rr_net_reset_communication(const rr_can_interface_t *iface)
+{
+	IS_VALID_INTERFACE(iface);
+	usbcan_instance_t *inst = (usbcan_instance_t *)iface->iface;
+	return write_nmt(inst, 0, CO_NMT_CMD_RESET_COMM) ? RET_OK : RET_ERROR;
+}
+
+/**
+ * @brief The function sets all servos connected to the interface (CAN bus) specified in the 'interface' parameter to the operational state.
+ *  In the state, the servos can both communicate with the user program and execute commands.
+ *  <p>For instance, you may need to call the function to switch all servos on a specific bus from the
+ *  pre-operational state to the operational one after an error (e.g., due to overcurrent).</p>
+ * @param iface Interface descriptor returned by the ::rr_init_interface function  
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup State
+ */
+rr_ret_status_t rr_net_set_state_operational(const rr_can_interface_t *iface)
+{
+	IS_VALID_INTERFACE(iface);
+	usbcan_instance_t *inst = (usbcan_instance_t *)iface->iface;
+	return write_nmt(inst, 0, CO_NMT_CMD_GOTO_OP) ? RET_OK : RET_ERROR;
+}
+
+/**
+ * @brief The function sets all servos connected to the interface specified in the 'interface' parameter to the pre-operational state.  
+ * In the state, the servos are available for communication, but cannot execute commands.
+ * <p>For instance, you may need to call the function, if you want to force all servos on a specific bus to stop executing commands, e.g., in an emergency.</p>
+ * @param iface Interface descriptor returned by the ::rr_init_interface function 
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup State
+ */
+rr_ret_status_t rr_net_set_state_pre_operational(const rr_can_interface_t *iface)
+{
+	IS_VALID_INTERFACE(iface);
+	usbcan_instance_t *inst = (usbcan_instance_t *)iface->iface;
+	return write_nmt(inst, 0, CO_NMT_CMD_GOTO_PREOP) ? RET_OK : RET_ERROR;
+}
+
+/**
+ * @brief The function sets all servos connected to the interface specified in the 'interface' parameter to the stopped state.  
+ * In the state, the servos are neither available for communication nor can execute commands.
+ * <p>For instance, you may need to call the fuction to stop all servos on a specific bus without deinitializing them.</p>
+ * @param iface Interface descriptor returned by the ::rr_init_interface function. 
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup State
+ */
+rr_ret_status_t rr_net_set_state_stopped(const rr_can_interface_t *iface)
+{
+	IS_VALID_INTERFACE(iface);
+	usbcan_instance_t *inst = (usbcan_instance_t *)iface->iface;
+	return write_nmt(inst, 0, CO_NMT_CMD_GOTO_STOPPED) ? RET_OK : RET_ERROR;
+}
+
+/**
+ * @brief The function retrieves the actual NMT state of any device (a servo motor or any other) connected to the specified CAN network.
+ * The state is described as a status code (:: rr_nmt_state_t). 
+ * <p></p>
+ * @param iface Interface descriptor returned by the ::rr_init_interface function 
+ * @param id Identificator of the addressed device 
+ * @param state Pointer to the variable where the state of the device is returned 
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup State
+ */
+rr_ret_status_t rr_net_get_state(const rr_can_interface_t *iface, int id, rr_nmt_state_t *state)
+{
+	IS_VALID_INTERFACE(iface);
+	usbcan_instance_t *inst = (usbcan_instance_t *)iface->iface;
+
+	*state = (rr_nmt_state_t)usbcan_get_device_state(inst, id);
+
+	return RET_OK;
+}
+
+/**
+ * @brief The function sets the specified devices to the NMT state (operational, pre-operational or stopped)
+ * and waits until every device reports the state in its Heartbeat message.
+ * The function returns as soon as the last Heartbeat message is received (no polling is involved).
+ * <p>When 'ids' is NULL, the command is broadcast to the whole network and the function waits for all the devices 
+ * whose Heartbeat messages are being received (see ::rr_net_list_nodes).</p>
+ * @param iface Interface descriptor returned by the ::rr_init_interface function 
+ * @param state Target state: RR_NMT_OPERATIONAL, RR_NMT_PRE_OPERATIONAL or RR_NMT_STOPPED
+ * @param ids Array of device identifiers or NULL for all devices
+ * @param n Number of devices in the 'ids' array
+ * @param timeout_ms Maximum waiting time in milliseconds
+ * @return Status code (::rr_ret_status_t): RET_OK when all the devices have entered the state, RET_TIMEOUT otherwise
+ * @ingroup State
+ */
+rr_ret_status_t rr_net_set_state_and_wait(const rr_can_interface_t *iface, rr_nmt_state_t state, const uint8_t *ids, int n, int timeout_ms)
+{
+	IS_VALID_INTERFACE(iface);
+	usbcan_instance_t *inst = (usbcan_instance_t *)iface->iface;
+	int cmd = nmt_cmd(state);
+	int id[MAX_CO_DEV];
+	uint32_t seq[MAX_CO_DEV];
+
+	if((cmd < 0) || (ids && !INRANGE(n, 1, MAX_CO_DEV)))
+	{
+		return RET_WRONG_ARG;
+	}
+
+	if(ids)
+	{
+		for(int i = 0; i < n; i++)
+		{
+			id[i] = ids[i];
+		}
+	}
+	else
+	{
+		n = MIN(usbcan_get_alive_devices(inst, id, NULL, MAX_CO_DEV), MAX_CO_DEV);
+	}
+
+	get_devices_hb_seq(inst, id, n, seq);
+
+	if(ids)
+	{
+		for(int i = 0; i < n; i++)
+		{
+			if(!write_nmt(inst, id[i], (usbcan_nmt_cmd_t)cmd))
+			{
+				return RET_ERROR;
+			}
+		}
+	}
+	else if(!write_nmt(inst, 0, (usbcan_nmt_cmd_t)cmd))
+	{
+		return RET_ERROR;
+	}
+
+	if(!wait_devices_state(inst, id, n, (usbcan_nmt_state_t)state, seq, timeout_ms, NULL))
+	{
+		return RET_TIMEOUT;
+	}
+	return RET_OK;
+}
+
+/**
+ * @brief The function lists all devices whose heartbeats are currently being received on the specified CAN network.
+ * No CAN communication is involved: the list is built from the heartbeat table maintained by the interface,
+ * so the function returns immediately.
+ * <p></p>
+ * @param iface Interface descriptor returned by the ::rr_init_interface function 
+ * @param nodes Pointer to the array where the identifiers and NMT states of the devices are returned
+ * @param count Pointer to the variable holding the capacity of the 'nodes' array on input 
+ * and the number of alive devices on output (may exceed the input capacity, in which case the list is truncated)
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup State
+ */
+rr_ret_status_t rr_net_list_nodes(const rr_can_interface_t *iface, rr_net_node_t *nodes, int *count)
+{
+	IS_VALID_INTERFACE(iface);
+	usbcan_instance_t *inst = (usbcan_instance_t *)iface->iface;
+
+	if(!count || (*count < 0) || (*count && !nodes))
+	{
+		return RET_WRONG_ARG;
+	}
+
+	int ids[MAX_CO_DEV];
+	usbcan_nmt_state_t states[MAX_CO_DEV];
+	int n = usbcan_get_alive_devices(inst, ids, states, MAX_CO_DEV);
+
+	for(int i = 0; i < MIN(n, *count); i++)
+	{
+		nodes[i].id = ids[i];
+		nodes[i].state = (rr_nmt_state_t)states[i];
+	}
+	*count = n;
+
+	return RET_OK;
+}
+
+/**
+ * @brief The function reads the identity objects (device name, hardware and software versions, 0x1018 identity record)
+ * of the specified devices. Requests to different devices are issued concurrently, 
+ * so the total time is close to that of identifying a single device.
+ * <p>All the objects are requested even if some of them fail, so the ones a device provides are returned anyway.
+ * The 'status' field reflects the first object that failed.</p>
+ * @param iface Interface descriptor returned by the ::rr_init_interface function 
+ * @param nodes Array of devices to identify (e.g., returned by the ::rr_net_list_nodes function)
+ * @param ident Pointer to the array where the identities are returned (one entry per device in 'nodes')
+ * @param count Number of devices in the 'nodes' array
+ * @return Status code (::rr_ret_status_t): RET_OK when all the devices were identified,
+ * RET_ERROR otherwise (see the 'status' field of each entry)
+ * @ingroup State
+ */
+rr_ret_status_t rr_net_identify_nodes(const rr_can_interface_t *iface, const rr_net_node_t *nodes, rr_net_node_identity_t *ident, int count)
+{
+	IS_VALID_INTERFACE(iface);
+	usbcan_instance_t *inst = (usbcan_instance_t *)iface->iface;
+
+	if((count < 0) || (count && (!nodes || !ident)))
+	{
+		return RET_WRONG_ARG;
+	}
+	if(!count)
+	{
+		return RET_OK;
+	}
+
+	const int per_node = 7;
+	usbcan_sdo_req_t req[count * per_node];
+	uint8_t u32[count][4][4];
+	rr_ret_status_t ret = RET_OK;
+
+	for(int i = 0; i < count; i++)
+	{
+		rr_net_node_identity_t *d = &ident[i];
+		usbcan_sdo_req_t *r = &req[i * per_node];
+
+		memset(d, 0, sizeof(*d));
+		d->id = nodes[i].id;
+
+		r[0] = (usbcan_sdo_req_t){.id = d->id, .idx = 0x1008, .data = (uint8_t *)d->device_name, .len = sizeof(d->device_name) - 1};
+		r[1] = (usbcan_sdo_req_t){.id = d->id, .idx = 0x1009, .data = (uint8_t *)d->hw_version, .len = sizeof(d->hw_version) - 1};
+		r[2] = (usbcan_sdo_req_t){.id = d->id, .idx = 0x100a, .data = (uint8_t *)d->sw_version, .len = sizeof(d->sw_version) - 1};
+		for(int k = 0; k < 4; k++)
+		{
+			r[3 + k] = (usbcan_sdo_req_t){.id = d->id, .idx = 0x1018, .sidx = k + 1, .data = u32[i][k], .len = 4};
+		}
+		for(int k = 0; k < per_node; k++)
+		{
+			r[k].retry = 1;
+			r[k].tout = 200;
+		}
+	}
+
+	batch_raw_sdo(inst, req, count * per_node, false);
+
+	for(int i = 0; i < count; i++)
+	{
+		rr_net_node_identity_t *d = &ident[i];
+		usbcan_sdo_req_t *r = &req[i * per_node];
+
+		d->status = RET_OK;
+		for(int k = 0; k < per_node; k++)
+		{
+			if(!r[k].done || r[k].abt)
+			{
+				d->status = !r[k].done ? RET_ERROR : (r[k].abt == -1u) ? RET_TIMEOUT : ret_sdo(r[k].abt);
+				ret = RET_ERROR;
+				break;
+			}
+		}
+		for(int k = 0; k < 3; k++)
+		{
+			((char *)r[k].data)[r[k].done && !r[k].abt ? r[k].len : 0] = 0;
+		}
+		uint32_t *v[4] = {&d->vendor_id, &d->product_code, &d->revision, &d->serial};
+		for(int k = 0; k < 4; k++)
+		{
+			if(r[3 + k].done && !r[3 + k].abt && (r[3 + k].len == 4))
+			{
+				usb_can_get_uint32_t(u32[i][k], 0, v[k], 1);
+			}
+		}
+	}
+
+	return ret;
+}
+
+
+/**
+ * @brief The function sets the specified servo to the released state. The servo is de-energized 
+ * and continues rotating for as long as it is affected by external forces (e.g., inertia, gravity).
+ * <p><b>Note:</b> Affected by external force, the servo may also begin rotating in the opposite direction.</p>
+ * @param servo Servo descriptor returned by the ::rr_init_servo function 
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Motion
+ */
+rr_ret_status_t rr_release(const rr_servo_t *servo)
+{
+	IS_VALID_SERVO(servo);
+	CHECK_NMT_STATE(servo);
+
+	uint8_t data = 0;
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	uint32_t sts = write_raw_sdo(dev, 0x2010, 0x01, &data, sizeof(data), 1, 100);
+
+	return ret_sdo(sts);
+}
+
+/**
+ * @brief The function sets the specified servo to the freeze state. The servo stops, retaining its last position.
+ * @param servo Servo descriptor returned by the ::rr_init_servo function
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Motion
+ */
+rr_ret_status_t rr_freeze(const rr_servo_t *servo)
+{
+	IS_VALID_SERVO(servo);
+	CHECK_NMT_STATE(servo);
+
+	uint8_t data = 0;
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	uint32_t sts = write_raw_sdo(dev, 0x2010, 0x02, &data, sizeof(data), 1, 100);
+
+	return ret_sdo(sts);
+}
+
+/**
+ * @brief The function sets the current supplied to the stator of the servo specified in the 'servo' parameter.
+ * Changing the 'current_a parameter' value, it is possible to adjust the servo's torque (Torque = stator current*Kt).
+ * @param servo Servo descriptor returned by the ::rr_init_servo function 
+ * @param current_a Phase current of the stator in Amperes
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Motion
+ */
+rr_ret_status_t rr_set_current(const rr_servo_t *servo, const float current_a)
+{
+	IS_VALID_SERVO(servo);
+	CHECK_NMT_STATE(servo);
+
+	uint8_t data[4];
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	usb_can_put_float(data, 0, &current_a, 1);
+	uint32_t sts = write_raw_sdo(dev, 0x2012, 0x01, data, sizeof(data), 1, 100);
+
+	return ret_sdo(sts);
+}
+
+/**
+ * @brief The function applies or releases the servo's built-in brake.
+ * If a servo is supplied without a brake, the function will not work.
+ * In this case, to stop a servo, use either the ::rr_freeze() or ::rr_release() function.
+ * @param servo Servo descriptor returned by the ::rr_init_servo function 
+ * @param en Desired action: true - engage brake, false - disengage
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Motion
+ */
+rr_ret_status_t rr_brake_engage(const rr_servo_t *servo, const bool en)
+{
+	IS_VALID_SERVO(servo);
+	CHECK_NMT_STATE(servo);
+
+	uint8_t data = en ? 1 : 0;
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+
+	uint32_t sts = write_raw_sdo(dev, 0x2010, 0x03, &data, sizeof(data), 1, 100);
+
+	return ret_sdo(sts);
+}
+
+/**
+ * @brief The function sets the output shaft velocity with which the specified servo should move at its maximum current.
+ * The maximum current is in accordance with the servo motor specification. When you need to set a lower current limit, use the ::rr_set_velocity_with_limits function.
+ * <p>The rr_set_velocity() function works with geared servos only. When a servo includes no gearhead, use the ::rr_set_velocity_motor() for setting servo velocity.</p>
+ * @param servo Servo descriptor returned by the ::rr_init_servo function
+ * @param velocity_deg_per_sec Velocity (in degrees/sec) at the servo flange 
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Motion
+ */
+rr_ret_status_t rr_set_velocity(const rr_servo_t *servo, const float velocity_deg_per_sec)
+{
+	IS_VALID_SERVO(servo);
+	CHECK_NMT_STATE(servo);
+
+	uint8_t data[4];
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	usb_can_put_float(data, 0, &velocity_deg_per_sec, 1);
+	uint32_t sts = write_raw_sdo(dev, 0x2012, 0x03, data, sizeof(data), 1, 100);
+
+	return ret_sdo(sts);
+}
+
+/**
+ * @brief The function sets the velocity with which the motor of the specified servo should move at its maximum current.
+ * The maximum current is in accordance with the servo motor specification.
+ * <p>You can use the function for both geared servos and servos without a gearhead.
+ * When a servo is geared, the velocity at the output flange will depend on the applied gear ratio (refer to the servo motor specification).</p>
+ * @param servo Servo descriptor returned by the ::rr_init_servo function
+ * @param velocity_rpm Velocity of the motor (in revolutions per minute)
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Motion
+ */
+rr_ret_status_t rr_set_velocity_motor(const rr_servo_t *servo, const float velocity_rpm)
+{
+	IS_VALID_SERVO(servo);
+	CHECK_NMT_STATE(servo);
+
+	uint8_t data[3];
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	usb_can_put_float24(data, 0, &velocity_rpm, 1);
+	uint32_t sts = write_raw_sdo(dev, 0x2012, 0x03, data, sizeof(data), 1, 100);
+
+	return ret_sdo(sts);
+}
+
+/**
+ * @brief The function sets the position that the specified servo should reach as a result of executing the command.
+ * The velocity and current are maximum values in accordance with the servo motor specifications.
+ * For setting lower velocity and current limits, use the ::rr_set_position_with_limits function.
+ * @param servo Servo descriptor returned by the ::rr_init_servo function 
+ * @param position_deg Position of the servo (in degrees) to be reached. The parameter is a multi-turn value (e.g., when set to 720, the servo will make two turns, 360 degrees each).
+ When the parameter is set to a "-" sign value, the servo will rotate in the opposite direction. 
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Motion
+ */
+rr_ret_status_t rr_set_position(const rr_servo_t *servo, const float position_deg)
+{
+	IS_VALID_SERVO(servo);
+	CHECK_NMT_STATE(servo);
+
+	uint8_t data[4];
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	usb_can_put_float(data, 0, &position_deg, 1);
+	uint32_t sts = write_raw_sdo(dev, 0x2012, 0x04, data, sizeof(data), 1, 100);
+
+	return ret_sdo(sts);
+}
+
+/**
+ * @brief The function changes velocity rate limiter acceleration value,
+ * @param servo Servo descriptor returned by the ::rr_init_servo function 
+ * @param velocity_rate_rpm_per_sec Velocity rate (in RPM/sec) at the motor flange. Take into account gear reduction ratio.
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Motion
+ */
+rr_ret_status_t rr_set_velocity_rate(const rr_servo_t *servo, const float velocity_rate_rpm_per_sec)
+{
+	IS_VALID_SERVO(servo);
+	CHECK_NMT_STATE(servo);
+
+	if(velocity_rate_rpm_per_sec < 0)
+	{
+		return RET_WRONG_ARG;
+	}
+
+	uint8_t data[8];
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	int p = 0;
+	p = usb_can_put_float(data, p, &velocity_rate_rpm_per_sec, 1);
+	uint32_t sts = write_raw_sdo(dev, 0x4308, 0x06, data, p, 1, 100);
+
+	return ret_sdo(sts);
+}
+
+/**
+ * @brief The function reads velocity rate limiter acceleration value,
+ * @param servo Servo descriptor returned by the ::rr_init_servo function 
+ * @param velocity_rate_rpm_per_sec Pointer to put velocity rate in. See ::rr_set_velocity_rate for details.
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Motion
+ */
+rr_ret_status_t rr_get_velocity_rate(const rr_servo_t *servo, float *const velocity_rate_rpm_per_sec)
+{
+	IS_VALID_SERVO(servo);
+	CHECK_NMT_STATE(servo);
+
+	if(velocity_rate_rpm_per_sec < 0)
+	{
+		return RET_WRONG_ARG;
+	}
+
+	uint8_t data[8];
+	int l = sizeof(data);
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	uint32_t sts = read_raw_sdo(dev, 0x4308, 0x06, data, &l, 1, 100);
+	if(sts != CO_SDO_AB_NONE)
+	{
+		return ret_sdo(sts);
+	}
+
+	if(l != sizeof(float))
+	{
+		return RET_SIZE_MISMATCH;
+	}
+
+	usb_can_get_float(data, 0, velocity_rate_rpm_per_sec, 1);
+	return RET_OK;
+}
+
+/**
+ * @brief Function is deprecated!. Use ::rr_get_velocity_rate and ::rr_set_velocity_rate to get or set velocity rate limiter acceleration value.
+ * The function commands the specified servo to rotate at the specified velocity,
+ * while setting the maximum limit for the servo current (below the servo motor specifications).
+ * The velocity value is the velocity of the servo’s output shaft.
+ * <p>Similarly to ::rr_set_velocity(), this function can be used for geared servos only.</p>
+ * @param servo Servo descriptor returned by the ::rr_init_servo function 
+ * @param velocity_deg_per_sec Velocity (in degrees/sec) at the servo flange. The value can have a "-" sign, in which case the servo will rotate in the opposite direction.
+ * @param current_a Maximum user-defined current limit in Amperes.
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Motion
+ */
+rr_ret_status_t rr_set_velocity_with_limits(const rr_servo_t *servo, const float velocity_deg_per_sec, const float current_a)
+{
+	IS_VALID_SERVO(servo);
+	CHECK_NMT_STATE(servo);
+
+	uint8_t data[8];
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	int p = 0;
+	p = usb_can_put_float(data, p, &velocity_deg_per_sec, 1);
+	p = usb_can_put_float(data, p, &current_a, 1);
+	uint32_t sts = write_raw_sdo(dev, 0x2012, 0x05, data, sizeof(data), 1, 100);
+
+	return ret_sdo(sts);
+}
+
+/*
+ * PVAT profile of the position move (acceleration phase of d = 3 * vm^2 / 4 / am, cruise and deceleration),
+ * stretched to 'duration_ms' by lowering the cruise velocity when the motion is shorter. Returns the motion time (ms).
+ */
+static uint32_t position_profile(double ps, double pf, double vm, double am, uint32_t duration_ms, rr_motion_point_t *pt, int *n)
+{
+	double dist = fabs(pf - ps);
+	double dir = SIGN(pf - ps);
+	double d = 3.0 * SQ(vm) / 4.0 / am;
+
+	*n = 0;
+	if(dist == 0)
+	{
+		return 0;
+	}
+	if(2.0 * d >= dist)
+	{
+		d = 0.5 * dist;
+		vm = 2.0 * sqrt(am * d / 3.0);
+	}
+
+	uint32_t own_ms = 2 * lround(1000.0 * 2.0 * d / vm) + lround(1000.0 * (dist - 2.0 * d) / vm);
+
+	if(duration_ms > own_ms)
+	{
+		//time = 1.5 * vm / am + dist / vm, the lower root keeps the cruise phase
+		double T = duration_ms / 1000.0;
+		vm = am * (T - sqrt(fmax(SQ(T) - 6.0 * dist / am, 0))) / 3.0;
+		d = 3.0 * SQ(vm) / 4.0 / am;
+	}
+	else
+	{
+		duration_ms = own_ms;
+	}
+
+	uint32_t ta_ms = lround(1000.0 * 2.0 * d / vm);
+	uint32_t tc_ms = duration_ms > 2 * ta_ms ? duration_ms - 2 * ta_ms : 0;
+
+	ta_ms = MIN(ta_ms, duration_ms - tc_ms);
+	pt[(*n)++] = (rr_motion_point_t){ps + dir * d, dir * vm, 0, ta_ms};
+	if(tc_ms)
+	{
+		pt[(*n)++] = (rr_motion_point_t){pf - dir * d, dir * vm, 0, tc_ms};
+	}
+	pt[(*n)++] = (rr_motion_point_t){pf, 0, 0, duration_ms - tc_ms - ta_ms};
+
+	return duration_ms;
+}
+
+/*
+ * Start position of a move: the state mirror position when the mirror decodes it (see rr_servo_mirror_setup)
+ * from a TPDO actually mapped that way and that TPDO has been received within RR_API_MIRROR_POSITION_AGE_US, 
+ * otherwise the position is read from the servo.
+ */
+static rr_ret_status_t motion_start_position(const rr_servo_t *servo, float *position)
+{
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	rr_node_t *n = get_node(dev->inst, dev->id);
+	const rr_pdo_layout_t *l = n ? __atomic_load_n(&n->mirror_layout, __ATOMIC_ACQUIRE) : NULL;
+
+	for(int k = 0; l && (k < l->n_sig); k++)
+	{
+		if(l->sig[k].offset != offsetof(rr_servo_state_t, position))
+		{
+			continue;
+		}
+
+		int p = l->pdo[l->sig_pdo[k]] - TPDO0;
+		const rr_pdo_layout_t *map = __atomic_load_n(&n->tpdo_map[p], __ATOMIC_ACQUIRE);
+		int64_t ts = __atomic_load_n(&n->mirror_pdo_us[p], __ATOMIC_RELAXED);
+		rr_servo_state_t st;
+
+		if(((map == l) || (!map && (l == &mirror_default_layout))) && ts && 
+				(monotonic_us() - ts <= RR_API_MIRROR_POSITION_AGE_US) && (rr_servo_snapshot(servo, &st) == RET_OK))
+		{
+			*position = st.position;
+			return RET_OK;
+		}
+		break;
+	}
+
+	return rr_read_parameter((rr_servo_t *)servo, APP_PARAM_POSITION, position);
+}
+
+/*
+ * Maximum velocity of the servo cached by rr_get_max_velocity within RR_API_MAX_VELOCITY_AGE_US
+ */
+static rr_ret_status_t motion_max_velocity(const rr_servo_t *servo, float *velocity)
+{
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	rr_node_t *n = get_node(dev->inst, dev->id);
+
+	if(n)
+	{
+		int64_t ts = __atomic_load_n(&n->max_velocity_us, __ATOMIC_ACQUIRE);
+		if(ts && (monotonic_us() - ts <= RR_API_MAX_VELOCITY_AGE_US))
+		{
+			__atomic_load(&n->max_velocity, velocity, __ATOMIC_RELAXED);
+			return RET_OK;
+		}
+	}
+
+	return rr_get_max_velocity(servo, velocity);
+}
+
+/**
+ * @brief The function sets the position that the servo should reach with velocity and acceleration limits on generated trajectory.
+ * <p>The velocity limit is clamped to the maximum velocity of the servo (see ::rr_get_max_velocity), which is cached for up to 1 s (it follows the supply voltage).
+ * The start position is taken from the servo state mirror (see ::rr_servo_snapshot) when the mirror decodes the position,
+ * the TPDO carrying it is mapped as the mirror decodes it (the factory TPDO0 mapping or the mirror layout programmed 
+ * with ::rr_pdo_program) and has been received within the last 20 ms, otherwise it is read from the servo. 
+ * The trajectory points are written back-to-back in a single pipelined pass, so with a streaming mirror 
+ * the function involves no read requests at all.</p>
+ * <p><b>Note:</b> The motion starts with ::rr_start_motion, i.e. the points already queued on the other servos are started as well.</p>
+ * @param servo Servo descriptor returned by the ::rr_init_servo function
+ * @param position_deg Final position of the servo flange (in degrees) to be reached
+ * @param velocity_deg_per_sec Maximum Velocity on generated trajectory (in degrees/sec)
+ * @param accel_deg_per_sec_sq Maximum acceleration on generated trajectory (in degrees/(sec*sec))
+ * @param time_ms Trajectory execution time (im milliseconds): int
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Motion
+ */
+rr_ret_status_t rr_set_position_with_limits(rr_servo_t *servo, const float position_deg, const float velocity_deg_per_sec, const float accel_deg_per_sec_sq, uint32_t *time_ms)
+{
+	IS_VALID_SERVO(servo);
+	CHECK_NMT_STATE(servo);
+
+	if(!(velocity_deg_per_sec != 0) || !(accel_deg_per_sec_sq != 0))
+	{
+		return RET_WRONG_ARG;
+	}
+
+	rr_ret_status_t sts;
+
+	/* Get current position */
+	float current_position = 0.0;
+	if((sts = motion_start_position(servo, &current_position)) != RET_OK)
+	{
+		return sts;
+	}
+
+	/* Read max velocity */
+	float max_velocity = 0.0;
+	if((sts = motion_max_velocity(servo, &max_velocity)) != RET_OK)
+	{
+		return sts;
+	}
+
+	double vm = fabs(velocity_deg_per_sec); //max velocity
+	if(max_velocity > 0)
+	{
+		vm = MIN(vm, max_velocity);
+	}
+
+	rr_motion_point_t pt[3];
+	const rr_motion_point_t *ppt = pt;
+	int cnt;
+	uint32_t duration_ms = position_profile(current_position, position_deg, vm, fabs(accel_deg_per_sec_sq), 0, pt, &cnt);
+
+	if(time_ms)
+	{
+		*time_ms = duration_ms;
+	}
+
+	int rej = -1;
+	if((sts = add_motion_points_batch((const rr_servo_t *const *)&servo, 1, &ppt, &cnt, true, false, &rej)) != RET_OK)
+	{
+		rr_clear_points_all(servo);
+		LOG_ERROR(debug_log, "Can't add motion point %d", rej);
+		return sts;
 	}
+
+	usbcan_instance_t *inst = ((usbcan_device_t *)servo->dev)->inst;
+	write_timestamp(inst, 0);
+
+	return RET_OK;
 }
 
 /**
- * @brief The function is the first to call to be able to work with the user API. It opens the COM port where the corresponding CAN-USB dongle
- * is connected, enabling communication between the user program and the servo motors on the respective CAN bus.
- <p><b>Example:</b></p>
- * <p>rr_can_interface_t *iface =  rr_init_interface	("/dev/ttyACM0");</p>
- * <p><code>if(!iface)<br>
- *{<br>
- *	... handle errors ...<br>
- *}</code></p>
- * @param interface_name Full path to the COM port to open. The path can vary, depending on the operating system.
- <p><b>Examples:</b></p>
- <p>OS Linux: "/dev/ttyACM0"</p>
- <p>mac OS: "/dev/cu.modem301"</p>
- * @return Interface descriptor (::rr_can_interface_t)<br> or NULL when an error occurs
- * @ingroup Init
+ * @brief The function moves a group of servos to the target positions with velocity and acceleration limits, 
+ * so that all of them start and arrive simultaneously.
+ * <p>Each servo gets the PVAT profile of ::rr_set_position_with_limits (with the velocity limit clamped to ::rr_get_max_velocity).
+ * The profiles of the faster servos are stretched to the duration of the slowest one by lowering their cruise velocities.
+ * The start positions and maximum velocities of all the servos are read in a single pipelined pass, 
+ * the points are uploaded in parallel (see ::rr_add_motion_points_group) and the motion starts with ::rr_start_motion.</p>
+ * <p><b>Note:</b> The motion queues of the servos should be empty.</p>
+ * @param servos Array of servo descriptors (on the same interface)
+ * @param n Number of servos in the 'servos' array (up to the number of CAN node identifiers, ::MAX_CO_DEV)
+ * @param targets_deg Array of target positions (in degrees)
+ * @param vmax_deg_per_sec Array of velocity limits (in degrees/sec)
+ * @param amax_deg_per_sec_sq Array of acceleration limits (in degrees/sec^2)
+ * @param time_ms Pointer to the variable to receive the motion time (ms) or NULL
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Motion
+ */
+rr_ret_status_t rr_group_move_to(rr_servo_t *const *servos, int n, const float *targets_deg, 
+		const float *vmax_deg_per_sec, const float *amax_deg_per_sec_sq, uint32_t *time_ms)
+{
+	//the servos share a bus, so their number is bounded and the per-servo arrays stay on the stack
+	if(!servos || (n <= 0) || (n > MAX_CO_DEV) || !targets_deg || !vmax_deg_per_sec || !amax_deg_per_sec_sq)
+	{
+		return RET_WRONG_ARG;
+	}
+
+	usbcan_instance_t *inst = NULL;
+	usbcan_sdo_req_t req[2 * n];
+	uint8_t buf[2 * n][4];
+
+	for(int i = 0; i < n; i++)
+	{
+		IS_VALID_SERVO(servos[i]);
+		CHECK_NMT_STATE(servos[i]);
+		if(!(vmax_deg_per_sec[i] != 0) || !(amax_deg_per_sec_sq[i] != 0))
+		{
+			return RET_WRONG_ARG;
+		}
+
+		usbcan_device_t *dev = (usbcan_device_t *)servos[i]->dev;
+		if(inst && (inst != dev->inst))
+		{
+			return RET_WRONG_ARG;
+		}
+		inst = dev->inst;
+		req[2 * i] = (usbcan_sdo_req_t){.id = dev->id, .idx = 0x2013, .sidx = APP_PARAM_POSITION, .data = buf[2 * i], .len = 4, .retry = 2, .tout = 100};
+		req[2 * i + 1] = (usbcan_sdo_req_t){.id = dev->id, .idx = 0x2207, .sidx = 0x02, .data = buf[2 * i + 1], .len = 4, .retry = 1, .tout = 100};
+	}
+
+	batch_raw_sdo(inst, req, 2 * n, true);
+
+	double ps[n], vm[n];
+
+	for(int i = 0; i < n; i++)
+	{
+		float v[2];
+
+		for(int k = 0; k < 2; k++)
+		{
+			usbcan_sdo_req_t *r = &req[2 * i + k];
+			if(!r->done || r->abt)
+			{
+				return !r->done ? RET_TIMEOUT : ret_sdo(r->abt);
+			}
+			if(r->len != 4)
+			{
+				return RET_SIZE_MISMATCH;
+			}
+			usb_can_get_float(r->data, 0, &v[k], 1);
+		}
+		ps[i] = v[0];
+		vm[i] = fabs(vmax_deg_per_sec[i]);
+		if(v[1] > 0)
+		{
+			vm[i] = MIN(vm[i], v[1]);
+		}
+	}
+
+	/*Synchronize to the slowest servo*/
+	rr_motion_point_t pt[n][3];
+	const rr_motion_point_t *ppt[n];
+	int cnt[n];
+	uint32_t duration_ms = 0;
+
+	for(int i = 0; i < n; i++)
+	{
+		duration_ms = MAX(duration_ms, position_profile(ps[i], targets_deg[i], vm[i], fabs(amax_deg_per_sec_sq[i]), 0, pt[i], &cnt[i]));
+	}
+	for(int i = 0; i < n; i++)
+	{
+		position_profile(ps[i], targets_deg[i], vm[i], fabs(amax_deg_per_sec_sq[i]), duration_ms, pt[i], &cnt[i]);
+		ppt[i] = pt[i];
+	}
+
+	rr_ret_status_t sts = rr_add_motion_points_group(servos, n, ppt, cnt, true, NULL);
+	if(sts != RET_OK)
+	{
+		for(int i = 0; i < n; i++)
+		{
+			rr_clear_points_all(servos[i]);
+		}
+		return sts;
+	}
+
+	if(time_ms)
+	{
+		*time_ms = duration_ms;
+	}
+	write_timestamp(inst, 0);
+
+	return RET_OK;
+}
+
+/**
+ * @brief The function limits the input voltage supplied to the servo, enabling to adjust its motion velocity.
+ * For instance, when the input voltage is 20V, setting the duty_percent parameter to 40% will result in 8V supplied to the servo.
+ * @param servo Servo descriptor returned by the ::rr_init_servo function 
+ * @param duty_percent User-defined percentage of the input voltage to be supplied to the servo
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Motion
+ */
+rr_ret_status_t rr_set_duty(const rr_servo_t *servo, float duty_percent)
+{
+	IS_VALID_SERVO(servo);
+	CHECK_NMT_STATE(servo);
+
+	uint8_t data[4];
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	usb_can_put_float(data, 0, &duty_percent, 1);
+	uint32_t sts = write_raw_sdo(dev, 0x2012, 0x07, data, sizeof(data), 1, 100);
+
+	return ret_sdo(sts);
+}
+
+/**
+ * @brief The function enables creating PVT (position-velocity-time) points to set the motion trajectory of the servo specified in the 'servo' parameter.
+ * PVT points define the following:<br>
+ * <ul><li>what position the servo specified in the 'servo' parameter should reach</li><br>
+ * <li>how fast the servo should move to the specified position</li><br>
+ * <li>how long the movement to the specified position should take</li></ul>
+ * <p>The graphs below illustrate how a servo builds a trajectory based on the preset PVT points.<br> 
+ * <b>Note:</b> In this case, the preset position values are 0, 45, 90, 45, and 0 degrees; the preset velocity values are 0, 30, 15, 30, 0 degrees per second;
+ * the time values are equal to delta time between two adjacent points on the Time axis (e.g., 2,000ms-3,000ms=1,000ms).</p>
+ * @image html "PVT.png" "Example of calculated trajectory using PVT points" width=600 
+ * @image latex "PVT.png" "Example of calculated trajectory using PVT points" width=300pt
+ * Created PVT points are arranged into a motion queue that defines the motion trajectory of the specified servo. To execute the motion queue, 
+ * use the ::rr_start_motion function.<br>
+ * When any of the parameter values (e.g., position, velocity) exceeds user-defined limits or the servo motor specifications 
+ * whichever is the smallest value), the function returns an error.<br><br>
+
+ * <b>Note:</b> When you set a PVT trajectory to move more than one servo simultaneously, mind that the clock rate of the servos can differ by up to 2-3%.
+ * Therefore, if the preset PVT trajectory is rather long, servos can get desynchronized. To avoid the desynchronization, we have implemented the following mechanism:
+ * <ul><li>The device controlling the servos broadcasts a sync CAN frame to all servos on an interface. The frame should have the following format:<br>
+ * ID = 0x27f, data = uint32 (4 bytes),<br>
+ * <b>Where:</b> ‘data’ stands for the microseconds counter value by modulus of 600,000,000, starting from any value.</li><br>
+ * <li>Servos receive the frame and try to adjust their clock rates to that of the device using the PLL.
+ * The adjustment proper starts after the servos receive the second frame and can take up to 5 seconds, depending on the broadcasting frequency.
+ * The higher the broadcasting frequency, the less time the adjustment takes.</li><br>
+ * <li>The broadcasting frequency is 5 Hz minimum. The recommended frequency range is from 10 to 20 Hz.
+ * When the sync frames are not broadcast or the broadcast frequency is below 5 Hz, the clock rate of servos is as usual.</li><br>
+
+ * @param servo Servo descriptor returned by the ::rr_init_servo function
+ * @param position_deg Position that the servo flange (in degrees) should reach as a result of executing the command
+ * @param velocity_deg_per_sec Servo velocity(in degrees/sec) at the point
+ * @param time_ms Time (in milliseconds) it should take the servo to move from the previous position (PVT point in a motion trajectory or an initial point) to the commanded one.
+ * The maximum admissible value is (2^32-1)/10 (roughly equivalent to 4.9 days). 
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Trajectory
+ */
+rr_ret_status_t rr_add_motion_point(const rr_servo_t *servo, const float position_deg, const float velocity_deg_per_sec, const uint32_t time_ms)
+{
+	IS_VALID_SERVO(servo);
+	CHECK_NMT_STATE(servo);
+
+	uint8_t data[12];
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	int p = 0;
+	p = usb_can_put_float(data, p, &position_deg, 1);
+	p = usb_can_put_float(data, p, &velocity_deg_per_sec, 1);
+	p = usb_can_put_uint32_t(data, p, &time_ms, 1);
+
+	uint32_t sts = write_raw_sdo(dev, 0x2200, 2, data, sizeof(data), 1, 200);
+	if(sts == CO_SDO_AB_PRAM_INCOMPAT)
+	{
+		return RET_WRONG_TRAJ;
+	}
+	else
+	{
+		return ret_sdo(sts);
+	}
+}
+
+/**
+ * @brief The function enables creating PVAT (position-velocity-acceleration-time) points to set the motion trajectory of the servo specified in the 'servo' parameter.
+ * PVAT points define the following:<br>
+ * <ul><li>what position the servo specified in the 'servo' parameter should reach</li><br>
+ * <li>how fast the servo should move to the specified position</li><br>
+ * <li>how long the movement to the specified position should take</li><br>
+ * <li>with what acceleration the servo should reach the specified position</li></ul>
+ * For details of PVAT motion synchronization when running multiple servos, see ::rr_add_motion_point.
+ * @param servo Servo descriptor returned by the ::rr_init_servo function
+ * @param position_deg Position that the servo flange (in degrees) should reach as a result of executing the command
+ * @param velocity_deg_per_sec Servo velocity (in degrees/sec) at the point
+ * @param accel_deg_per_sec2 Servo acceleration (in degrees/sec^2) at the point
+ * @param time_ms Time (in milliseconds) it should take the servo to move from the previous position (PVT point in a motion trajectory or an initial point) to the commanded one.
+ * The maximum admissible value is (2^32-1)/10 (roughly equivalent to 4.9 days). 
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Trajectory
  */
-rr_can_interface_t *rr_init_interface(const char *interface_name)
+rr_ret_status_t rr_add_motion_point_pvat(
+		const rr_servo_t *servo,
+		const float position_deg,
+		const float velocity_deg_per_sec,
+		const float accel_deg_per_sec2,
+		const uint32_t time_ms)
 {
-	rr_can_interface_t *i = (rr_can_interface_t *)calloc(1, sizeof(rr_can_interface_t));
+	IS_VALID_SERVO(servo);
+	CHECK_NMT_STATE(servo);
 
-	if(!i)
+	uint8_t data[16];
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	int p = 0;
+	p = usb_can_put_float(data, p, &position_deg, 1);
+	p = usb_can_put_float(data, p, &velocity_deg_per_sec, 1);
+	p = usb_can_put_float(data, p, &accel_deg_per_sec2, 1);
+	p = usb_can_put_uint32_t(data, p, &time_ms, 1);
+
+	uint32_t sts = write_raw_sdo(dev, 0x2200, 3, data, sizeof(data), 1, 200);
+	if(sts == CO_SDO_AB_PRAM_INCOMPAT)
 	{
-		return NULL;
+		return RET_WRONG_TRAJ;
+	}
+	else
+	{
+		return ret_sdo(sts);
 	}
+}
 
-	rr_set_debug_log_stream(stderr);
+/**
+ * @brief The function encodes arrays of PVT (or PVAT) points into motion queue writes (object 0x2200).
+ * <p>The servos are interleaved, so that each of them has a point write in flight when the writes are pipelined with ::batch_raw_sdo.</p>
+ * @param req Array of 'total' requests to fill in
+ * @param buf Buffer of 'total' encoded points (16 bytes for PVAT, 12 bytes for PVT)
+ * @param servo_of Array to receive the servo index of each request or NULL
+ * @param position Array to receive the point position of each request or NULL
+ */
+static void encode_motion_points(const rr_servo_t *const *servos, int n_servos, const rr_motion_point_t *const *points, const int *n,
+		int total, bool pvat, usbcan_sdo_req_t *req, uint8_t *buf, int *servo_of, float *position)
+{
+	const int size = pvat ? 16 : 12;
+	int r = 0;
 
-	usbcan_instance_t *usbcan = usbcan_instance_init(interface_name);
-	if(!usbcan)
+	for(int k = 0; r < total; k++)
 	{
-		free(i);
-		return NULL;
-	}
-	usbcan->udata = i;
-	i->iface = usbcan;
+		for(int i = 0; i < n_servos; i++)
+		{
+			if(k >= n[i])
+			{
+				continue;
+			}
 
-	usbcan_setup_nmt_state_cb(usbcan, rr_nmt_state_master_cb);
-	usbcan_setup_com_frame_cb(usbcan, rr_com_frame_cb);
-	usbcan_setup_pdo_cb(usbcan, rr_pdo_cb);
-	usbcan_setup_emcy_cb(usbcan, rr_emcy_master_cb);
+			const rr_motion_point_t *pt = &points[i][k];
+			uint8_t *data = buf + r * size;
+			int p = 0;
 
-	i->emcy_log.d = (emcy_log_entry_t *)malloc(sizeof(emcy_log_entry_t) * EMCY_LOG_DEPTH);
-	i->emcy_log.sz = EMCY_LOG_DEPTH;
-	i->emcy_log.head = 0;
-	i->emcy_log.tail = 0;
+			p = usb_can_put_float(data, p, &pt->position_deg, 1);
+			p = usb_can_put_float(data, p, &pt->velocity_deg_per_sec, 1);
+			if(pvat)
+			{
+				p = usb_can_put_float(data, p, &pt->accel_deg_per_sec2, 1);
+			}
+			p = usb_can_put_uint32_t(data, p, &pt->time_ms, 1);
 
-	if(!i->iface)
-	{
-		free(i->emcy_log.d);
-		free(i);
-		return NULL;
+			if(servo_of)
+			{
+				servo_of[r] = i;
+			}
+			if(position)
+			{
+				position[r] = pt->position_deg;
+			}
+			req[r++] = (usbcan_sdo_req_t){.id = ((usbcan_device_t *)servos[i]->dev)->id, .write = true, 
+				.idx = 0x2200, .sidx = pvat ? 3 : 2, .data = data, .len = size, .retry = 1, .tout = 200};
+		}
 	}
-
-	return i;
 }
 
 /**
- * @brief The function closes the COM port where the corresponding CAN-USB dongle is connected,
- * clearing all data associated with the interface descriptor.
- * It is advisable to call the function every time before quitting the user program.
- * @param iface Interface descriptor (see ::rr_init_interface).
- * @return Status code (::rr_ret_status_t)
- * @ingroup Init
+ * @brief The function uploads arrays of PVT (or PVAT) points to a group of servos on the same interface (see ::rr_add_motion_points_group).
+ * Free space of each servo motion queue is checked first, then all the point writes are pipelined with ::batch_raw_sdo.
  */
-rr_ret_status_t rr_deinit_interface(rr_can_interface_t **iface)
+static rr_ret_status_t add_motion_points_batch(const rr_servo_t *const *servos, int n_servos, 
+		const rr_motion_point_t *const *points, const int *n, bool pvat, bool check_space, int *rejected)
 {
-	IS_VALID_INTERFACE(*iface);
+	usbcan_instance_t *inst = NULL;
+	usbcan_sdo_req_t space[n_servos];
+	uint8_t space_buf[n_servos][4];
+	int total = 0;
 
-	if(usbcan_instance_deinit((usbcan_instance_t **)&((*iface)->iface)))
+	for(int i = 0; i < n_servos; i++)
+	{
+		IS_VALID_SERVO(servos[i]);
+		if((n[i] < 0) || (n[i] && !points[i]))
+		{
+			return RET_WRONG_ARG;
+		}
+
+		usbcan_device_t *dev = (usbcan_device_t *)servos[i]->dev;
+		if(inst && (inst != dev->inst))
+		{
+			return RET_WRONG_ARG;
+		}
+		inst = dev->inst;
+		rejected[i] = -1;
+		total += n[i];
+		space[i] = (usbcan_sdo_req_t){.id = dev->id, .idx = 0x2202, .sidx = 0x03, .data = space_buf[i], .len = 4, .retry = 1, .tout = 100};
+	}
+	if(!total)
 	{
-		free(*iface);
-		*iface = NULL;
 		return RET_OK;
 	}
-	return RET_ERROR;
-}
 
-/**
- * @brief The function determines whether the servo motor with the specified ID is connected to the specified interface. It waits for 2 seconds to receive a Heartbeat message from the servo.
- * When the message arrives within the interval, the servo is identified as successfully connected.<br>
- * <p>The function returns the servo descriptor that you will need for subsequent API calls to the servo.</p> 
- * @param iface Descriptor of the interface (returned by the ::rr_init_interface function) where the servo is connected
- * @param id Unique identifier of the servo in the specified interface. The available value range is from 0 to 127.
- * @return Servo descriptor (::rr_servo_t) <br> or NULL when no Heartbeat message is received within the specified interval
- * @ingroup Init
- */
-rr_servo_t *rr_init_servo(rr_can_interface_t *iface, const uint8_t id)
-{
-	if(!iface)
+	/*Check free space once for all the points*/
+	if(check_space)
 	{
-		return NULL;
+		batch_raw_sdo(inst, space, n_servos, false);
 	}
-	rr_servo_t *s = (rr_servo_t *)calloc(1, sizeof(rr_servo_t));
 
-	if(!s)
+	rr_ret_status_t ret = RET_OK;
+
+	for(int i = 0; check_space && (i < n_servos); i++)
 	{
-		return NULL;
+		uint32_t num;
+
+		if(!space[i].done || space[i].abt || (space[i].len != 4))
+		{
+			rejected[i] = 0;
+			ret = (ret != RET_OK) ? ret : ((!space[i].done || (space[i].abt == CO_SDO_AB_TIMEOUT)) ? RET_TIMEOUT : RET_ERROR);
+			continue;
+		}
+		usb_can_get_uint32_t(space_buf[i], 0, &num, 1);
+		if(num < (uint32_t)n[i])
+		{
+			LOG_ERROR(debug_log, "%s: id(%d) motion queue has %u free points, %d required", 
+					__func__, space[i].id, (unsigned int)num, n[i]);
+			rejected[i] = num;
+			ret = (ret != RET_OK) ? ret : RET_WRONG_TRAJ;
+		}
+	}
+	if(ret != RET_OK)
+	{
+		return ret;
 	}
 
-	s->dev = usbcan_device_init((usbcan_instance_t *)iface->iface, id);
+	const int size = pvat ? 16 : 12;
+	usbcan_sdo_req_t *req = (usbcan_sdo_req_t *)malloc(total * sizeof(usbcan_sdo_req_t));
+	uint8_t *buf = (uint8_t *)malloc(total * size);
 
-	if(!s->dev)
+	if(!req || !buf)
 	{
-		free(s);
-		return NULL;
+		free(req);
+		free(buf);
+		return RET_ERROR;
 	}
 
-	if(!wait_device((usbcan_instance_t *)iface->iface, id, RR_API_WAIT_DEVICE_TIMEOUT_MS))
+	encode_motion_points(servos, n_servos, points, n, total, pvat, req, buf, NULL, NULL);
+
+	batch_raw_sdo(inst, req, total, true);
+
+	/*Points of a servo are written in order and the rest are skipped after the first failure*/
+	int r = 0;
+	for(int k = 0; r < total; k++)
 	{
-		rr_deinit_servo(&s);
+		for(int i = 0; i < n_servos; i++)
+		{
+			if(k >= n[i])
+			{
+				continue;
+			}
+			if((rejected[i] < 0) && (!req[r].done || req[r].abt))
+			{
+				rejected[i] = k;
+				if(ret == RET_OK)
+				{
+					ret = !req[r].done ? RET_TIMEOUT : (req[r].abt == CO_SDO_AB_PRAM_INCOMPAT) ? RET_WRONG_TRAJ : ret_sdo(req[r].abt);
+				}
+			}
+			r++;
+		}
 	}
 
-	return s;
+	free(req);
+	free(buf);
+
+	return ret;
 }
 
 /**
- * @brief The function deinitializes the servo, clearing all data associated with the servo descriptor.
+ * @brief The function uploads an array of PVT (or PVAT) points to the motion queue of the servo (see ::rr_add_motion_point and ::rr_add_motion_point_pvat).
+ * <p>Unlike calling ::rr_add_motion_point for each point, the function checks the free space of the motion queue once 
+ * and pipelines the point writes, so that the upload time is not limited by the round trip of each request.</p>
+ * <p>When the queue has less free space than 'n' points, no point is uploaded.</p>
  * @param servo Servo descriptor returned by the ::rr_init_servo function
- * @return Status code (::rr_ret_status_t)
- * @ingroup Init
+ * @param points Array of points
+ * @param n Number of points in the 'points' array
+ * @param pvat Set to 'true' to upload PVAT points, 'false' to upload PVT points (the acceleration is ignored)
+ * @param rejected Pointer to the variable to receive the index of the first rejected point (-1 - all the points are accepted).
+ * The points preceding it are in the motion queue. May be NULL
+ * @return Status code (::rr_ret_status_t)<br>RET_WRONG_TRAJ - the point is rejected by the servo or there is not enough free space in the motion queue
+ * @ingroup Trajectory
  */
-rr_ret_status_t rr_deinit_servo(rr_servo_t **servo)
+rr_ret_status_t rr_add_motion_points(const rr_servo_t *servo, const rr_motion_point_t *points, int n, bool pvat, int *rejected)
 {
-	IS_VALID_SERVO(*servo);
+	int rej = -1;
+	rr_ret_status_t ret = add_motion_points_batch(&servo, 1, &points, &n, pvat, true, &rej);
 
-	if(usbcan_device_deinit((usbcan_device_t **)&((*servo)->dev)))
+	if(rejected)
 	{
-		free(*servo);
-		*servo = NULL;
-		return RET_OK;
+		*rejected = rej;
 	}
-	return RET_ERROR;
+
+	return ret;
 }
 
 /**
- * @brief The function reboots the servo specified in the 'servo' parameter of the function, resetting it to the power-on state.
- * @param servo Servo descriptor returned by the ::rr_init_servo function 
- * @return Status code (::rr_ret_status_t)
- * @ingroup State
+ * @brief The function uploads arrays of PVT (or PVAT) points to a group of servos on the same interface (see ::rr_add_motion_points).
+ * Point writes to different servos are kept in flight simultaneously.
+ * @param servos Array of servo descriptors
+ * @param n_servos Number of servos in the 'servos' array
+ * @param points Array of point arrays, one per servo
+ * @param n Array of point counts, one per servo
+ * @param pvat Set to 'true' to upload PVAT points, 'false' to upload PVT points (the acceleration is ignored)
+ * @param rejected Array to receive the index of the first rejected point for each servo (-1 - all the points are accepted). May be NULL
+ * @return Status code (::rr_ret_status_t) of the first failure<br>RET_WRONG_TRAJ - a point is rejected by the servo or there is not enough free space in a motion queue
+ * @ingroup Trajectory
  */
-rr_ret_status_t rr_servo_reboot(const rr_servo_t *servo)
+rr_ret_status_t rr_add_motion_points_group(rr_servo_t *const *servos, int n_servos, 
+		const rr_motion_point_t *const *points, const int *n, bool pvat, int *rejected)
 {
-	IS_VALID_SERVO(servo);
-	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
-	clear_device_boot_up_flag(dev->inst, dev->id);
-	if(!write_nmt(dev->inst, dev->id, CO_NMT_CMD_RESET_NODE))
+	if(!servos || !points || !n || (n_servos <= 0))
 	{
-		return RET_ERROR;
+		return RET_WRONG_ARG;
 	}
-	if(!wait_device_boot_up(dev->inst, dev->id, RR_API_REBOOT_TIMEOUT_MS))
+
+	int rej[n_servos];
+
+	for(int i = 0; i < n_servos; i++)
 	{
-		return RET_ERROR;
+		rej[i] = -1;
 	}
-	return RET_OK;
+
+	rr_ret_status_t ret = add_motion_points_batch((const rr_servo_t *const *)servos, n_servos, points, n, pvat, true, rej);
+
+	if(rejected)
+	{
+		for(int i = 0; i < n_servos; i++)
+		{
+			rejected[i] = rej[i];
+		}
+	}
+
+	return ret;
 }
 
 /**
- * @brief The function resets communication with the servo specified in the 'servo' parameter without resetting the entire interface.
- * @param servo Servo descriptor returned by the ::rr_init_servo function
- * @return Status code (::rr_ret_status_t)
- * @ingroup State
+ * @brief The function creates a trajectory template: a multi-axis PVT (or PVAT) trajectory validated and encoded once 
+ * into ready-to-send motion queue writes, for moves repeated many times (see ::rr_traj_template_play).
+ * <p>The point positions are relative: the template is replayed with a per-servo position offset.
+ * When 'limits' is given, the trajectory of each servo is checked with ::rr_check_trajectory from its 'start' state
+ * (the result does not depend on the offset).</p>
+ * @param servos Array of servo descriptors (on the same interface)
+ * @param n_servos Number of servos in the 'servos' array
+ * @param points Array of point arrays, one per servo
+ * @param n Array of point counts, one per servo
+ * @param pvat Set to 'true' for PVAT points, 'false' for PVT points (the acceleration is ignored)
+ * @param start Array of start states, one per servo (relative positions), or NULL. Required when 'limits' is given
+ * @param limits Limits to check the trajectories against or NULL to skip the check
+ * @return Template descriptor or NULL when an error occurs or the trajectory violates the limits
+ * @ingroup Trajectory
  */
-rr_ret_status_t rr_servo_reset_communication(const rr_servo_t *servo)
+rr_traj_template_t *rr_init_traj_template(rr_servo_t *const *servos, int n_servos, const rr_motion_point_t *const *points, const int *n, 
+		bool pvat, const rr_motion_point_t *start, const rr_trj_limits_t *limits)
 {
-	IS_VALID_SERVO(servo);
-	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
-	clear_device_boot_up_flag(dev->inst, dev->id);
-	if(!write_nmt(dev->inst, dev->id, CO_NMT_CMD_RESET_COMM))
+	if(!servos || (n_servos <= 0) || !points || !n || (limits && !start))
 	{
-		return RET_ERROR;
+		return NULL;
 	}
-	if(!wait_device_boot_up(dev->inst, dev->id, RR_API_RESET_COMM_TIMEOUT_MS))
+
+	usbcan_instance_t *inst = NULL;
+	int total = 0;
+
+	for(int i = 0; i < n_servos; i++)
 	{
-		return RET_ERROR;
+		if(!servos[i] || (inst && (inst != ((usbcan_device_t *)servos[i]->dev)->inst)) || (n[i] < 0) || (n[i] && !points[i]))
+		{
+			return NULL;
+		}
+		inst = ((usbcan_device_t *)servos[i]->dev)->inst;
+		total += n[i];
+
+		if(limits)
+		{
+			rr_trj_report_t report = {};
+			rr_ret_status_t sts = rr_check_trajectory(&start[i], points[i], n[i], pvat, limits, &report);
+			if(sts != RET_OK)
+			{
+				LOG_ERROR(debug_log, "%s: id(%d) trajectory check failed (%d violations)", 
+						__func__, ((usbcan_device_t *)servos[i]->dev)->id, report.violations);
+				return NULL;
+			}
+		}
 	}
-	return RET_OK;
-}
 
-/**
- * @brief The function sets the servo specified in the 'servo' parameter to the operational state. In the state, the servo is both available for communication and can execute commands.
- * <p>For instance, you may need to call the function to switch the servo from the pre-operational state to the operational one after an error (e.g., due to overcurrent).</p>
- * @param servo Servo descriptor returned by the ::rr_init_servo function
- *  If the parameter is set to 0, all servos connected to the interface will be set to the operational state.
- * @return Status code (::rr_ret_status_t)
- * @ingroup State
- */
-rr_ret_status_t rr_servo_set_state_operational(const rr_servo_t *servo)
-{
-	IS_VALID_SERVO(servo);
-	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
-	if(!write_nmt(dev->inst, dev->id, CO_NMT_CMD_GOTO_OP))
+	rr_traj_template_t *t = (rr_traj_template_t *)calloc(1, sizeof(rr_traj_template_t));
+	if(!t)
 	{
-		return RET_ERROR;
+		return NULL;
 	}
-	if(!wait_device_state(dev->inst, dev->id, CO_NMT_OPERATIONAL, RR_API_CHANGE_STATE_TIMEOUT_MS))
+
+	t->inst = inst;
+	t->n = n_servos;
+	t->total = total;
+	t->size = pvat ? 16 : 12;
+	t->servos = (rr_servo_t **)malloc(n_servos * sizeof(rr_servo_t *));
+	t->servo_of = (int *)malloc((total + 1) * sizeof(int));
+	t->position = (float *)malloc((total + 1) * sizeof(float));
+	t->buf = (uint8_t *)malloc((total + 1) * t->size);
+	t->req = (usbcan_sdo_req_t *)malloc((total + 1) * sizeof(usbcan_sdo_req_t));
+	if(!t->servos || !t->servo_of || !t->position || !t->buf || !t->req)
 	{
-		return RET_ERROR;
+		rr_deinit_traj_template(&t);
+		return NULL;
 	}
-	return RET_OK;
+	memcpy(t->servos, servos, n_servos * sizeof(rr_servo_t *));
+
+	encode_motion_points((const rr_servo_t *const *)servos, n_servos, points, n, total, pvat, t->req, t->buf, t->servo_of, t->position);
+
+	return t;
 }
 
 /**
- * @brief The function sets the servo specified in the 'servo' parameter to the pre-operational state. In the state, the servo is available for communication, but cannot execute any commands.  
- * <p>For instance, you may need to call the function, if you want to force the servo to stop executing commands, e.g., in an emergency.</p>
- * @param servo Servo descriptor returned by the ::rr_init_servo function
+ * @brief The function destroys the trajectory template (see ::rr_init_traj_template).
+ * @param tmpl Pointer to the template descriptor, set to NULL on return
  * @return Status code (::rr_ret_status_t)
- * @ingroup State
+ * @ingroup Trajectory
  */
-rr_ret_status_t rr_servo_set_state_pre_operational(const rr_servo_t *servo)
+rr_ret_status_t rr_deinit_traj_template(rr_traj_template_t **tmpl)
 {
-	IS_VALID_SERVO(servo);
-	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
-	if(!write_nmt(dev->inst, dev->id, CO_NMT_CMD_GOTO_PREOP))
-	{
-		return RET_ERROR;
-	}
-	if(!wait_device_state(dev->inst, dev->id, CO_NMT_PRE_OPERATIONAL, RR_API_CHANGE_STATE_TIMEOUT_MS))
+	if(!tmpl || !*tmpl)
 	{
-		return RET_ERROR;
+		return RET_BAD_INSTANCE;
 	}
+
+	rr_traj_template_t *t = *tmpl;
+
+	free(t->servos);
+	free(t->servo_of);
+	free(t->position);
+	free(t->buf);
+	free(t->req);
+	free(t);
+	*tmpl = NULL;
+
 	return RET_OK;
 }
 
 /**
- * @brief The function sets the servo specified in the 'servo' parameter to the stopped state. In the state, only Heartbeats are available. You can neither communicate with the servo nor make it execute any commands.  
- * <p>For instance, you may need to call the fuction to reduce the workload of a CAN bus by disabling individual servos connected to it without deninitializing them.</p>
- * @param servo Servo descriptor returned by the ::rr_init_servo function  
- * @return Status code (::rr_ret_status_t)
- * @ingroup State
+ * @brief The function uploads the trajectory template (see ::rr_init_traj_template) to the motion queues of the servos,
+ * shifting the point positions of each servo by its offset, and optionally starts the motion (see ::rr_start_motion).
+ * <p>Only the position fields of the pre-encoded writes are patched, and the writes are pipelined across the servos 
+ * without a free space pre-check (see ::rr_add_motion_points_group), so the cost of a repetition is the bus time of the writes.
+ * When a point is rejected, the motion queues of all the servos of the template are cleared.</p>
+ * <p><b>Note:</b> A template may be replayed from one thread at a time.</p>
+ * @param tmpl Template descriptor returned by the ::rr_init_traj_template function
+ * @param offset_deg Array of position offsets (in degrees), one per servo, or NULL for no offset
+ * @param start Set to 'true' to start the motion after the upload
+ * @return Status code (::rr_ret_status_t)<br>RET_WRONG_TRAJ - a point is rejected by the servo (e.g. the motion queue is full)
+ * @ingroup Trajectory
  */
-rr_ret_status_t rr_servo_set_state_stopped(const rr_servo_t *servo)
+rr_ret_status_t rr_traj_template_play(rr_traj_template_t *tmpl, const float *offset_deg, bool start)
 {
-	IS_VALID_SERVO(servo);
-	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	if(!tmpl)
+	{
+		return RET_BAD_INSTANCE;
+	}
 
-	if(!write_nmt(dev->inst, dev->id, CO_NMT_CMD_GOTO_STOPPED))
+	rr_traj_template_t *t = tmpl;
+
+	for(int r = 0; r < t->total; r++)
 	{
-		return RET_ERROR;
+		float pos = t->position[r] + (offset_deg ? offset_deg[t->servo_of[r]] : 0.0f);
+		usb_can_put_float(t->buf + r * t->size, 0, &pos, 1);
 	}
 
-	if(!wait_device_state(dev->inst, dev->id, CO_NMT_STOPPED, RR_API_CHANGE_STATE_TIMEOUT_MS))
+	batch_raw_sdo(t->inst, t->req, t->total, true);
+
+	rr_ret_status_t ret = RET_OK;
+
+	for(int r = 0; (r < t->total) && (ret == RET_OK); r++)
 	{
-		return RET_ERROR;
+		if(!t->req[r].done || t->req[r].abt)
+		{
+			ret = !t->req[r].done ? RET_TIMEOUT : (t->req[r].abt == CO_SDO_AB_PRAM_INCOMPAT) ? RET_WRONG_TRAJ : ret_sdo(t->req[r].abt);
+		}
 	}
+	if(ret != RET_OK)
+	{
+		for(int i = 0; i < t->n; i++)
+		{
+			rr_clear_points_all(t->servos[i]);
+		}
+		return ret;
+	}
+
+	if(start)
+	{
+		write_timestamp(t->inst, 0);
+	}
+
 	return RET_OK;
 }
 
 /**
- * @brief The function retrieves the actual NMT state of a specified servo. The state is described as a status code (::rr_nmt_state_t).  
- * <p></p>
- * @param servo Servo descriptor returned by the ::rr_init_servo function 
- * @param state Pointer to the variable where the state of the servo is returned 
+ * @brief The function commands all servos connected to the specified interface (CAN bus) 
+ * to move simultaneously through a number of preset PVT points (see ::rr_add_motion_point).<br> 
+ * <p><b>Note:</b> When any of the servos fails to reach any of the PVT points due to an error, it will broadcast
+ * a "Go to Stopped State" command to all the other servos on the same bus. The servos will stop executing the preset PVT points and go to the stopped state.
+ * In the state, only Heartbeats are available. You can neither communicate with servos nor command them to execute any operations.</p>
+ * <p><b>Note:</b> Once servos execute the last PVT in their preset motion queue, the queue is cleared automatically.</p>
+ * @param iface Interface descriptor returned by the ::rr_init_interface function
+ * @param timestamp_ms Delay (in milliseconds) before the servos associated with the interface start to move. When the value is set to 0, the servos will start moving immediately.
+ * The available value range is from 0 to 2^24-1.
  * @return Status code (::rr_ret_status_t)
- * @ingroup State
+ * @ingroup Trajectory
  */
-rr_ret_status_t rr_servo_get_state(const rr_servo_t *servo, rr_nmt_state_t *state)
+rr_ret_status_t rr_start_motion(rr_can_interface_t *iface, uint32_t timestamp_ms)
 {
-	IS_VALID_SERVO(servo);
-	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
-
-	*state = (rr_nmt_state_t)usbcan_get_device_state(dev->inst, dev->id);
+	IS_VALID_INTERFACE(iface);
 
+	usbcan_instance_t *inst = (usbcan_instance_t *)iface->iface;
+	write_timestamp(inst, timestamp_ms);
 	return RET_OK;
 }
 
-/**
- * @brief The function retrieves statistics on minimal and maximal intervals between Heartbeat messages of a servo. The statistics is saved to the variables
- * specified in the param min_hb_ival and param max_hb_ival parameters, from where they are available for the user to perform further operations (e.g., comparison).<br>
- * The Heartbeat statistics is helpful in diagnozing and troubleshooting servo failures. For instance, when the Heartbeat interval of a servo is too long,
- * it may mean that the control device sees the servo as being offline.<br>
- * <b>Note:</b> Before using the function, it is advisable to clear Heartbeat statistics with ::rr_servo_clear_hb_stat. 
- * @param servo Servo descriptor returned by the ::rr_init_servo function 
- * @param min_hb_ival Pointer to the variable where the minimal arrival interval is to be saved; when set to NULL, the variable is disabled. 
- * @param max_hb_ival Pointer to the variable where the maximal arrival interval is to be saved; when set to NULL, the variable is disabled.
- * @return Status code (::rr_ret_status_t), min_hb_ival & max_hb_ival - min/max arrival intervals or -1 if no information available
- * @ingroup State
+/*
+ * Reads motion queue free space (0x2202/3) or size (0x2202/2) of all the servos at once.
  */
-rr_ret_status_t rr_servo_get_hb_stat(const rr_servo_t *servo, int64_t *min_hb_ival, int64_t *max_hb_ival)
+static rr_ret_status_t traj_stream_read_queue(rr_traj_stream_t *t, uint8_t sidx, uint32_t *num, int *axis)
 {
-	IS_VALID_SERVO(servo);
-	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	usbcan_sdo_req_t req[t->n];
+	uint8_t buf[t->n][4];
 
-	if(min_hb_ival)
+	for(int i = 0; i < t->n; i++)
 	{
-		*min_hb_ival = usbcan_get_min_hb_interval(dev->inst, dev->id);
+		req[i] = (usbcan_sdo_req_t){.id = ((usbcan_device_t *)t->servos[i]->dev)->id, .idx = 0x2202, .sidx = sidx, 
+			.data = buf[i], .len = 4, .retry = 1, .tout = 100};
 	}
 
-	if(max_hb_ival)
+	batch_raw_sdo((usbcan_instance_t *)t->iface->iface, req, t->n, false);
+
+	for(int i = 0; i < t->n; i++)
 	{
-		*max_hb_ival = usbcan_get_max_hb_interval(dev->inst, dev->id);
+		if(!req[i].done || req[i].abt || (req[i].len != 4))
+		{
+			*axis = i;
+			return req[i].done ? RET_ERROR : RET_TIMEOUT;
+		}
+		usb_can_get_uint32_t(buf[i], 0, &num[i], 1);
 	}
 
 	return RET_OK;
 }
 
-/**
- * @brief The function clears statistics on minimal and maximal intervals between Heartbeat messages of a servo.
- * It is advisable to use the function before attempting to get the Heartbeat statistics with the ::rr_servo_get_hb_stat function.
- * @param servo Servo descriptor returned by the ::rr_init_servo function 
- * @return Status code (::rr_ret_status_t)
- * @ingroup State
+/*
+ * Pulls up to 'max' points of the axis from the source. Returns RET_OK when at least 'max' points are taken or the trajectory is exhausted.
  */
-rr_ret_status_t rr_servo_clear_hb_stat(const rr_servo_t *servo)
+static rr_ret_status_t traj_stream_pull(rr_traj_stream_t *t, int axis, int max)
 {
-	IS_VALID_SERVO(servo);
-	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
-
-	usbcan_clear_hb_stat(dev->inst, dev->id);
+	t->count[axis] = 0;
+	while(!t->exhausted[axis] && (t->count[axis] < max))
+	{
+		int r = t->source(t->ctx, axis, t->buf[axis] + t->count[axis], max - t->count[axis]);
+		if(r < 0)
+		{
+			return RET_ERROR;
+		}
+		t->exhausted[axis] = (r == 0);
+		t->count[axis] += MIN(r, max - t->count[axis]);
+	}
 
 	return RET_OK;
 }
 
-/**
- * @brief The function reboots all servos connected to the interface specified in the 'interface' parameter,
- * resetting them back to the power-on state.
- * @param iface Interface descriptor returned by the ::rr_init_interface function
- * @return Status code (::rr_ret_status_t)
- * @ingroup State
- */
-rr_ret_status_t rr_net_reboot(const rr_can_interface_t *iface)
+static void traj_stream_fail(rr_traj_stream_t *t, rr_ret_status_t sts, int axis)
 {
-	IS_VALID_INTERFACE(iface);
-	usbcan_instance_t *inst = (usbcan_instance_t *)iface->iface;
-	return write_nmt(inst, 0, CO_NMT_CMD_RESET_NODE) ? RET_OK : RET_ERROR;
+	pthread_mutex_lock(&t->mutex);
+	t->stats.state = RR_TRAJ_STREAM_ERROR;
+	t->stats.error = sts;
+	t->stats.error_axis = axis;
+	pthread_mutex_unlock(&t->mutex);
+	LOG_ERROR(debug_log, "%s: axis %d failed with status %d", __func__, axis, sts);
 }
 
-/**
- * @brief The function resets communication via the interface specified in the 'interface' parameter.
- * For instance, you may need to use the function when changing settings that require a reset after modification.
- * @param iface Interface descriptor returned by the ::rr_init_interface function 
- * @return Status code (::rr_ret_status_t)
- * @ingroup State
+/*
+ * Pulls points for the axes with 'space' free points and uploads them.
  */
-rr_ret_status_t rr_net_reset_communication(const rr_can_interface_t *iface)
+static rr_ret_status_t traj_stream_refill(rr_traj_stream_t *t, const uint32_t *space, int *axis)
 {
-	IS_VALID_INTERFACE(iface);
-	usbcan_instance_t *inst = (usbcan_instance_t *)iface->iface;
-	return write_nmt(inst, 0, CO_NMT_CMD_RESET_COMM) ? RET_OK : RET_ERROR;
+	int total = 0;
+	int rejected[t->n];
+
+	for(int i = 0; i < t->n; i++)
+	{
+		rejected[i] = -1;
+		if(traj_stream_pull(t, i, MIN(space[i], t->cap[i])) != RET_OK)
+		{
+			*axis = i;
+			return RET_ERROR;
+		}
+		total += t->count[i];
+	}
+	if(!total)
+	{
+		return RET_OK;
+	}
+
+	rr_ret_status_t sts = add_motion_points_batch((const rr_servo_t *const *)t->servos, t->n, 
+			(const rr_motion_point_t *const *)t->buf, t->count, t->pvat, true, rejected);
+
+	for(int i = 0; i < t->n; i++)
+	{
+		if(rejected[i] >= 0)
+		{
+			*axis = i;
+		}
+	}
+
+	pthread_mutex_lock(&t->mutex);
+	t->stats.points += total;
+	t->stats.refills++;
+	pthread_mutex_unlock(&t->mutex);
+
+	return sts;
 }
 
-/**
- * @brief The function sets all servos connected to the interface (CAN bus) specified in the 'interface' parameter to the operational state.
- *  In the state, the servos can both communicate with the user program and execute commands.
- *  <p>For instance, you may need to call the function to switch all servos on a specific bus from the
- *  pre-operational state to the operational one after an error (e.g., due to overcurrent).</p>
- * @param iface Interface descriptor returned by the ::rr_init_interface function  
- * @return Status code (::rr_ret_status_t)
- * @ingroup State
- */
-rr_ret_status_t rr_net_set_state_operational(const rr_can_interface_t *iface)
+static void *traj_stream_process(void *arg)
 {
-	IS_VALID_INTERFACE(iface);
-	usbcan_instance_t *inst = (usbcan_instance_t *)iface->iface;
-	return write_nmt(inst, 0, CO_NMT_CMD_GOTO_OP) ? RET_OK : RET_ERROR;
+	rr_traj_stream_t *t = (rr_traj_stream_t *)arg;
+	uint32_t size[t->n], space[t->n];
+	int axis = -1;
+
+	while(!__atomic_load_n(&t->stop, __ATOMIC_ACQUIRE))
+	{
+		msleep(t->poll_ms);
+
+		rr_ret_status_t sts = traj_stream_read_queue(t, 0x02, size, &axis);
+		if(sts != RET_OK)
+		{
+			traj_stream_fail(t, sts, axis);
+			break;
+		}
+
+		bool refill = false, done = true;
+		uint32_t min_queue = UINT32_MAX;
+
+		for(int i = 0; i < t->n; i++)
+		{
+			space[i] = 0;
+			done = done && t->exhausted[i] && !size[i];
+			if(t->exhausted[i])
+			{
+				continue;
+			}
+			if(!size[i])
+			{
+				//the axis has stopped at the last point before its trajectory is exhausted
+				traj_stream_fail(t, RET_ZERO_SIZE, i);
+				return NULL;
+			}
+			min_queue = MIN(min_queue, size[i]);
+			if(size[i] <= t->low_watermark)
+			{
+				space[i] = t->cap[i] - MIN(size[i], t->cap[i]);
+				refill = true;
+			}
+		}
+
+		pthread_mutex_lock(&t->mutex);
+		t->stats.polls++;
+		t->stats.min_queue = MIN(t->stats.min_queue, min_queue);
+		if(done)
+		{
+			t->stats.state = RR_TRAJ_STREAM_DONE;
+		}
+		pthread_mutex_unlock(&t->mutex);
+
+		if(done)
+		{
+			break;
+		}
+		if(refill && ((sts = traj_stream_refill(t, space, &axis)) != RET_OK))
+		{
+			traj_stream_fail(t, sts, axis);
+			break;
+		}
+	}
+
+	return NULL;
 }
 
 /**
- * @brief The function sets all servos connected to the interface specified in the 'interface' parameter to the pre-operational state.  
- * In the state, the servos are available for communication, but cannot execute commands.
- * <p>For instance, you may need to call the function, if you want to force all servos on a specific bus to stop executing commands, e.g., in an emergency.</p>
- * @param iface Interface descriptor returned by the ::rr_init_interface function 
- * @return Status code (::rr_ret_status_t)
- * @ingroup State
+ * @brief The function creates a trajectory stream: an engine executing multi-axis PVT (or PVAT) trajectories of any length 
+ * through the finite motion queues of the servos (see ::rr_add_motion_point).
+ * <p>The trajectory points are taken from the 'source' callback (e.g., reading a file or generating points on the fly)
+ * in chunks of at most the motion queue capacity. ::rr_traj_stream_start fills the motion queues and starts synchronized motion. 
+ * Then a background thread polls the queue sizes and tops up the queues that have dropped to the low watermark, 
+ * so that the bus load stays bounded regardless of the trajectory length.</p>
+ * <p><b>Note:</b> The axis trajectories should have the same duration and the same time grid, as each servo executes its own queue.</p>
+ * @param servos Array of servo descriptors (on the same interface)
+ * @param n Number of servos in the 'servos' array
+ * @param pvat Set to 'true' for PVAT points, 'false' for PVT points
+ * @param source Trajectory source callback. It is called from the background thread
+ * @param ctx User context passed to the 'source' callback
+ * @return Stream descriptor or NULL when an error occurs
+ * @ingroup Trajectory
  */
-rr_ret_status_t rr_net_set_state_pre_operational(const rr_can_interface_t *iface)
+rr_traj_stream_t *rr_init_traj_stream(rr_servo_t *const *servos, int n, bool pvat, rr_traj_source_cb_t source, void *ctx)
 {
-	IS_VALID_INTERFACE(iface);
-	usbcan_instance_t *inst = (usbcan_instance_t *)iface->iface;
-	return write_nmt(inst, 0, CO_NMT_CMD_GOTO_PREOP) ? RET_OK : RET_ERROR;
+	if(!servos || (n <= 0) || !source)
+	{
+		return NULL;
+	}
+
+	usbcan_instance_t *inst = NULL;
+
+	for(int i = 0; i < n; i++)
+	{
+		if(!servos[i] || (inst && (inst != ((usbcan_device_t *)servos[i]->dev)->inst)))
+		{
+			return NULL;
+		}
+		inst = ((usbcan_device_t *)servos[i]->dev)->inst;
+	}
+
+	rr_traj_stream_t *t = (rr_traj_stream_t *)calloc(1, sizeof(rr_traj_stream_t));
+	if(!t)
+	{
+		return NULL;
+	}
+
+	t->iface = (rr_can_interface_t *)inst->udata;
+	t->n = n;
+	t->pvat = pvat;
+	t->source = source;
+	t->ctx = ctx;
+	t->stats.error_axis = -1;
+	pthread_mutex_init(&t->mutex, NULL);
+	t->servos = (rr_servo_t **)malloc(n * sizeof(rr_servo_t *));
+	t->cap = (uint32_t *)calloc(n, sizeof(uint32_t));
+	t->exhausted = (bool *)calloc(n, sizeof(bool));
+	t->count = (int *)calloc(n, sizeof(int));
+	t->buf = (rr_motion_point_t **)calloc(n, sizeof(rr_motion_point_t *));
+	if(!t->servos || !t->cap || !t->exhausted || !t->count || !t->buf)
+	{
+		rr_deinit_traj_stream(&t);
+		return NULL;
+	}
+	memcpy(t->servos, servos, n * sizeof(rr_servo_t *));
+
+	return t;
 }
 
 /**
- * @brief The function sets all servos connected to the interface specified in the 'interface' parameter to the stopped state.  
- * In the state, the servos are neither available for communication nor can execute commands.
- * <p>For instance, you may need to call the fuction to stop all servos on a specific bus without deinitializing them.</p>
- * @param iface Interface descriptor returned by the ::rr_init_interface function. 
+ * @brief The function stops the background refills and destroys the trajectory stream (see ::rr_init_traj_stream).
+ * <p><b>Note:</b> The servos keep executing the points left in their motion queues. Use ::rr_clear_points_all to discard them.</p>
+ * @param stream Pointer to the stream descriptor, set to NULL on return
  * @return Status code (::rr_ret_status_t)
- * @ingroup State
+ * @ingroup Trajectory
  */
-rr_ret_status_t rr_net_set_state_stopped(const rr_can_interface_t *iface)
+rr_ret_status_t rr_deinit_traj_stream(rr_traj_stream_t **stream)
 {
-	IS_VALID_INTERFACE(iface);
-	usbcan_instance_t *inst = (usbcan_instance_t *)iface->iface;
-	return write_nmt(inst, 0, CO_NMT_CMD_GOTO_STOPPED) ? RET_OK : RET_ERROR;
+	if(!stream || !*stream)
+	{
+		return RET_BAD_INSTANCE;
+	}
+
+	rr_traj_stream_t *t = *stream;
+
+	if(t->thread_running)
+	{
+		__atomic_store_n(&t->stop, true, __ATOMIC_RELEASE);
+		pthread_join(t->thread, NULL);
+	}
+	for(int i = 0; t->buf && (i < t->n); i++)
+	{
+		free(t->buf[i]);
+	}
+	pthread_mutex_destroy(&t->mutex);
+	free(t->servos);
+	free(t->cap);
+	free(t->exhausted);
+	free(t->count);
+	free(t->buf);
+	free(t);
+	*stream = NULL;
+
+	return RET_OK;
 }
 
 /**
- * @brief The function retrieves the actual NMT state of any device (a servo motor or any other) connected to the specified CAN network.
- * The state is described as a status code (:: rr_nmt_state_t). 
- * <p></p>
- * @param iface Interface descriptor returned by the ::rr_init_interface function 
- * @param id Identificator of the addressed device 
- * @param state Pointer to the variable where the state of the device is returned 
+ * @brief The function fills the motion queues of the servos, starts synchronized motion (see ::rr_start_motion)
+ * and the background thread refilling the queues (see ::rr_init_traj_stream).
+ * <p>The motion queues should be empty. The queue capacity of each servo is taken as its free space at the start.</p>
+ * <p>The low watermark should leave the queues enough points to run for the poll period plus the refill upload time. 
+ * If a queue runs empty before its trajectory is exhausted, the stream goes to the error state with ::RET_ZERO_SIZE.</p>
+ * @param stream Stream descriptor returned by the ::rr_init_traj_stream function
+ * @param low_watermark Queue size (number of points) at or below which the queue is refilled
+ * @param poll_ms Queue polling period (ms)
+ * @param timestamp_ms Delay (in milliseconds) before the servos start to move (see ::rr_start_motion)
  * @return Status code (::rr_ret_status_t)
- * @ingroup State
+ * @ingroup Trajectory
  */
-rr_ret_status_t rr_net_get_state(const rr_can_interface_t *iface, int id, rr_nmt_state_t *state)
+rr_ret_status_t rr_traj_stream_start(rr_traj_stream_t *stream, uint32_t low_watermark, uint32_t poll_ms, uint32_t timestamp_ms)
 {
-	IS_VALID_INTERFACE(iface);
-	usbcan_instance_t *inst = (usbcan_instance_t *)iface->iface;
+	if(!stream)
+	{
+		return RET_BAD_INSTANCE;
+	}
 
-	*state = (rr_nmt_state_t)usbcan_get_device_state(inst, id);
+	rr_traj_stream_t *t = stream;
+	rr_ret_status_t sts;
+	int axis = -1;
+
+	if(t->thread_running || !poll_ms)
+	{
+		return RET_WRONG_ARG;
+	}
+	if((sts = traj_stream_read_queue(t, 0x03, t->cap, &axis)) != RET_OK)
+	{
+		traj_stream_fail(t, sts, axis);
+		return sts;
+	}
+
+	t->low_watermark = low_watermark;
+	t->poll_ms = poll_ms;
+	t->stats.capacity = UINT32_MAX;
+	t->stats.min_queue = UINT32_MAX;
+	for(int i = 0; i < t->n; i++)
+	{
+		if(!t->cap[i] || (t->cap[i] <= low_watermark))
+		{
+			return RET_WRONG_ARG;
+		}
+		t->stats.capacity = MIN(t->stats.capacity, t->cap[i]);
+		t->exhausted[i] = false;
+		free(t->buf[i]);
+		if(!(t->buf[i] = (rr_motion_point_t *)malloc(t->cap[i] * sizeof(rr_motion_point_t))))
+		{
+			return RET_ERROR;
+		}
+	}
+
+	if((sts = traj_stream_refill(t, t->cap, &axis)) != RET_OK)
+	{
+		traj_stream_fail(t, sts, axis);
+		return sts;
+	}
+
+	t->stats.state = RR_TRAJ_STREAM_RUNNING;
+	t->stop = false;
+	rr_start_motion(t->iface, timestamp_ms);
+
+	if(pthread_create(&t->thread, NULL, traj_stream_process, t))
+	{
+		traj_stream_fail(t, RET_ERROR, -1);
+		return RET_ERROR;
+	}
+	t->thread_running = true;
 
 	return RET_OK;
 }
 
-
 /**
- * @brief The function sets the specified servo to the released state. The servo is de-energized 
- * and continues rotating for as long as it is affected by external forces (e.g., inertia, gravity).
- * <p><b>Note:</b> Affected by external force, the servo may also begin rotating in the opposite direction.</p>
- * @param servo Servo descriptor returned by the ::rr_init_servo function 
- * @return Status code (::rr_ret_status_t)
- * @ingroup Motion
+ * @brief The function waits for the trajectory stream to complete (see ::rr_traj_stream_start).
+ * @param stream Stream descriptor returned by the ::rr_init_traj_stream function
+ * @param timeout_ms Timeout (ms), negative - wait infinitely
+ * @return Status code (::rr_ret_status_t)<br>RET_TIMEOUT - the motion is still in progress<br>
+ * Failure status of the stream when it is in the error state (see ::rr_traj_stream_stats_t)
+ * @ingroup Trajectory
  */
-rr_ret_status_t rr_release(const rr_servo_t *servo)
+rr_ret_status_t rr_traj_stream_wait(rr_traj_stream_t *stream, int timeout_ms)
 {
-	IS_VALID_SERVO(servo);
-	CHECK_NMT_STATE(servo);
+	if(!stream)
+	{
+		return RET_BAD_INSTANCE;
+	}
 
-	uint8_t data = 0;
-	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
-	uint32_t sts = write_raw_sdo(dev, 0x2010, 0x01, &data, sizeof(data), 1, 100);
+	int64_t deadline = monotonic_us() + 1000ll * timeout_ms;
 
-	return ret_sdo(sts);
+	while(true)
+	{
+		rr_traj_stream_stats_t st;
+
+		rr_traj_stream_get_stats(stream, &st);
+		if(st.state == RR_TRAJ_STREAM_DONE)
+		{
+			return RET_OK;
+		}
+		if(st.state == RR_TRAJ_STREAM_ERROR)
+		{
+			return st.error;
+		}
+		if(st.state == RR_TRAJ_STREAM_IDLE)
+		{
+			return RET_ERROR;
+		}
+		if((timeout_ms >= 0) && (monotonic_us() >= deadline))
+		{
+			return RET_TIMEOUT;
+		}
+		msleep(MAX(stream->poll_ms / 2, 1));
+	}
 }
 
 /**
- * @brief The function sets the specified servo to the freeze state. The servo stops, retaining its last position.
- * @param servo Servo descriptor returned by the ::rr_init_servo function
+ * @brief The function reads the state and statistics of the trajectory stream (see ::rr_init_traj_stream).
+ * @param stream Stream descriptor returned by the ::rr_init_traj_stream function
+ * @param stats Pointer to the structure to receive the statistics
  * @return Status code (::rr_ret_status_t)
- * @ingroup Motion
+ * @ingroup Trajectory
  */
-rr_ret_status_t rr_freeze(const rr_servo_t *servo)
+rr_ret_status_t rr_traj_stream_get_stats(rr_traj_stream_t *stream, rr_traj_stream_stats_t *stats)
 {
-	IS_VALID_SERVO(servo);
-	CHECK_NMT_STATE(servo);
+	if(!stream)
+	{
+		return RET_BAD_INSTANCE;
+	}
+	if(!stats)
+	{
+		return RET_WRONG_ARG;
+	}
 
-	uint8_t data = 0;
-	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
-	uint32_t sts = write_raw_sdo(dev, 0x2010, 0x02, &data, sizeof(data), 1, 100);
+	pthread_mutex_lock(&stream->mutex);
+	*stats = stream->stats;
+	pthread_mutex_unlock(&stream->mutex);
 
-	return ret_sdo(sts);
+	return RET_OK;
 }
 
 /**
- * @brief The function sets the current supplied to the stator of the servo specified in the 'servo' parameter.
- * Changing the 'current_a parameter' value, it is possible to adjust the servo's torque (Torque = stator current*Kt).
- * @param servo Servo descriptor returned by the ::rr_init_servo function 
- * @param current_a Phase current of the stator in Amperes
+ * @brief The functions enables reading the total actual count of servo hardware errors (e.g., no Heartbeats/overcurrent, etc.).
+ * In addition, the function returns the codes of all the detected errors as a single array. 
+ * <p><b>Note</b>: The ::rr_ret_status_t codes returned by API functions only indicate that an error occured during communication between the user program and a servo.
+ * If it is a hardware error, the ::rr_ret_status_t code will be ::RET_ERROR. Use ::rr_read_error_status to determine the cause of the error.</p>  
+ * @param servo Servo Servo descriptor returned by the ::rr_init_servo function  
+ * @param error_count Pointer to the variable where the function will save the current servo error count
+ * @param error_array Pointer to the array where the function will save the codes of all errors. Default array size is ::ARRAY_ERROR_BITS_SIZE
+ * <b>Note:</b> Call the ::rr_describe_emcy_bit function, to get a detailed error code description.
+ * If the array is not used, set the parameter to 0.
  * @return Status code (::rr_ret_status_t)
- * @ingroup Motion
+ * @ingroup Err
  */
-rr_ret_status_t rr_set_current(const rr_servo_t *servo, const float current_a)
+rr_ret_status_t rr_read_error_status(const rr_servo_t *servo, uint32_t *const error_count, uint8_t *const error_array)
 {
 	IS_VALID_SERVO(servo);
+
 	CHECK_NMT_STATE(servo);
 
-	uint8_t data[4];
+	uint8_t array[32];
+	uint8_t *ptr = error_array == 0 ? array : error_array;
+	*error_count = 0;
+
+	int size = sizeof(array); //? think about
 	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
-	usb_can_put_float(data, 0, &current_a, 1);
-	uint32_t sts = write_raw_sdo(dev, 0x2012, 0x01, data, sizeof(data), 1, 100);
+	uint32_t sts = read_raw_sdo(dev, 0x2000, 0, ptr, &size, 1, 200);
+
+	if(sts == CO_SDO_AB_NONE)
+	{
+		for(int i = 0; i < size * 8; i++)
+		{
+			if(ptr[i / 8] & (1 << (i % 8)))
+			{
+				if(error_array)
+				{
+					error_array[*error_count] = i;
+				}
+				*error_count += 1;
+			}
+		}
+	}
 
 	return ret_sdo(sts);
 }
 
 /**
- * @brief The function applies or releases the servo's built-in brake.
- * If a servo is supplied without a brake, the function will not work.
- * In this case, to stop a servo, use either the ::rr_freeze() or ::rr_release() function.
+ * @brief The function is always used in combination with the ::rr_param_cache_setup_entry function. It retreives from the servo the array of parameters
+ * that was set up using ::rr_param_cache_setup_entry function and saves the array to the program cache. You can subsequently read the parameters from the program
+ * cache with the ::rr_read_cached_parameter function. For more information, see ::rr_param_cache_setup_entry.
+ * <p><b>Note</b>: After you exit the program, the cache will be cleared.</p>
  * @param servo Servo descriptor returned by the ::rr_init_servo function 
- * @param en Desired action: true - engage brake, false - disengage
  * @return Status code (::rr_ret_status_t)
- * @ingroup Motion
+ * @ingroup Realtime
  */
-rr_ret_status_t rr_brake_engage(const rr_servo_t *servo, const bool en)
+rr_ret_status_t rr_param_cache_update(rr_servo_t *servo)
 {
 	IS_VALID_SERVO(servo);
 	CHECK_NMT_STATE(servo);
 
-	uint8_t data = en ? 1 : 0;
 	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
 
-	uint32_t sts = write_raw_sdo(dev, 0x2010, 0x03, &data, sizeof(data), 1, 100);
+	if(param_cache_is_streamed(servo))
+	{
+		return RET_OK;
+	}
 
-	return ret_sdo(sts);
+	uint8_t data[APP_PARAM_SIZE * sizeof(float)];
+	int len = sizeof(data);
+	int i, src;
+
+	int sts = read_raw_sdo(dev, 0x2014, 0x01, data, &len, 1, 100);
+
+	if(sts != 0)
+	{
+		return ret_sdo(sts);
+	}
+
+	for(i = 0, src = 0; i < APP_PARAM_SIZE; i++)
+	{
+		if(servo->pcache[i].activated)
+		{
+			usb_can_get_float(data + src, 0, (float *)&servo->pcache[i].value, 1);
+			servo->pcache[i].timestamp = RR_TIMESTAMP_INVALID;
+			src += sizeof(float);
+		}
+	}
+
+	if(src != len)
+	{
+		return RET_SIZE_MISMATCH;
+	}
+
+	return RET_OK;
 }
 
 /**
- * @brief The function sets the output shaft velocity with which the specified servo should move at its maximum current.
- * The maximum current is in accordance with the servo motor specification. When you need to set a lower current limit, use the ::rr_set_velocity_with_limits function.
- * <p>The rr_set_velocity() function works with geared servos only. When a servo includes no gearhead, use the ::rr_set_velocity_motor() for setting servo velocity.</p>
- * @param servo Servo descriptor returned by the ::rr_init_servo function
- * @param velocity_deg_per_sec Velocity (in degrees/sec) at the servo flange 
+ * @brief Same as ::rr_param_cache_update but with timestamp functionality.
+ * @param servo Servo descriptor returned by the ::rr_init_servo function 
  * @return Status code (::rr_ret_status_t)
- * @ingroup Motion
+ * @ingroup Realtime
  */
-rr_ret_status_t rr_set_velocity(const rr_servo_t *servo, const float velocity_deg_per_sec)
+rr_ret_status_t rr_param_cache_update_with_timestamp(rr_servo_t *servo)
 {
 	IS_VALID_SERVO(servo);
 	CHECK_NMT_STATE(servo);
 
-	uint8_t data[4];
 	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
-	usb_can_put_float(data, 0, &velocity_deg_per_sec, 1);
-	uint32_t sts = write_raw_sdo(dev, 0x2012, 0x03, data, sizeof(data), 1, 100);
+
+	if(param_cache_is_streamed(servo))
+	{
+		return RET_OK;
+	}
+
+	uint8_t data[APP_PARAM_SIZE * sizeof(float) + sizeof(uint32_t)];
+	int len = sizeof(data);
+	int i, src = 0;
+	uint32_t timestamp;
+
+	int sts = read_raw_sdo(dev, 0x2016, 0x01, data, &len, 1, 100);
+
+	if(sts != 0)
+	{
+		return ret_sdo(sts);
+	}
+
+	if(len < sizeof(uint32_t))
+	{
+		return RET_SIZE_MISMATCH;
+	}
+
+	src = usb_can_get_uint32_t(data, src, &timestamp, 1);
+
+	if(sts == CO_SDO_AB_NONE)
+	{
+		for(i = 0; i < APP_PARAM_SIZE; i++)
+		{
+			if(servo->pcache[i].activated)
+			{
+				if((src + sizeof(float)) > len)
+				{
+					return RET_SIZE_MISMATCH;
+				}
+				src = usb_can_get_float(data, src, (float *)&servo->pcache[i].value, 1);
+				servo->pcache[i].timestamp = timestamp;
+			}
+		}
+		return RET_OK;
+	}
 
 	return ret_sdo(sts);
 }
 
 /**
- * @brief The function sets the velocity with which the motor of the specified servo should move at its maximum current.
- * The maximum current is in accordance with the servo motor specification.
- * <p>You can use the function for both geared servos and servos without a gearhead.
- * When a servo is geared, the velocity at the output flange will depend on the applied gear ratio (refer to the servo motor specification).</p>
+ * @brief The function is the fist one in the API call sequence that enables reading multiple servo paramaters (e.g., velocity, voltage,
+ * and position) as a data array. Using the sequence is advisable when you need to read <b>more than one parameter at a time</b>.
+ * The user can set up the array to include up to 50 parameters.
+ * In all, the sequence comprises the following functions:
+ * <ul> <li>::rr_param_cache_setup_entry for setting up an array of servo parameters to read</li>
+ * <li>::rr_param_cache_update for retreiving the parameters from the servo and saving them to the program cache</li>
+ * <li>::rr_read_cached_parameter for reading parameters from the program cache</li></ul>
+ * Using the sequence of API calls allows for speeding up data acquisition by nearly two times.
+ * Let's assume you need to read 49 parameters. At a bit rate of 1 MBit/s, reading them one by one will take about 35 ms, 
+ * whereas reading them as an array will only take 10 ms.
+ * <p><b>Note:</b> When you need to read a single parameter, it is better to use the ::rr_read_parameter function.</p>
  * @param servo Servo descriptor returned by the ::rr_init_servo function
- * @param velocity_rpm Velocity of the motor (in revolutions per minute)
+ * @param param Index of the parameter to read as indicated in the ::rr_servo_param_t list (e.g., APP_PARAM_POSITION_ROTOR)
+ * @param enabled Set True/False to enable/ disable the specified parameter for reading
  * @return Status code (::rr_ret_status_t)
- * @ingroup Motion
+ * @ingroup Realtime
  */
-rr_ret_status_t rr_set_velocity_motor(const rr_servo_t *servo, const float velocity_rpm)
+rr_ret_status_t rr_param_cache_setup_entry(rr_servo_t *servo, const rr_servo_param_t param, bool enabled)
 {
 	IS_VALID_SERVO(servo);
 	CHECK_NMT_STATE(servo);
 
-	uint8_t data[3];
+	uint8_t array[10] = {0};
 	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
-	usb_can_put_float24(data, 0, &velocity_rpm, 1);
-	uint32_t sts = write_raw_sdo(dev, 0x2012, 0x03, data, sizeof(data), 1, 100);
+
+	if((param < 0) || (param >= APP_PARAM_SIZE))
+	{
+		return RET_WRONG_ARG;
+	}
+
+	servo->pcache[param].activated = enabled;
+
+	for(int i = 0; i < APP_PARAM_SIZE; i++)
+	{
+		if(servo->pcache[i].activated)
+		{
+			BIT_SET_UINT_ARRAY(array, i);
+		}
+	}
+
+	uint32_t sts = write_raw_sdo(dev, 0x2015, 1, array, sizeof(array), 1, 200);
 
 	return ret_sdo(sts);
 }
 
-/**
- * @brief The function sets the position that the specified servo should reach as a result of executing the command.
- * The velocity and current are maximum values in accordance with the servo motor specifications.
- * For setting lower velocity and current limits, use the ::rr_set_position_with_limits function.
- * @param servo Servo descriptor returned by the ::rr_init_servo function 
- * @param position_deg Position of the servo (in degrees) to be reached. The parameter is a multi-turn value (e.g., when set to 720, the servo will make two turns, 360 degrees each).
- When the parameter is set to a "-" sign value, the servo will rotate in the opposite direction. 
- * @return Status code (::rr_ret_status_t)
- * @ingroup Motion
- */
-rr_ret_status_t rr_set_position(const rr_servo_t *servo, const float position_deg)
+static bool pdo_in_layout(const rr_pdo_layout_t *layout, rr_pdo_n_t pdo_n)
 {
-	IS_VALID_SERVO(servo);
-	CHECK_NMT_STATE(servo);
+	for(int p = 0; p < layout->n_pdo; p++)
+	{
+		if(layout->pdo[p] == pdo_n)
+		{
+			return true;
+		}
+	}
+	return false;
+}
 
-	uint8_t data[4];
-	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
-	usb_can_put_float(data, 0, &position_deg, 1);
-	uint32_t sts = write_raw_sdo(dev, 0x2012, 0x04, data, sizeof(data), 1, 100);
+static rr_ret_status_t pdo_save_map(rr_servo_t *s, rr_pdo_n_t n, uint32_t *cob_id, uint8_t *cnt, uint32_t *map, uint8_t *trans_type)
+{
+	int l = 4;
+
+	if(rr_read_raw_sdo(s, tr_type_obj(n), 1, (uint8_t *)cob_id, &l, 1, 100) != RET_OK)
+	{
+		return RET_ERROR;
+	}
+	l = 1;
+	if(rr_read_raw_sdo(s, tr_type_obj(n), 2, trans_type, &l, 1, 100) != RET_OK)
+	{
+		return RET_ERROR;
+	}
+	if((rr_pdo_get_map_count(s, n, cnt) != RET_OK) || (*cnt > 8))
+	{
+		return RET_ERROR;
+	}
+	for(int k = 0; k < *cnt; k++)
+	{
+		if(rr_pdo_read_map(s, n, k + 1, &map[k]) != RET_OK)
+		{
+			return RET_ERROR;
+		}
+	}
+
+	return RET_OK;
+}
+
+static rr_ret_status_t pdo_restore_map(rr_servo_t *s, rr_pdo_n_t n, uint32_t cob_id, uint8_t cnt, const uint32_t *map, uint8_t trans_type)
+{
+	if(rr_pdo_clear_map(s, n) != RET_OK)
+	{
+		return RET_ERROR;
+	}
+	for(int k = 0; k < cnt; k++)
+	{
+		if(rr_pdo_write_map(s, n, k + 1, map[k]) != RET_OK)
+		{
+			return RET_ERROR;
+		}
+	}
+	if((rr_pdo_set_map_count(s, n, cnt) != RET_OK) || 
+			(rr_write_raw_sdo(s, tr_type_obj(n), 2, &trans_type, 1, 1, 100) != RET_OK) ||
+			(rr_write_raw_sdo(s, tr_type_obj(n), 1, (uint8_t *)&cob_id, 4, 1, 100) != RET_OK))
+	{
+		return RET_ERROR;
+	}
 
-	return ret_sdo(sts);
+	return RET_OK;
 }
 
 /**
- * @brief The function changes velocity rate limiter acceleration value,
- * @param servo Servo descriptor returned by the ::rr_init_servo function 
- * @param velocity_rate_rpm_per_sec Velocity rate (in RPM/sec) at the motor flange. Take into account gear reduction ratio.
+ * @brief The function switches the parameter cache of the servo to streaming mode. The parameters enabled with ::rr_param_cache_setup_entry
+ * (objects 0x2013:param) are mapped to TPDOs, and the interface thread updates the cache values and timestamps as the TPDOs arrive.
+ * Thus, ::rr_read_cached_parameter returns data refreshed at the bus cycle rate without any SDO traffic,
+ * and ::rr_param_cache_update does nothing while streaming is enabled.
+ * <p>Each TPDO carries up to two parameters. The timestamps are the reception times of the TPDOs converted to the servo time 
+ * (microseconds by modulus of 600,000,000 since the first trajectory sync frame, as in ::rr_read_parameter_with_timestamp), 
+ * or ::RR_TIMESTAMP_INVALID before the first sync frame is sent.</p>
+ * <p><b>Note:</b> Call the function again after changing the set of parameters. 
+ * Synchronous TPDOs are transmitted in response to SYNC frames (see ::rr_send_pdo_sync), the servo should be in the operational state.</p>
+ * <p>TPDO0 carries the factory mapping decoded by the state mirror (see ::rr_servo_snapshot), so it is only used when listed in 'pdo_pool'.
+ * In that case, its mapping is saved, the mirror is detached from TPDO0 while streaming, and both are restored by ::rr_param_cache_stream_disable.</p>
+ * @param servo Servo descriptor returned by the ::rr_init_servo function
+ * @param trans_type TPDO transmission type: 1-240 - synchronous (number of SYNC frames between transmissions), 254/255 - asynchronous
+ * @param pdo_pool TPDO numbers available for streaming (NULL - TPDO1 to TPDO3, up to 6 parameters)
+ * @param n_pool Number of TPDOs in the 'pdo_pool' array
  * @return Status code (::rr_ret_status_t)
- * @ingroup Motion
+ * @ingroup Realtime
  */
-rr_ret_status_t rr_set_velocity_rate(const rr_servo_t *servo, const float velocity_rate_rpm_per_sec)
+rr_ret_status_t rr_param_cache_stream_enable(rr_servo_t *servo, uint8_t trans_type, const rr_pdo_n_t *pdo_pool, int n_pool)
 {
+	static const rr_pdo_n_t default_pool[] = {TPDO1, TPDO2, TPDO3};
+
 	IS_VALID_SERVO(servo);
-	CHECK_NMT_STATE(servo);
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	rr_node_t *n = get_node(dev->inst, dev->id);
+	rr_pdo_signal_t sig[RR_PDO_MAX_SIGNALS];
+	rr_pdo_layout_t layout;
+	int cnt = 0;
 
-	if(velocity_rate_rpm_per_sec < 0)
+	if(!n)
+	{
+		return RET_ERROR;
+	}
+
+	for(int i = 0; i < APP_PARAM_SIZE; i++)
+	{
+		if(!servo->pcache[i].activated)
+		{
+			continue;
+		}
+		if(cnt == RR_PDO_MAX_SIGNALS)
+		{
+			return RET_SIZE_MISMATCH;
+		}
+		sig[cnt++] = (rr_pdo_signal_t){.idx = 0x2013, .sidx = i, .type = RR_PDO_SIG_FLOAT, .count = 1, .scale = 1, 
+			.offset = offsetof(rr_servo_t, pcache) + i * sizeof(param_cache_entry_t) + offsetof(param_cache_entry_t, value)};
+	}
+	if(!cnt)
 	{
 		return RET_WRONG_ARG;
 	}
+	if(!pdo_pool)
+	{
+		pdo_pool = default_pool;
+		n_pool = sizeof(default_pool) / sizeof(default_pool[0]);
+	}
 
-	uint8_t data[8];
-	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
-	int p = 0;
-	p = usb_can_put_float(data, p, &velocity_rate_rpm_per_sec, 1);
-	uint32_t sts = write_raw_sdo(dev, 0x4308, 0x06, data, p, 1, 100);
+	rr_ret_status_t ret = rr_pdo_compile(&layout, true, pdo_pool, n_pool, sig, cnt);
+	if(ret != RET_OK)
+	{
+		return ret;
+	}
 
-	return ret_sdo(sts);
+	__atomic_store_n(&n->pcache_servo, NULL, __ATOMIC_RELEASE);
+	n->pcache_layout = layout;
+
+	if(pdo_in_layout(&layout, TPDO0))
+	{
+		if(!n->pcache_tpdo0_saved)
+		{
+			if(pdo_save_map(servo, TPDO0, &n->pcache_tpdo0_cob, &n->pcache_tpdo0_cnt, n->pcache_tpdo0_map, &n->pcache_tpdo0_tt) != RET_OK)
+			{
+				return RET_ERROR;
+			}
+			n->pcache_tpdo0_owner = __atomic_load_n(&n->tpdo_map[0], __ATOMIC_ACQUIRE);
+			n->pcache_tpdo0_saved = true;
+		}
+		const rr_pdo_layout_t *ml = __atomic_load_n(&n->mirror_layout, __ATOMIC_ACQUIRE);
+		if(pdo_in_layout(ml, TPDO0))
+		{
+			n->pcache_mirror = ml;
+			__atomic_store_n(&n->mirror_layout, &mirror_none_layout, __ATOMIC_RELEASE);
+		}
+	}
+
+	ret = rr_pdo_program(&servo, 1, &n->pcache_layout, trans_type);
+	if(ret != RET_OK)
+	{
+		return ret;
+	}
+
+	__atomic_store_n(&n->pcache_servo, servo, __ATOMIC_RELEASE);
+
+	return RET_OK;
 }
 
 /**
- * @brief The function reads velocity rate limiter acceleration value,
- * @param servo Servo descriptor returned by the ::rr_init_servo function 
- * @param velocity_rate_rpm_per_sec Pointer to put velocity rate in. See ::rr_set_velocity_rate for details.
+ * @brief The function switches the parameter cache of the servo back to SDO mode (see ::rr_param_cache_stream_enable)
+ * and disables the TPDOs used for streaming. If TPDO0 was used, its original mapping is restored instead 
+ * and the state mirror decodes it again.
+ * @param servo Servo descriptor returned by the ::rr_init_servo function
  * @return Status code (::rr_ret_status_t)
- * @ingroup Motion
+ * @ingroup Realtime
  */
-rr_ret_status_t rr_get_velocity_rate(const rr_servo_t *servo, float *const velocity_rate_rpm_per_sec)
+rr_ret_status_t rr_param_cache_stream_disable(rr_servo_t *servo)
 {
 	IS_VALID_SERVO(servo);
-	CHECK_NMT_STATE(servo);
+	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
+	rr_node_t *n = get_node(dev->inst, dev->id);
 
-	if(velocity_rate_rpm_per_sec < 0)
+	if(!n || (n->pcache_servo != servo))
 	{
-		return RET_WRONG_ARG;
+		return RET_OK;
 	}
 
-	uint8_t data[8];
-	int l = sizeof(data);
-	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
-	uint32_t sts = read_raw_sdo(dev, 0x4308, 0x06, data, &l, 1, 100);
-	if(sts != CO_SDO_AB_NONE)
+	__atomic_store_n(&n->pcache_servo, NULL, __ATOMIC_RELEASE);
+
+	for(int k = 0; k < n->pcache_layout.n_pdo; k++)
 	{
-		return ret_sdo(sts);
+		if(n->pcache_layout.pdo[k] == TPDO0)
+		{
+			continue;
+		}
+		if(rr_pdo_disable(servo, n->pcache_layout.pdo[k]) != RET_OK)
+		{
+			return RET_ERROR;
+		}
 	}
 
-	if(l != sizeof(float))
+	if(n->pcache_tpdo0_saved)
 	{
-		return RET_SIZE_MISMATCH;
+		if(pdo_restore_map(servo, TPDO0, n->pcache_tpdo0_cob, n->pcache_tpdo0_cnt, n->pcache_tpdo0_map, n->pcache_tpdo0_tt) != RET_OK)
+		{
+			return RET_ERROR;
+		}
+		tpdo_map_note(servo, TPDO0, n->pcache_tpdo0_owner);
+		n->pcache_tpdo0_saved = false;
+	}
+	if(n->pcache_mirror)
+	{
+		//unless the mirror has been set up again in the meantime
+		const rr_pdo_layout_t *none = &mirror_none_layout;
+		__atomic_compare_exchange_n(&n->mirror_layout, &none, n->pcache_mirror, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+		n->pcache_mirror = NULL;
 	}
 
-	usb_can_get_float(data, 0, velocity_rate_rpm_per_sec, 1);
 	return RET_OK;
 }
 
-/**
- * @brief Function is deprecated!. Use ::rr_get_velocity_rate and ::rr_set_velocity_rate to get or set velocity rate limiter acceleration value.
- * The function commands the specified servo to rotate at the specified velocity,
- * while setting the maximum limit for the servo current (below the servo motor specifications).
- * The velocity value is the velocity of the servo’s output shaft.
- * <p>Similarly to ::rr_set_velocity(), this function can be used for geared servos only.</p>
- * @param servo Servo descriptor returned by the ::rr_init_servo function 
- * @param velocity_deg_per_sec Velocity (in degrees/sec) at the servo flange. The value can have a "-" sign, in which case the servo will rotate in the opposite direction.
- * @param current_a Maximum user-defined current limit in Amperes.
- * @return Status code (::rr_ret_status_t)
- * @ingroup Motion
+/*
+ * Telemetry scheduler
  */
-rr_ret_status_t rr_set_velocity_with_limits(const rr_servo_t *servo, const float velocity_deg_per_sec, const float current_a)
+static int telemetry_find(const rr_telemetry_t *t, const rr_servo_t *servo, rr_servo_param_t param)
 {
-	IS_VALID_SERVO(servo);
-	CHECK_NMT_STATE(servo);
-
-	uint8_t data[8];
-	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
-	int p = 0;
-	p = usb_can_put_float(data, p, &velocity_deg_per_sec, 1);
-	p = usb_can_put_float(data, p, &current_a, 1);
-	uint32_t sts = write_raw_sdo(dev, 0x2012, 0x05, data, sizeof(data), 1, 100);
+	for(int k = 0; k < t->n; k++)
+	{
+		if((t->sub[k].servo == servo) && (t->sub[k].param == param))
+		{
+			return k;
+		}
+	}
 
-	return ret_sdo(sts);
+	return -1;
 }
 
-/**
- * @brief The function sets the position that the servo should reach with velocity and acceleration limits on generated trajectory.
- * @param servo Servo descriptor returned by the ::rr_init_servo function
- * @param position_deg Final position of the servo flange (in degrees) to be reached
- * @param velocity_deg_per_sec Maximum Velocity on generated trajectory (in degrees/sec)
- * @param accel_deg_per_sec_sq Maximum acceleration on generated trajectory (in degrees/(sec*sec))
- * @param time_ms Trajectory execution time (im milliseconds): int
- * @return Status code (::rr_ret_status_t)
- * @ingroup Motion
- */
-rr_ret_status_t rr_set_position_with_limits(rr_servo_t *servo, const float position_deg, const float velocity_deg_per_sec, const float accel_deg_per_sec_sq, uint32_t *time_ms)
+static int telemetry_cmp(const void *a, const void *b)
 {
-	IS_VALID_SERVO(servo);
-	CHECK_NMT_STATE(servo);
-
-	uint32_t sts = 0;
+	const telemetry_sub_t *x = *(const telemetry_sub_t *const *)a, *y = *(const telemetry_sub_t *const *)b;
 
-	/* Get current position */
-	float current_position = 0.0;
-	if((sts = rr_read_parameter(servo, APP_PARAM_POSITION, &current_position)) != CO_SDO_AB_NONE)
+	if(x->priority != y->priority)
 	{
-		return ret_sdo(sts);
+		return x->priority - y->priority;
 	}
 
-	/* Read max velocity */
-	float max_velocity = 0.0;
-	if((sts = rr_get_max_velocity(servo, &max_velocity)) != CO_SDO_AB_NONE)
+	return (x->due_us > y->due_us) - (x->due_us < y->due_us);
+}
+
+static int telemetry_active_count(const rr_servo_t *servo)
+{
+	int m = 0;
+
+	for(int i = 0; i < APP_PARAM_SIZE; i++)
 	{
-		return ret_sdo(sts);
+		m += servo->pcache[i].activated;
 	}
 
-	double vm = fabs(velocity_deg_per_sec); //max velocity
-	double ps = current_position; // start position
-	double pf = position_deg; // final position
-	double am = fabs(accel_deg_per_sec_sq); // max acceleration
-
-	double dir = SIGN(pf - ps);
-	double d = 3.0 * SQ(vm) / 4.0 / am * dir;
-	bool cruise = true;
+	return m;
+}
 
-	if(fabs(2.0 * d) >= fabs(pf - ps))
+static void telemetry_served(telemetry_sub_t *s, int64_t now)
+{
+	if(s->last_us)
 	{
-		d = 0.5 * fabs(pf - ps);
-		vm = 2.0 * sqrt(am * d / 3.0);
-		d *= dir;
-		cruise = false;
+		s->interval_us += 0.1f * ((now - s->last_us) - s->interval_us);
 	}
+	s->last_us = now;
+	s->due_us = (s->due_us + s->period_us > now) ? s->due_us + s->period_us : now + s->period_us;
+}
 
-	double tc = (pf - ps - 2.0 * d) / (dir * vm); // cruise time
-	double ta = fabs(2.0 * d / vm); //acceleration time
+/*
+ * The interval estimate is at least the time since the last read, so that a deferred subscription reports its degraded rate
+ */
+static void telemetry_age(telemetry_sub_t *s, int64_t now)
+{
+	int64_t idle = now - (s->last_us ? s->last_us : s->since_us);
 
-	if(time_ms)
+	if(idle > s->interval_us)
 	{
-		*time_ms = 1000.0 * (2.0 * ta + tc);
+		s->interval_us = idle;
 	}
+}
 
-	if((sts = rr_add_motion_point_pvat(servo, ps + d, dir * vm, 0, 1000.0 * ta)) != CO_SDO_AB_NONE)
+/*
+ * One scheduler tick: the due subscriptions are served in priority order while the frame budget lasts.
+ * The reads of a servo are packed into a single parameter array read (0x2014) when it takes fewer frames than separate reads.
+ * The reads are planned and their results stored under the mutex, while the bus transactions run without it, 
+ * so the subscriptions can change in the meantime: the results of the cancelled ones are dropped.
+ */
+static void telemetry_tick(rr_telemetry_t *t)
+{
+	typedef struct
 	{
-		rr_clear_points_all(servo);
-		LOG_ERROR(debug_log, "Can't add acceleration point");
-		return ret_sdo(sts);
+		rr_servo_t *servo;
+		int k;          //number of due reads
+		int m;          //number of parameters enabled in the servo cache
+		int cost;       //frames
+		int req;        //first request
+		bool act[APP_PARAM_SIZE]; //parameters enabled in the servo cache when the reads are planned
+	} group_t;
+
+	pthread_mutex_lock(&t->mutex);
+
+	int64_t now = monotonic_us();
+	double cap = MAX(2.0 * t->frames_per_tick, RR_API_TELEMETRY_ARRAY_FRAMES(APP_PARAM_SIZE));
+	int n_sub = t->n;
+	telemetry_sub_t *due[n_sub > 0 ? n_sub : 1];
+	rr_servo_t *due_servo[n_sub > 0 ? n_sub : 1];
+	rr_servo_param_t due_param[n_sub > 0 ? n_sub : 1];
+	int grp[n_sub > 0 ? n_sub : 1];
+	group_t group[n_sub > 0 ? n_sub : 1];
+	int n_due = 0, n_group = 0, spent = 0;
+	bool full = false;
+
+	t->tokens = MIN(t->tokens + t->frames_per_tick, cap);
+	t->stats.ticks++;
+
+	//the reads falling due before the next tick are served now, which keeps the subscriptions of the same rate in phase
+	for(int k = 0; k < t->n; k++)
+	{
+		telemetry_age(&t->sub[k], now);
+		if((t->sub[k].due_us < now + 1000ll * t->tick_ms) && !param_cache_is_streamed(t->sub[k].servo))
+		{
+			due[n_due++] = &t->sub[k];
+		}
 	}
+	qsort(due, n_due, sizeof(due[0]), telemetry_cmp);
 
-	if(cruise)
+	for(int k = 0; k < n_due; k++)
 	{
-		if((sts = rr_add_motion_point_pvat(servo, pf - d, dir * vm, 0, 1000.0 * tc)) != CO_SDO_AB_NONE)
+		int j = 0;
+
+		due_servo[k] = due[k]->servo;
+		due_param[k] = due[k]->param;
+		while((j < n_group) && (group[j].servo != due[k]->servo))
+		{
+			j++;
+		}
+		if(j == n_group)
+		{
+			group[j] = (group_t){.servo = due[k]->servo, .m = telemetry_active_count(due[k]->servo)};
+		}
+
+		int cost = MIN(2 * (group[j].k + 1), RR_API_TELEMETRY_ARRAY_FRAMES(group[j].m));
+		int delta = cost - group[j].cost;
+
+		//lower priorities are deferred first, only the reads costing nothing more are added after the budget is exhausted
+		grp[k] = -1;
+		if((full || (spent + delta > t->tokens)) && (delta > 0))
 		{
-			rr_clear_points_all(servo);
-			LOG_ERROR(debug_log, "Can't add cruise point");
-			return ret_sdo(sts);
+			full = true;
+			t->stats.deferred++;
+			continue;
 		}
+		n_group += (j == n_group);
+		grp[k] = j;
+		group[j].k++;
+		group[j].cost = cost;
+		spent += delta;
 	}
 
-	if((sts = rr_add_motion_point_pvat(servo, pf, 0, 0, 1000.0 * ta)) != CO_SDO_AB_NONE)
+	/*Build the requests: a parameter array read or separate reads per servo*/
+	int n_req = 0;
+
+	for(int j = 0; j < n_group; j++)
 	{
-		rr_clear_points_all(servo);
-		LOG_ERROR(debug_log, "Can't add deceleration point");
-		return ret_sdo(sts);
+		group[j].req = n_req;
+		n_req += (group[j].cost < 2 * group[j].k) ? 1 : group[j].k;
+		for(int i = 0; i < APP_PARAM_SIZE; i++)
+		{
+			group[j].act[i] = group[j].servo->pcache[i].activated;
+		}
 	}
 
-	usbcan_instance_t *inst = ((usbcan_device_t *)servo->dev)->inst;
-	write_timestamp(inst, 0);
+	usbcan_sdo_req_t req[n_req > 0 ? n_req : 1];
+	uint8_t buf[n_req > 0 ? n_req : 1][APP_PARAM_SIZE * sizeof(float)];
+	int next[n_group > 0 ? n_group : 1];
 
-	return RET_OK;
-}
+	for(int j = 0; j < n_group; j++)
+	{
+		usbcan_device_t *dev = (usbcan_device_t *)group[j].servo->dev;
+		int r = group[j].req;
 
-/**
- * @brief The function limits the input voltage supplied to the servo, enabling to adjust its motion velocity.
- * For instance, when the input voltage is 20V, setting the duty_percent parameter to 40% will result in 8V supplied to the servo.
- * @param servo Servo descriptor returned by the ::rr_init_servo function 
- * @param duty_percent User-defined percentage of the input voltage to be supplied to the servo
- * @return Status code (::rr_ret_status_t)
- * @ingroup Motion
- */
-rr_ret_status_t rr_set_duty(const rr_servo_t *servo, float duty_percent)
-{
-	IS_VALID_SERVO(servo);
-	CHECK_NMT_STATE(servo);
+		next[j] = r;
+		if(group[j].cost < 2 * group[j].k)
+		{
+			req[r] = (usbcan_sdo_req_t){.id = dev->id, .idx = 0x2014, .sidx = 0x01, .data = buf[r], .len = sizeof(buf[r]), .retry = 1, .tout = 100};
+		}
+	}
+	for(int k = 0; k < n_due; k++)
+	{
+		int j = grp[k];
 
-	uint8_t data[4];
-	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
-	usb_can_put_float(data, 0, &duty_percent, 1);
-	uint32_t sts = write_raw_sdo(dev, 0x2012, 0x07, data, sizeof(data), 1, 100);
+		if((j >= 0) && (group[j].cost >= 2 * group[j].k))
+		{
+			int r = next[j]++;
+			req[r] = (usbcan_sdo_req_t){.id = ((usbcan_device_t *)group[j].servo->dev)->id, .idx = 0x2013, .sidx = due_param[k], 
+				.data = buf[r], .len = 4, .retry = 1, .tout = 100};
+		}
+	}
 
-	return ret_sdo(sts);
-}
+	t->tokens -= spent;
+	t->stats.transactions += n_req;
+	t->stats.frames += spent;
+	t->stats.load = spent / t->frames_per_tick;
 
-/**
- * @brief The function enables creating PVT (position-velocity-time) points to set the motion trajectory of the servo specified in the 'servo' parameter.
- * PVT points define the following:<br>
- * <ul><li>what position the servo specified in the 'servo' parameter should reach</li><br>
- * <li>how fast the servo should move to the specified position</li><br>
- * <li>how long the movement to the specified position should take</li></ul>
- * <p>The graphs below illustrate how a servo builds a trajectory based on the preset PVT points.<br> 
- * <b>Note:</b> In this case, the preset position values are 0, 45, 90, 45, and 0 degrees; the preset velocity values are 0, 30, 15, 30, 0 degrees per second;
- * the time values are equal to delta time between two adjacent points on the Time axis (e.g., 2,000ms-3,000ms=1,000ms).</p>
- * @image html "PVT.png" "Example of calculated trajectory using PVT points" width=600 
- * @image latex "PVT.png" "Example of calculated trajectory using PVT points" width=300pt
- * Created PVT points are arranged into a motion queue that defines the motion trajectory of the specified servo. To execute the motion queue, 
- * use the ::rr_start_motion function.<br>
- * When any of the parameter values (e.g., position, velocity) exceeds user-defined limits or the servo motor specifications 
- * whichever is the smallest value), the function returns an error.<br><br>
+	pthread_mutex_unlock(&t->mutex);
 
- * <b>Note:</b> When you set a PVT trajectory to move more than one servo simultaneously, mind that the clock rate of the servos can differ by up to 2-3%.
- * Therefore, if the preset PVT trajectory is rather long, servos can get desynchronized. To avoid the desynchronization, we have implemented the following mechanism:
- * <ul><li>The device controlling the servos broadcasts a sync CAN frame to all servos on an interface. The frame should have the following format:<br>
- * ID = 0x27f, data = uint32 (4 bytes),<br>
- * <b>Where:</b> ‘data’ stands for the microseconds counter value by modulus of 600,000,000, starting from any value.</li><br>
- * <li>Servos receive the frame and try to adjust their clock rates to that of the device using the PLL.
- * The adjustment proper starts after the servos receive the second frame and can take up to 5 seconds, depending on the broadcasting frequency.
- * The higher the broadcasting frequency, the less time the adjustment takes.</li><br>
- * <li>The broadcasting frequency is 5 Hz minimum. The recommended frequency range is from 10 to 20 Hz.
- * When the sync frames are not broadcast or the broadcast frequency is below 5 Hz, the clock rate of servos is as usual.</li><br>
+	if(n_req)
+	{
+		batch_raw_sdo(t->inst, req, n_req, false);
+	}
 
- * @param servo Servo descriptor returned by the ::rr_init_servo function
- * @param position_deg Position that the servo flange (in degrees) should reach as a result of executing the command
- * @param velocity_deg_per_sec Servo velocity(in degrees/sec) at the point
- * @param time_ms Time (in milliseconds) it should take the servo to move from the previous position (PVT point in a motion trajectory or an initial point) to the commanded one.
- * The maximum admissible value is (2^32-1)/10 (roughly equivalent to 4.9 days). 
- * @return Status code (::rr_ret_status_t)
- * @ingroup Trajectory
- */
-rr_ret_status_t rr_add_motion_point(const rr_servo_t *servo, const float position_deg, const float velocity_deg_per_sec, const uint32_t time_ms)
-{
-	IS_VALID_SERVO(servo);
-	CHECK_NMT_STATE(servo);
+	pthread_mutex_lock(&t->mutex);
 
-	uint8_t data[12];
-	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
-	int p = 0;
-	p = usb_can_put_float(data, p, &position_deg, 1);
-	p = usb_can_put_float(data, p, &velocity_deg_per_sec, 1);
-	p = usb_can_put_uint32_t(data, p, &time_ms, 1);
+	/*Store the results in the parameter caches of the servos still subscribed*/
+	now = monotonic_us();
+	uint32_t ts;
+	if(!usbcan_get_sync_time(t->inst, now, &ts))
+	{
+		ts = RR_TIMESTAMP_INVALID;
+	}
 
-	uint32_t sts = write_raw_sdo(dev, 0x2200, 2, data, sizeof(data), 1, 200);
-	if(sts == CO_SDO_AB_PRAM_INCOMPAT)
+	for(int j = 0; j < n_group; j++)
+	{
+		rr_servo_t *servo = group[j].servo;
+		bool subscribed = false;
+
+		for(int k = 0; (k < t->n) && !subscribed; k++)
+		{
+			subscribed = t->sub[k].servo == servo;
+		}
+		for(int r = group[j].req; subscribed && (r < (j + 1 < n_group ? group[j + 1].req : n_req)); r++)
+		{
+			if(!req[r].done || req[r].abt)
+			{
+				t->stats.failures++;
+				continue;
+			}
+			if(req[r].idx == 0x2014)
+			{
+				for(int i = 0, src = 0; (i < APP_PARAM_SIZE) && (src + sizeof(float) <= req[r].len); i++)
+				{
+					if(group[j].act[i])
+					{
+						src = usb_can_get_float(req[r].data, src, (float *)&servo->pcache[i].value, 1);
+						servo->pcache[i].timestamp = ts;
+					}
+				}
+			}
+			else if(req[r].len == sizeof(float))
+			{
+				usb_can_get_float(req[r].data, 0, (float *)&servo->pcache[req[r].sidx].value, 1);
+				servo->pcache[req[r].sidx].timestamp = ts;
+			}
+		}
+	}
+	for(int k = 0; k < n_due; k++)
 	{
-		return RET_WRONG_TRAJ;
+		int i = telemetry_find(t, due_servo[k], due_param[k]);
+
+		if((grp[k] >= 0) && (i >= 0))
+		{
+			telemetry_served(&t->sub[i], now);
+		}
 	}
-	else
+
+	pthread_mutex_unlock(&t->mutex);
+}
+
+static void *telemetry_process(void *arg)
+{
+	rr_telemetry_t *t = (rr_telemetry_t *)arg;
+	int64_t next = monotonic_us();
+
+	while(!__atomic_load_n(&t->stop, __ATOMIC_ACQUIRE))
 	{
-		return ret_sdo(sts);
+		telemetry_tick(t);
+
+		next += 1000ll * t->tick_ms;
+
+		int64_t now = monotonic_us();
+		if(next > now)
+		{
+			msleep((next - now + 999) / 1000);
+		}
+		else
+		{
+			next = now;
+		}
 	}
+
+	return NULL;
 }
 
 /**
- * @brief The function enables creating PVAT (position-velocity-acceleration-time) points to set the motion trajectory of the servo specified in the 'servo' parameter.
- * PVAT points define the following:<br>
- * <ul><li>what position the servo specified in the 'servo' parameter should reach</li><br>
- * <li>how fast the servo should move to the specified position</li><br>
- * <li>how long the movement to the specified position should take</li><br>
- * <li>with what acceleration the servo should reach the specified position</li></ul>
- * For details of PVAT motion synchronization when running multiple servos, see ::rr_add_motion_point.
- * @param servo Servo descriptor returned by the ::rr_init_servo function
- * @param position_deg Position that the servo flange (in degrees) should reach as a result of executing the command
- * @param velocity_deg_per_sec Servo velocity (in degrees/sec) at the point
- * @param accel_deg_per_sec2 Servo acceleration (in degrees/sec^2) at the point
- * @param time_ms Time (in milliseconds) it should take the servo to move from the previous position (PVT point in a motion trajectory or an initial point) to the commanded one.
- * The maximum admissible value is (2^32-1)/10 (roughly equivalent to 4.9 days). 
- * @return Status code (::rr_ret_status_t)
- * @ingroup Trajectory
+ * @brief The function starts a telemetry service: a background thread polling servo parameters at the subscribed rates 
+ * (see ::rr_telemetry_subscribe) within a share of the CAN bus bandwidth.
+ * <p>On each tick, the due reads are packed per servo (a single parameter array read when it takes fewer CAN frames than separate reads)
+ * and pipelined across the servos. When the reads exceed the budget, the lower priority subscriptions are deferred first, 
+ * so their effective rates degrade (see ::rr_telemetry_get_rate). Unused budget is carried over to the next tick (up to two ticks).</p>
+ * <p>The results land in the parameter caches of the servos (see ::rr_read_cached_parameter_with_timestamp); the timestamps are
+ * the reception times of the responses converted to the servo time (microseconds by modulus of 600,000,000 since the first 
+ * trajectory sync frame, as in ::rr_read_parameter_with_timestamp), or ::RR_TIMESTAMP_INVALID before the first sync frame is sent.</p>
+ * @param iface Descriptor of the interface (as returned by the ::rr_init_interface function)
+ * @param tick_ms Scheduler tick (ms)
+ * @param bitrate CAN bus bitrate (bit/s)
+ * @param bus_share Share of the bus bandwidth available to the telemetry (0 to 1)
+ * @return Telemetry service descriptor or NULL when an error occurs
+ * @ingroup Realtime
  */
-rr_ret_status_t rr_add_motion_point_pvat(
-		const rr_servo_t *servo,
-		const float position_deg,
-		const float velocity_deg_per_sec,
-		const float accel_deg_per_sec2,
-		const uint32_t time_ms)
+rr_telemetry_t *rr_init_telemetry(rr_can_interface_t *iface, uint32_t tick_ms, uint32_t bitrate, float bus_share)
 {
-	IS_VALID_SERVO(servo);
-	CHECK_NMT_STATE(servo);
-
-	uint8_t data[16];
-	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
-	int p = 0;
-	p = usb_can_put_float(data, p, &position_deg, 1);
-	p = usb_can_put_float(data, p, &velocity_deg_per_sec, 1);
-	p = usb_can_put_float(data, p, &accel_deg_per_sec2, 1);
-	p = usb_can_put_uint32_t(data, p, &time_ms, 1);
+	if(!iface || !tick_ms || !bitrate || !(bus_share > 0) || (bus_share > 1))
+	{
+		return NULL;
+	}
 
-	uint32_t sts = write_raw_sdo(dev, 0x2200, 3, data, sizeof(data), 1, 200);
-	if(sts == CO_SDO_AB_PRAM_INCOMPAT)
+	rr_telemetry_t *t = (rr_telemetry_t *)calloc(1, sizeof(rr_telemetry_t));
+	if(!t)
 	{
-		return RET_WRONG_TRAJ;
+		return NULL;
 	}
-	else
+
+	t->inst = (usbcan_instance_t *)iface->iface;
+	t->tick_ms = tick_ms;
+	t->frames_per_tick = (double)bitrate * bus_share * tick_ms / 1000.0 / RR_API_TELEMETRY_FRAME_BITS;
+	pthread_mutex_init(&t->mutex, NULL);
+
+	if(pthread_create(&t->thread, NULL, telemetry_process, t))
 	{
-		return ret_sdo(sts);
+		rr_deinit_telemetry(&t);
+		return NULL;
 	}
+	t->thread_running = true;
+
+	return t;
 }
 
 /**
- * @brief The function commands all servos connected to the specified interface (CAN bus) 
- * to move simultaneously through a number of preset PVT points (see ::rr_add_motion_point).<br> 
- * <p><b>Note:</b> When any of the servos fails to reach any of the PVT points due to an error, it will broadcast
- * a "Go to Stopped State" command to all the other servos on the same bus. The servos will stop executing the preset PVT points and go to the stopped state.
- * In the state, only Heartbeats are available. You can neither communicate with servos nor command them to execute any operations.</p>
- * <p><b>Note:</b> Once servos execute the last PVT in their preset motion queue, the queue is cleared automatically.</p>
- * @param iface Interface descriptor returned by the ::rr_init_interface function
- * @param timestamp_ms Delay (in milliseconds) before the servos associated with the interface start to move. When the value is set to 0, the servos will start moving immediately.
- * The available value range is from 0 to 2^24-1.
+ * @brief The function stops the telemetry service (see ::rr_init_telemetry) and destroys it. 
+ * The parameters enabled in the servo caches by the subscriptions are left enabled.
+ * @param telemetry Pointer to the telemetry service descriptor, set to NULL on return
  * @return Status code (::rr_ret_status_t)
- * @ingroup Trajectory
+ * @ingroup Realtime
  */
-rr_ret_status_t rr_start_motion(rr_can_interface_t *iface, uint32_t timestamp_ms)
+rr_ret_status_t rr_deinit_telemetry(rr_telemetry_t **telemetry)
 {
-	IS_VALID_INTERFACE(iface);
+	if(!telemetry || !*telemetry)
+	{
+		return RET_BAD_INSTANCE;
+	}
+
+	rr_telemetry_t *t = *telemetry;
+
+	if(t->thread_running)
+	{
+		__atomic_store_n(&t->stop, true, __ATOMIC_RELEASE);
+		pthread_join(t->thread, NULL);
+	}
+	pthread_mutex_destroy(&t->mutex);
+	free(t->sub);
+	free(t);
+	*telemetry = NULL;
 
-	usbcan_instance_t *inst = (usbcan_instance_t *)iface->iface;
-	write_timestamp(inst, timestamp_ms);
 	return RET_OK;
 }
 
 /**
- * @brief The functions enables reading the total actual count of servo hardware errors (e.g., no Heartbeats/overcurrent, etc.).
- * In addition, the function returns the codes of all the detected errors as a single array. 
- * <p><b>Note</b>: The ::rr_ret_status_t codes returned by API functions only indicate that an error occured during communication between the user program and a servo.
- * If it is a hardware error, the ::rr_ret_status_t code will be ::RET_ERROR. Use ::rr_read_error_status to determine the cause of the error.</p>  
- * @param servo Servo Servo descriptor returned by the ::rr_init_servo function  
- * @param error_count Pointer to the variable where the function will save the current servo error count
- * @param error_array Pointer to the array where the function will save the codes of all errors. Default array size is ::ARRAY_ERROR_BITS_SIZE
- * <b>Note:</b> Call the ::rr_describe_emcy_bit function, to get a detailed error code description.
- * If the array is not used, set the parameter to 0.
+ * @brief The function subscribes to a servo parameter in the telemetry service (see ::rr_init_telemetry) 
+ * or changes the rate and priority of an existing subscription.
+ * <p>The parameter is enabled in the servo cache (see ::rr_param_cache_setup_entry), so that it can be read with the other parameters
+ * of the servo in a single transaction. The servos whose caches are streamed by TPDOs (see ::rr_param_cache_stream_enable) are not polled.</p>
+ * @param telemetry Telemetry service descriptor returned by the ::rr_init_telemetry function
+ * @param servo Servo descriptor returned by the ::rr_init_servo function
+ * @param param Index of the parameter (see ::rr_servo_param_t)
+ * @param rate_hz Requested rate (Hz)
+ * @param priority Priority, 0 is the highest one. The lower priorities are degraded first when the bus budget is exceeded
  * @return Status code (::rr_ret_status_t)
- * @ingroup Err
+ * @ingroup Realtime
  */
-rr_ret_status_t rr_read_error_status(const rr_servo_t *servo, uint32_t *const error_count, uint8_t *const error_array)
+rr_ret_status_t rr_telemetry_subscribe(rr_telemetry_t *telemetry, rr_servo_t *servo, rr_servo_param_t param, float rate_hz, int priority)
 {
+	if(!telemetry)
+	{
+		return RET_BAD_INSTANCE;
+	}
 	IS_VALID_SERVO(servo);
+	if((param < 0) || (param >= APP_PARAM_SIZE) || !(rate_hz > 0) || (priority < 0))
+	{
+		return RET_WRONG_ARG;
+	}
 
-	CHECK_NMT_STATE(servo);
+	rr_telemetry_t *t = telemetry;
+	rr_ret_status_t ret = RET_OK;
 
-	uint8_t array[32];
-	uint8_t *ptr = error_array == 0 ? array : error_array;
-	*error_count = 0;
+	bool own = false;
 
-	int size = sizeof(array); //? think about
-	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
-	uint32_t sts = read_raw_sdo(dev, 0x2000, 0, ptr, &size, 1, 200);
+	pthread_mutex_lock(&t->mutex);
 
-	if(sts == CO_SDO_AB_NONE)
+	int k = telemetry_find(t, servo, param);
+	if(k < 0)
 	{
-		for(int i = 0; i < size * 8; i++)
+		own = !servo->pcache[param].activated;
+
+		/*The cache entry is set up with a blocking SDO, so the scheduler is not held meanwhile*/
+		pthread_mutex_unlock(&t->mutex);
+		if(own && ((ret = rr_param_cache_setup_entry(servo, param, true)) != RET_OK))
 		{
-			if(ptr[i / 8] & (1 << (i % 8)))
+			servo->pcache[param].activated = false;
+			return ret;
+		}
+		pthread_mutex_lock(&t->mutex);
+
+		//the same parameter may have been subscribed to meanwhile
+		k = telemetry_find(t, servo, param);
+	}
+	if(k < 0)
+	{
+		if(t->n == t->cap)
+		{
+			int cap = t->cap ? 2 * t->cap : 16;
+			telemetry_sub_t *sub = (telemetry_sub_t *)realloc(t->sub, cap * sizeof(telemetry_sub_t));
+			if(!sub)
 			{
-				if(error_array)
+				pthread_mutex_unlock(&t->mutex);
+				if(own)
 				{
-					error_array[*error_count] = i;
+					rr_param_cache_setup_entry(servo, param, false);
 				}
-				*error_count += 1;
+				return RET_ERROR;
 			}
+			t->sub = sub;
+			t->cap = cap;
 		}
+		//start in phase with the next read of the servo, so that the reads can be packed
+		int64_t due = monotonic_us();
+		for(int j = 0; j < t->n; j++)
+		{
+			if(t->sub[j].servo == servo)
+			{
+				due = MIN(due, t->sub[j].due_us);
+			}
+		}
+		k = t->n++;
+		t->sub[k] = (telemetry_sub_t){.servo = servo, .param = param, .due_us = due, .since_us = monotonic_us(), .own_entry = own};
+	}
+	t->sub[k].priority = priority;
+	t->sub[k].period_us = 1e6 / rate_hz;
+	if(!t->sub[k].interval_us)
+	{
+		t->sub[k].interval_us = t->sub[k].period_us;
 	}
 
-	return ret_sdo(sts);
+	pthread_mutex_unlock(&t->mutex);
+
+	return ret;
 }
 
 /**
- * @brief The function is always used in combination with the ::rr_param_cache_setup_entry function. It retreives from the servo the array of parameters
- * that was set up using ::rr_param_cache_setup_entry function and saves the array to the program cache. You can subsequently read the parameters from the program
- * cache with the ::rr_read_cached_parameter function. For more information, see ::rr_param_cache_setup_entry.
- * <p><b>Note</b>: After you exit the program, the cache will be cleared.</p>
- * @param servo Servo descriptor returned by the ::rr_init_servo function 
+ * @brief The function cancels a subscription of the telemetry service (see ::rr_telemetry_subscribe).
+ * The parameter is disabled in the servo cache unless it had been enabled before the subscription.
+ * @param telemetry Telemetry service descriptor returned by the ::rr_init_telemetry function
+ * @param servo Servo descriptor returned by the ::rr_init_servo function
+ * @param param Index of the parameter (see ::rr_servo_param_t)
  * @return Status code (::rr_ret_status_t)
  * @ingroup Realtime
  */
-rr_ret_status_t rr_param_cache_update(rr_servo_t *servo)
+rr_ret_status_t rr_telemetry_unsubscribe(rr_telemetry_t *telemetry, rr_servo_t *servo, rr_servo_param_t param)
 {
+	if(!telemetry)
+	{
+		return RET_BAD_INSTANCE;
+	}
 	IS_VALID_SERVO(servo);
-	CHECK_NMT_STATE(servo);
 
-	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
-	uint8_t data[APP_PARAM_SIZE * sizeof(float)];
-	int len = sizeof(data);
-	int i, src;
+	rr_telemetry_t *t = telemetry;
+	rr_ret_status_t ret = RET_OK;
 
-	int sts = read_raw_sdo(dev, 0x2014, 0x01, data, &len, 1, 100);
+	pthread_mutex_lock(&t->mutex);
 
-	if(sts != 0)
+	int k = telemetry_find(t, servo, param);
+	if(k < 0)
 	{
-		return ret_sdo(sts);
+		pthread_mutex_unlock(&t->mutex);
+		return RET_WRONG_ARG;
 	}
 
-	for(i = 0, src = 0; i < APP_PARAM_SIZE; i++)
-	{
-		if(servo->pcache[i].activated)
-		{
-			usb_can_get_float(data + src, 0, (float *)&servo->pcache[i].value, 1);
-			servo->pcache[i].timestamp = RR_TIMESTAMP_INVALID;
-			src += sizeof(float);
-		}
-	}
+	bool own = t->sub[k].own_entry;
+	t->sub[k] = t->sub[--t->n];
 
-	if(src != len)
+	pthread_mutex_unlock(&t->mutex);
+
+	//the blocking SDO is sent once the subscription is removed from the scheduler
+	if(own)
 	{
-		return RET_SIZE_MISMATCH;
+		ret = rr_param_cache_setup_entry(servo, param, false);
 	}
 
-	return RET_OK;
+	return ret;
 }
 
 /**
- * @brief Same as ::rr_param_cache_update but with timestamp functionality.
- * @param servo Servo descriptor returned by the ::rr_init_servo function 
+ * @brief The function returns the effective rate of a subscription of the telemetry service (see ::rr_telemetry_subscribe), 
+ * i.e. the moving average of the read rate, which is lower than the requested one when the subscription is degraded.
+ * The time elapsed since the last read is taken into account, so the rate of a subscription that is not served at all decays towards zero.
+ * @param telemetry Telemetry service descriptor returned by the ::rr_init_telemetry function
+ * @param servo Servo descriptor returned by the ::rr_init_servo function
+ * @param param Index of the parameter (see ::rr_servo_param_t)
+ * @param rate_hz Pointer to the variable to receive the rate (Hz)
  * @return Status code (::rr_ret_status_t)
  * @ingroup Realtime
  */
-rr_ret_status_t rr_param_cache_update_with_timestamp(rr_servo_t *servo)
+rr_ret_status_t rr_telemetry_get_rate(rr_telemetry_t *telemetry, const rr_servo_t *servo, rr_servo_param_t param, float *rate_hz)
 {
-	IS_VALID_SERVO(servo);
-	CHECK_NMT_STATE(servo);
-
-	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
-	uint8_t data[APP_PARAM_SIZE * sizeof(float) + sizeof(uint32_t)];
-	int len = sizeof(data);
-	int i, src = 0;
-	uint32_t timestamp;
-
-	int sts = read_raw_sdo(dev, 0x2016, 0x01, data, &len, 1, 100);
-
-	if(sts != 0)
+	if(!telemetry)
 	{
-		return ret_sdo(sts);
+		return RET_BAD_INSTANCE;
 	}
-
-	if(len < sizeof(uint32_t))
+	if(!rate_hz)
 	{
-		return RET_SIZE_MISMATCH;
+		return RET_WRONG_ARG;
 	}
 
-	src = usb_can_get_uint32_t(data, src, &timestamp, 1);
+	pthread_mutex_lock(&telemetry->mutex);
 
-	if(sts == CO_SDO_AB_NONE)
+	int k = telemetry_find(telemetry, servo, param);
+	if(k >= 0)
 	{
-		for(i = 0; i < APP_PARAM_SIZE; i++)
-		{
-			if(servo->pcache[i].activated)
-			{
-				if((src + sizeof(float)) > len)
-				{
-					return RET_SIZE_MISMATCH;
-				}
-				src = usb_can_get_float(data, src, (float *)&servo->pcache[i].value, 1);
-				servo->pcache[i].timestamp = timestamp;
-			}
-		}
-		return RET_OK;
+		*rate_hz = telemetry->sub[k].interval_us > 0 ? 1e6f / telemetry->sub[k].interval_us : 0;
 	}
 
-	return ret_sdo(sts);
+	pthread_mutex_unlock(&telemetry->mutex);
+
+	return k >= 0 ? RET_OK : RET_WRONG_ARG;
 }
 
 /**
- * @brief The function is the fist one in the API call sequence that enables reading multiple servo paramaters (e.g., velocity, voltage,
- * and position) as a data array. Using the sequence is advisable when you need to read <b>more than one parameter at a time</b>.
- * The user can set up the array to include up to 50 parameters.
- * In all, the sequence comprises the following functions:
- * <ul> <li>::rr_param_cache_setup_entry for setting up an array of servo parameters to read</li>
- * <li>::rr_param_cache_update for retreiving the parameters from the servo and saving them to the program cache</li>
- * <li>::rr_read_cached_parameter for reading parameters from the program cache</li></ul>
- * Using the sequence of API calls allows for speeding up data acquisition by nearly two times.
- * Let's assume you need to read 49 parameters. At a bit rate of 1 MBit/s, reading them one by one will take about 35 ms, 
- * whereas reading them as an array will only take 10 ms.
- * <p><b>Note:</b> When you need to read a single parameter, it is better to use the ::rr_read_parameter function.</p>
- * @param servo Servo descriptor returned by the ::rr_init_servo function
- * @param param Index of the parameter to read as indicated in the ::rr_servo_param_t list (e.g., APP_PARAM_POSITION_ROTOR)
- * @param enabled Set True/False to enable/ disable the specified parameter for reading
+ * @brief The function returns the statistics of the telemetry service (see ::rr_init_telemetry).
+ * @param telemetry Telemetry service descriptor returned by the ::rr_init_telemetry function
+ * @param stats Pointer to the structure to receive the statistics
  * @return Status code (::rr_ret_status_t)
  * @ingroup Realtime
  */
-rr_ret_status_t rr_param_cache_setup_entry(rr_servo_t *servo, const rr_servo_param_t param, bool enabled)
+rr_ret_status_t rr_telemetry_get_stats(rr_telemetry_t *telemetry, rr_telemetry_stats_t *stats)
 {
-	IS_VALID_SERVO(servo);
-	CHECK_NMT_STATE(servo);
-
-	uint8_t array[10] = {0};
-	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
-
-	if((param < 0) || (param >= APP_PARAM_SIZE))
+	if(!telemetry)
 	{
-		return RET_WRONG_ARG;
+		return RET_BAD_INSTANCE;
 	}
-
-	servo->pcache[param].activated = enabled;
-
-	for(int i = 0; i < APP_PARAM_SIZE; i++)
+	if(!stats)
 	{
-		if(servo->pcache[i].activated)
-		{
-			BIT_SET_UINT_ARRAY(array, i);
-		}
+		return RET_WRONG_ARG;
 	}
 
-	uint32_t sts = write_raw_sdo(dev, 0x2015, 1, array, sizeof(array), 1, 200);
+	pthread_mutex_lock(&telemetry->mutex);
+	*stats = telemetry->stats;
+	pthread_mutex_unlock(&telemetry->mutex);
 
-	return ret_sdo(sts);
+	return RET_OK;
 }
 
 /**
@@ -2195,6 +6163,8 @@ rr_ret_status_t rr_param_cache_setup_entry(rr_servo_t *servo, const rr_servo_par
  * The function returns the current value of the parameter.
  * Additionally, the parameter is saved to the program cache, irrespective of whether 
  * it was enabled/ disabled with the ::rr_param_cache_setup_entry function.
+ * <p><b>Note:</b> When several threads read the same parameter of the same servo within the same millisecond, 
+ * only one SDO request is sent (see ::rr_read_parameter_coalesced).</p>
  * @param servo Servo descriptor returned by the ::rr_init_servo function
  * @param param Index of the parameter to read; you can find these indices in the ::rr_servo_param_t list (e.g., APP_PARAM_POSITION_ROTOR).
  * @param value Pointer to the variable where the function will save the reading
@@ -2202,6 +6172,23 @@ rr_ret_status_t rr_param_cache_setup_entry(rr_servo_t *servo, const rr_servo_par
  * @ingroup Realtime
  */
 rr_ret_status_t rr_read_parameter(rr_servo_t *servo, const rr_servo_param_t param, float *value)
+{
+	return rr_read_parameter_coalesced(servo, param, value, RR_API_COALESCE_AGE_MS);
+}
+
+/**
+ * @brief Same as ::rr_read_parameter, but with the caller-defined freshness bound.
+ * When several threads read the same parameter of the same servo simultaneously, only one SDO request is sent
+ * and all the callers get its result (see ::rr_read_raw_sdo_coalesced).
+ * @param servo Servo descriptor returned by the ::rr_init_servo function
+ * @param param Index of the parameter to read; you can find these indices in the ::rr_servo_param_t list (e.g., APP_PARAM_POSITION_ROTOR).
+ * @param value Pointer to the variable where the function will save the reading
+ * @param max_age_ms Maximum age (in milliseconds) of the reading shared with other callers. 
+ * When set to 0, only reads issued within the same millisecond are shared. When set to a negative value, the reading is never shared.
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Realtime
+ */
+rr_ret_status_t rr_read_parameter_coalesced(rr_servo_t *servo, const rr_servo_param_t param, float *value, int max_age_ms)
 {
 	IS_VALID_SERVO(servo);
 	CHECK_NMT_STATE(servo);
@@ -2215,7 +6202,7 @@ rr_ret_status_t rr_read_parameter(rr_servo_t *servo, const rr_servo_param_t para
 	usbcan_device_t *dev = (usbcan_device_t *)servo->dev;
 	int size = sizeof(data);
 
-	uint32_t sts = read_raw_sdo(dev, 0x2013, param, data, &size, 2, 100);
+	uint32_t sts = read_raw_sdo_coalesced(dev, 0x2013, param, data, &size, 2, 100, max_age_ms);
 
 	if(sts != CO_SDO_AB_NONE)
 	{
@@ -2260,7 +6247,7 @@ rr_ret_status_t rr_read_parameter_with_timestamp(rr_servo_t *servo, const rr_ser
 	int size = sizeof(data);
 	int src = 0;
 
-	uint32_t sts = read_raw_sdo(dev, 0x2017, param, data, &size, 2, 100);
+	uint32_t sts = read_raw_sdo_coalesced(dev, 0x2017, param, data, &size, 2, 100, RR_API_COALESCE_AGE_MS);
 
 	if(sts != CO_SDO_AB_NONE)
 	{
@@ -2567,6 +6554,13 @@ rr_ret_status_t rr_get_max_velocity(const rr_servo_t *servo, float *velocity_deg
 	if(sts == CO_SDO_AB_NONE)
 	{
 		usb_can_get_float(data, 0, velocity_deg_per_sec, 1);
+
+		rr_node_t *n = get_node(dev->inst, dev->id);
+		if(n)
+		{
+			__atomic_store(&n->max_velocity, velocity_deg_per_sec, __ATOMIC_RELAXED);
+			__atomic_store_n(&n->max_velocity_us, monotonic_us(), __ATOMIC_RELEASE);
+		}
 	}
 
 	return ret_sdo(sts);
@@ -2590,6 +6584,13 @@ rr_ret_status_t rr_set_max_velocity(const rr_servo_t *servo, const float max_vel
 	usb_can_put_float(data, 0, &max_velocity_deg_per_sec, 1);
 	uint32_t sts = write_raw_sdo(dev, 0x2300, 0x03, data, sizeof(data), 1, 100);
 
+	//the cached maximum velocity is re-read on the next request
+	rr_node_t *n = get_node(dev->inst, dev->id);
+	if(n)
+	{
+		__atomic_store_n(&n->max_velocity_us, 0, __ATOMIC_RELEASE);
+	}
+
 	return ret_sdo(sts);
 }
 
@@ -0,0 +1,1526 @@
+/**
+ * @brief Host-side model of the servo trajectory interpolator
+ *
+ * @file trajectory.c
+ * @author Rozum
+ * @date 2018-06-01
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "api.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+//! @cond Doxygen_Suppress
+/* Private define ------------------------------------------------------------*/
+#define TRJ_LANES 4
+#define TRJ_TIME_EPS 1e-9
+#define TRJ_CHECK_SAMPLES 16
+#define TRJ_CHECK_NEWTON 4
+#define TRJ_TIME_MAX_MS (UINT32_MAX / 10)
+#define TRJ_SCURVE_ITERATIONS 60
+#define TRJ_SCURVE_ATTEMPTS 12
+#define TRJ_SCURVE_DERATE 0.97
+#define TRJ_SCURVE_MIN_PHASE_MS 10
+#define TRJ_FIT_CHUNK 256
+#define TRJ_BLEND_MIN_MS 20
+#define TRJ_BLEND_MIN_PHASE_MS 10
+#define TRJ_BLEND_DERATE 0.95
+#define TRJ_BLEND_FLOAT_DERATE 0.999
+#define TRJ_BLEND_ATTEMPTS 100
+
+/*
+ * The evaluation kernel is written with GCC vector extensions, which compile to
+ * AVX/AVX2 or NEON when the target has them and to plain scalar code otherwise.
+ * On x86-64 Linux an AVX2 clone is dispatched at run time, so the library itself
+ * is still built for the baseline CPU.
+ */
+#if defined(__x86_64__) && defined(__linux__) && defined(__GNUC__) && !defined(__clang__)
+#define TRJ_SIMD_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define TRJ_SIMD_CLONES
+#endif
+
+/* Private typedef -----------------------------------------------------------*/
+typedef double trj_vec_t __attribute__((vector_size(TRJ_LANES * sizeof(double))));
+
+typedef struct
+{
+	double j;       //jerk
+	double dt;      //duration
+} trj_phase_t;
+
+struct rr_blend_t
+{
+	double vmax;    //velocity limit, derated by the error of the 'float' points
+	double am;      //mean acceleration of a zero end acceleration PVAT phase planned (2/3 of the limit, derated)
+	double ac;      //the one allowed (2/3 of the limit, derated as 'vmax')
+	double pos;     //state at the end of the last emitted segment
+	double vel;
+	int depth;
+	int n;          //number of pending segments, the k-th one leads to wp[k]
+	double *wp;
+	double *tol;
+	double *v;      //planned speed at wp[k]
+};
+
+/* Private functions ---------------------------------------------------------*/
+/*
+ * Quintic segment (debug-tools/trj_coeff.m)
+ */
+static void trj_coeff5(double *c, double pf, double vf, double af, double ps, double vs, double as, double dt)
+{
+	double dt2 = dt * dt;
+	double dt3 = dt2 * dt;
+
+	c[0] = ps;
+	c[1] = vs;
+	c[2] = as / 2;
+	c[3] = -(20 * ps - 20 * pf + 8 * dt * vf + 12 * dt * vs - af * dt2 + 3 * as * dt2) / (2 * dt3);
+	c[4] = (30 * ps - 30 * pf + 14 * dt * vf + 16 * dt * vs - 2 * af * dt2 + 3 * as * dt2) / (2 * dt3 * dt);
+	c[5] = -(12 * ps - 12 * pf + 6 * dt * vf + 6 * dt * vs - af * dt2 + as * dt2) / (2 * dt3 * dt2);
+}
+
+/*
+ * Cubic segment (debug-tools/trj_coeff3.m)
+ */
+static void trj_coeff3(double *c, double pf, double vf, double ps, double vs, double dt)
+{
+	c[0] = ps;
+	c[1] = vs;
+	c[2] = -(dt * vf + 2 * dt * vs - 3 * pf + 3 * ps) / (dt * dt);
+	c[3] = (dt * vf + dt * vs - 2 * pf + 2 * ps) / (dt * dt * dt);
+	c[4] = 0;
+	c[5] = 0;
+}
+
+static void trj_eval_scalar(const double *c, double t, float *pos, float *vel, float *acc)
+{
+	if(pos)
+	{
+		*pos = ((((c[5] * t + c[4]) * t + c[3]) * t + c[2]) * t + c[1]) * t + c[0];
+	}
+	if(vel)
+	{
+		*vel = (((5 * c[5] * t + 4 * c[4]) * t + 3 * c[3]) * t + 2 * c[2]) * t + c[1];
+	}
+	if(acc)
+	{
+		*acc = ((20 * c[5] * t + 12 * c[4]) * t + 6 * c[3]) * t + 2 * c[2];
+	}
+}
+
+/*
+ * Evaluates segment 'c' at 'm' samples t = t0 + k * step (Horner scheme, TRJ_LANES samples at once).
+ */
+TRJ_SIMD_CLONES
+static void trj_eval_grid(const double *c, double t0, double step, int m, float *pos, float *vel, float *acc)
+{
+	const trj_vec_t lane = {0, 1, 2, 3};
+	const trj_vec_t c0 = c[0] - (trj_vec_t){}, c1 = c[1] - (trj_vec_t){}, c2 = c[2] - (trj_vec_t){};
+	const trj_vec_t c3 = c[3] - (trj_vec_t){}, c4 = c[4] - (trj_vec_t){}, c5 = c[5] - (trj_vec_t){};
+	const trj_vec_t v2 = 2 * c2, v3 = 3 * c3, v4 = 4 * c4, v5 = 5 * c5;
+	const trj_vec_t a3 = 6 * c3, a4 = 12 * c4, a5 = 20 * c5;
+
+	for(int k = 0; k < m; k += TRJ_LANES)
+	{
+		trj_vec_t t = t0 + (k + lane) * step;
+		trj_vec_t p = ((((c5 * t + c4) * t + c3) * t + c2) * t + c1) * t + c0;
+		trj_vec_t v = (((v5 * t + v4) * t + v3) * t + v2) * t + c1;
+		trj_vec_t a = ((a5 * t + a4) * t + a3) * t + v2;
+		int l = m - k < TRJ_LANES ? m - k : TRJ_LANES;
+
+		for(int i = 0; i < l; i++)
+		{
+			if(pos)
+			{
+				pos[k + i] = p[i];
+			}
+			if(vel)
+			{
+				vel[k + i] = v[i];
+			}
+			if(acc)
+			{
+				acc[k + i] = a[i];
+			}
+		}
+	}
+}
+
+/*
+ * Peak absolute velocity, acceleration and jerk of segment 'c' over [0, T].
+ * The segment is sampled on a coarse grid (vectorized), then the velocity peak is refined
+ * by Newton iterations on a(t) = 0, the acceleration extrema are found from the roots of the jerk polynomial
+ * and the jerk extremum from the vertex of the jerk parabola.
+ */
+TRJ_SIMD_CLONES
+static void trj_segment_peaks(const double *c, double T, double *vmax, double *amax, double *jmax)
+{
+	const trj_vec_t lane = {0, 1, 2, 3};
+	const trj_vec_t c1 = c[1] - (trj_vec_t){}, v2 = 2 * c[2] - (trj_vec_t){}, v3 = 3 * c[3] - (trj_vec_t){};
+	const trj_vec_t v4 = 4 * c[4] - (trj_vec_t){}, v5 = 5 * c[5] - (trj_vec_t){};
+	const trj_vec_t a3 = 6 * c[3] - (trj_vec_t){}, a4 = 12 * c[4] - (trj_vec_t){}, a5 = 20 * c[5] - (trj_vec_t){};
+	const double step = T / TRJ_CHECK_SAMPLES;
+	double v[TRJ_CHECK_SAMPLES + TRJ_LANES], a[TRJ_CHECK_SAMPLES + TRJ_LANES];
+
+	for(int k = 0; k <= TRJ_CHECK_SAMPLES; k += TRJ_LANES)
+	{
+		trj_vec_t t = (k + lane) * step;
+		trj_vec_t vv = (((v5 * t + v4) * t + v3) * t + v2) * t + c1;
+		trj_vec_t av = ((a5 * t + a4) * t + a3) * t + v2;
+
+		memcpy(&v[k], &vv, sizeof(vv));
+		memcpy(&a[k], &av, sizeof(av));
+	}
+
+	int best = 0;
+	double vm = 0, am = 0;
+
+	for(int k = 0; k <= TRJ_CHECK_SAMPLES; k++)
+	{
+		if(fabs(v[k]) > vm)
+		{
+			vm = fabs(v[k]);
+			best = k;
+		}
+		am = fmax(am, fabs(a[k]));
+	}
+
+	double t = best * step;
+
+	for(int i = 0; i < TRJ_CHECK_NEWTON; i++)
+	{
+		double acc = ((20 * c[5] * t + 12 * c[4]) * t + 6 * c[3]) * t + 2 * c[2];
+		double jerk = (60 * c[5] * t + 24 * c[4]) * t + 6 * c[3];
+
+		if(jerk == 0)
+		{
+			break;
+		}
+		t = fmin(fmax(t - acc / jerk, 0), T);
+	}
+	vm = fmax(vm, fabs((((5 * c[5] * t + 4 * c[4]) * t + 3 * c[3]) * t + 2 * c[2]) * t + c[1]));
+
+	//jerk roots: 60 * c5 * t^2 + 24 * c4 * t + 6 * c3 = 0
+	double qa = 60 * c[5], qb = 24 * c[4], qc = 6 * c[3];
+	double r[2];
+	int nr = 0;
+
+	if(qa != 0)
+	{
+		double d = qb * qb - 4 * qa * qc;
+		if(d >= 0)
+		{
+			d = sqrt(d);
+			r[nr++] = (-qb + d) / (2 * qa);
+			r[nr++] = (-qb - d) / (2 * qa);
+		}
+	}
+	else if(qb != 0)
+	{
+		r[nr++] = -qc / qb;
+	}
+	for(int i = 0; i < nr; i++)
+	{
+		if((r[i] > 0) && (r[i] < T))
+		{
+			am = fmax(am, fabs(((20 * c[5] * r[i] + 12 * c[4]) * r[i] + 6 * c[3]) * r[i] + 2 * c[2]));
+		}
+	}
+
+	//jerk is a parabola: extrema at the ends or at the vertex
+	double jm = fmax(fabs(qc), fabs((qa * T + qb) * T + qc));
+
+	if((qa != 0) && (-qb / (2 * qa) > 0) && (-qb / (2 * qa) < T))
+	{
+		jm = fmax(jm, fabs(qc - qb * qb / (4 * qa)));
+	}
+
+	*vmax = vm;
+	*amax = am;
+	*jmax = jm;
+}
+
+/*
+ * Checks 'value' against 'limit' (zero limit is not checked)
+ */
+static bool trj_exceeds(double value, float limit)
+{
+	return (limit != 0) && (value > fabs(limit));
+}
+
+/*
+ * Checks the quintic segment from 's' to 'e' of 'time_ms' duration against the limits.
+ */
+static bool trj_segment_feasible(const rr_motion_point_t *s, const rr_motion_point_t *e, uint32_t time_ms, const rr_trj_limits_t *l)
+{
+	double c[6], vm, am, jm;
+
+	trj_coeff5(c, e->position_deg, e->velocity_deg_per_sec, e->accel_deg_per_sec2,
+			s->position_deg, s->velocity_deg_per_sec, s->accel_deg_per_sec2, time_ms / 1000.0);
+	trj_segment_peaks(c, time_ms / 1000.0, &vm, &am, &jm);
+
+	return !trj_exceeds(vm, l->velocity_deg_per_sec) && !trj_exceeds(am, l->accel_deg_per_sec2) && !trj_exceeds(jm, l->jerk_deg_per_sec3);
+}
+
+/*
+ * Shortest duration (ms) of a feasible segment: doubling, then bisection. 0 - no feasible duration.
+ */
+static uint32_t trj_segment_time(const rr_motion_point_t *s, const rr_motion_point_t *e, const rr_trj_limits_t *l)
+{
+	uint32_t lo = 0, hi = 1;
+
+	while(!trj_segment_feasible(s, e, hi, l))
+	{
+		if(hi >= TRJ_TIME_MAX_MS)
+		{
+			return 0;
+		}
+		lo = hi;
+		hi = hi > TRJ_TIME_MAX_MS / 2 ? TRJ_TIME_MAX_MS : hi * 2;
+	}
+	while(hi - lo > 1)
+	{
+		uint32_t mid = lo + (hi - lo) / 2;
+		if(trj_segment_feasible(s, e, mid, l))
+		{
+			hi = mid;
+		}
+		else
+		{
+			lo = mid;
+		}
+	}
+
+	return hi;
+}
+
+/*
+ * Maximum position error of segment 'c' against samples pos[k] at t = k * step, k = 0..m-1 (vectorized).
+ */
+TRJ_SIMD_CLONES
+static double trj_fit_error(const double *c, double step, const float *pos, int m)
+{
+	const trj_vec_t lane = {0, 1, 2, 3};
+	const trj_vec_t c0 = c[0] - (trj_vec_t){}, c1 = c[1] - (trj_vec_t){}, c2 = c[2] - (trj_vec_t){};
+	const trj_vec_t c3 = c[3] - (trj_vec_t){}, c4 = c[4] - (trj_vec_t){}, c5 = c[5] - (trj_vec_t){};
+	trj_vec_t err = {0, 0, 0, 0};
+	int k = 0;
+
+	for(; k + TRJ_LANES <= m; k += TRJ_LANES)
+	{
+		trj_vec_t t = (k + lane) * step;
+		trj_vec_t p = ((((c5 * t + c4) * t + c3) * t + c2) * t + c1) * t + c0;
+		trj_vec_t s = {pos[k], pos[k + 1], pos[k + 2], pos[k + 3]};
+		trj_vec_t d = p - s;
+		trj_vec_t e = d * d;
+
+		err = (trj_vec_t){fmax(err[0], e[0]), fmax(err[1], e[1]), fmax(err[2], e[2]), fmax(err[3], e[3])};
+	}
+
+	double e = fmax(fmax(err[0], err[1]), fmax(err[2], err[3]));
+
+	for(; k < m; k++)
+	{
+		double t = k * step;
+		double d = ((((c[5] * t + c[4]) * t + c[3]) * t + c[2]) * t + c[1]) * t + c[0] - pos[k];
+		e = fmax(e, d * d);
+	}
+
+	return sqrt(e);
+}
+
+/*
+ * Checks the quintic segment between samples 'i' and 'j' against the samples in between.
+ */
+static bool trj_fit_segment(const float *pos, const double *vel, const double *acc, int i, int j, double step, double tol, double *c)
+{
+	trj_coeff5(c, pos[j], vel[j], acc[j], pos[i], vel[i], acc[i], (j - i) * step);
+
+	for(int k = i + 1; k < j; k += TRJ_FIT_CHUNK)
+	{
+		int m = j - k < TRJ_FIT_CHUNK ? j - k : TRJ_FIT_CHUNK;
+		double cs[6];
+
+		//re-centre the polynomial at sample 'k' to keep 't' small
+		double t0 = (k - i) * step;
+		cs[0] = ((((c[5] * t0 + c[4]) * t0 + c[3]) * t0 + c[2]) * t0 + c[1]) * t0 + c[0];
+		cs[1] = (((5 * c[5] * t0 + 4 * c[4]) * t0 + 3 * c[3]) * t0 + 2 * c[2]) * t0 + c[1];
+		cs[2] = ((10 * c[5] * t0 + 6 * c[4]) * t0 + 3 * c[3]) * t0 + c[2];
+		cs[3] = (10 * c[5] * t0 + 4 * c[4]) * t0 + c[3];
+		cs[4] = 5 * c[5] * t0 + c[4];
+		cs[5] = c[5];
+		if(trj_fit_error(cs, step, pos + k, m) > tol)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * S-curve planner: constant jerk phases
+ */
+static void scurve_advance(double *p, double *v, double *a, const trj_phase_t *ph, double dt)
+{
+	*p += (*v + (*a / 2 + ph->j * dt / 6) * dt) * dt;
+	*v += (*a + ph->j * dt / 2) * dt;
+	*a += ph->j * dt;
+}
+
+/*
+ * Time-optimal change of velocity from (v0, a0) to (v1, 0) with |a| <= am, |j| <= jm: 
+ * jerk phase, constant acceleration phase, jerk phase. Returns the number of phases added.
+ */
+static int scurve_vel_change(trj_phase_t *ph, double v0, double a0, double v1, double am, double jm)
+{
+	//direction: velocity reached when the acceleration is removed at once
+	double s = (v1 >= v0 + a0 * fabs(a0) / (2 * jm)) ? 1 : -1;
+	double ap = s * sqrt(fmax(s * jm * (v1 - v0) + a0 * a0 / 2, 0));
+	double hold = 0;
+
+	if(fabs(ap) > am)
+	{
+		ap = s * am;
+		double j1 = (ap >= a0 ? 1 : -1) * jm;
+		hold = fmax(((v1 - v0) - (ap * ap - a0 * a0) / (2 * j1) - ap * ap / (2 * s * jm)) / ap, 0);
+	}
+
+	ph[0] = (trj_phase_t){.j = (ap >= a0 ? 1 : -1) * jm, .dt = fabs(ap - a0) / jm};
+	ph[1] = (trj_phase_t){.j = 0, .dt = hold};
+	ph[2] = (trj_phase_t){.j = -s * jm, .dt = fabs(ap) / jm};
+
+	return 3;
+}
+
+/*
+ * Builds the profile through the peak velocity 'vp' with 'cruise' seconds at it. Returns the travelled distance.
+ */
+static double scurve_build(trj_phase_t *ph, double v0, double a0, double vp, double cruise, const rr_trj_limits_t *l)
+{
+	double am = fabs(l->accel_deg_per_sec2), jm = fabs(l->jerk_deg_per_sec3);
+	double p = 0, v = v0, a = a0;
+
+	scurve_vel_change(ph, v0, a0, vp, am, jm);
+	ph[3] = (trj_phase_t){.j = 0, .dt = cruise};
+	scurve_vel_change(ph + 4, vp, 0, 0, am, jm);
+	for(int k = 0; k < RR_SCURVE_MAX_POINTS; k++)
+	{
+		scurve_advance(&p, &v, &a, &ph[k], ph[k].dt);
+	}
+
+	return p;
+}
+
+/*
+ * Time-optimal profile from (v0, a0) to a stop after 'dist': cruise at the velocity limit or bisect the peak velocity
+ */
+static void scurve_plan(trj_phase_t *ph, double v0, double a0, double dist, const rr_trj_limits_t *l)
+{
+	double vm = fabs(l->velocity_deg_per_sec);
+	double d_hi = scurve_build(ph, v0, a0, vm, 0, l);
+	double d_lo = scurve_build(ph, v0, a0, -vm, 0, l);
+
+	if(dist >= d_hi)
+	{
+		scurve_build(ph, v0, a0, vm, (dist - d_hi) / vm, l);
+	}
+	else if(dist <= d_lo)
+	{
+		scurve_build(ph, v0, a0, -vm, (d_lo - dist) / vm, l);
+	}
+	else
+	{
+		double lo = -vm, hi = vm;
+
+		for(int k = 0; k < TRJ_SCURVE_ITERATIONS; k++)
+		{
+			double mid = (lo + hi) / 2;
+			if(scurve_build(ph, v0, a0, mid, 0, l) < dist)
+			{
+				lo = mid;
+			}
+			else
+			{
+				hi = mid;
+			}
+		}
+		scurve_build(ph, v0, a0, (lo + hi) / 2, 0, l);
+	}
+}
+
+/*
+ * Gaussian elimination with partial pivoting of the n x (n + 1) augmented matrix 'm'
+ */
+static bool trj_solve(double m[][5], double *x, int n)
+{
+	for(int c = 0; c < n; c++)
+	{
+		int p = c;
+		for(int r = c + 1; r < n; r++)
+		{
+			p = fabs(m[r][c]) > fabs(m[p][c]) ? r : p;
+		}
+		if(fabs(m[p][c]) < TRJ_TIME_EPS)
+		{
+			return false;
+		}
+		for(int k = 0; k <= n; k++)
+		{
+			double tmp = m[c][k];
+			m[c][k] = m[p][k];
+			m[p][k] = tmp;
+		}
+		for(int r = c + 1; r < n; r++)
+		{
+			double f = m[r][c] / m[c][c];
+			for(int k = c; k <= n; k++)
+			{
+				m[r][k] -= f * m[c][k];
+			}
+		}
+	}
+	for(int c = n - 1; c >= 0; c--)
+	{
+		x[c] = m[c][n];
+		for(int k = c + 1; k < n; k++)
+		{
+			x[c] -= m[c][k] * x[k];
+		}
+		x[c] /= m[c][c];
+	}
+
+	return true;
+}
+
+/*
+ * Snaps the phases to the ms grid and re-solves the jerks of phases 0, 2, 4 and 6, so that the acceleration is zero 
+ * at the cruise and the profile still stops at 'dist'. The servo interpolates a constant jerk phase exactly, 
+ * so the PVAT points at the phase boundaries reproduce the profile. The phase times are rounded up and the short phases 
+ * are avoided ('float' points can't represent them accurately): the jerk phases last at least TRJ_SCURVE_MIN_PHASE_MS, 
+ * a shorter constant acceleration or cruise phase is added to both its neighbours instead.
+ */
+static bool scurve_snap(trj_phase_t *ph, double v0, double a0, double dist)
+{
+	static const int jp[4] = {0, 2, 4, 6};
+	double end = 0, m[4][5];
+
+	for(int k = 1; k < RR_SCURVE_MAX_POINTS; k += 2)
+	{
+		if(ph[k].dt * 1000 < TRJ_SCURVE_MIN_PHASE_MS)
+		{
+			ph[k - 1].dt += ph[k].dt;
+			ph[k + 1].dt += ph[k].dt;
+			ph[k].dt = 0;
+		}
+	}
+	for(int k = 0; k < RR_SCURVE_MAX_POINTS; k++)
+	{
+		double ms = ceil(ph[k].dt * 1000 - TRJ_TIME_EPS * 1000);
+		ph[k].dt = ((k % 2 == 0) && (ms < TRJ_SCURVE_MIN_PHASE_MS) ? TRJ_SCURVE_MIN_PHASE_MS : ms) / 1000.0;
+		end += ph[k].dt;
+	}
+
+	//rows: acceleration at the cruise, final acceleration, velocity and position; columns: unit jerk of each jerk phase
+	double t = 0;
+
+	for(int k = 0, c = 0; k < RR_SCURVE_MAX_POINTS; t += ph[k].dt, k++)
+	{
+		if((c == 4) || (k != jp[c]))
+		{
+			continue;
+		}
+
+		double T = ph[k].dt, R = end - t - T;
+
+		m[0][c] = k < 3 ? T : 0;
+		m[1][c] = T;
+		m[2][c] = T * T / 2 + T * R;
+		m[3][c] = T * T * T / 6 + T * T * R / 2 + T * R * R / 2;
+		c++;
+	}
+	m[0][4] = -a0;
+	m[1][4] = -a0;
+	m[2][4] = -(v0 + a0 * end);
+	m[3][4] = dist - (v0 * end + a0 * end * end / 2);
+
+	double j[4];
+	if(!trj_solve(m, j, 4))
+	{
+		return false;
+	}
+	for(int c = 0; c < 4; c++)
+	{
+		ph[jp[c]].j = j[c];
+	}
+	ph[1].j = ph[3].j = ph[5].j = 0;
+
+	return true;
+}
+
+static double trj_duration(const rr_trj_segment_t *seg, int n)
+{
+	return n > 0 ? seg[n - 1].t0 + seg[n - 1].duration : 0;
+}
+
+/*
+ * Motion blending: look-ahead speed planning over the pending segments
+ */
+static double blend_from(const rr_blend_t *b, int k)
+{
+	return k > 0 ? b->wp[k - 1] : b->pos;
+}
+
+static double blend_dir(const rr_blend_t *b, int k)
+{
+	return b->wp[k] > blend_from(b, k) ? 1.0 : -1.0;
+}
+
+static void blend_replan(rr_blend_t *b)
+{
+	//backward pass: stop at the last known waypoint, direction reversals are passed at rest
+	b->v[b->n - 1] = 0;
+	for(int k = b->n - 2; k >= 0; k--)
+	{
+		double cap = blend_dir(b, k) == blend_dir(b, k + 1) ? b->vmax : 0;
+		double v = sqrt(b->v[k + 1] * b->v[k + 1] + 2.0 * b->am * fabs(b->wp[k + 1] - b->wp[k]));
+
+		b->v[k] = v < cap ? v : cap;
+	}
+
+	//forward pass from the frozen state
+	double prev = fabs(b->vel);
+	for(int k = 0; k < b->n; k++)
+	{
+		double v = sqrt(prev * prev + 2.0 * b->am * fabs(b->wp[k] - blend_from(b, k)));
+
+		b->v[k] = b->v[k] < v ? b->v[k] : v;
+		prev = b->v[k];
+	}
+}
+
+/*
+ * The speed at the inner points of a blended segment (or at the end of a single phase) 
+ * for the given phase times, such that the segment is 'len' long: len = kx * x + k0.
+ */
+static double blend_speed(double len, double vs, double ve, const double *t, int cnt, double *kx)
+{
+	int l = cnt - 1;
+	double k0 = vs * t[0] / 2.0 + (l ? ve * t[l] / 2.0 : 0);
+
+	*kx = l ? 0 : t[0] / 2.0;
+	for(int j = 0; j < l; j++)
+	{
+		*kx += (t[j] + t[j + 1]) / 2.0;
+	}
+
+	return (len - k0) / *kx;
+}
+
+/*
+ * PVAT points of a blended segment from 'from' to 'to': acceleration, cruise and deceleration phases with zero acceleration at the points,
+ * with the short phases merged and the phase times rounded up to ms. The distance of each phase matches the quintic interpolation, 
+ * so its peak acceleration is 1.5 times the mean one. The speeds are recomputed for the rounded times to end exactly at 'to'; 
+ * when that breaks the limits, a segment passed without stopping keeps the planned speeds and its end point absorbs the rounding. 
+ * 'end' receives the end point, the end speed is that of the last point.
+ */
+static int blend_segment(const rr_blend_t *b, double from, double to, double vs, double ve, rr_motion_point_t *pt, double *end)
+{
+	double dir = to > from ? 1.0 : -1.0;
+	double len = fabs(to - from);
+
+	if(len == 0)
+	{
+		*end = to;
+		return 0;
+	}
+
+	//the rounding of the previous segments may leave less room than planned for the speed change
+	double am = fabs(vs * vs - ve * ve) / (2.0 * len);
+	am = am > b->am ? am : b->am;
+
+	double vp = sqrt((2.0 * am * len + vs * vs + ve * ve) / 2.0);
+
+	vp = vp < b->vmax ? vp : b->vmax;
+	vp = vp > vs ? vp : vs;
+	vp = vp > ve ? vp : ve;
+
+	double dc = len - (2.0 * vp * vp - vs * vs - ve * ve) / (2.0 * am);
+	double d[3] = {(vp - vs) / am, dc > 0 ? dc / vp : 0, (vp - ve) / am};
+	double v[3] = {vp, vp, ve};
+	int np = 3;
+
+	//merge the short phases into the shorter neighbour: the time grid and 'float' positions can't represent them accurately
+	for(int i = 0; (i < np) && (np > 1);)
+	{
+		if(d[i] * 1000.0 >= TRJ_BLEND_MIN_PHASE_MS)
+		{
+			i++;
+			continue;
+		}
+
+		int j = (i == 0) || ((i < np - 1) && (d[i + 1] < d[i - 1])) ? i : i - 1;
+		d[j] += d[j + 1];
+		v[j] = v[j + 1];
+		for(int q = j + 1; q < np - 1; q++)
+		{
+			d[q] = d[q + 1];
+			v[q] = v[q + 1];
+		}
+		np--;
+		i = 0;
+	}
+
+	//phase times rounded up to ms: with the planned speeds, the mean acceleration of a phase stays within the planned one
+	double dt[4], w[4];
+	int cnt = 0;
+
+	for(int i = 0; i < np; i++)
+	{
+		double t_ms = ceil(1000.0 * d[i] - 1e-6);
+		if(t_ms >= 1)
+		{
+			dt[cnt] = t_ms / 1000.0;
+			w[cnt] = v[i];
+			cnt++;
+		}
+		else if(cnt)
+		{
+			w[cnt - 1] = v[i];
+		}
+	}
+	if(!cnt)
+	{
+		dt[0] = 0.001;
+		cnt = 1;
+	}
+	w[cnt - 1] = ve;
+
+	if((ve == 0) && (cnt == 1) && (dt[0] >= 0.002))
+	{
+		//a single stopping phase can't end exactly at 'to' on the ms grid, split it to free the speed in between
+		dt[1] = 0.001 * floor(dt[0] * 500.0 + 0.5);
+		dt[0] -= dt[1];
+		w[0] = w[1] = 0;
+		cnt = 2;
+	}
+
+	//the speed 'x' is recomputed for the rounded times to end exactly at 'to': 
+	//the phase too short for the speed change it gets is stretched, or its neighbour shortened, by 1 ms
+	double t[4], x = 0;
+	bool exact = false;
+
+	memcpy(t, dt, sizeof(t));
+	for(int attempt = 0; (attempt < TRJ_BLEND_ATTEMPTS) && !exact; attempt++)
+	{
+		int l = cnt - 1;
+		double kx;
+
+		x = blend_speed(len, vs, ve, t, cnt, &kx);
+		if(!(x >= 0))
+		{
+			break;
+		}
+
+		double xe = l ? ve : x;
+		if((x - vs > b->ac * t[0]) || (x > ve && !l))
+		{
+			t[0] += 0.001;
+		}
+		else if(vs - x > b->ac * t[0])
+		{
+			//too slow: shorten the last phase, or move 1 ms of it to the first one when that's too short then
+			if(!l || (t[l] < 0.0015))
+			{
+				break;
+			}
+			t[l] -= 0.001;
+			if(blend_speed(len, vs, ve, t, cnt, &kx) - ve > b->ac * t[l])
+			{
+				t[0] += 0.001;
+			}
+		}
+		else if(x - xe > b->ac * t[l])
+		{
+			t[l] += 0.001;
+		}
+		else if(xe - x > b->ac * t[l])
+		{
+			if(t[0] < 0.0015)
+			{
+				break;
+			}
+			t[0] -= 0.001;
+			if(vs - blend_speed(len, vs, ve, t, cnt, &kx) > b->ac * t[0])
+			{
+				t[l] += 0.001;
+			}
+		}
+		else if(x > b->vmax)
+		{
+			//stretch the cruise (or the last phase) by the time the excess distance takes
+			double dt_ms = l > 1 ? 1000.0 * kx * (x - b->vmax) / b->vmax : 2000.0 * kx * (x - b->vmax) / (b->vmax + ve);
+			t[l > 1 ? 1 : l] += 0.001 * ceil(dt_ms);
+		}
+		else
+		{
+			exact = true;
+		}
+	}
+	if(exact || (ve == 0))
+	{
+		//a stop that can't be made exact keeps the last attempt
+		x = x > 0 ? x : 0;
+		memcpy(dt, t, sizeof(t));
+		for(int j = 0; j < cnt - 1; j++)
+		{
+			w[j] = x;
+		}
+		w[cnt - 1] = cnt > 1 ? ve : x;
+	}
+
+	for(int j = 0; j < cnt; j++)
+	{
+		pt[j].velocity_deg_per_sec = w[j];
+	}
+
+	double pos = from, v0 = vs;
+	for(int j = 0; j < cnt; j++)
+	{
+		double v1 = pt[j].velocity_deg_per_sec;
+
+		pos += dir * (v0 + v1) / 2.0 * dt[j];
+		pt[j].time_ms = lround(1000.0 * dt[j]);
+		pt[j].position_deg = pos;
+		pt[j].velocity_deg_per_sec = dir * v1;
+		pt[j].accel_deg_per_sec2 = 0;
+		v0 = v1;
+	}
+	if(exact || (ve == 0))
+	{
+		pt[cnt - 1].position_deg = to;
+	}
+	*end = pt[cnt - 1].position_deg;
+
+	return cnt;
+}
+//! @endcond
+
+/**
+ * @brief The function computes the polynomial segments the servo interpolates between trajectory points
+ * (the host-side model of the servo interpolator, see debug-tools/qupsample.m).
+ * PVAT points are connected by quintic polynomials, PVT points by cubic polynomials.
+ * <p>The segment polynomials take time in seconds from the segment start and return position in degrees.</p>
+ * @param start Initial point of the trajectory (the 'time_ms' field is ignored)
+ * @param points Array of trajectory points (see ::rr_add_motion_point and ::rr_add_motion_point_pvat)
+ * @param n Number of points in the 'points' array
+ * @param pvat Set to 'true' for PVAT points, 'false' for PVT points (the acceleration is ignored)
+ * @param segments Array of 'n' segments to receive the result: the 'k'-th segment leads to the 'k'-th point.
+ * Zero duration segments have zero coefficients
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Trajectory
+ */
+rr_ret_status_t rr_trj_compile(const rr_motion_point_t *start, const rr_motion_point_t *points, int n, bool pvat, rr_trj_segment_t *segments)
+{
+	if(!start || !points || !segments || (n < 0))
+	{
+		return RET_WRONG_ARG;
+	}
+
+	const rr_motion_point_t *prev = start;
+	double t0 = 0;
+
+	for(int k = 0; k < n; k++)
+	{
+		const rr_motion_point_t *pt = &points[k];
+		rr_trj_segment_t *s = &segments[k];
+		double dt = pt->time_ms / 1000.0;
+
+		s->t0 = t0;
+		s->duration = dt;
+		if(pt->time_ms == 0)
+		{
+			memset(s->c, 0, sizeof(s->c));
+		}
+		else if(pvat)
+		{
+			trj_coeff5(s->c, pt->position_deg, pt->velocity_deg_per_sec, pt->accel_deg_per_sec2,
+					prev->position_deg, prev->velocity_deg_per_sec, prev->accel_deg_per_sec2, dt);
+		}
+		else
+		{
+			trj_coeff3(s->c, pt->position_deg, pt->velocity_deg_per_sec, prev->position_deg, prev->velocity_deg_per_sec, dt);
+		}
+		t0 += dt;
+		prev = pt;
+	}
+
+	return RET_OK;
+}
+
+/**
+ * @brief The function returns the number of samples ::rr_trj_sample produces for a trajectory.
+ * @param segments Trajectory segments computed by ::rr_trj_compile
+ * @param n Number of segments
+ * @param step_s Sampling period (s)
+ * @return Number of samples (0 - wrong arguments)
+ * @ingroup Trajectory
+ */
+int rr_trj_sample_count(const rr_trj_segment_t *segments, int n, double step_s)
+{
+	if(!segments || (n <= 0) || !(step_s > 0))
+	{
+		return 0;
+	}
+
+	return (int)floor(trj_duration(segments, n) / step_s + TRJ_TIME_EPS) + 1;
+}
+
+/**
+ * @brief The function evaluates position, velocity and acceleration of a trajectory on a uniform time grid
+ * t = k * step_s, k = 0, 1, ..., from the start to the end of the trajectory (see ::rr_trj_sample_count).
+ * <p>A sample at the boundary of two segments is taken from the later one, the last sample is taken from the last segment.</p>
+ * @param segments Trajectory segments computed by ::rr_trj_compile
+ * @param n Number of segments
+ * @param step_s Sampling period (s)
+ * @param pos Array to receive positions (degrees) or NULL
+ * @param vel Array to receive velocities (degrees per second) or NULL
+ * @param acc Array to receive accelerations (degrees per second^2) or NULL
+ * @param max Capacity of the arrays (samples)
+ * @return Number of samples written (negative - wrong arguments)
+ * @ingroup Trajectory
+ */
+int rr_trj_sample(const rr_trj_segment_t *segments, int n, double step_s, float *pos, float *vel, float *acc, int max)
+{
+	int total = rr_trj_sample_count(segments, n, step_s);
+
+	if(!total || (max < 0))
+	{
+		return -1;
+	}
+	total = total < max ? total : max;
+
+	int j = 0, last = n - 1;
+
+	//trailing zero duration segments have no polynomial
+	while((last > 0) && (segments[last].duration == 0))
+	{
+		last--;
+	}
+
+	for(int k = 0; (k <= last) && (j < total); k++)
+	{
+		const rr_trj_segment_t *s = &segments[k];
+		int end = total;
+
+		if(k < last)
+		{
+			//first sample index of the next segment
+			end = (int)ceil((s->t0 + s->duration) / step_s - TRJ_TIME_EPS);
+			end = end < total ? end : total;
+		}
+		if(end <= j)
+		{
+			continue;
+		}
+		trj_eval_grid(s->c, j * step_s - s->t0, step_s, end - j,
+				pos ? pos + j : NULL, vel ? vel + j : NULL, acc ? acc + j : NULL);
+		j = end;
+	}
+
+	return j;
+}
+
+/**
+ * @brief The function evaluates position, velocity and acceleration of a trajectory at a given time.
+ * @param segments Trajectory segments computed by ::rr_trj_compile
+ * @param n Number of segments
+ * @param t_s Time from the trajectory start (s). It is clamped to the trajectory duration
+ * @param pos Pointer to the variable to receive the position (degrees) or NULL
+ * @param vel Pointer to the variable to receive the velocity (degrees per second) or NULL
+ * @param acc Pointer to the variable to receive the acceleration (degrees per second^2) or NULL
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Trajectory
+ */
+rr_ret_status_t rr_trj_eval(const rr_trj_segment_t *segments, int n, double t_s, float *pos, float *vel, float *acc)
+{
+	if(!segments || (n <= 0))
+	{
+		return RET_WRONG_ARG;
+	}
+
+	double end = trj_duration(segments, n);
+	int lo = 0, hi = n - 1;
+
+	t_s = t_s < 0 ? 0 : (t_s > end ? end : t_s);
+
+	//last segment starting at or before 't_s'
+	while(lo < hi)
+	{
+		int mid = (lo + hi + 1) / 2;
+		if(segments[mid].t0 <= t_s)
+		{
+			lo = mid;
+		}
+		else
+		{
+			hi = mid - 1;
+		}
+	}
+	//a trailing zero duration segment has no polynomial
+	while((lo > 0) && (segments[lo].duration == 0))
+	{
+		lo--;
+	}
+
+	trj_eval_scalar(segments[lo].c, t_s - segments[lo].t0, pos, vel, acc);
+
+	return RET_OK;
+}
+
+/**
+ * @brief The function validates a whole PVT or PVAT trajectory against velocity and acceleration limits on the host,
+ * before the points are uploaded to the servo (see ::rr_add_motion_points).
+ * <p>Unlike ::rr_check_point, the function uses the exact segment polynomials of the servo interpolator (see ::rr_trj_compile),
+ * so it checks both PVT and PVAT points and covers the acceleration.</p>
+ * @param start Initial point of the trajectory (the 'time_ms' field is ignored)
+ * @param points Array of trajectory points
+ * @param n Number of points in the 'points' array
+ * @param pvat Set to 'true' for PVAT points, 'false' for PVT points (the acceleration is ignored)
+ * @param limits Velocity and acceleration limits (zero limit is not checked)
+ * @param report Pointer to the validation report or NULL. 
+ * The 'segments' and 'max_segments' fields should be set by the caller (see ::rr_trj_report_t)
+ * @return Status code (::rr_ret_status_t)<br>RET_WRONG_TRAJ - at least one segment violates the limits
+ * @ingroup Trajectory
+ */
+rr_ret_status_t rr_check_trajectory(const rr_motion_point_t *start, const rr_motion_point_t *points, int n, bool pvat, 
+		const rr_trj_limits_t *limits, rr_trj_report_t *report)
+{
+	if(!start || !points || !limits || (n < 0))
+	{
+		return RET_WRONG_ARG;
+	}
+
+	double vpeak = 0, apeak = 0, jpeak = 0;
+	int vseg = -1, aseg = -1, jseg = -1, violations = 0;
+	rr_trj_segment_t seg;
+
+	for(int k = 0; k < n; k++)
+	{
+		double vm, am, jm;
+
+		rr_trj_compile(k ? &points[k - 1] : start, &points[k], 1, pvat, &seg);
+		if(seg.duration == 0)
+		{
+			continue;
+		}
+		trj_segment_peaks(seg.c, seg.duration, &vm, &am, &jm);
+		if(vm > vpeak)
+		{
+			vpeak = vm;
+			vseg = k;
+		}
+		if(am > apeak)
+		{
+			apeak = am;
+			aseg = k;
+		}
+		if(jm > jpeak)
+		{
+			jpeak = jm;
+			jseg = k;
+		}
+		if(trj_exceeds(vm, limits->velocity_deg_per_sec) || trj_exceeds(am, limits->accel_deg_per_sec2) || 
+				trj_exceeds(jm, limits->jerk_deg_per_sec3))
+		{
+			if(report && report->segments && (violations < report->max_segments))
+			{
+				report->segments[violations] = k;
+			}
+			violations++;
+		}
+	}
+
+	if(report)
+	{
+		report->violations = violations;
+		report->velocity_max_deg_per_sec = vpeak;
+		report->velocity_max_segment = vseg;
+		report->accel_max_deg_per_sec2 = apeak;
+		report->accel_max_segment = aseg;
+		report->jerk_max_deg_per_sec3 = jpeak;
+		report->jerk_max_segment = jseg;
+	}
+
+	return violations ? RET_WRONG_TRAJ : RET_OK;
+}
+
+/**
+ * @brief The function estimates on the host the minimum time of a PVAT segment between two states under the given limits.
+ * <p>When 'end->time_ms' is 0, the function returns the shortest duration (in whole milliseconds) of the quintic PVAT segment 
+ * (see ::rr_trj_compile) that respects the limits. Otherwise, it checks that the segment of the given duration respects the limits.</p>
+ * <p><b>Note:</b> This is a host-side estimate, not the time calculation of the servo firmware (see ::rr_invoke_time_calculation): 
+ * it is not verified against the servo answers, and the two results may differ. 
+ * The limits are not read from the servo. Use, e.g., ::rr_get_max_velocity to obtain the velocity limit.</p>
+ * @param start Start point (the 'time_ms' field is ignored)
+ * @param end End point
+ * @param limits Velocity (required) and acceleration (0 - not checked) limits
+ * @param time_ms Pointer to the variable to receive the calculated time (ms) or NULL
+ * @return Status code (::rr_ret_status_t)<br>RET_WRONG_TRAJ - the motion cannot be executed within the limits
+ * @ingroup Trajectory
+ */
+rr_ret_status_t rr_calc_segment_time(const rr_motion_point_t *start, const rr_motion_point_t *end, const rr_trj_limits_t *limits, uint32_t *time_ms)
+{
+	if(!start || !end || !limits || !(limits->velocity_deg_per_sec != 0))
+	{
+		return RET_WRONG_ARG;
+	}
+
+	double vlim = fabs(limits->velocity_deg_per_sec);
+	uint32_t t = end->time_ms;
+
+	if((fabs(start->velocity_deg_per_sec) > vlim) || (fabs(end->velocity_deg_per_sec) > vlim))
+	{
+		return RET_WRONG_TRAJ;
+	}
+	if(t ? !trj_segment_feasible(start, end, t, limits) : !(t = trj_segment_time(start, end, limits)))
+	{
+		return RET_WRONG_TRAJ;
+	}
+	if(time_ms)
+	{
+		*time_ms = t;
+	}
+
+	return RET_OK;
+}
+
+/**
+ * @brief The function is the batch form of ::rr_calc_segment_time for a whole PVAT trajectory.
+ * It fills in the estimated minimum durations of the points with zero 'time_ms' and checks the other points against the limits.
+ * @param start Initial point of the trajectory (the 'time_ms' field is ignored)
+ * @param points Array of trajectory points, zero 'time_ms' fields are replaced with the calculated time
+ * @param n Number of points in the 'points' array
+ * @param limits Velocity (required) and acceleration (0 - not checked) limits
+ * @param failed Pointer to the variable to receive the index of the first infeasible point (-1 - none) or NULL
+ * @return Status code (::rr_ret_status_t)<br>RET_WRONG_TRAJ - a segment cannot be executed within the limits
+ * @ingroup Trajectory
+ */
+rr_ret_status_t rr_calc_trajectory_time(const rr_motion_point_t *start, rr_motion_point_t *points, int n, const rr_trj_limits_t *limits, int *failed)
+{
+	if(failed)
+	{
+		*failed = -1;
+	}
+	if(!points || (n < 0))
+	{
+		return RET_WRONG_ARG;
+	}
+
+	for(int k = 0; k < n; k++)
+	{
+		rr_ret_status_t sts = rr_calc_segment_time(k ? &points[k - 1] : start, &points[k], limits, &points[k].time_ms);
+
+		if(sts != RET_OK)
+		{
+			if(failed && (sts == RET_WRONG_TRAJ))
+			{
+				*failed = k;
+			}
+			return sts;
+		}
+	}
+
+	return RET_OK;
+}
+
+/**
+ * @brief The function plans a time-optimal jerk-limited (S-curve) point-to-point motion from an arbitrary initial state 
+ * (position, velocity and acceleration) to a stop at the target position, and emits it as PVAT points (see ::rr_add_motion_points).
+ * <p>Unlike ::rr_set_position_with_limits, the profile limits the jerk and starts from a moving state.
+ * It consists of up to seven constant jerk phases: the velocity change to the peak velocity, cruise at it and the stop.
+ * The phase boundaries become the PVAT points, so a move takes at most ::RR_SCURVE_MAX_POINTS points.</p>
+ * <p>The point times are whole milliseconds: the phase times are rounded up (the jerk phases last at least 10 ms) and the jerks and 
+ * the peak velocity are solved again on that grid, so the quintic interpolation of the servo reproduces the profile exactly. 
+ * The result is validated with ::rr_check_trajectory; when the 'float' points overshoot a limit, the profile is planned again 
+ * with slightly reduced limits. The velocity limit is raised to the initial velocity and the velocity reached while 
+ * the initial acceleration is removed, when they exceed it.</p>
+ * @param start Initial state (the 'time_ms' field is ignored). The initial acceleration should be within the limit
+ * @param position_deg Target position (in degrees)
+ * @param limits Velocity, acceleration and jerk limits (all required)
+ * @param points Array of at least ::RR_SCURVE_MAX_POINTS points to receive the motion
+ * @param n Pointer to the variable to receive the number of points (0 - the servo is at rest at the target)
+ * @param time_ms Pointer to the variable to receive the motion time (ms) or NULL
+ * @return Status code (::rr_ret_status_t)<br>RET_WRONG_TRAJ - no profile within the limits is found from the initial state
+ * @ingroup Trajectory
+ */
+rr_ret_status_t rr_plan_scurve(const rr_motion_point_t *start, float position_deg, const rr_trj_limits_t *limits, 
+		rr_motion_point_t *points, int *n, uint32_t *time_ms)
+{
+	if(!start || !limits || !points || !n || 
+			!(limits->velocity_deg_per_sec != 0) || !(limits->accel_deg_per_sec2 != 0) || !(limits->jerk_deg_per_sec3 != 0))
+	{
+		return RET_WRONG_ARG;
+	}
+
+	double v0 = start->velocity_deg_per_sec, a0 = start->accel_deg_per_sec2;
+	double dist = (double)position_deg - start->position_deg;
+	trj_phase_t ph[RR_SCURVE_MAX_POINTS];
+	uint32_t end_ms = 0;
+
+	//the initial state is accepted as is, along with the velocity reached while its acceleration is removed
+	rr_trj_limits_t check = *limits;
+	double v_free = v0 + a0 * fabs(a0) / (2 * fabs(limits->jerk_deg_per_sec3));
+	check.velocity_deg_per_sec = fmax(fabs(check.velocity_deg_per_sec), fmax(fabs(v0), fabs(v_free)));
+	check.accel_deg_per_sec2 = fmax(fabs(check.accel_deg_per_sec2), fabs(a0));
+
+	*n = 0;
+	if((dist == 0) && (v0 == 0) && (a0 == 0))
+	{
+		if(time_ms)
+		{
+			*time_ms = 0;
+		}
+		return RET_OK;
+	}
+
+	/*Plan, snap to the ms grid and validate: 'float' points may overshoot slightly, so the limits are derated until the check passes*/
+	rr_trj_limits_t plan = *limits;
+	rr_ret_status_t ret = RET_WRONG_TRAJ;
+
+	for(int attempt = 0; (attempt < TRJ_SCURVE_ATTEMPTS) && (ret != RET_OK); attempt++)
+	{
+		scurve_plan(ph, v0, a0, dist, &plan);
+		plan.velocity_deg_per_sec *= TRJ_SCURVE_DERATE;
+		plan.accel_deg_per_sec2 *= TRJ_SCURVE_DERATE;
+		plan.jerk_deg_per_sec3 *= TRJ_SCURVE_DERATE;
+		if(!scurve_snap(ph, v0, a0, dist))
+		{
+			continue;
+		}
+
+		/*Phase boundaries to PVAT points*/
+		double p = start->position_deg, v = v0, a = a0;
+
+		*n = 0;
+		end_ms = 0;
+		for(int k = 0; k < RR_SCURVE_MAX_POINTS; k++)
+		{
+			uint32_t dt_ms = (uint32_t)lround(ph[k].dt * 1000);
+
+			if(dt_ms == 0)
+			{
+				continue;
+			}
+			scurve_advance(&p, &v, &a, &ph[k], ph[k].dt);
+			points[(*n)++] = (rr_motion_point_t){.position_deg = p, .velocity_deg_per_sec = v, .accel_deg_per_sec2 = a, .time_ms = dt_ms};
+			end_ms += dt_ms;
+		}
+		points[*n - 1].position_deg = position_deg;
+		points[*n - 1].velocity_deg_per_sec = 0;
+		points[*n - 1].accel_deg_per_sec2 = 0;
+
+		ret = rr_check_trajectory(start, points, *n, true, &check, NULL);
+	}
+
+	if(time_ms)
+	{
+		*time_ms = end_ms;
+	}
+
+	return ret;
+}
+
+/**
+ * @brief The function compresses a densely sampled path (e.g., exported by a CAM tool at 1 kHz) into a small set of PVAT points.
+ * <p>Consecutive samples are greedily merged into the longest PVAT segments whose quintic interpolation (the servo model, see ::rr_trj_compile)
+ * stays within the position tolerance at every sample. The points are placed at samples and take the sampled (or estimated) velocity 
+ * and acceleration, so the fitted trajectory is continuous in position, velocity and acceleration.</p>
+ * @param pos Array of sampled positions (degrees)
+ * @param vel Array of sampled velocities (degrees/sec) or NULL to estimate them by central differences
+ * @param acc Array of sampled accelerations (degrees/sec^2) or NULL to estimate them by central differences
+ * @param n Number of samples (at least 2)
+ * @param step_ms Sampling period (ms)
+ * @param tol_deg Position tolerance (degrees)
+ * @param start Pointer to the variable to receive the initial state (the first sample) or NULL
+ * @param points Array to receive the PVAT points
+ * @param n_points Input: capacity of the 'points' array, output: number of points
+ * @return Status code (::rr_ret_status_t)<br>RET_SIZE_MISMATCH - the 'points' array is too small
+ * @ingroup Trajectory
+ */
+rr_ret_status_t rr_trj_fit(const float *pos, const float *vel, const float *acc, int n, uint32_t step_ms, float tol_deg,
+		rr_motion_point_t *start, rr_motion_point_t *points, int *n_points)
+{
+	if(!pos || (n < 2) || !step_ms || !(tol_deg > 0) || !points || !n_points || (*n_points <= 0))
+	{
+		return RET_WRONG_ARG;
+	}
+
+	double step = step_ms / 1000.0;
+	double *v = (double *)malloc(n * sizeof(double));
+	double *a = (double *)malloc(n * sizeof(double));
+
+	if(!v || !a)
+	{
+		free(v);
+		free(a);
+		return RET_ERROR;
+	}
+
+	for(int k = 0; k < n; k++)
+	{
+		int l = k > 0 ? k - 1 : 0, r = k < n - 1 ? k + 1 : n - 1;
+
+		v[k] = vel ? vel[k] : (pos[r] - pos[l]) / ((r - l) * step);
+	}
+	for(int k = 0; k < n; k++)
+	{
+		int l = k > 0 ? k - 1 : 0, r = k < n - 1 ? k + 1 : n - 1;
+
+		a[k] = acc ? acc[k] : (vel ? (vel[r] - vel[l]) : (v[r] - v[l])) / ((r - l) * step);
+	}
+
+	int cap = *n_points, cnt = 0;
+	double c[6];
+	rr_ret_status_t ret = RET_OK;
+
+	for(int i = 0; i < n - 1;)
+	{
+		int good = 1, bad = 0;
+
+		//gallop, then bisect the segment length
+		for(int len = 2; !bad; len *= 2)
+		{
+			if(i + len >= n - 1)
+			{
+				len = n - 1 - i;
+			}
+			if(trj_fit_segment(pos, v, a, i, i + len, step, tol_deg, c))
+			{
+				good = len;
+				if(i + len == n - 1)
+				{
+					break;
+				}
+			}
+			else
+			{
+				bad = len;
+			}
+		}
+		while(bad && (bad - good > 1))
+		{
+			int mid = good + (bad - good) / 2;
+			if(trj_fit_segment(pos, v, a, i, i + mid, step, tol_deg, c))
+			{
+				good = mid;
+			}
+			else
+			{
+				bad = mid;
+			}
+		}
+
+		if(cnt == cap)
+		{
+			ret = RET_SIZE_MISMATCH;
+			break;
+		}
+		i += good;
+		points[cnt++] = (rr_motion_point_t){.position_deg = pos[i], .velocity_deg_per_sec = v[i], .accel_deg_per_sec2 = a[i], .time_ms = good * step_ms};
+	}
+
+	if(start)
+	{
+		*start = (rr_motion_point_t){.position_deg = pos[0], .velocity_deg_per_sec = v[0], .accel_deg_per_sec2 = a[0]};
+	}
+	*n_points = cnt;
+	free(v);
+	free(a);
+
+	return ret;
+}
+
+/**
+ * @brief The function creates a look-ahead motion blending planner for a servo.
+ * <p>The planner turns a sequence of waypoints (see ::rr_blend_add_waypoint) into a continuous-velocity PVAT trajectory 
+ * (see ::rr_blend_get_points): the waypoints passed in the direction of motion are passed without stopping, 
+ * at the highest speed from which the servo can still stop at the last known waypoint. 
+ * It is incremental: new waypoints may be appended while the points already emitted are being executed.</p>
+ * <p>The segments consist of the acceleration, cruise and deceleration phases of the PVAT profile of ::rr_set_position_with_limits.</p>
+ * @param start_deg Start position (in degrees), the servo is assumed to be at rest
+ * @param limits Velocity and acceleration limits (the jerk limit is ignored), both should be positive
+ * @param depth Look-ahead depth: the maximum number of waypoints not yet emitted
+ * @return Planner descriptor or NULL when an error occurs
+ * @ingroup Trajectory
+ */
+rr_blend_t *rr_init_blend(float start_deg, const rr_trj_limits_t *limits, int depth)
+{
+	if(!limits || !(limits->velocity_deg_per_sec > 0) || !(limits->accel_deg_per_sec2 > 0) || (depth <= 0))
+	{
+		return NULL;
+	}
+
+	rr_blend_t *b = (rr_blend_t *)calloc(1, sizeof(rr_blend_t));
+	if(!b)
+	{
+		return NULL;
+	}
+
+	b->vmax = TRJ_BLEND_FLOAT_DERATE * limits->velocity_deg_per_sec;
+	b->ac = TRJ_BLEND_FLOAT_DERATE * 2.0 * limits->accel_deg_per_sec2 / 3.0;
+	b->am = TRJ_BLEND_DERATE * b->ac;
+	b->pos = start_deg;
+	b->depth = depth;
+	b->wp = (double *)malloc(depth * sizeof(double));
+	b->tol = (double *)malloc(depth * sizeof(double));
+	b->v = (double *)malloc(depth * sizeof(double));
+	if(!b->wp || !b->tol || !b->v)
+	{
+		rr_deinit_blend(&b);
+		return NULL;
+	}
+
+	return b;
+}
+
+/**
+ * @brief The function destroys the motion blending planner (see ::rr_init_blend).
+ * @param blend Pointer to the planner descriptor, set to NULL on return
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Trajectory
+ */
+rr_ret_status_t rr_deinit_blend(rr_blend_t **blend)
+{
+	if(!blend || !*blend)
+	{
+		return RET_BAD_INSTANCE;
+	}
+
+	free((*blend)->wp);
+	free((*blend)->tol);
+	free((*blend)->v);
+	free(*blend);
+	*blend = NULL;
+
+	return RET_OK;
+}
+
+/**
+ * @brief The function appends a waypoint to the motion blending planner (see ::rr_init_blend) and replans the pending segments.
+ * <p>When the motion reverses at the previous waypoint and its segment has not been emitted yet, 
+ * the reversal point is moved short of that waypoint by up to its tolerance (as far as the servo can still stop there).</p>
+ * @param blend Planner descriptor returned by the ::rr_init_blend function
+ * @param position_deg Waypoint position (in degrees)
+ * @param tol_deg Waypoint tolerance (in degrees), 0 - the waypoint is reached exactly
+ * @return Status code (::rr_ret_status_t)<br>RET_BUSY - the look-ahead is full, emit points first
+ * @ingroup Trajectory
+ */
+rr_ret_status_t rr_blend_add_waypoint(rr_blend_t *blend, float position_deg, float tol_deg)
+{
+	if(!blend)
+	{
+		return RET_BAD_INSTANCE;
+	}
+	if(!isfinite(position_deg) || !(tol_deg >= 0))
+	{
+		return RET_WRONG_ARG;
+	}
+
+	rr_blend_t *b = blend;
+	double from = b->n ? b->wp[b->n - 1] : b->pos;
+
+	if(position_deg == from)
+	{
+		return RET_OK;
+	}
+	if(b->n == b->depth)
+	{
+		return RET_BUSY;
+	}
+
+	int k = b->n - 1;
+	if((k >= 0) && ((position_deg > from ? 1.0 : -1.0) != blend_dir(b, k)))
+	{
+		//turn short, keeping the stopping distance from the planned entry speed
+		double entry = k > 0 ? b->v[k - 1] : fabs(b->vel);
+		double len = fabs(b->wp[k] - blend_from(b, k));
+		double shift = b->tol[k];
+
+		shift = shift < len - entry * entry / (2.0 * b->am) ? shift : len - entry * entry / (2.0 * b->am);
+		shift = shift < 0.5 * len ? shift : 0.5 * len;
+		shift = shift < 0.5 * fabs(position_deg - from) ? shift : 0.5 * fabs(position_deg - from);
+		if(shift > 0)
+		{
+			b->wp[k] -= blend_dir(b, k) * shift;
+		}
+	}
+
+	b->wp[b->n] = position_deg;
+	b->tol[b->n] = tol_deg;
+	b->n++;
+	blend_replan(b);
+
+	return RET_OK;
+}
+
+/**
+ * @brief The function emits the PVAT points of the planned segments (see ::rr_blend_add_waypoint), 
+ * e.g. for ::rr_add_motion_points or a trajectory stream source (see ::rr_init_traj_stream).
+ * <p>The segment to the last known waypoint is kept back unless 'flush' is set, so that it can still be blended with the next waypoint.
+ * Each segment takes up to ::RR_BLEND_MAX_POINTS points, only whole segments are emitted. 
+ * The first segment starts from the initial position (see ::rr_init_blend), the next ones from the end of the previous one.</p>
+ * @param blend Planner descriptor returned by the ::rr_init_blend function
+ * @param points Array to receive the PVAT points
+ * @param max Capacity of the 'points' array
+ * @param flush Set to 'true' to emit the last segment as well (the motion stops at the last waypoint)
+ * @return Number of points emitted or -1 when an error occurs
+ * @ingroup Trajectory
+ */
+int rr_blend_get_points(rr_blend_t *blend, rr_motion_point_t *points, int max, bool flush)
+{
+	if(!blend || (!points && (max > 0)))
+	{
+		return -1;
+	}
+
+	rr_blend_t *b = blend;
+	int limit = b->n - (flush ? 0 : 1);
+	int cnt = 0, k = 0;
+
+	while((k < limit) && (cnt + RR_BLEND_MAX_POINTS <= max))
+	{
+		//merge the short segments passed without stopping, the ms time grid can't represent them
+		int m = k;
+		double dir = blend_dir(b, k), min_len = b->vmax * TRJ_BLEND_MIN_MS / 1000.0;
+
+		while((m < limit) && (b->v[m] > 0) && (fabs(b->wp[m] - blend_from(b, k)) < min_len))
+		{
+			m++;
+		}
+		//so is the short segment continuing it, the speed reached can't be taken away on the ms grid
+		while((m + 1 < b->n) && (blend_dir(b, m + 1) == dir) && (fabs(b->wp[m + 1] - b->wp[m]) < min_len))
+		{
+			m++;
+		}
+		if(m >= limit)
+		{
+			break;
+		}
+
+		int c = blend_segment(b, b->pos, b->wp[m], fabs(b->vel), b->v[m], points + cnt, &b->pos);
+		b->vel = c ? points[cnt + c - 1].velocity_deg_per_sec : dir * b->v[m];
+		cnt += c;
+		k = m + 1;
+	}
+
+	b->n -= k;
+	memmove(b->wp, b->wp + k, b->n * sizeof(double));
+	memmove(b->tol, b->tol + k, b->n * sizeof(double));
+	memmove(b->v, b->v + k, b->n * sizeof(double));
+
+	return cnt;
+}
@@ -0,0 +1,563 @@
+/**
+ * @brief Binary trajectory file format: writer, memory-mapped loader and CSV converter
+ *
+ * @file trajectory_file.c
+ * @author Rozum
+ * @date 2018-06-01
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "api.h"
+#include "crc16-ccitt.h"
+#include "logging.h"
+#include "usbcan_proto.h"
+#include <stdlib.h>
+#include <string.h>
+
+//! @cond Doxygen_Suppress
+/* Private define ------------------------------------------------------------*/
+#define TRJ_FILE_ALIGN 16
+#define TRJ_FILE_CRC_CHUNK (1u << 30)
+#define TRJ_FILE_CSV_LINE 256
+
+/* Private typedef -----------------------------------------------------------*/
+struct rr_trj_file_t
+{
+#ifdef _WIN32
+	HANDLE fh;
+	HANDLE mh;
+#endif
+	const uint8_t *map;
+	size_t size;
+	const rr_trj_file_header_t *hdr;
+	const rr_trj_file_axis_t *axes;
+	const rr_motion_point_t *records;
+	uint32_t *cursor;
+};
+
+_Static_assert(sizeof(rr_motion_point_t) == 16, "rr_motion_point_t is the on-disk record");
+_Static_assert(sizeof(rr_trj_file_header_t) == 32, "rr_trj_file_header_t size");
+_Static_assert(sizeof(rr_trj_file_axis_t) == 32, "rr_trj_file_axis_t size");
+
+/* Private functions ---------------------------------------------------------*/
+static uint16_t trj_file_crc(const void *data, size_t len, uint16_t crc)
+{
+	const uint8_t *p = (const uint8_t *)data;
+
+	while(len)
+	{
+		unsigned int l = len > TRJ_FILE_CRC_CHUNK ? TRJ_FILE_CRC_CHUNK : len;
+		crc = crc16_ccitt(p, l, crc);
+		p += l;
+		len -= l;
+	}
+
+	return crc;
+}
+
+static uint64_t trj_file_data_offset(int n_axes)
+{
+	uint64_t off = sizeof(rr_trj_file_header_t) + (uint64_t)n_axes * sizeof(rr_trj_file_axis_t);
+
+	return (off + TRJ_FILE_ALIGN - 1) / TRJ_FILE_ALIGN * TRJ_FILE_ALIGN;
+}
+
+static void trj_file_unmap(rr_trj_file_t *f)
+{
+#ifdef _WIN32
+	if(f->map)
+	{
+		UnmapViewOfFile(f->map);
+	}
+	if(f->mh)
+	{
+		CloseHandle(f->mh);
+	}
+	if(f->fh != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(f->fh);
+	}
+#else
+	if(f->map)
+	{
+		munmap((void *)f->map, f->size);
+	}
+#endif
+}
+
+static bool trj_file_map(rr_trj_file_t *f, const char *path)
+{
+#ifdef _WIN32
+	LARGE_INTEGER size;
+
+	f->fh = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if((f->fh == INVALID_HANDLE_VALUE) || !GetFileSizeEx(f->fh, &size) || !size.QuadPart)
+	{
+		return false;
+	}
+	f->size = size.QuadPart;
+	if(!(f->mh = CreateFileMapping(f->fh, NULL, PAGE_READONLY, 0, 0, NULL)))
+	{
+		return false;
+	}
+	f->map = (const uint8_t *)MapViewOfFile(f->mh, FILE_MAP_READ, 0, 0, 0);
+
+	return f->map != NULL;
+#else
+	struct stat st;
+	int fd = open(path, O_RDONLY);
+
+	if(fd < 0)
+	{
+		return false;
+	}
+	if((fstat(fd, &st) < 0) || !st.st_size)
+	{
+		close(fd);
+		return false;
+	}
+	f->size = st.st_size;
+	void *m = mmap(NULL, f->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(m == MAP_FAILED)
+	{
+		return false;
+	}
+	madvise(m, f->size, MADV_SEQUENTIAL);
+	f->map = (const uint8_t *)m;
+
+	return true;
+#endif
+}
+//! @endcond
+
+/**
+ * @brief The function writes a trajectory file (see ::rr_trj_file_header_t).
+ * <p>The file consists of the header, the axis table and the point records of all the axes in a contiguous 16-byte aligned array.
+ * All fields are little-endian, a record has the in-memory layout of ::rr_motion_point_t.</p>
+ * @param path File path
+ * @param axes Array of axis descriptors: the 'id', 'count' and 'start' fields are used, the 'offset' field is ignored
+ * @param points Array of point arrays, one per axis ('count' points each)
+ * @param n_axes Number of axes
+ * @param pvat Set to 'true' for PVAT points, 'false' for PVT points
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Trajectory
+ */
+rr_ret_status_t rr_trj_file_write(const char *path, const rr_trj_file_axis_t *axes, const rr_motion_point_t *const *points, int n_axes, bool pvat)
+{
+	if(!path || !axes || !points || (n_axes <= 0))
+	{
+		return RET_WRONG_ARG;
+	}
+
+	rr_trj_file_axis_t *tab = (rr_trj_file_axis_t *)calloc(n_axes, sizeof(rr_trj_file_axis_t));
+	if(!tab)
+	{
+		return RET_ERROR;
+	}
+
+	uint64_t offset = 0;
+
+	for(int i = 0; i < n_axes; i++)
+	{
+		tab[i] = axes[i];
+		tab[i].offset = offset;
+		offset += axes[i].count;
+	}
+
+	rr_trj_file_header_t hdr =
+	{
+		.magic = RR_TRJ_FILE_MAGIC,
+		.version = RR_TRJ_FILE_VERSION,
+		.flags = pvat ? RR_TRJ_FILE_PVAT : 0,
+		.n_axes = n_axes,
+		.record_size = sizeof(rr_motion_point_t),
+		.data_offset = trj_file_data_offset(n_axes),
+	};
+	uint8_t pad[TRJ_FILE_ALIGN] = {0};
+	size_t pad_len = hdr.data_offset - sizeof(hdr) - n_axes * sizeof(rr_trj_file_axis_t);
+	uint16_t crc = trj_file_crc(tab, n_axes * sizeof(rr_trj_file_axis_t), 0);
+
+	for(int i = 0; i < n_axes; i++)
+	{
+		crc = trj_file_crc(points[i], tab[i].count * sizeof(rr_motion_point_t), crc);
+	}
+	hdr.crc = crc;
+
+	FILE *fp = fopen(path, "wb");
+	bool ok = fp != NULL;
+
+	ok = ok && (fwrite(&hdr, sizeof(hdr), 1, fp) == 1);
+	ok = ok && (fwrite(tab, sizeof(rr_trj_file_axis_t), n_axes, fp) == (size_t)n_axes);
+	ok = ok && (!pad_len || (fwrite(pad, pad_len, 1, fp) == 1));
+	for(int i = 0; ok && (i < n_axes); i++)
+	{
+		ok = !tab[i].count || (fwrite(points[i], sizeof(rr_motion_point_t), tab[i].count, fp) == tab[i].count);
+	}
+	if(fp && fclose(fp))
+	{
+		ok = false;
+	}
+	free(tab);
+
+	if(!ok)
+	{
+		LOG_ERROR(debug_log, "%s: can't write '%s'", __func__, path);
+		return RET_ERROR;
+	}
+
+	return RET_OK;
+}
+
+/**
+ * @brief The function opens a trajectory file (see ::rr_trj_file_write) by mapping it into memory.
+ * The points are used in place (see ::rr_trj_file_get_axis), nothing is parsed or copied.
+ * @param path File path
+ * @param verify Set to 'true' to verify the checksum of the file (reads the whole file)
+ * @return File descriptor or NULL when the file can't be opened or is not a valid trajectory file
+ * @ingroup Trajectory
+ */
+rr_trj_file_t *rr_trj_file_open(const char *path, bool verify)
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__)
+	LOG_ERROR(debug_log, "%s: trajectory files are not supported on big-endian hosts", __func__);
+	return NULL;
+#endif
+	if(!path)
+	{
+		return NULL;
+	}
+
+	rr_trj_file_t *f = (rr_trj_file_t *)calloc(1, sizeof(rr_trj_file_t));
+	if(!f)
+	{
+		return NULL;
+	}
+#ifdef _WIN32
+	f->fh = INVALID_HANDLE_VALUE;
+#endif
+
+	if(!trj_file_map(f, path))
+	{
+		LOG_ERROR(debug_log, "%s: can't map '%s'", __func__, path);
+		rr_trj_file_close(&f);
+		return NULL;
+	}
+
+	const rr_trj_file_header_t *h = (const rr_trj_file_header_t *)f->map;
+	bool ok = (f->size >= sizeof(*h)) && (h->magic == RR_TRJ_FILE_MAGIC) && (h->version <= RR_TRJ_FILE_VERSION) &&
+		(h->record_size == sizeof(rr_motion_point_t)) && h->n_axes &&
+		(h->data_offset >= sizeof(*h) + (uint64_t)h->n_axes * sizeof(rr_trj_file_axis_t)) &&
+		!(h->data_offset % TRJ_FILE_ALIGN) && (h->data_offset <= f->size);
+
+	if(ok)
+	{
+		uint64_t n_records = (f->size - h->data_offset) / sizeof(rr_motion_point_t);
+
+		f->hdr = h;
+		f->axes = (const rr_trj_file_axis_t *)(f->map + sizeof(*h));
+		f->records = (const rr_motion_point_t *)(f->map + h->data_offset);
+		for(uint32_t i = 0; ok && (i < h->n_axes); i++)
+		{
+			ok = (f->axes[i].offset <= n_records) && (f->axes[i].count <= n_records - f->axes[i].offset);
+		}
+	}
+	if(ok && verify)
+	{
+		uint16_t crc = trj_file_crc(f->axes, h->n_axes * sizeof(rr_trj_file_axis_t), 0);
+
+		for(uint32_t i = 0; i < h->n_axes; i++)
+		{
+			crc = trj_file_crc(f->records + f->axes[i].offset, f->axes[i].count * sizeof(rr_motion_point_t), crc);
+		}
+		if(crc != h->crc)
+		{
+			LOG_ERROR(debug_log, "%s: '%s' checksum mismatch", __func__, path);
+			ok = false;
+		}
+	}
+	if(ok && !(f->cursor = (uint32_t *)calloc(h->n_axes, sizeof(uint32_t))))
+	{
+		ok = false;
+	}
+	if(!ok)
+	{
+		LOG_ERROR(debug_log, "%s: '%s' is not a valid trajectory file", __func__, path);
+		rr_trj_file_close(&f);
+		return NULL;
+	}
+
+	return f;
+}
+
+/**
+ * @brief The function closes a trajectory file (see ::rr_trj_file_open). The point arrays of the file become invalid.
+ * @param file Pointer to the file descriptor, set to NULL on return
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Trajectory
+ */
+rr_ret_status_t rr_trj_file_close(rr_trj_file_t **file)
+{
+	if(!file || !*file)
+	{
+		return RET_BAD_INSTANCE;
+	}
+
+	trj_file_unmap(*file);
+	free((*file)->cursor);
+	free(*file);
+	*file = NULL;
+
+	return RET_OK;
+}
+
+/**
+ * @brief The function returns the number of axes and the point type of a trajectory file.
+ * @param file File descriptor returned by the ::rr_trj_file_open function
+ * @param n_axes Pointer to the variable to receive the number of axes
+ * @param pvat Pointer to the variable to receive the point type ('true' - PVAT, 'false' - PVT) or NULL
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Trajectory
+ */
+rr_ret_status_t rr_trj_file_get_info(const rr_trj_file_t *file, int *n_axes, bool *pvat)
+{
+	if(!file)
+	{
+		return RET_BAD_INSTANCE;
+	}
+	if(!n_axes)
+	{
+		return RET_WRONG_ARG;
+	}
+
+	*n_axes = file->hdr->n_axes;
+	if(pvat)
+	{
+		*pvat = (file->hdr->flags & RR_TRJ_FILE_PVAT) != 0;
+	}
+
+	return RET_OK;
+}
+
+/**
+ * @brief The function returns the points of an axis of a trajectory file. The points reside in the mapped file,
+ * so they can be passed to ::rr_add_motion_points, ::rr_check_trajectory, etc. without copying.
+ * @param file File descriptor returned by the ::rr_trj_file_open function
+ * @param axis Axis index
+ * @param info Pointer to the structure to receive the axis descriptor or NULL
+ * @param points Pointer to the variable to receive the point array (valid until the file is closed)
+ * @param n Pointer to the variable to receive the number of points
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Trajectory
+ */
+rr_ret_status_t rr_trj_file_get_axis(const rr_trj_file_t *file, int axis, rr_trj_file_axis_t *info, const rr_motion_point_t **points, int *n)
+{
+	if(!file)
+	{
+		return RET_BAD_INSTANCE;
+	}
+	if((axis < 0) || ((uint32_t)axis >= file->hdr->n_axes) || !points || !n)
+	{
+		return RET_WRONG_ARG;
+	}
+
+	const rr_trj_file_axis_t *a = &file->axes[axis];
+
+	if(info)
+	{
+		*info = *a;
+	}
+	*points = file->records + a->offset;
+	*n = a->count;
+
+	return RET_OK;
+}
+
+/**
+ * @brief Trajectory source callback (see ::rr_traj_source_cb_t) reading the points of a trajectory file in sequence.
+ * Pass it to ::rr_init_traj_stream with the file descriptor as the context. The axes of the file map to the servos of the stream in order.
+ * @param file File descriptor returned by the ::rr_trj_file_open function
+ * @param axis Axis index
+ * @param points Array to receive the next points of the axis
+ * @param max Capacity of the 'points' array
+ * @return Number of points written (0 - end of the axis, negative - error)
+ * @ingroup Trajectory
+ */
+int rr_trj_file_source(void *file, int axis, rr_motion_point_t *points, int max)
+{
+	rr_trj_file_t *f = (rr_trj_file_t *)file;
+
+	if(!f || (axis < 0) || ((uint32_t)axis >= f->hdr->n_axes) || !points || (max < 0))
+	{
+		return -1;
+	}
+
+	const rr_trj_file_axis_t *a = &f->axes[axis];
+	uint32_t left = a->count - f->cursor[axis];
+	uint32_t n = left < (uint32_t)max ? left : (uint32_t)max;
+
+	memcpy(points, f->records + a->offset + f->cursor[axis], n * sizeof(rr_motion_point_t));
+	f->cursor[axis] += n;
+
+	return n;
+}
+
+/**
+ * @brief The function rewinds the reading positions of ::rr_trj_file_source to the start of all the axes.
+ * @param file File descriptor returned by the ::rr_trj_file_open function
+ * @return Status code (::rr_ret_status_t)
+ * @ingroup Trajectory
+ */
+rr_ret_status_t rr_trj_file_rewind(rr_trj_file_t *file)
+{
+	if(!file)
+	{
+		return RET_BAD_INSTANCE;
+	}
+
+	memset(file->cursor, 0, file->hdr->n_axes * sizeof(uint32_t));
+
+	return RET_OK;
+}
+
+/**
+ * @brief The function converts a CSV trajectory into a trajectory file (see ::rr_trj_file_write).
+ * <p>Each CSV line holds a point: "id, position, velocity, acceleration, time_ms", where 'id' is the axis (servo) identifier.
+ * The axes are stored in the order of their first appearance. When the first line of an axis has zero time, it is taken as the initial state of the axis.
+ * Empty lines, lines starting with '#' and lines that don't start with a number (e.g., column titles) are skipped.
+ * The time must be a non-negative integer, and a line may hold up to 254 characters.</p>
+ * @param csv_path CSV file path
+ * @param path Trajectory file path
+ * @param pvat Set to 'true' for PVAT points, 'false' for PVT points
+ * @return Status code (::rr_ret_status_t)<br>RET_WRONG_TRAJ - a line can't be parsed or is too long
+ * @ingroup Trajectory
+ */
+rr_ret_status_t rr_trj_file_from_csv(const char *csv_path, const char *path, bool pvat)
+{
+	if(!csv_path || !path)
+	{
+		return RET_WRONG_ARG;
+	}
+
+	FILE *fp = fopen(csv_path, "r");
+	if(!fp)
+	{
+		LOG_ERROR(debug_log, "%s: can't open '%s'", __func__, csv_path);
+		return RET_ERROR;
+	}
+
+	rr_trj_file_axis_t axes[MAX_CO_DEV];
+	rr_motion_point_t *points[MAX_CO_DEV] = {NULL};
+	uint32_t cap[MAX_CO_DEV] = {0};
+	int axis_of[MAX_CO_DEV];
+	int n_axes = 0, line_no = 0;
+	char line[TRJ_FILE_CSV_LINE];
+	rr_ret_status_t ret = RET_OK;
+
+	memset(axes, 0, sizeof(axes));
+	for(int i = 0; i < MAX_CO_DEV; i++)
+	{
+		axis_of[i] = -1;
+	}
+
+	while((ret == RET_OK) && fgets(line, sizeof(line), fp))
+	{
+		char *p = line, *e;
+
+		line_no++;
+		//a line that doesn't fit the buffer would be split and its tail parsed as another line
+		if(!strchr(line, '\n') && !feof(fp))
+		{
+			LOG_ERROR(debug_log, "%s: '%s' line %d: the line is too long", __func__, csv_path, line_no);
+			ret = RET_WRONG_TRAJ;
+			break;
+		}
+		while((*p == ' ') || (*p == '\t'))
+		{
+			p++;
+		}
+		if(!((*p >= '0') && (*p <= '9')))
+		{
+			continue;
+		}
+
+		long id = strtol(p, &e, 0);
+		double v[4];
+		int k;
+
+		for(k = 0; k < 4; k++)
+		{
+			p = e;
+			while((*p == ' ') || (*p == '\t'))
+			{
+				p++;
+			}
+			if(*p != ',')
+			{
+				break;
+			}
+			v[k] = strtod(p + 1, &e);
+			if(e == p + 1)
+			{
+				break;
+			}
+		}
+		//the time must be an integer number of milliseconds that fits the point
+		if((k < 4) || (id < 0) || (id >= MAX_CO_DEV) || !(v[3] >= 0) || !(v[3] <= UINT32_MAX) || ((uint32_t)v[3] != v[3]))
+		{
+			LOG_ERROR(debug_log, "%s: '%s' line %d: wrong format", __func__, csv_path, line_no);
+			ret = RET_WRONG_TRAJ;
+			break;
+		}
+
+		rr_motion_point_t pt = {.position_deg = v[0], .velocity_deg_per_sec = v[1], .accel_deg_per_sec2 = v[2], .time_ms = v[3]};
+		int a = axis_of[id];
+
+		if(a < 0)
+		{
+			a = axis_of[id] = n_axes++;
+			axes[a].id = id;
+			if(!pt.time_ms)
+			{
+				axes[a].start = pt;
+				continue;
+			}
+		}
+		if(axes[a].count == cap[a])
+		{
+			cap[a] = cap[a] ? 2 * cap[a] : 1024;
+			rr_motion_point_t *np = (rr_motion_point_t *)realloc(points[a], cap[a] * sizeof(rr_motion_point_t));
+			if(!np)
+			{
+				ret = RET_ERROR;
+				break;
+			}
+			points[a] = np;
+		}
+		points[a][axes[a].count++] = pt;
+	}
+	fclose(fp);
+
+	if((ret == RET_OK) && !n_axes)
+	{
+		ret = RET_ZERO_SIZE;
+	}
+	if(ret == RET_OK)
+	{
+		ret = rr_trj_file_write(path, axes, (const rr_motion_point_t *const *)points, n_axes, pvat);
+	}
+	for(int i = 0; i < n_axes; i++)
+	{
+		free(points[i]);
+	}
+
+	return ret;
+}
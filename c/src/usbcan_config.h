@@ -29,6 +29,7 @@
 #define USB_CAN_REOPEN_DELAY_MS			100
 
 #define USB_CAN_MAX_SDO_PAYLOAD			4096
+#define USB_CAN_MAX_SDO_IN_FLIGHT		8 //SDO transactions on bus at once (one per node)
 
 #define USB_CAN_OUTGOING_UDP_PORT		17701
 #define USB_CAN_INGOING_UDP_PORT		17700
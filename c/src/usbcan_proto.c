@@ -1,3 +1,6 @@
+#ifdef __linux__
+#define _GNU_SOURCE //sendmmsg()
+#endif
 #include "usbcan_proto.h"
 #include "usbcan_util.h"
 #include "rb_tools.h"
@@ -135,20 +138,100 @@ static int usbcan_write_fd(usbcan_instance_t *inst, uint8_t *b, int l)
 	return ret;
 }
 
+/*
+ * Writes 'n' wrapped frames placed back to back in 'b' ('l' - frame lengths) with a single system call.
+ * Notice: if connection type is UDP socket, frames are unwrapped and sent as separate datagrams.
+ */
+static int usbcan_write_fd_multi(usbcan_instance_t *inst, uint8_t *b, const int *l, int n)
+{
+	int total = 0;
+	int ret = 0;
+
+	for(int i = 0; i < n; i++)
+	{
+		total += l[i];
+	}
+
+	if(!inst->usbcan_udp)
+	{
+		return usbcan_write_fd(inst, b, total);
+	}
+
+	pthread_mutex_lock(&inst->mutex_write);
+#ifdef __linux__
+	struct mmsghdr msg[n];
+	struct iovec iov[n];
+
+	memset(msg, 0, sizeof(msg));
+	for(int i = 0, p = 0; i < n; p += l[i], i++)
+	{
+		iov[i].iov_base = b + p + USB_CAN_HEAD_SZ;
+		iov[i].iov_len = l[i] - USB_CAN_OHEAD;
+		msg[i].msg_hdr.msg_iov = &iov[i];
+		msg[i].msg_hdr.msg_iovlen = 1;
+	}
+	for(int sent = 0; sent < n;)
+	{
+		int r = sendmmsg(inst->fd, msg + sent, n - sent, 0);
+		if(r <= 0)
+		{
+			LOG_ERROR(debug_log, "%s: usbcan write failed", __func__);
+			ret = -1;
+			break;
+		}
+		sent += r;
+	}
+#else
+	for(int i = 0, p = 0; i < n; p += l[i], i++)
+	{
+		if(send(inst->fd, (char*)(b + p + USB_CAN_HEAD_SZ), l[i] - USB_CAN_OHEAD, 0) < 0)
+		{
+			LOG_ERROR(debug_log, "%s: usbcan write failed", __func__);
+			ret = -1;
+			break;
+		}
+	}
+#endif
+	pthread_mutex_unlock(&inst->mutex_write);
+
+	return ret < 0 ? ret : total;
+}
+
+/*
+ * Looks up SDO slot which is in flight for specified node & object.
+ * Should be called with instance mutex locked.
+ */
+static usbcan_sdo_t *sdo_find_busy(usbcan_instance_t *inst, int id, bool write, int idx, int sidx)
+{
+	for(int i = 0; i < USB_CAN_MAX_SDO_IN_FLIGHT; i++)
+	{
+		usbcan_sdo_t *s = &inst->sdo[i];
+		if(s->busy && (s->id == id) && (s->write == write) && 
+				(s->idx == idx) && (s->sidx == sidx))
+		{
+			return s;
+		}
+	}
+	return NULL;
+}
+
 /*
  * Callback for handling SDO response.
+ * Completes transaction and wakes up every caller attached to it.
  */
-static void sdo_resp_cb(usbcan_instance_t *inst, uint32_t abt, uint8_t *data, int len)
+static void sdo_resp_cb(usbcan_instance_t *inst, usbcan_sdo_t *s, uint32_t abt, uint8_t *data, int len)
 {
-	inst->op.abt = abt;
-	if(!inst->op.write)
+	s->abt = abt;
+	if(!s->write)
 	{
-		memcpy(inst->op.data, data, len);
+		len = MIN(len, (int)sizeof(s->data));
+		memcpy(s->data, data, len);
 	}
-	inst->op.len = len;
-	pthread_mutex_lock(&inst->mutex);
-	pthread_cond_signal(&inst->cond);
-	pthread_mutex_unlock(&inst->mutex);
+	s->len = len;
+	s->busy = false;
+	s->valid = !s->write && !abt;
+	s->seq++;
+	pthread_cond_broadcast(&inst->sdo_cond);
 }
 
 /*
@@ -213,68 +296,22 @@ static void usbcan_poll(usbcan_instance_t *inst, uint64_t delta_us)
 		inst->traj_sync_timer -= inst->traj_sync_ival;
 	}
 
-	/*Wait for SDO response*/
-	if(inst->op.code == OP_SDO)
+	/*Wait for SDO responses*/
+	pthread_mutex_lock(&inst->mutex);
+	for(i = 0; i < USB_CAN_MAX_SDO_IN_FLIGHT; i++)
 	{
-		if(inst->op.ttl <= 0)
+		usbcan_sdo_t *s = &inst->sdo[i];
+		if(!s->busy)
 		{
-			inst->op.code = OP_NONE;
-			sdo_resp_cb(inst, -1u, NULL, 0);
-		}
-
-		inst->op.ttl -= delta_ms;
-	}
-
-	/*Wait for device specific state*/
-	if(inst->op.code == OP_WAIT_DEV_STATE)
-	{
-		if(inst->dev_alive[inst->op.id] > 0)
-		{			
-			if((inst->op.state == CO_NMT_ANY) || (inst->op.state == inst->dev_state[inst->op.id]))
-			{
-				inst->op.abt = 0;
-				inst->op.code = OP_NONE;
-				pthread_mutex_lock(&inst->mutex);
-				pthread_cond_signal(&inst->cond);
-				pthread_mutex_unlock(&inst->mutex);
-			}
-		}
-		if(inst->op.ttl <= 0)
-		{	
-			inst->op.abt = -1u;
-			inst->op.code = OP_NONE;
-			pthread_mutex_lock(&inst->mutex);
-			pthread_cond_signal(&inst->cond);
-			pthread_mutex_unlock(&inst->mutex);
-		}
-
-		inst->op.ttl -= delta_ms;
-	}
-
-	/*Wait for device boot-up*/
-	if(inst->op.code == OP_WAIT_DEV_BOOT_UP)
-	{
-		if(inst->dev_boot_up[inst->op.id])
-		{			
-			inst->dev_boot_up[inst->op.id] = false;
-			inst->op.abt = 0;
-			inst->op.code = OP_NONE;
-			pthread_mutex_lock(&inst->mutex);
-			pthread_cond_signal(&inst->cond);
-			pthread_mutex_unlock(&inst->mutex);
+			continue;
 		}
-		if(inst->op.ttl <= 0)
-		{	
-			inst->op.abt = -1u;
-			inst->op.code = OP_NONE;
-			pthread_mutex_lock(&inst->mutex);
-			pthread_cond_signal(&inst->cond);
-			pthread_mutex_unlock(&inst->mutex);
-
+		if(s->ttl <= 0)
+		{
+			sdo_resp_cb(inst, s, -1u, NULL, 0);
 		}
-
-		inst->op.ttl -= delta_ms;
+		s->ttl -= delta_ms;
 	}
+	pthread_mutex_unlock(&inst->mutex);
 }
 
 /*
@@ -431,11 +468,31 @@ int usbcan_send_sdo_req(usbcan_instance_t *inst, bool write, uint8_t id,
  */
 int usbcan_send_com_frame(usbcan_instance_t *inst, can_msg_t *m)
 {
-	uint8_t dst[USB_CAN_MAX_PAYLOAD];
+	uint8_t dst[USB_CAN_COM_FRAME_MAX_SZ];
 	int l = usbcan_build_com_frame(dst, m);
 	return usbcan_write_fd(inst, dst, l);
 }
 
+/*
+ * Sends 'n' non-CanOpen genaric CAN frames at once (in array order).
+ */
+int usbcan_send_com_frames(usbcan_instance_t *inst, can_msg_t *m, int n)
+{
+	if(n <= 0)
+	{
+		return 0;
+	}
+
+	uint8_t dst[n * USB_CAN_COM_FRAME_MAX_SZ];
+	int l[n];
+
+	for(int i = 0, p = 0; i < n; p += l[i], i++)
+	{
+		l[i] = usbcan_build_com_frame(dst + p, &m[i]);
+	}
+	return usbcan_write_fd_multi(inst, dst, l, n);
+}
+
 /**
  * @brief Sends PDO message. 
  * 
@@ -525,7 +582,7 @@ static void usbcan_frame_receive_cb(usbcan_instance_t *inst, uint8_t *data, int
 				usbcan_parse_com_frame(&m, data, len);
 				if(inst->usbcan_com_frame_cb)
 				{
-					((usbcan_com_frame_cb_t)inst->usbcan_com_frame_cb)(inst, &m);
+					((usbcan_com_frame_cb_t)inst->usbcan_com_frame_cb)(inst, &m, inst->rx_data.ts);
 				}
 			}
 			break;	
@@ -552,17 +609,13 @@ static void usbcan_frame_receive_cb(usbcan_instance_t *inst, uint8_t *data, int
 				uint8_t sidx = get_ux_(data, &p, 1);
 				uint32_t abt = get_ux_(data, &p, 4);
 
-				if(inst->op.code == OP_SDO)
+				pthread_mutex_lock(&inst->mutex);
+				usbcan_sdo_t *s = sdo_find_busy(inst, id, true, idx, sidx);
+				if(s)
 				{
-					inst->op.code = OP_NONE;
-					if((inst->op.id == id) &&
-							(inst->op.idx == idx) &&
-							(inst->op.sidx == sidx) &&
-							(inst->op.write == true))
-					{
-						sdo_resp_cb(inst, abt, NULL, 0);
-					}
+					sdo_resp_cb(inst, s, abt, NULL, 0);
 				}
+				pthread_mutex_unlock(&inst->mutex);
 			}
 			break;
 
@@ -580,17 +633,13 @@ static void usbcan_frame_receive_cb(usbcan_instance_t *inst, uint8_t *data, int
 
 				LOG_DUMP(inst->comm_log, "SDO read data", data + p, len - p);
 			
-				if(inst->op.code == OP_SDO)
+				pthread_mutex_lock(&inst->mutex);
+				usbcan_sdo_t *s = sdo_find_busy(inst, id, false, idx, sidx);
+				if(s)
 				{
-					inst->op.code = OP_NONE;
-					if((inst->op.id == id) &&
-							(inst->op.idx == idx) &&
-							(inst->op.sidx == sidx) &&
-							(inst->op.write == false))
-					{
-						sdo_resp_cb(inst, abt, data + p, len - p);
-					}
+					sdo_resp_cb(inst, s, abt, data + p, len - p);
 				}
+				pthread_mutex_unlock(&inst->mutex);
 			}
 			break;
 
@@ -602,7 +651,7 @@ static void usbcan_frame_receive_cb(usbcan_instance_t *inst, uint8_t *data, int
 				uint8_t pdo_n = get_ux_(data, &p, 1);
 				len -= p;
 
-				((usbcan_pdo_cb_t)inst->usbcan_pdo_cb)(inst, id, pdo_n, len, &data[p]);
+				((usbcan_pdo_cb_t)inst->usbcan_pdo_cb)(inst, id, pdo_n, len, &data[p], inst->rx_data.ts);
 			}
 			break;
 
@@ -615,11 +664,6 @@ static void usbcan_frame_receive_cb(usbcan_instance_t *inst, uint8_t *data, int
 				uint8_t id = get_ux_(data, &p, 1) & 0x7f;
 				usbcan_nmt_state_t state = (usbcan_nmt_state_t)get_ux_(data, &p, 1);
 
-				if(state == CO_NMT_INITIALIZING)
-				{
-					inst->dev_boot_up[id] = true;
-				}
-
 				if((inst->dev_state[id] != state) || (inst->dev_alive[id] == -1))
 				{
 					inst->dev_state[id] = state;
@@ -638,9 +682,18 @@ static void usbcan_frame_receive_cb(usbcan_instance_t *inst, uint8_t *data, int
 				inst->dev_max_hb_ival[id] = MAX(inst->dev_max_hb_ival[id], inst->dev_hb_ival[id]);
 				inst->dev_alive[id] = inst->hb_alive_threshold;
 
+				pthread_mutex_lock(&inst->mutex);
+				if(state == CO_NMT_INITIALIZING)
+				{
+					inst->dev_boot_up[id] = true;
+				}
+				inst->dev_hb_seq[id]++;
+				pthread_cond_broadcast(&inst->hb_cond);
+				pthread_mutex_unlock(&inst->mutex);
+
 				if(inst->usbcan_hb_rx_cb)
 				{
-					((usbcan_hb_rx_cb_t)inst->usbcan_hb_rx_cb)(inst, id, state);
+					((usbcan_hb_rx_cb_t)inst->usbcan_hb_rx_cb)(inst, id, state, inst->rx_data.ts);
 				}
 			}
 			break;
@@ -667,7 +720,7 @@ static void usbcan_frame_receive_cb(usbcan_instance_t *inst, uint8_t *data, int
 				uint32_t err_info = get_ux_(data, &p, 4);
 				if(inst->usbcan_emcy_cb)
 				{
-					((usbcan_emcy_cb_t)inst->usbcan_emcy_cb)(inst, id, err_code, err_reg, err_bits, err_info);
+					((usbcan_emcy_cb_t)inst->usbcan_emcy_cb)(inst, id, err_code, err_reg, err_bits, err_info, inst->rx_data.ts);
 				}
 			}
 			break;
@@ -746,7 +799,7 @@ static int usbcan_rx(usbcan_instance_t *inst)
 /*
  * Default callback for handling emergency packets
  */
-static void emcy_cb(usbcan_instance_t *inst, int id, uint16_t code, uint8_t reg, uint8_t bits, uint32_t info)
+static void emcy_cb(usbcan_instance_t *inst, int id, uint16_t code, uint8_t reg, uint8_t bits, uint32_t info, int64_t ts_us)
 {
 	LOG_WARN(debug_log, "Emergency frame received: id(%" PRId8 ") code(0x%" PRIX16 ") reg(0x%" PRIX8 ") bits(0x%" PRIX8 ") info(0x%" PRIX32 ")",
 		id, code, reg, bits, info);
@@ -762,7 +815,7 @@ static void hb_tx_cb(usbcan_instance_t *inst)
 /*
  * Default callback for handling heart beat reception
  */
-static void hb_rx_cb(usbcan_instance_t *inst, int id, usbcan_nmt_state_t state)
+static void hb_rx_cb(usbcan_instance_t *inst, int id, usbcan_nmt_state_t state, int64_t ts_us)
 {
 }
 
@@ -1054,6 +1107,13 @@ static void usbcan_open_device(usbcan_instance_t *inst)
 			inst->fd = -1;
 			return;
 		}
+#ifdef SO_TIMESTAMPNS
+		int on = 1;
+		if(setsockopt(inst->fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) < 0)
+		{
+			LOG_WARN(debug_log, "%s: kernel RX timestamps are not available", __func__);
+		}
+#endif
 	}
 	else if((f = fopen(dev_addr, "r+")) != NULL)
 	{
@@ -1152,6 +1212,7 @@ static int win_comm_recv(usbcan_instance_t *inst)
 			LOG_ERROR(debug_log, "%s: ReadFile failed to read buffered data", __func__);
 			return 0;
 		}
+		inst->rx_data.ts = monotonic_us();
 	}
 	else
 	{
@@ -1165,6 +1226,40 @@ static int win_comm_recv(usbcan_instance_t *inst)
 
 
 
+/*
+ * Receives UDP datagram into 'rx_data'.
+ * RX time is taken from the kernel timestamp (SO_TIMESTAMPNS, realtime clock) when available
+ * and translated to the monotonic clock by the datagram age.
+ */
+static int usbcan_recv_udp(usbcan_instance_t *inst)
+{
+#if defined(SO_TIMESTAMPNS) && !defined(_WIN32)
+	uint8_t ctrl[CMSG_SPACE(sizeof(struct timespec))];
+	struct iovec iov = {.iov_base = inst->rx_data.b, .iov_len = USB_CAN_MAX_PAYLOAD};
+	struct msghdr msg = {.msg_iov = &iov, .msg_iovlen = 1, .msg_control = ctrl, .msg_controllen = sizeof(ctrl)};
+
+	int l = recvmsg(inst->fd, &msg, 0);
+	inst->rx_data.ts = monotonic_us();
+
+	for(struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c))
+	{
+		if((c->cmsg_level == SOL_SOCKET) && (c->cmsg_type == SCM_TIMESTAMPNS))
+		{
+			struct timespec kts, now;
+			memcpy(&kts, CMSG_DATA(c), sizeof(kts));
+			clock_gettime(CLOCK_REALTIME, &now);
+			int64_t age = (now.tv_sec - kts.tv_sec) * 1000000ll + (now.tv_nsec - kts.tv_nsec) / 1000;
+			inst->rx_data.ts -= CLIPL(age, 0);
+		}
+	}
+	return l;
+#else
+	int l = recv(inst->fd, (char*)inst->rx_data.b, USB_CAN_MAX_PAYLOAD, 0);
+	inst->rx_data.ts = monotonic_us();
+	return l;
+#endif
+}
+
 /*
  * Thread task.
  * Handles recieved data from USB<->CAN ot Ethernet<->CAN.
@@ -1218,11 +1313,12 @@ static void *usbcan_process(void *udata)
 				{
 					if(inst->usbcan_udp)
 					{
-						inst->rx_data.l = recv(inst->fd, (char*)inst->rx_data.b, USB_CAN_MAX_PAYLOAD, 0);
+						inst->rx_data.l = usbcan_recv_udp(inst);
 					}
 					else
 					{
 						inst->rx_data.l = read(inst->fd, (char*)inst->rx_data.b, USB_CAN_MAX_PAYLOAD);
+						inst->rx_data.ts = monotonic_us();
 					}
 
 					if(inst->rx_data.l <= 0)
@@ -1267,6 +1363,36 @@ void usbcan_setup_hb_tx_cb(usbcan_instance_t *inst, usbcan_hb_tx_cb_t cb, int64_
 	inst->usbcan_hb_tx_cb = (void*)cb;
 }
 
+/*
+ * Returns RX time (monotonic clock, us) of the frame being handled.
+ * Valid within the callbacks called by the interface thread.
+ */
+int64_t usbcan_get_rx_timestamp(usbcan_instance_t *inst)
+{
+	return inst->rx_data.ts;
+}
+
+/*
+ * Converts a host monotonic time (us) to the servo time: microseconds since the first trajectory sync 
+ * by modulus of 600 s, the epoch the servo clocks are locked to by the sync frames (see usbcan_send_traj_sync).
+ * Returns false until the first sync is sent.
+ */
+bool usbcan_get_sync_time(usbcan_instance_t *inst, int64_t ts_us, uint32_t *t)
+{
+	struct timeval now, epoch = inst->traj_sync_prev;
+
+	if(!epoch.tv_sec && !epoch.tv_usec)
+	{
+		return false;
+	}
+	gettimeofday(&now, NULL);
+
+	int64_t d = (TIME_DELTA_US(now, epoch) - (monotonic_us() - ts_us)) % 600000000ll;
+	*t = (uint32_t)(d < 0 ? d + 600000000ll : d);
+
+	return true;
+}
+
 void usbcan_setup_hb_rx_cb(usbcan_instance_t *inst, usbcan_hb_rx_cb_t cb)
 {
 	inst->usbcan_hb_rx_cb = (void*)cb;
@@ -1339,6 +1465,38 @@ usbcan_nmt_state_t usbcan_get_device_state(usbcan_instance_t *inst, int id)
 	return CO_NMT_HB_TIMEOUT;
 }
 
+/*
+ * Fills 'ids' & 'states' with devices which heart beats are being received.
+ * Returns total number of alive devices (may exceed 'max_n').
+ */
+int usbcan_get_alive_devices(usbcan_instance_t *inst, int *ids, usbcan_nmt_state_t *states, int max_n)
+{
+	int n = 0;
+
+	for(int i = 1; i < USB_CAN_MAX_DEV; i++)
+	{
+		usbcan_nmt_state_t state = inst->dev_state[i];
+
+		if((inst->dev_alive[i] <= 0) || (state == CO_NMT_HB_TIMEOUT))
+		{
+			continue;
+		}
+		if(n < max_n)
+		{
+			if(ids)
+			{
+				ids[n] = i;
+			}
+			if(states)
+			{
+				states[n] = state;
+			}
+		}
+		n++;
+	}
+	return n;
+}
+
 void usbcan_inhibit_master_hb(usbcan_instance_t *inst, bool inh)
 {
 	inst->inhibit_master_hb = inh;
@@ -1385,6 +1543,7 @@ usbcan_instance_t *usbcan_instance_init(const char *dev_name)
 	
 	inst->rx_data.t = 0;
 	inst->rx_data.h = 0;
+	inst->rx_data.ts = 0;
 	inst->rx_data.b = (uint8_t *)malloc(USB_CAN_MAX_PAYLOAD);
 	inst->rx_data.rb = (uint8_t *)malloc(USB_CAN_MAX_PAYLOAD);
 
@@ -1418,7 +1577,8 @@ usbcan_instance_t *usbcan_instance_init(const char *dev_name)
 	
 	pthread_mutex_init(&inst->mutex, NULL);
 	pthread_mutex_init(&inst->mutex_write, NULL);
-	pthread_cond_init(&inst->cond, NULL);
+	pthread_cond_init(&inst->sdo_cond, NULL);
+	pthread_cond_init(&inst->hb_cond, NULL);
 
 	inst->running = true;
 
@@ -1554,14 +1714,72 @@ int wait_device(usbcan_instance_t *inst, int id, int timeout_ms)
 	return wait_device_state(inst, id, CO_NMT_ANY, timeout_ms);
 }
 
-int wait_device_state(usbcan_instance_t *inst, int id, usbcan_nmt_state_t state, int timeout_ms)
+static void deadline_from_now(struct timespec *ts, int timeout_ms)
 {
-	if(!inst)
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	int64_t ns = (int64_t)tv.tv_usec * 1000 + (int64_t)(timeout_ms % 1000) * 1000000;
+	ts->tv_sec = tv.tv_sec + timeout_ms / 1000 + ns / 1000000000;
+	ts->tv_nsec = ns % 1000000000;
+}
+
+/*
+ * Waits for heart beats of 'n' devices listed in 'ids' with a single deadline for all of them.
+ * Devices that are already alive are not waited for.
+ * 'alive' (optional) is filled with the per device result.
+ * Returns the number of alive devices.
+ */
+int wait_devices(usbcan_instance_t *inst, const int *ids, int n, int timeout_ms, bool *alive)
+{
+	struct timespec deadline;
+	bool expired = false;
+	int n_alive;
+
+	if(!inst || !ids)
 	{
 		return 0;
 	}
 
-	if(id <= 0)
+	deadline_from_now(&deadline, MAX(timeout_ms, 0));
+
+	pthread_mutex_lock(&inst->mutex);
+	while(true)
+	{
+		n_alive = 0;
+		for(int i = 0; i < n; i++)
+		{
+			bool a = INRANGE(ids[i], 1, USB_CAN_MAX_DEV - 1) && (inst->dev_alive[ids[i]] > 0);
+			if(alive)
+			{
+				alive[i] = a;
+			}
+			n_alive += a;
+		}
+		if((n_alive == n) || expired)
+		{
+			break;
+		}
+		expired = pthread_cond_timedwait(&inst->hb_cond, &inst->mutex, &deadline) == ETIMEDOUT;
+	}
+	pthread_mutex_unlock(&inst->mutex);
+
+	for(int i = 0; alive && (i < n); i++)
+	{
+		if(!alive[i])
+		{
+			LOG_WARN(debug_log, "%s: device (%d) not found during timeout (%d) period", __func__, ids[i], timeout_ms);
+		}
+	}
+
+	return n_alive;
+}
+
+int wait_device_state(usbcan_instance_t *inst, int id, usbcan_nmt_state_t state, int timeout_ms)
+{
+	uint32_t seq;
+
+	if(!inst || (id <= 0))
 	{
 		return 0;
 	}
@@ -1571,33 +1789,91 @@ int wait_device_state(usbcan_instance_t *inst, int id, usbcan_nmt_state_t state,
 		return 1;
 	}
 
+	get_devices_hb_seq(inst, &id, 1, &seq);
+	return wait_devices_state(inst, &id, 1, state, &seq, timeout_ms, NULL);
+}
+
+/*
+ * Samples heart beat counters of the devices.
+ * Pass the result to 'wait_devices_state' to accept only heart beats received after the call
+ * (e.g., sample before sending an NMT command).
+ */
+void get_devices_hb_seq(usbcan_instance_t *inst, const int *ids, int n, uint32_t *seq)
+{
 	pthread_mutex_lock(&inst->mutex);
-	
-	inst->op.code = OP_WAIT_DEV_STATE;
-	inst->op.ttl = timeout_ms;
-	inst->op.state = state;
-	inst->op.id = id;
-	inst->op.abt = -1;
-	inst->dev_alive[inst->op.id] = -1;
-
-	pthread_cond_wait(&inst->cond, &inst->mutex);
+	for(int i = 0; i < n; i++)
+	{
+		seq[i] = INRANGE(ids[i], 1, USB_CAN_MAX_DEV - 1) ? inst->dev_hb_seq[ids[i]] : 0;
+	}
+	pthread_mutex_unlock(&inst->mutex);
+}
+
+/*
+ * Waits until all 'n' devices listed in 'ids' report 'state' (CO_NMT_ANY - any state) in their heart beats.
+ * When 'seq' is set (see 'get_devices_hb_seq'), only heart beats newer than 'seq' are taken into account.
+ * The waiter is woken up directly by the heart beat handler, any number of waiters may coexist.
+ * 'reached' (optional) is filled with the per device result.
+ * Returns 1 when all the devices have reached the state.
+ */
+int wait_devices_state(usbcan_instance_t *inst, const int *ids, int n, usbcan_nmt_state_t state, const uint32_t *seq, int timeout_ms, bool *reached)
+{
+	struct timespec deadline;
+	bool expired = false;
+	int n_reached;
+
+	if(!inst || !ids)
+	{
+		return 0;
+	}
+
+	deadline_from_now(&deadline, MAX(timeout_ms, 0));
+
+	pthread_mutex_lock(&inst->mutex);
+	while(true)
+	{
+		n_reached = 0;
+		for(int i = 0; i < n; i++)
+		{
+			int id = ids[i];
+			bool r = INRANGE(id, 1, USB_CAN_MAX_DEV - 1) && (inst->dev_alive[id] > 0) &&
+				(!seq || (inst->dev_hb_seq[id] != seq[i])) && 
+				((state == CO_NMT_ANY) || (inst->dev_state[id] == state));
+			if(reached)
+			{
+				reached[i] = r;
+			}
+			n_reached += r;
+		}
+		if((n_reached == n) || expired)
+		{
+			break;
+		}
+		expired = pthread_cond_timedwait(&inst->hb_cond, &inst->mutex, &deadline) == ETIMEDOUT;
+	}
 	pthread_mutex_unlock(&inst->mutex);
 
-	if(inst->op.abt)
+	if(n_reached != n)
 	{
-		LOG_WARN(debug_log, "%s: device (%d) not entered into desired (%d), mode during timeout (%d) period", __func__, id, state, timeout_ms);
+		LOG_WARN(debug_log, "%s: %d of %d device(s) not entered into desired (%d), mode during timeout (%d) period", 
+				__func__, n - n_reached, n, state, timeout_ms);
 	}
 
-	return !inst->op.abt;
+	return n_reached == n;
 }
 
 void clear_device_boot_up_flag(usbcan_instance_t *inst, int id)
 {
+	pthread_mutex_lock(&inst->mutex);
 	inst->dev_boot_up[id] = false;
+	pthread_mutex_unlock(&inst->mutex);
 }
 
 int wait_device_boot_up(usbcan_instance_t *inst, int id, int timeout_ms)
 {
+	struct timespec deadline;
+	bool expired = false;
+	bool booted;
+
 	if(!inst)
 	{
 		return 0;
@@ -1613,22 +1889,22 @@ int wait_device_boot_up(usbcan_instance_t *inst, int id, int timeout_ms)
 		return 1;
 	}
 
-	pthread_mutex_lock(&inst->mutex);
-	
-	inst->op.code = OP_WAIT_DEV_BOOT_UP;
-	inst->op.ttl = timeout_ms;
-	inst->op.id = id;
-	inst->op.abt = -1;
+	deadline_from_now(&deadline, timeout_ms);
 
-	pthread_cond_wait(&inst->cond, &inst->mutex);
+	pthread_mutex_lock(&inst->mutex);
+	while(!(booted = inst->dev_boot_up[id]) && !expired)
+	{
+		expired = pthread_cond_timedwait(&inst->hb_cond, &inst->mutex, &deadline) == ETIMEDOUT;
+	}
+	inst->dev_boot_up[id] = false;
 	pthread_mutex_unlock(&inst->mutex);
 
-	if(inst->op.abt)
+	if(!booted)
 	{
 		LOG_WARN(debug_log, "%s: device (%d) sent no boot-up messages during timeout (%d) period", __func__, id, timeout_ms);
 	}
 
-	return !inst->op.abt;
+	return booted;
 }
 
 int write_nmt(usbcan_instance_t *inst, int id, usbcan_nmt_cmd_t cmd)
@@ -1667,103 +1943,358 @@ int write_com_frame(usbcan_instance_t *inst, can_msg_t *msg)
 	return 1;
 }
 
-uint32_t write_raw_sdo(usbcan_device_t *dev, uint16_t idx, uint8_t sidx, uint8_t *data, int len, int retry, int timeout_ms)
+/*
+ * Checks whether SDO slot was issued no more than 'max_age_ms' ago.
+ */
+static bool sdo_is_fresh(usbcan_sdo_t *s, int max_age_ms)
 {
-	if(!is_valid_device(dev))
+	struct timeval now;
+
+	if(max_age_ms < 0)
 	{
-		return -1;
+		return false;
 	}
+	gettimeofday(&now, NULL);
+	return TIME_DELTA_MS(now, s->issued) <= max_age_ms;
+}
 
+/*
+ * Looks up read transaction (in flight or completed) of the same object 
+ * which satisfies caller freshness bound.
+ * Should be called with instance mutex locked.
+ */
+static usbcan_sdo_t *sdo_find_shared(usbcan_instance_t *inst, int id, int idx, int sidx, int max_age_ms)
+{
+	for(int i = 0; i < USB_CAN_MAX_SDO_IN_FLIGHT; i++)
+	{
+		usbcan_sdo_t *s = &inst->sdo[i];
+		if((s->busy || s->valid) && !s->write && (s->id == id) && 
+				(s->idx == idx) && (s->sidx == sidx) && sdo_is_fresh(s, max_age_ms))
+		{
+			return s;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Allocates free SDO slot for the node.
+ * Only one transaction per node can be in flight (single SDO server channel),
+ * the least recently issued idle slot is reused first.
+ * Should be called with instance mutex locked.
+ * Returns NULL if node is busy or all slots are in use.
+ */
+static usbcan_sdo_t *sdo_alloc(usbcan_instance_t *inst, int id)
+{
+	usbcan_sdo_t *free_s = NULL;
+
+	for(int i = 0; i < USB_CAN_MAX_SDO_IN_FLIGHT; i++)
+	{
+		usbcan_sdo_t *s = &inst->sdo[i];
+		if(s->busy && (s->id == id))
+		{
+			return NULL;
+		}
+		if(s->busy || s->refs)
+		{
+			continue;
+		}
+		if(!free_s)
+		{
+			free_s = s;
+		}
+		else if(free_s->valid && (!s->valid || timercmp(&s->issued, &free_s->issued, <)))
+		{
+			free_s = s;
+		}
+	}
+
+	return free_s;
+}
+
+/*
+ * Drops cached read results of the object being written.
+ * Should be called with instance mutex locked.
+ */
+static void sdo_invalidate(usbcan_instance_t *inst, int id, int idx, int sidx)
+{
+	for(int i = 0; i < USB_CAN_MAX_SDO_IN_FLIGHT; i++)
+	{
+		usbcan_sdo_t *s = &inst->sdo[i];
+		if((s->id == id) && (s->idx == idx) && (s->sidx == sidx))
+		{
+			s->valid = false;
+		}
+	}
+}
+
+/*
+ * Issues SDO request or attaches to an identical read in flight 
+ * (when 'max_age_ms' >= 0) and waits for its completion.
+ * Returns abort code, result data are placed into 'data' & 'len'.
+ */
+static uint32_t sdo_transfer(usbcan_device_t *dev, bool write, uint16_t idx, uint8_t sidx, 
+		uint8_t *data, int *len, int retry, int timeout_ms, int max_age_ms)
+{
 	usbcan_instance_t *inst = dev->inst;
+	usbcan_sdo_t *s;
+	uint32_t seq;
 
 	pthread_mutex_lock(&inst->mutex);
 
-	inst->op.code = OP_SDO;
-	inst->op.write = true;
-	inst->op.id = dev->id;
-	inst->op.idx = idx;
-	inst->op.sidx = sidx;
-	inst->op.tout = timeout_ms ? timeout_ms : dev->timeout;
-	inst->op.re_txn = retry ? retry : dev->retry;
-	inst->op.ttl = inst->op.tout * 2;
-	inst->op.len = len;
+	while(1)
+	{
+		if(!write && (s = sdo_find_shared(inst, dev->id, idx, sidx, max_age_ms)) != NULL)
+		{
+			if(!s->busy)
+			{
+				/*Completed recently enough, no need to go to the bus*/
+				s->refs++;
+				break;
+			}
+			s->refs++;
+			seq = s->seq;
+			while(s->seq == seq)
+			{
+				pthread_cond_wait(&inst->sdo_cond, &inst->mutex);
+			}
+			break;
+		}
+
+		if((s = sdo_alloc(inst, dev->id)) != NULL)
+		{
+			if(write)
+			{
+				sdo_invalidate(inst, dev->id, idx, sidx);
+			}
+			s->busy = true;
+			s->valid = false;
+			s->write = write;
+			s->id = dev->id;
+			s->idx = idx;
+			s->sidx = sidx;
+			s->tout = timeout_ms ? timeout_ms : dev->timeout;
+			s->re_txn = retry ? retry : dev->retry;
+			s->ttl = s->tout * 2;
+			s->len = *len;
+			s->refs = 1;
+			gettimeofday(&s->issued, NULL);
+			seq = s->seq;
+
+			usbcan_send_sdo_req(inst, write, dev->id, idx, sidx, timeout_ms, retry, data, *len);
+
+			while(s->seq == seq)
+			{
+				pthread_cond_wait(&inst->sdo_cond, &inst->mutex);
+			}
+			break;
+		}
+
+		pthread_cond_wait(&inst->sdo_cond, &inst->mutex);
+	}
 
-	usbcan_send_sdo_req(inst, true, dev->id, idx, sidx, timeout_ms, retry, data, len);
+	uint32_t abt = s->abt;
 
-	pthread_cond_wait(&inst->cond, &inst->mutex);
-	pthread_mutex_unlock(&inst->mutex);
+	if(!abt && !write)
+	{
+		if(s->len > *len)
+		{
+			LOG_WARN(debug_log, "%s: supplied buffer of %d bytes to small, %d bytes required", __func__, *len, s->len);
+		}
+		else
+		{
+			*len = s->len;
+		}
+		memcpy(data, s->data, *len);
+	}
 
-	if(inst->op.abt)
+	if(abt)
 	{
 		LOG_ERROR(debug_log, "%s: SDO failed id(%d) idx(0x%X) sidx(%d), len(%d), re_txn(%d), tout(%d) with abort-code(0x%.X):\n    %s", 
-					__func__,
-					inst->op.id,
+					write ? "write_raw_sdo" : "read_raw_sdo",
+					s->id,
 					(unsigned int)idx, 
 					(int)sidx, 
-					len, 
-					inst->op.re_txn, 
-					inst->op.tout, 
-					(unsigned int)inst->op.abt, 
-					sdo_describe_error(inst->op.abt));
+					*len, 
+					s->re_txn, 
+					s->tout, 
+					(unsigned int)abt, 
+					sdo_describe_error(abt));
+	}
+
+	s->refs--;
+	if(!s->refs)
+	{
+		pthread_cond_broadcast(&inst->sdo_cond);
 	}
 
-	return inst->op.abt;
+	pthread_mutex_unlock(&inst->mutex);
+
+	return abt;
 }
 
-uint32_t read_raw_sdo(usbcan_device_t *dev, uint16_t idx, uint8_t sidx, uint8_t *data, int *len, int retry, int timeout_ms)
+/*
+ * Executes set of SDO requests keeping as many of them on the bus as possible
+ * (one per node, up to USB_CAN_MAX_SDO_IN_FLIGHT in total).
+ * Requests to the same node are executed in array order.
+ * If 'skip_node_on_error' is set, the rest of requests to the node which 
+ * failed are not sent (their 'done' flag stays false).
+ * Returns number of requests completed without abort.
+ */
+int batch_raw_sdo(usbcan_instance_t *inst, usbcan_sdo_req_t *req, int n, bool skip_node_on_error)
 {
-	if(!is_valid_device(dev))
+	enum {REQ_WAITING, REQ_ON_BUS, REQ_FINISHED};
+
+	usbcan_sdo_t *slot[n > 0 ? n : 1];
+	uint32_t seq[n > 0 ? n : 1];
+	uint8_t st[n > 0 ? n : 1];
+	bool failed[USB_CAN_MAX_DEV] = {false};
+	int lo = 0, hi = 0, ok = 0;
+
+	if(!is_valid_instance(inst))
 	{
-		return -1;
+		return 0;
 	}
 
-	usbcan_instance_t *inst = dev->inst;
+	for(int k = 0; k < n; k++)
+	{
+		st[k] = REQ_WAITING;
+		req[k].done = false;
+		req[k].abt = -1u;
+	}
 
 	pthread_mutex_lock(&inst->mutex);
 
-	inst->op.code = OP_SDO;
-	inst->op.write = false;
-	inst->op.id = dev->id;
-	inst->op.idx = idx;
-	inst->op.sidx = sidx;
-	inst->op.tout = timeout_ms ? timeout_ms : dev->timeout;
-	inst->op.re_txn = retry ? retry : dev->retry;
-	inst->op.ttl = inst->op.tout * 2;
-	inst->op.len = *len;
+	while(lo < n)
+	{
+		bool blocked[USB_CAN_MAX_DEV] = {false};
 
-	usbcan_send_sdo_req(inst, false, dev->id, idx, sidx, timeout_ms, retry,	data, *len);
+		/*Collect completed transactions*/
+		for(int k = lo; k < hi; k++)
+		{
+			usbcan_sdo_t *s = slot[k];
+			if((st[k] != REQ_ON_BUS) || (s->seq == seq[k]))
+			{
+				continue;
+			}
+			st[k] = REQ_FINISHED;
+			req[k].abt = s->abt;
+			req[k].done = true;
+			if(!s->abt)
+			{
+				if(!req[k].write)
+				{
+					req[k].len = MIN(req[k].len, s->len);
+					memcpy(req[k].data, s->data, req[k].len);
+				}
+				ok++;
+			}
+			else
+			{
+				failed[req[k].id & 0x7f] = true;
+				LOG_ERROR(debug_log, "%s: SDO failed id(%d) idx(0x%X) sidx(%d) with abort-code(0x%.X):\n    %s", 
+						__func__, req[k].id, (unsigned int)req[k].idx, (int)req[k].sidx,
+						(unsigned int)s->abt, sdo_describe_error(s->abt));
+			}
+			s->refs--;
+		}
 
-	pthread_cond_wait(&inst->cond, &inst->mutex);
-	pthread_mutex_unlock(&inst->mutex);
+		/*Issue as many requests as possible, keeping per node order*/
+		for(int k = lo; k < n; k++)
+		{
+			int id = req[k].id & 0x7f;
 
-	if(!inst->op.abt)
-	{
-		if(inst->op.len > *len)
+			if((st[k] != REQ_WAITING) || blocked[id])
+			{
+				continue;
+			}
+			if(skip_node_on_error && failed[id])
+			{
+				st[k] = REQ_FINISHED;
+				continue;
+			}
+
+			usbcan_sdo_t *s = sdo_alloc(inst, id);
+			if(!s)
+			{
+				blocked[id] = true;
+				continue;
+			}
+			if(req[k].write)
+			{
+				sdo_invalidate(inst, id, req[k].idx, req[k].sidx);
+			}
+			s->busy = true;
+			s->valid = false;
+			s->write = req[k].write;
+			s->id = id;
+			s->idx = req[k].idx;
+			s->sidx = req[k].sidx;
+			s->tout = req[k].tout ? req[k].tout : 1000;
+			s->re_txn = req[k].retry ? req[k].retry : 1;
+			s->ttl = s->tout * 2;
+			s->len = req[k].len;
+			s->refs = 1;
+			gettimeofday(&s->issued, NULL);
+			slot[k] = s;
+			seq[k] = s->seq;
+			st[k] = REQ_ON_BUS;
+			hi = MAX(hi, k + 1);
+
+			usbcan_send_sdo_req(inst, req[k].write, id, req[k].idx, req[k].sidx, 
+					req[k].tout, req[k].retry, req[k].data, req[k].len);
+		}
+
+		while((lo < n) && (st[lo] == REQ_FINISHED))
 		{
-			LOG_WARN(debug_log, "%s: supplied buffer of %d bytes to small, %d bytes required", __func__, *len, inst->op.len);
+			lo++;
 		}
-		else
+
+		if(lo < n)
 		{
-			*len = inst->op.len;
+			pthread_cond_wait(&inst->sdo_cond, &inst->mutex);
 		}
-		memcpy(data, inst->op.data, *len);
 	}
-	else
+
+	pthread_cond_broadcast(&inst->sdo_cond);
+	pthread_mutex_unlock(&inst->mutex);
+
+	return ok;
+}
+
+uint32_t write_raw_sdo(usbcan_device_t *dev, uint16_t idx, uint8_t sidx, uint8_t *data, int len, int retry, int timeout_ms)
+{
+	if(!is_valid_device(dev))
 	{
-		LOG_ERROR(debug_log, "%s: SDO failed id(%d) idx(0x%X) sidx(%d), len(%d), re_txn(%d), tout(%d) with abort-code(0x%.X):\n    %s", 
-					__func__,
-					inst->op.id,
-					(unsigned int)idx, 
-					(int)sidx, 
-					*len, 
-					inst->op.re_txn, 
-					inst->op.tout, 
-					(unsigned int)inst->op.abt, 
-					sdo_describe_error(inst->op.abt));
+		return -1;
 	}
 
-	return inst->op.abt;
+	return sdo_transfer(dev, true, idx, sidx, data, &len, retry, timeout_ms, -1);
 }
 
+uint32_t read_raw_sdo(usbcan_device_t *dev, uint16_t idx, uint8_t sidx, uint8_t *data, int *len, int retry, int timeout_ms)
+{
+	if(!is_valid_device(dev))
+	{
+		return -1;
+	}
 
+	return sdo_transfer(dev, false, idx, sidx, data, len, retry, timeout_ms, -1);
+}
 
+/*
+ * Same as read_raw_sdo, but shares result with concurrent callers:
+ * if identical read to the same node is in flight (or has just completed)
+ * and it was issued no more than 'max_age_ms' milliseconds ago, 
+ * the caller gets its result instead of issuing a new request.
+ * Negative 'max_age_ms' disables coalescing.
+ */
+uint32_t read_raw_sdo_coalesced(usbcan_device_t *dev, uint16_t idx, uint8_t sidx, uint8_t *data, int *len, int retry, int timeout_ms, int max_age_ms)
+{
+	if(!is_valid_device(dev))
+	{
+		return -1;
+	}
+
+	return sdo_transfer(dev, false, idx, sidx, data, len, retry, timeout_ms, max_age_ms);
+}
@@ -47,29 +47,30 @@ typedef struct
 typedef struct usbcan_instance_t usbcan_instance_t;
 typedef struct usbcan_device_t usbcan_device_t;
 
-typedef enum
-{
-	OP_NONE,
-	OP_WAIT_DEV_STATE,
-	OP_WAIT_DEV_BOOT_UP,
-	OP_SDO,
-} usbcan_op_code_t;
-
+/*
+ * SDO transaction slot.
+ * A slot is 'busy' while the request is on the bus. After completion
+ * a successful read keeps its result ('valid') until the slot is reused,
+ * so callers with loose freshness bounds may take it without bus traffic.
+ */
 typedef struct
 {
-		usbcan_op_code_t code;
-		int tout;
+		bool busy;
+		bool valid;
 		bool write;
 		int id;
 		int idx;
 		int sidx;
-		int len;
-		int ttl;
-		usbcan_nmt_state_t state;
+		int tout;
 		int re_txn;
-		uint8_t data[8192];
+		int ttl;
+		int refs;
+		uint32_t seq;
+		struct timeval issued;
 		uint32_t abt;
-} usbcan_op_t;
+		int len;
+		uint8_t data[USB_CAN_MAX_SDO_PAYLOAD];
+} usbcan_sdo_t;
 
 typedef struct
 {
@@ -82,8 +83,26 @@ typedef struct
 	#else
 	int l;
 #endif
+	int64_t ts; //RX time of 'b' (monotonic clock, us)
 } usbcan_rx_data_t;
 
+/*
+ * Request descriptor for pipelined SDO transfers (see batch_raw_sdo).
+ */
+typedef struct
+{
+		int id;
+		bool write;
+		uint16_t idx;
+		uint8_t sidx;
+		uint8_t *data;
+		int len;
+		int retry;
+		int tout;
+		bool done;
+		uint32_t abt;
+} usbcan_sdo_req_t;
+
 struct usbcan_instance_t
 {
 	void *udata;
@@ -102,9 +121,10 @@ struct usbcan_instance_t
 
 	pthread_t usbcan_thread;
 	pthread_mutex_t mutex, mutex_write;
-	pthread_cond_t cond;
 
-	usbcan_op_t op;
+	pthread_cond_t sdo_cond;
+	pthread_cond_t hb_cond;
+	usbcan_sdo_t sdo[USB_CAN_MAX_SDO_IN_FLIGHT];
 
 	void *usbcan_hb_tx_cb;
 	void *usbcan_hb_rx_cb;
@@ -125,6 +145,7 @@ struct usbcan_instance_t
 	bool send_traj_sync_enable;
 
 	int64_t dev_alive[USB_CAN_MAX_DEV];
+	uint32_t dev_hb_seq[USB_CAN_MAX_DEV];
 	bool dev_boot_up[USB_CAN_MAX_DEV];
 	int64_t dev_hb_ival[USB_CAN_MAX_DEV];
 	int64_t dev_min_hb_ival[USB_CAN_MAX_DEV];
@@ -149,11 +170,11 @@ struct usbcan_device_t
 };
 
 typedef void (*usbcan_hb_tx_cb_t)(usbcan_instance_t *inst);
-typedef void (*usbcan_hb_rx_cb_t)(usbcan_instance_t *inst, int id, usbcan_nmt_state_t state);
+typedef void (*usbcan_hb_rx_cb_t)(usbcan_instance_t *inst, int id, usbcan_nmt_state_t state, int64_t ts_us);
 typedef void (*usbcan_nmt_state_cb_t)(usbcan_instance_t *inst, int id, usbcan_nmt_state_t state);
-typedef void (*usbcan_com_frame_cb_t)(usbcan_instance_t *inst, can_msg_t *m);
-typedef void (*usbcan_pdo_cb_t)(usbcan_instance_t *inst, int id, int pdo_n, int len, uint8_t *data);
-typedef void (*usbcan_emcy_cb_t)(usbcan_instance_t *inst, int id, uint16_t err_code, uint8_t err_reg, uint8_t err_bits, uint32_t err_info);
+typedef void (*usbcan_com_frame_cb_t)(usbcan_instance_t *inst, can_msg_t *m, int64_t ts_us);
+typedef void (*usbcan_pdo_cb_t)(usbcan_instance_t *inst, int id, int pdo_n, int len, uint8_t *data, int64_t ts_us);
+typedef void (*usbcan_emcy_cb_t)(usbcan_instance_t *inst, int id, uint16_t err_code, uint8_t err_reg, uint8_t err_bits, uint32_t err_info, int64_t ts_us);
 
 extern const char *CAN_OPEN_CMD[];
 extern FILE *debug_log;
@@ -166,6 +187,9 @@ void usbcan_setup_com_frame_cb(usbcan_instance_t *inst, usbcan_com_frame_cb_t cb
 void usbcan_setup_pdo_cb(usbcan_instance_t *inst, usbcan_pdo_cb_t cb);
 
 usbcan_nmt_state_t usbcan_get_device_state(usbcan_instance_t *inst, int id);
+int64_t usbcan_get_rx_timestamp(usbcan_instance_t *inst);
+bool usbcan_get_sync_time(usbcan_instance_t *inst, int64_t ts_us, uint32_t *t);
+int usbcan_get_alive_devices(usbcan_instance_t *inst, int *ids, usbcan_nmt_state_t *states, int max_n);
 int64_t usbcan_get_hb_interval(usbcan_instance_t *inst, int id);
 int64_t usbcan_get_min_hb_interval(usbcan_instance_t *inst, int id);
 int64_t usbcan_get_max_hb_interval(usbcan_instance_t *inst, int id);
@@ -184,11 +208,16 @@ int usbcan_device_deinit(usbcan_device_t **dev);
  * User thread functions
  */
 int wait_device(usbcan_instance_t *inst, int id, int timeout_ms);
+int wait_devices(usbcan_instance_t *inst, const int *ids, int n, int timeout_ms, bool *alive);
 int wait_device_state(usbcan_instance_t *inst, int id, usbcan_nmt_state_t state, int timeout_ms);
+void get_devices_hb_seq(usbcan_instance_t *inst, const int *ids, int n, uint32_t *seq);
+int wait_devices_state(usbcan_instance_t *inst, const int *ids, int n, usbcan_nmt_state_t state, const uint32_t *seq, int timeout_ms, bool *reached);
 void clear_device_boot_up_flag(usbcan_instance_t *inst, int id);
 int wait_device_boot_up(usbcan_instance_t *inst, int id, int timeout_ms);
 uint32_t write_raw_sdo(usbcan_device_t *dev, uint16_t idx, uint8_t sidx, uint8_t *data, int len, int retry, int timeout_ms);
 uint32_t read_raw_sdo(usbcan_device_t *dev, uint16_t idx, uint8_t sidx, uint8_t *data, int *len, int retry, int timeout_ms);
+int batch_raw_sdo(usbcan_instance_t *inst, usbcan_sdo_req_t *req, int n, bool skip_node_on_error);
+uint32_t read_raw_sdo_coalesced(usbcan_device_t *dev, uint16_t idx, uint8_t sidx, uint8_t *data, int *len, int retry, int timeout_ms, int max_age_ms);
 int write_com_frame(usbcan_instance_t *inst, can_msg_t *msg);
 int write_timestamp(usbcan_instance_t *inst, uint32_t ts);
 int write_nmt(usbcan_instance_t *inst, int id, usbcan_nmt_cmd_t cmd);
@@ -201,6 +230,7 @@ int usbcan_send_sdo_req(usbcan_instance_t *inst, bool write, uint8_t id,
 		void *data, uint16_t len);
 void usbcan_send_master_hb(usbcan_instance_t *inst);
 int usbcan_send_com_frame(usbcan_instance_t *inst, can_msg_t *m);
+int usbcan_send_com_frames(usbcan_instance_t *inst, can_msg_t *m, int n);
 int usbcan_send_nmt(usbcan_instance_t *inst, int id, usbcan_nmt_cmd_t cmd);
 int usbcan_send_hb(usbcan_instance_t *inst, int id, usbcan_nmt_state_t state) __attribute__((unused));
 int usbcan_send_timestamp(usbcan_instance_t *inst, uint32_t ts);
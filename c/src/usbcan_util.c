@@ -57,3 +57,19 @@ void msleep(uint32_t ms)
 	#endif  
 }
 
+/*
+ * Returns monotonic time in microseconds.
+ */
+int64_t monotonic_us(void)
+{
+	#ifdef _WIN32
+	LARGE_INTEGER f, c;
+	QueryPerformanceFrequency(&f);
+	QueryPerformanceCounter(&c);
+	return (c.QuadPart / f.QuadPart) * 1000000ll + (c.QuadPart % f.QuadPart) * 1000000ll / f.QuadPart;
+	#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000ll + ts.tv_nsec / 1000;
+	#endif  
+}
@@ -14,6 +14,7 @@ extern "C"
 #include <string.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <time.h>
 
 #ifndef PI
 #define PI 3.141592653589793f
@@ -57,6 +58,7 @@ uint64_t get_ix_(uint8_t *d, int *p, int x);
 void set_ux_(uint8_t *d, int *p, int x, uint64_t v);
 
 void msleep(uint32_t ms);
+int64_t monotonic_us(void);
 
 #ifdef __cplusplus
 }
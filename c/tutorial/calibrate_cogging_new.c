@@ -78,19 +78,7 @@ int main(int argc, char *argv[])
 	//! [Init servo31]
 
 	//! [Switching to operational state1]
-	rr_servo_set_state_operational(servo);
-
-	rr_nmt_state_t state = 0;
-	for(int i = 0; i < 20; i++)
-	{
-		rr_sleep_ms(100);
-		rr_servo_get_state(servo, &state);
-		if(state == RR_NMT_OPERATIONAL)
-		{
-			break;
-		}
-	}
-	if(state != RR_NMT_OPERATIONAL)
+	if(rr_servo_set_state_and_wait(servo, RR_NMT_OPERATIONAL, 2000) != RET_OK)
 	{
 		API_DEBUG("Can't switch tot operational mode\n");
 		exit(1);
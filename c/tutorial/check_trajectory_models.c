@@ -0,0 +1,381 @@
+/**
+ * @brief Verifying the trajectory model and planners
+ * @file check_trajectory_models.c
+ * @author Rozum
+ * @date 2026-10-18
+ */
+
+#include "api.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * \defgroup tutor_c_check_trajectory_models Verifying the trajectory model and planners
+ * The tutorial verifies the host-side trajectory functions without connecting a servo.
+ * A failed check is reported with an "ERROR:" line and a non-zero exit code.
+ *
+ * 1. Compile PVAT and PVT points with ::rr_trj_compile, sample them with ::rr_trj_sample and compare the positions
+ * with the reference output of debug-tools/qupsample.m for the same points.
+ * \snippet check_trajectory_models.c Check interpolator
+ * 2. Plan S-curve motions with ::rr_plan_scurve from rest and from moving states,
+ * and validate them with ::rr_check_trajectory using the planning limits.
+ * \snippet check_trajectory_models.c Check S-curve
+ * 3. Blend a sequence of waypoints with ::rr_init_blend and validate the result the same way.
+ * \snippet check_trajectory_models.c Check blending
+ * 4. Fit a sampled path with ::rr_trj_fit, compare the fitted trajectory with the samples
+ * and validate it against the limits of the sampled path.
+ * \snippet check_trajectory_models.c Check fit
+ * 5. Write a trajectory file with ::rr_trj_file_write and convert the same points from CSV with ::rr_trj_file_from_csv,
+ * then read both files back with ::rr_trj_file_get_axis and ::rr_trj_file_source and compare them with the written points.
+ * Malformed CSV lines (a fractional or out-of-range time, a line that is too long) must be rejected.
+ * \snippet check_trajectory_models.c Check trajectory file
+ *
+ *<b> Complete tutorial code: </b>
+ * \snippet check_trajectory_models.c check_trajectory_models_code_full
+ */
+
+//! [check_trajectory_models_code_full]
+#define REF_STEP_S 0.03125
+#define REF_SAMPLES 33
+#define REF_TOL_DEG 1e-4
+
+/*
+ * The reference trajectory: start at rest at 0, the points at 0.25 s, 0.75 s and 1 s.
+ * The positions are the output of qupsample(pt, 0.03125) with
+ * pt.p = [0 12 30 35], pt.v = [0 40 20 0], pt.a = [0 100 -150 0], pt.t = [0 0.25 0.75 1],
+ * and pt.o = [3 3 3] for the PVT (cubic) one.
+ */
+static const rr_motion_point_t ref_start = {0, 0, 0, 0};
+static const rr_motion_point_t ref_points[] = {
+	{12, 40, 100, 250},
+	{30, 20, -150, 500},
+	{35, 0, 0, 250}};
+
+static const float ref_pvat[REF_SAMPLES] = {
+	0.000000, 0.135349, 0.888794, 2.419292, 4.535156, 6.859303,
+	8.994507, 10.688656, 12.000000, 13.290499, 14.632652, 15.990689,
+	17.338623, 18.658739, 19.940071, 21.176891, 22.367188, 23.511155,
+	24.609673, 25.662791, 26.668213, 27.619781, 28.505959, 29.308313,
+	30.000000, 30.606909, 31.316833, 32.187853, 33.134766, 34.001188,
+	34.631653, 34.943705, 35.000000};
+
+static const float ref_pvt[REF_SAMPLES] = {
+	0.000000, 0.378906, 1.406250, 2.917969, 4.750000, 6.738281,
+	8.718750, 10.527344, 12.000000, 13.264160, 14.550781, 15.851074,
+	17.156250, 18.457520, 19.746094, 21.013184, 22.250000, 23.447754,
+	24.597656, 25.690918, 26.718750, 27.672363, 28.542969, 29.321777,
+	30.000000, 30.693359, 31.484375, 32.314453, 33.125000, 33.857422,
+	34.453125, 34.853516, 35.000000};
+
+//! [Check interpolator]
+static int check_model(bool pvat, const float *ref)
+{
+	const int n = sizeof(ref_points) / sizeof(ref_points[0]);
+	rr_trj_segment_t seg[sizeof(ref_points) / sizeof(ref_points[0])];
+	float pos[REF_SAMPLES];
+
+	if((rr_trj_compile(&ref_start, ref_points, n, pvat, seg) != RET_OK) ||
+			(rr_trj_sample_count(seg, n, REF_STEP_S) != REF_SAMPLES) ||
+			(rr_trj_sample(seg, n, REF_STEP_S, pos, NULL, NULL, REF_SAMPLES) != REF_SAMPLES))
+	{
+		API_DEBUG("%s model: sampling failed\n", pvat ? "PVAT" : "PVT");
+		return 1;
+	}
+
+	double err = 0;
+	for(int k = 0; k < REF_SAMPLES; k++)
+	{
+		err = fmax(err, fabs(pos[k] - ref[k]));
+	}
+
+	API_DEBUG("%s model: max deviation from qupsample.m %.6f deg %s\n", pvat ? "PVAT" : "PVT", err, err > REF_TOL_DEG ? "FAIL" : "OK");
+	return err > REF_TOL_DEG;
+}
+//! [Check interpolator]
+
+static int check_points(const char *name, const rr_motion_point_t *start, const rr_motion_point_t *points, int n,
+		const rr_trj_limits_t *limits)
+{
+	rr_trj_report_t report = {0};
+	rr_ret_status_t ret = rr_check_trajectory(start, points, n, true, limits, &report);
+
+	API_DEBUG("%s: %d points, peak velocity %.2f, acceleration %.2f, jerk %.2f, %d violating segments %s\n",
+			name, n, report.velocity_max_deg_per_sec, report.accel_max_deg_per_sec2, report.jerk_max_deg_per_sec3,
+			report.violations, ret == RET_OK ? "OK" : "FAIL");
+	return ret != RET_OK;
+}
+
+//! [Check S-curve]
+static int check_scurve(void)
+{
+	const rr_trj_limits_t limits = {100, 300, 2000};
+	const rr_motion_point_t starts[] = {
+		{0, 0, 0, 0},
+		{0, 50, 0, 0},
+		{0, 80, 250, 0},
+		{0, -60, -100, 0},
+		{0, 90, -200, 0}};
+	const float targets[] = {90, 0.5, 40, 30, -20};
+	int fails = 0;
+
+	for(unsigned k = 0; k < sizeof(targets) / sizeof(targets[0]); k++)
+	{
+		rr_motion_point_t points[RR_SCURVE_MAX_POINTS];
+		int n;
+		char name[64];
+
+		snprintf(name, sizeof(name), "S-curve %.1f (%.0f, %.0f) -> %.1f",
+				starts[k].position_deg, starts[k].velocity_deg_per_sec, starts[k].accel_deg_per_sec2, targets[k]);
+		if(rr_plan_scurve(&starts[k], targets[k], &limits, points, &n, NULL) != RET_OK)
+		{
+			API_DEBUG("%s: planning failed\n", name);
+			fails++;
+			continue;
+		}
+		fails += check_points(name, &starts[k], points, n, &limits);
+	}
+
+	return fails;
+}
+//! [Check S-curve]
+
+//! [Check blending]
+static int check_blend(float tol_deg)
+{
+	const rr_trj_limits_t limits = {100, 300, 0};
+	const float waypoints[] = {30, 60, 61, 90, 50, 50.5, 120, 130, 10};
+	const int n_wp = sizeof(waypoints) / sizeof(waypoints[0]);
+	rr_motion_point_t start = {0, 0, 0, 0};
+	rr_motion_point_t points[n_wp * RR_BLEND_MAX_POINTS];
+	rr_blend_t *blend = rr_init_blend(start.position_deg, &limits, 4);
+	int n = 0;
+
+	if(!blend)
+	{
+		API_DEBUG("Blending: init failed\n");
+		return 1;
+	}
+
+	for(int k = 0; k < n_wp; k++)
+	{
+		//a full look-ahead is emitted before the next waypoint is added
+		if(rr_blend_add_waypoint(blend, waypoints[k], tol_deg) == RET_BUSY)
+		{
+			n += rr_blend_get_points(blend, points + n, n_wp * RR_BLEND_MAX_POINTS - n, false);
+			rr_blend_add_waypoint(blend, waypoints[k], tol_deg);
+		}
+	}
+	n += rr_blend_get_points(blend, points + n, n_wp * RR_BLEND_MAX_POINTS - n, true);
+	rr_deinit_blend(&blend);
+
+	char name[64];
+	snprintf(name, sizeof(name), "Blending, tolerance %.1f deg", tol_deg);
+
+	int fails = check_points(name, &start, points, n, &limits);
+	if(fabs(points[n - 1].position_deg - waypoints[n_wp - 1]) > REF_TOL_DEG)
+	{
+		API_DEBUG("%s: the motion ends at %.4f instead of %.4f\n", name, points[n - 1].position_deg, waypoints[n_wp - 1]);
+		fails++;
+	}
+
+	return fails;
+}
+//! [Check blending]
+
+//! [Check fit]
+#define FIT_SAMPLES 2001
+#define FIT_STEP_MS 1
+#define FIT_TOL_DEG 0.01
+
+static int check_fit(void)
+{
+	//30 deg amplitude, 0.5 Hz sine: peak velocity 30 * pi, acceleration 30 * pi^2
+	const double w = M_PI;
+	const rr_trj_limits_t limits = {1.01 * 30 * w, 1.05 * 30 * w * w, 0};
+	static float pos[FIT_SAMPLES], vel[FIT_SAMPLES], acc[FIT_SAMPLES], fitted[FIT_SAMPLES];
+	static rr_motion_point_t points[FIT_SAMPLES];
+	rr_motion_point_t start;
+	int n = FIT_SAMPLES;
+
+	for(int k = 0; k < FIT_SAMPLES; k++)
+	{
+		double t = k * FIT_STEP_MS / 1000.0;
+
+		pos[k] = 30 * sin(w * t);
+		vel[k] = 30 * w * cos(w * t);
+		acc[k] = -30 * w * w * sin(w * t);
+	}
+	if(rr_trj_fit(pos, vel, acc, FIT_SAMPLES, FIT_STEP_MS, FIT_TOL_DEG, &start, points, &n) != RET_OK)
+	{
+		API_DEBUG("Fit: fitting failed\n");
+		return 1;
+	}
+
+	rr_trj_segment_t *seg = (rr_trj_segment_t *)malloc(n * sizeof(rr_trj_segment_t));
+	double err = INFINITY;
+
+	if(seg && (rr_trj_compile(&start, points, n, true, seg) == RET_OK) &&
+			(rr_trj_sample(seg, n, FIT_STEP_MS / 1000.0, fitted, NULL, NULL, FIT_SAMPLES) == FIT_SAMPLES))
+	{
+		err = 0;
+		for(int k = 0; k < FIT_SAMPLES; k++)
+		{
+			err = fmax(err, fabs(fitted[k] - pos[k]));
+		}
+	}
+	free(seg);
+
+	int fails = err > FIT_TOL_DEG + REF_TOL_DEG;
+	API_DEBUG("Fit: %d samples -> %d points, max deviation %.4f deg %s\n", FIT_SAMPLES, n, err, fails ? "FAIL" : "OK");
+
+	return fails + check_points("Fit", &start, points, n, &limits);
+}
+//! [Check fit]
+
+//! [Check trajectory file]
+#define TRJ_FILE_PATH "check_trajectory_models.rrtj"
+#define TRJ_CSV_PATH "check_trajectory_models.csv"
+
+static const rr_trj_file_axis_t file_axes[] = {
+	{.id = 32, .count = sizeof(ref_points) / sizeof(ref_points[0]), .start = {0, 0, 0, 0}},
+	{.id = 33, .count = 2, .start = {-10, 5, 0, 0}}};
+static const rr_motion_point_t file_points[] = {{-7.5, 0, 0, 1000}, {0.125, -2.5, 0, 500}};
+
+static int check_file_axes(const char *name, const char *path)
+{
+	const rr_motion_point_t *points[] = {ref_points, file_points};
+	const int n_axes = sizeof(file_axes) / sizeof(file_axes[0]);
+	rr_trj_file_t *file = rr_trj_file_open(path, true);
+	int n, fails = 0;
+	bool pvat;
+
+	if(!file || (rr_trj_file_get_info(file, &n, &pvat) != RET_OK) || (n != n_axes) || !pvat)
+	{
+		API_DEBUG("%s: the file can't be opened or has a wrong header\n", name);
+		rr_trj_file_close(&file);
+		return 1;
+	}
+
+	for(int a = 0; a < n_axes; a++)
+	{
+		rr_trj_file_axis_t info;
+		const rr_motion_point_t *mapped;
+		rr_motion_point_t read[8];
+		int got = 0, r;
+
+		if((rr_trj_file_get_axis(file, a, &info, &mapped, &n) != RET_OK) || (info.id != file_axes[a].id) || (n != (int)file_axes[a].count) ||
+				memcmp(&info.start, &file_axes[a].start, 3 * sizeof(float)) || memcmp(mapped, points[a], n * sizeof(rr_motion_point_t)))
+		{
+			API_DEBUG("%s: axis %d differs from the written one\n", name, a);
+			fails++;
+			continue;
+		}
+		//read the points in chunks of two, as a trajectory stream does
+		while((r = rr_trj_file_source(file, a, read + got, 2)) > 0)
+		{
+			got += r;
+		}
+		if((r < 0) || (got != n) || memcmp(read, points[a], n * sizeof(rr_motion_point_t)))
+		{
+			API_DEBUG("%s: axis %d source returned %d of %d points\n", name, a, got, n);
+			fails++;
+		}
+	}
+	rr_trj_file_close(&file);
+
+	API_DEBUG("%s: %d axes %s\n", name, n_axes, fails ? "FAIL" : "OK");
+	return fails;
+}
+
+static rr_ret_status_t convert_csv(const char *text)
+{
+	FILE *fp = fopen(TRJ_CSV_PATH, "w");
+
+	if(!fp)
+	{
+		return RET_ERROR;
+	}
+	fputs(text, fp);
+	fclose(fp);
+
+	return rr_trj_file_from_csv(TRJ_CSV_PATH, TRJ_FILE_PATH, true);
+}
+
+static int check_file(void)
+{
+	const rr_motion_point_t *points[] = {ref_points, file_points};
+	int fails = 0;
+
+	if(rr_trj_file_write(TRJ_FILE_PATH, file_axes, points, 2, true) != RET_OK)
+	{
+		API_DEBUG("Trajectory file: writing failed\n");
+		return 1;
+	}
+	fails += check_file_axes("Trajectory file", TRJ_FILE_PATH);
+
+	//the same trajectory in CSV: the zero-time lines are the initial states
+	const char *csv =
+		"id, position, velocity, acceleration, time_ms\n"
+		"# axis 32 starts at rest at 0\n"
+		"32, 0, 0, 0, 0\n"
+		"32, 12, 40, 100, 250\n"
+		"33, -10, 5, 0, 0\n"
+		"33, -7.5, 0, 0, 1000\n"
+		"32, 30, 20, -150, 500\n"
+		"33, 0.125, -2.5, 0, 500\n"
+		"32, 35, 0, 0, 250\n";
+
+	if(convert_csv(csv) != RET_OK)
+	{
+		API_DEBUG("CSV trajectory: conversion failed\n");
+		fails++;
+	}
+	else
+	{
+		fails += check_file_axes("CSV trajectory", TRJ_FILE_PATH);
+	}
+
+	char long_line[400];
+	snprintf(long_line, sizeof(long_line), "32, 1, 0, 0, 100\n32, 2, 0, 0, 100%*s\n", 300, "");
+
+	const char *bad[] = {"32, 1, 0, 0, 100.5\n", "32, 1, 0, 0, 5000000000\n", "32, 1, 0, 0, -100\n", long_line};
+	for(unsigned k = 0; k < sizeof(bad) / sizeof(bad[0]); k++)
+	{
+		if(convert_csv(bad[k]) != RET_WRONG_TRAJ)
+		{
+			API_DEBUG("CSV trajectory: malformed line %u is accepted\n", k);
+			fails++;
+		}
+	}
+	remove(TRJ_CSV_PATH);
+	remove(TRJ_FILE_PATH);
+
+	return fails;
+}
+//! [Check trajectory file]
+
+int main(int argc, char *argv[])
+{
+	int fails = 0;
+
+	fails += check_model(true, ref_pvat);
+	fails += check_model(false, ref_pvt);
+	fails += check_scurve();
+	fails += check_blend(0);
+	fails += check_blend(1);
+	fails += check_fit();
+	fails += check_file();
+
+	if(fails)
+	{
+		API_DEBUG("ERROR: %d trajectory checks failed\n", fails);
+	}
+	else
+	{
+		API_DEBUG("All trajectory checks passed\n");
+	}
+
+	return fails ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+//! [check_trajectory_models_code_full]
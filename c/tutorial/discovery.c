@@ -19,11 +19,14 @@
  *\snippet discovery.c Init interface33
  *3. Enable the RR_NMT_HB_TIMEOUT variable.
  *\snippet discovery.c Enable hb variable
- *4. Run a work cycle to scan the CAN bus, reading the states of potentially available CAN devices every 100 ms. Compare the read values with the previous states.
+ *4. Run a work cycle to scan the CAN bus every 100 ms. The ::rr_net_list_nodes function returns all devices
+ *whose heartbeats are being received, without any CAN communication. Compare the read states with the previous ones.
  *\snippet discovery.c Scan
- *5. Run an auxiliary function to display the following data about available CAN devices:
+ *5. Run an auxiliary function to display the following data about newly appeared CAN devices. 
+ *The ::rr_net_identify_nodes function reads the data of all the devices concurrently:
  *<ul><li> Hardware and software version</li>
- *<li>Device name</li></ul>
+ *<li>Device name</li>
+ *<li>Vendor ID, product code, revision and serial number</li></ul>
  *\snippet discovery.c auxiliary to display
  *The same sequence of scanning the CAN bus repeats multiple times
  *until you stop the program by pressing the Ctrl-C hotkey combination.
@@ -33,47 +36,22 @@
   */
    
 //! [discovery_code_full]
-void sdo_read_str(rr_servo_t *servo, uint16_t idx, uint8_t sidx, char *buf, int max_sz)
-{
-	if(!buf)
-	{
-		return;
-	}
-	if(max_sz <= 0)
-	{
-		buf[0] = 0;
-	}
-	max_sz--;
-    if(rr_read_raw_sdo(servo, idx, sidx, buf, &max_sz, 1, 200) == RET_OK)
-	{
-		buf[max_sz] = '\0';
-	}
-	else
-	{
-		buf[0] = '\0';
-	}
-
-}
-
      //! [auxiliary to display]
-void get_dev_info(rr_can_interface_t *iface, int id)
+void get_dev_info(rr_can_interface_t *iface, rr_net_node_t *nodes, int n)
 {
-	rr_servo_t *servo = rr_init_servo(iface, id);
+	rr_net_node_identity_t ident[MAX_CO_DEV];
 
-	char name[1024];
-	char hw[1024];
-	char sw[1024];
+	rr_net_identify_nodes(iface, nodes, ident, n);
 
-	sdo_read_str(servo, 0x1008, 0, name, sizeof(name));
-	sdo_read_str(servo, 0x1009, 0, hw, sizeof(hw));
-	sdo_read_str(servo, 0x100a, 0, sw, sizeof(sw));
-
-	API_DEBUG("Device %d:\n  NAME: %s\n  HW: %s\n  SW: %s\n", id,
-			name[0] ? name : "N/A",
-			hw[0] ? hw : "N/A",
-			sw[0] ? sw : "N/A");
-
-	rr_deinit_servo(&servo);
+	for(int i = 0; i < n; i++)
+	{
+		rr_net_node_identity_t *d = &ident[i];
+		API_DEBUG("Device %d:\n  NAME: %s\n  HW: %s\n  SW: %s\n  VENDOR: 0x%X PRODUCT: 0x%X REV: 0x%X SERIAL: %u\n", d->id,
+				d->device_name[0] ? d->device_name : "N/A",
+				d->hw_version[0] ? d->hw_version : "N/A",
+				d->sw_version[0] ? d->sw_version : "N/A",
+				d->vendor_id, d->product_code, d->revision, d->serial);
+	}
 }
 //! [auxiliary to display]
 
@@ -81,7 +59,8 @@ void get_dev_info(rr_can_interface_t *iface, int id)
 int main(int argc, char *argv[])
 {
 	rr_nmt_state_t states[MAX_CO_DEV];
-	rr_nmt_state_t state;
+	rr_net_node_t nodes[MAX_CO_DEV];
+	rr_net_node_t appeared[MAX_CO_DEV];
 
 	if(argc != 2)
 	{
@@ -114,24 +93,40 @@ int main(int argc, char *argv[])
 	{
 		rr_sleep_ms(100);
 
-		for(int i = 0; i < MAX_CO_DEV; i++)
+		int n = MAX_CO_DEV;
+		int n_appeared = 0;
+		bool alive[MAX_CO_DEV] = {false};
+
+		rr_net_list_nodes(iface, nodes, &n);
+
+		for(int i = 0; i < n; i++)
 		{
-			rr_net_get_state(iface, i, &state);
-			if(states[i] != state)
+			int id = nodes[i].id;
+			alive[id] = true;
+			if(states[id] != nodes[i].state)
 			{
-				states[i] = state;
-				if(state != RR_NMT_HB_TIMEOUT)
-				{
-					get_dev_info(iface, i);
-				}
-				else
+				if(states[id] == RR_NMT_HB_TIMEOUT)
 				{
-					API_DEBUG("DEVICE %d disappeared\n", i);
+					appeared[n_appeared++] = nodes[i];
 				}
+				states[id] = nodes[i].state;
 			}
 		}
+
+		for(int i = 0; i < MAX_CO_DEV; i++)
+		{
+			if(!alive[i] && (states[i] != RR_NMT_HB_TIMEOUT))
+			{
+				states[i] = RR_NMT_HB_TIMEOUT;
+				API_DEBUG("DEVICE %d disappeared\n", i);
+			}
+		}
+
+		if(n_appeared)
+		{
+			get_dev_info(iface, appeared, n_appeared);
+		}
 	}
 	//! [Scan]
 }
 //! [discovery_code_full]
-
@@ -165,6 +165,10 @@ int main(int argc, char *argv[])
 	//set cycle time
 	rr_pdo_set_cycle_time(servo, 1.0e6 * dt);
 
+	//collect SYNC jitter and TPDO latency statistics, print them to the debug log every 5 seconds
+	rr_cycle_monitor_start(iface, 1.0e6 * dt, 0, &id, 1);
+	rr_cycle_monitor_set_summary(iface, 5000);
+
 	if(!high_prio)
 	{
 		printf("!!! WARNING: Setting of high priority for process has failed. Servo may work unstable.\n");